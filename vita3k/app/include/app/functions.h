@@ -39,6 +39,8 @@ enum class AppRunType {
 };
 
 bool init(EmuEnvState &state, Config &cfg, const Root &root_paths);
+// Sets up the paths, memory and file system only, without window, audio or renderer
+bool init_headless(EmuEnvState &state, Config &cfg, const Root &root_paths);
 void destroy(EmuEnvState &emuenv, ImGui_State *imgui);
 void update_viewport(EmuEnvState &state);
 void error_dialog(const std::string &message, SDL_Window *window = nullptr);
@@ -95,15 +95,7 @@ void update_viewport(EmuEnvState &state) {
     }
 }
 
-bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
-    const ResumeAudioThread resume_thread = [&state](SceUID thread_id) {
-        const auto thread = lock_and_find(thread_id, state.kernel.threads, state.kernel.mutex);
-        const std::lock_guard<std::mutex> lock(thread->mutex);
-        if (thread->status == ThreadStatus::wait) {
-            thread->update_status(ThreadStatus::run);
-        }
-    };
-
+static void init_paths(EmuEnvState &state, Config &cfg, const Root &root_paths) {
     state.cfg = std::move(cfg);
 
     state.base_path = root_paths.get_base_path_string();
@@ -117,6 +109,18 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
             state.cfg.pref_path += '/';
         state.pref_path = string_utils::utf_to_wide(state.cfg.pref_path);
     }
+}
+
+bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
+    const ResumeAudioThread resume_thread = [&state](SceUID thread_id) {
+        const auto thread = lock_and_find(thread_id, state.kernel.threads, state.kernel.mutex);
+        const std::lock_guard<std::mutex> lock(thread->mutex);
+        if (thread->status == ThreadStatus::wait) {
+            thread->update_status(ThreadStatus::run);
+        }
+    };
+
+    init_paths(state, cfg, root_paths);
 
     state.backend_renderer = renderer::Backend::Vulkan;
 
@@ -212,6 +216,22 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
     return true;
 }
 
+bool init_headless(EmuEnvState &state, Config &cfg, const Root &root_paths) {
+    init_paths(state, cfg, root_paths);
+
+    if (!init(state.mem)) {
+        LOG_ERROR("Failed to initialize memory for emulator state!");
+        return false;
+    }
+
+    if (!init(state.io, state.base_path, state.pref_path, state.cfg.console)) {
+        LOG_ERROR("Failed to initialize file system for the emulator!");
+        return false;
+    }
+
+    return true;
+}
+
 void destroy(EmuEnvState &emuenv, ImGui_State *imgui) {
     ImGui_ImplSdl_Shutdown(imgui);
 
@@ -18,10 +18,15 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
+#include <vector>
 
 struct AVFrame;
 struct AVPacket;
@@ -205,6 +210,9 @@ struct AacDecoderState : public DecoderState {
 };
 
 struct PlayerState {
+    // Number of video frames the decoder thread keeps decoded ahead of the guest.
+    constexpr static size_t DECODE_AHEAD_FRAMES = 4;
+
     std::string video_playing;
     std::queue<std::string> videos_queue;
 
@@ -220,22 +228,46 @@ struct PlayerState {
     uint64_t time_of_last_frame = 0;
     uint64_t framerate_microseconds = 0;
 
-    uint64_t last_timestamp = 0;
+    // Timestamp of the last frame given to the guest, read by other guest threads
+    std::atomic<uint64_t> last_timestamp = 0;
     uint32_t last_channels = 0;
     uint32_t last_sample_rate = 0;
     uint32_t last_sample_count = 0;
 
+    // Protects the demuxer, the codec contexts and the packet queues, taken before frames_mutex.
+    std::mutex decode_mutex;
+
+    // Protects the decoded frames, the frame pool and the start of the decoder thread.
+    std::mutex frames_mutex;
+    std::condition_variable frames_cond;
+    std::queue<AVFrame *> decoded_frames;
+    std::vector<AVFrame *> free_frames;
+    DecoderSize last_size{};
+    bool decode_idle = true;
+    bool stop_decoding = false;
+    std::thread decode_thread;
+
+    // Size of the next frame. The size is only known once a frame is decoded, so this blocks until
+    // the decoder thread has decoded one, or has nothing left to decode and returns the last size.
     DecoderSize get_size();
     uint64_t get_framerate_microseconds();
+    bool is_playing();
 
     void pop_video();
+    void stop();
+
+    // These must be called with decode_mutex held.
     void free_video();
     void switch_video(const std::string &path);
-
     bool next_packet(int32_t stream_id);
+    bool decode_video_frame(AVFrame *frame);
+
+    void decode_loop();
+    void clear_decoded_frames();
 
     std::vector<int16_t> receive_audio();
-    std::vector<uint8_t> receive_video();
+    // Pops the next decoded frame and copies it to dest, which must hold H264DecoderState::buffer_size(get_size()) bytes.
+    bool receive_video(uint8_t *dest);
 
     void queue(const std::string &path);
 
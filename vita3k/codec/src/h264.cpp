@@ -145,6 +145,9 @@ H264DecoderState::H264DecoderState(uint32_t width, uint32_t height) {
     assert(context);
     context->width = width;
     context->height = height;
+    // Every access unit sent must give its picture back right away, frame threading would delay them
+    context->thread_count = 0;
+    context->thread_type = FF_THREAD_SLICE;
 
     int result = avcodec_open2(context, codec, nullptr);
     assert(result == 0);
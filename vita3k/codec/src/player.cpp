@@ -26,25 +26,54 @@ extern "C" {
 }
 
 #include <cassert>
-#include <chrono>
 
 uint64_t PlayerState::get_framerate_microseconds() {
-    AVRational rational = format->streams[video_stream_id]->avg_frame_rate;
-    return static_cast<float>(rational.den) / static_cast<float>(rational.num) * 1000000;
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    return framerate_microseconds;
 }
 
 DecoderSize PlayerState::get_size() {
-    if (video_context)
-        return { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) };
+    std::unique_lock<std::mutex> lock(frames_mutex);
+    frames_cond.wait(lock, [&] { return !decoded_frames.empty() || decode_idle; });
 
-    return {};
+    if (!decoded_frames.empty()) {
+        const AVFrame *frame = decoded_frames.front();
+        last_size = { static_cast<uint32_t>(frame->width), static_cast<uint32_t>(frame->height) };
+    }
+
+    return last_size;
+}
+
+bool PlayerState::is_playing() {
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    return !decode_idle || !decoded_frames.empty();
 }
 
 void PlayerState::pop_video() {
+    std::lock_guard<std::mutex> decode_lock(decode_mutex);
+    if (videos_queue.empty())
+        return;
+
+    {
+        // before the switch, so that the first frames of the next video are kept
+        std::lock_guard<std::mutex> frames_lock(frames_mutex);
+        clear_decoded_frames();
+    }
+
     switch_video(videos_queue.front());
     videos_queue.pop();
 }
 
+void PlayerState::stop() {
+    std::lock_guard<std::mutex> decode_lock(decode_mutex);
+    free_video();
+
+    std::lock_guard<std::mutex> frames_lock(frames_mutex);
+    clear_decoded_frames();
+    decode_idle = true;
+    frames_cond.notify_all();
+}
+
 void PlayerState::free_video() {
     if (video_context) {
         avcodec_close(video_context);
@@ -91,12 +120,19 @@ void PlayerState::switch_video(const std::string &path) {
     video_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
     audio_stream_id = av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
 
+    uint64_t framerate = 0;
     if (video_stream_id >= 0) {
         AVStream *video_stream = format->streams[video_stream_id];
         AVCodec *video_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
         video_context = avcodec_alloc_context3(video_codec);
         avcodec_parameters_to_context(video_context, video_stream->codecpar);
+        // Frames are decoded ahead on the decoder thread, the added latency of frame threading does not matter
+        video_context->thread_count = 0;
+        video_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
         avcodec_open2(video_context, video_codec, nullptr);
+
+        AVRational rational = video_stream->avg_frame_rate;
+        framerate = static_cast<float>(rational.den) / static_cast<float>(rational.num) * 1000000;
     }
 
     if (audio_stream_id >= 0) {
@@ -106,6 +142,13 @@ void PlayerState::switch_video(const std::string &path) {
         avcodec_parameters_to_context(audio_context, audio_stream->codecpar);
         avcodec_open2(audio_context, audio_codec, nullptr);
     }
+
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        framerate_microseconds = framerate;
+        decode_idle = false;
+    }
+    frames_cond.notify_all();
 }
 
 bool PlayerState::next_packet(int32_t stream_id) {
@@ -132,8 +175,10 @@ bool PlayerState::next_packet(int32_t stream_id) {
         }
 
         AVPacket *packet = av_packet_alloc();
-        if (av_read_frame(format, packet) != 0)
+        if (av_read_frame(format, packet) != 0) {
+            av_packet_free(&packet);
             return false;
+        }
 
         if (packet->stream_index == stream_id) {
             this_queue.push(packet);
@@ -143,7 +188,81 @@ bool PlayerState::next_packet(int32_t stream_id) {
     }
 }
 
+bool PlayerState::decode_video_frame(AVFrame *frame) {
+    if (video_stream_id < 0 || !video_context)
+        return false;
+
+    if (video_playing.empty())
+        return false;
+
+    int error;
+    while (true) {
+        error = avcodec_receive_frame(video_context, frame);
+
+        if (error == AVERROR(EAGAIN)) {
+            if (next_packet(video_stream_id))
+                continue;
+
+            // Drain the frames the decoder threads still hold, sending a second flush packet fails with AVERROR_EOF
+            if (avcodec_send_packet(video_context, nullptr) == 0)
+                continue;
+        }
+
+        if (error != 0) {
+            if (videos_queue.empty()) {
+                // Stop playing videos or
+                video_playing = "";
+                return false;
+            } else {
+                // Play the next video (if there is any).
+                switch_video(videos_queue.front());
+                videos_queue.pop();
+                continue;
+            }
+        }
+
+        return true;
+    }
+}
+
+void PlayerState::decode_loop() {
+    while (true) {
+        AVFrame *frame;
+        {
+            std::unique_lock<std::mutex> lock(frames_mutex);
+            frames_cond.wait(lock, [&] { return stop_decoding || (!decode_idle && !free_frames.empty()); });
+            if (stop_decoding)
+                return;
+
+            frame = free_frames.back();
+            free_frames.pop_back();
+        }
+
+        std::lock_guard<std::mutex> decode_lock(decode_mutex);
+        const bool decoded = decode_video_frame(frame);
+
+        std::lock_guard<std::mutex> frames_lock(frames_mutex);
+        if (decoded) {
+            decoded_frames.push(frame);
+        } else {
+            free_frames.push_back(frame);
+            decode_idle = true;
+        }
+        frames_cond.notify_all();
+    }
+}
+
+void PlayerState::clear_decoded_frames() {
+    while (!decoded_frames.empty()) {
+        AVFrame *frame = decoded_frames.front();
+        decoded_frames.pop();
+        av_frame_unref(frame);
+        free_frames.push_back(frame);
+    }
+}
+
 std::vector<int16_t> PlayerState::receive_audio() {
+    std::lock_guard<std::mutex> lock(decode_mutex);
     if (audio_stream_id < 0)
         return {};
 
@@ -197,63 +316,73 @@ std::vector<int16_t> PlayerState::receive_audio() {
     return data;
 }
 
-std::vector<uint8_t> PlayerState::receive_video() {
-    if (video_stream_id < 0)
-        return {};
-
-    if (video_playing.empty())
-        return {};
-
-    int error;
-    AVFrame *frame = av_frame_alloc();
-    std::vector<uint8_t> data;
-    while (true) {
-        error = avcodec_receive_frame(video_context, frame);
-
-        if (error == AVERROR(EAGAIN) && next_packet(video_stream_id))
-            continue;
+bool PlayerState::receive_video(uint8_t *dest) {
+    AVFrame *frame;
+    {
+        std::unique_lock<std::mutex> lock(frames_mutex);
+        frames_cond.wait(lock, [&] { return !decoded_frames.empty() || decode_idle; });
+        if (decoded_frames.empty())
+            return false;
 
-        if (error != 0) {
-            if (videos_queue.empty()) {
-                // Stop playing videos or
-                video_playing = "";
-                break;
-            } else {
-                // Play the next video (if there is any).
-                switch_video(videos_queue.front());
-                videos_queue.pop();
-                continue;
-            }
-        }
+        frame = decoded_frames.front();
+        decoded_frames.pop();
+    }
 
-        last_timestamp = frame->best_effort_timestamp;
+    // The frame is out of the queue, the decoder thread does not touch it until it is given back
+    last_timestamp = frame->best_effort_timestamp;
+    if (dest)
+        copy_yuv_data_from_frame(frame, dest);
 
-        data.resize(H264DecoderState::buffer_size(
-            { static_cast<uint32_t>(video_context->width), static_cast<uint32_t>(video_context->height) }));
-        copy_yuv_data_from_frame(frame, data.data());
+    av_frame_unref(frame);
 
-        break;
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        free_frames.push_back(frame);
     }
-
-    av_frame_free(&frame);
-    return data;
+    frames_cond.notify_all();
+    return true;
 }
 
 void PlayerState::queue(const std::string &path) {
     if (fs::exists(path)) {
         LOG_INFO("Queued video: '{}'.", path);
-        if (video_playing.empty())
-            switch_video(path);
-        else
-            videos_queue.push(path);
+        {
+            std::lock_guard<std::mutex> lock(decode_mutex);
+            if (video_playing.empty())
+                switch_video(path);
+            else
+                videos_queue.push(path);
+        }
+
+        // Guest threads can queue videos at the same time, only one starts the decoder thread
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        if (!decode_thread.joinable()) {
+            for (size_t i = 0; i < DECODE_AHEAD_FRAMES; i++)
+                free_frames.push_back(av_frame_alloc());
+
+            decode_thread = std::thread([this] { decode_loop(); });
+        }
     } else {
         LOG_INFO("Cannot find video: {}", path);
     }
 }
 
 PlayerState::~PlayerState() {
+    if (decode_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(frames_mutex);
+            stop_decoding = true;
+        }
+        frames_cond.notify_all();
+        decode_thread.join();
+    }
+
     free_video();
 
+    clear_decoded_frames();
+    for (AVFrame *frame : free_frames)
+        av_frame_free(&frame);
+
     video_playing = "";
     videos_queue = {};
 }
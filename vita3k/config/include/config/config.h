@@ -35,6 +35,12 @@ enum PerfomanceOverleyDetail {
     MAXIMUM,
 };
 
+enum ShaderCompilationMode {
+    SHADER_COMPILATION_SYNC,
+    SHADER_COMPILATION_ASYNC, // Draws with a fallback pipeline when there is one, waits otherwise
+    SHADER_COMPILATION_ASYNC_SKIP_DRAW, // Never waits, draws without a pipeline are skipped
+};
+
 enum PerfomanceOverleyPosition {
     TOP_LEFT,
     TOP_CENTER,
@@ -53,6 +59,7 @@ enum PerfomanceOverleyPosition {
     code(bool, "gdbstub", false, gdbstub)                                                               \
     code(bool, "log-active-shaders", false, log_active_shaders)                                         \
     code(bool, "log-uniforms", false, log_uniforms)                                                     \
+    code(bool, "log-command-stats", false, log_command_stats)                                           \
     code(bool, "pstv-mode", false, pstv_mode)                                                           \
     code(bool, "show-gui", false, show_gui)                                                             \
     code(bool, "show-info-bar", false, show_info_bar)                                                   \
@@ -64,11 +71,14 @@ enum PerfomanceOverleyPosition {
     code(int, "gpu-idx", 0, gpu_idx)                                                                    \
     code(int, "resolution-multiplier", 1, resolution_multiplier)                                        \
     code(bool, "disable-surface-sync", false, disable_surface_sync)                                     \
+    code(bool, "vulkan-surface-readback", false, vulkan_surface_readback)                               \
     code(bool, "enable-fxaa", false, enable_fxaa)                                                       \
     code(bool, "v-sync", true, v_sync)                                                                  \
     code(int, "anisotropic-filtering", 1, anisotropic_filtering)                                        \
     code(bool, "texture-cache", true, texture_cache)                                                    \
     code(bool, "hashless-texture-cache", false, hashless_texture_cache)                                 \
+    code(int, "texture-cache-size", 1024, texture_cache_size)                                           \
+    code(int, "shader-compilation-mode", static_cast<int>(SHADER_COMPILATION_SYNC), shader_compilation_mode) \
     code(bool, "boot-apps-full-screen", false, boot_apps_full_screen)                                   \
     code(std::string, "audio-backend", "SDL", audio_backend)                                            \
     code(bool, "ngs-enable", true, ngs_enable)                                                          \
@@ -128,8 +138,6 @@ enum PerfomanceOverleyPosition {
     code(bool, "http-enable", true, http_enable)                                                        \
     code(int, "http-timeout-attempts", 50, http_timeout_attempts)                                       \
     code(int, "http-timeout-sleep-ms", 100, http_timeout_sleep_ms)                                      \
-    code(int, "http-read-end-attempts", 10, http_read_end_attempts)                                     \
-    code(int, "http-read-end-sleep-ms", 250, http_read_end_sleep_ms)                                    \
     code(bool, "tracy-primitive-impl", false, tracy_primitive_impl)
 
 // Vector members produced in the config file
@@ -80,6 +80,8 @@ private:
         load_app_list = rhs.load_app_list;
         self_path = rhs.self_path;
         shader_cache = rhs.shader_cache;
+        populate_module_cache = rhs.populate_module_cache;
+        run_from_archive = rhs.run_from_archive;
     }
 
 public:
@@ -100,6 +102,8 @@ public:
     bool fullscreen = false;
     bool console = false;
     bool load_app_list = false;
+    bool populate_module_cache = false;
+    bool run_from_archive = false;
 
     /**
      * @brief Available HLE modules for advanced profiling using Tracy
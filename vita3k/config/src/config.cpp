@@ -156,6 +156,10 @@ ExitCode init_config(Config &cfg, int argc, char **argv, const Root &root_paths)
         ->default_str({})->group("Input");
     input->add_option("--shader-cache,-D", command_line.shader_cache, "Enable shader cache to pre-compile it at boot up")
        ->default_val(true)->group("Input");
+    input->add_flag("--populate-module-cache", command_line.populate_module_cache, "Load the modules of the app given with --installed-path or as a .vpk/.zip content path into the module cache and quit, without opening a window")
+        ->group("Input");
+    input->add_flag("--no-install", command_line.run_from_archive, "Run the app given with content-path from its .vpk/.zip without installing it")
+        ->group("Input");
     input->add_option("--deleted-id,-d", command_line.delete_title_id, "Title ID of installed app to delete")
         ->default_str({})->check(CLI::IsMember(get_file_set(fs::path(cfg.pref_path) / "ux0/app")))->group("Input");
     auto input_pkg = input->add_option("--pkg", command_line.pkg_path, "Path of app (in .pkg format) to install")
@@ -41,11 +41,13 @@ typedef std::function<Address(Address)> GetWatchMemoryAddr;
 typedef std::unique_ptr<CPUState, std::function<void(CPUState *)>> CPUStatePtr;
 typedef std::unique_ptr<CPUInterface> CPUInterfacePtr;
 typedef void *ExclusiveMonitorPtr;
+typedef void *JitCachePtr;
 
 struct CPUProtocolBase {
     virtual void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) = 0;
     virtual Address get_watch_memory_addr(Address addr) = 0;
     virtual ExclusiveMonitorPtr get_exlusive_monitor() = 0;
+    virtual JitCachePtr get_jit_cache() = 0;
     virtual ~CPUProtocolBase() = default;
 };
 
@@ -108,6 +110,13 @@ struct CPUContext {
     }
 };
 
+struct JitCacheStats {
+    uint64_t created = 0;
+    uint64_t reused = 0;
+    // Guest instructions the reused JITs had already translated, at the time they were reused
+    uint64_t reused_instructions = 0;
+};
+
 enum class CPUBackend {
     Dynarmic,
     Unicorn,
@@ -62,6 +62,11 @@ ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores);
 void free_exclusive_monitor(ExclusiveMonitorPtr monitor);
 void clear_exclusive(ExclusiveMonitorPtr monitor, std::size_t core_num);
 
+JitCachePtr new_jit_cache();
+void free_jit_cache(JitCachePtr cache);
+void invalidate_jit_cache(JitCachePtr cache, Address start, size_t length);
+JitCacheStats get_jit_cache_stats(JitCachePtr cache);
+
 // Debugging helpers
 std::string disassemble(CPUState &state, uint64_t at, bool thumb, uint16_t *insn_size = nullptr);
 std::string disassemble(CPUState &state, uint64_t at, uint16_t *insn_size = nullptr);
@@ -25,14 +25,60 @@
 #include <cpu/functions.h>
 #include <cpu/impl/unicorn_cpu.h>
 
+#include <atomic>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 class ArmDynarmicCallback;
 class ArmDynarmicCP15;
+class DynarmicCPU;
+
+/*! \brief Dynarmic JIT instance with the callbacks it was compiled against */
+struct DynarmicJitInstance {
+    std::unique_ptr<ArmDynarmicCallback> cb;
+    std::shared_ptr<ArmDynarmicCP15> cp15;
+    std::unique_ptr<Dynarmic::A32::Jit> jit;
+};
+
+/*!
+ * \brief Process-wide cache of Dynarmic JITs shared by all guest threads.
+ *
+ * Dynarmic keeps translated code inside each Jit, so instead of compiling the same game code again
+ * for every new thread, JITs of exited threads are kept warm here and handed to the next thread
+ * created with a compatible configuration. Idle JITs are invalidated right away, while the
+ * invalidations of live JITs are queued and applied by the thread running them, as Dynarmic
+ * does not synchronize them with a concurrent Run.
+ */
+class DynarmicJitCache {
+    // Upper bound of idle JITs kept around, each of them holds its own code cache
+    static constexpr size_t MAX_IDLE_JITS = 32;
+
+    std::mutex mutex;
+    std::map<uint64_t, std::vector<DynarmicJitInstance>> idle_jits;
+    std::map<Dynarmic::A32::Jit *, DynarmicCPU *> live_jits;
+    size_t idle_count = 0;
+    // Set once the kernel is done with the cache, the last live JIT released then deletes it
+    bool closed = false;
+    JitCacheStats stats;
+
+public:
+    static uint64_t make_key(std::size_t core_id, bool fastmem, bool log_code, bool cpu_opt);
+
+    DynarmicJitInstance acquire(uint64_t key, DynarmicCPU &cpu);
+    void release(uint64_t key, DynarmicJitInstance instance, DynarmicCPU &cpu);
+    void invalidate(Address start, size_t length);
+    void apply_pending_invalidations(DynarmicCPU &cpu);
+    void close();
+    JitCacheStats get_stats();
+};
 
 class DynarmicCPU : public CPUInterface {
     friend class ArmDynarmicCallback;
+    friend class DynarmicJitCache;
 
     UnicornCPU fallback;
     CPUState *parent;
@@ -41,6 +87,11 @@ class DynarmicCPU : public CPUInterface {
     std::unique_ptr<ArmDynarmicCallback> cb;
     std::shared_ptr<ArmDynarmicCP15> cp15;
     Dynarmic::ExclusiveMonitor *monitor;
+    DynarmicJitCache *jit_cache;
+
+    // Ranges invalidated from other threads, guarded by the mutex of the JIT cache
+    std::vector<std::pair<Address, size_t>> pending_invalidations;
+    std::atomic<bool> invalidation_pending = false;
 
     std::size_t core_id = 0;
 
@@ -52,10 +103,13 @@ class DynarmicCPU : public CPUInterface {
     bool log_code = false;
     bool cpu_opt;
 
-    std::unique_ptr<Dynarmic::A32::Jit> make_jit();
+    uint64_t jit_key() const;
+    DynarmicJitInstance make_jit();
+    void acquire_jit();
+    void release_jit();
 
 public:
-    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt);
+    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, DynarmicJitCache *jit_cache, bool cpu_opt);
     ~DynarmicCPU() override;
     int run() override;
     void stop() override;
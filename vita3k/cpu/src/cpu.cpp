@@ -67,7 +67,8 @@ CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::si
     switch (backend) {
     case CPUBackend::Dynarmic: {
         Dynarmic::ExclusiveMonitor *monitor = reinterpret_cast<Dynarmic::ExclusiveMonitor *>(protocol->get_exlusive_monitor());
-        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, cpu_opt);
+        DynarmicJitCache *jit_cache = reinterpret_cast<DynarmicJitCache *>(protocol->get_jit_cache());
+        state->cpu = std::make_unique<DynarmicCPU>(state.get(), processor_id, monitor, jit_cache, cpu_opt);
         break;
     }
     case CPUBackend::Unicorn: {
@@ -88,9 +88,12 @@ public:
 
 class ArmDynarmicCallback : public Dynarmic::A32::UserCallbacks {
     friend class DynarmicCPU;
+    friend class DynarmicJitCache;
 
     CPUState *parent;
     DynarmicCPU *cpu;
+    // Instructions fetched by the translator, kept with the JIT when it is handed to another thread
+    uint64_t translated_instructions = 0;
 
 public:
     explicit ArmDynarmicCallback(CPUState &parent, DynarmicCPU &cpu)
@@ -102,6 +105,7 @@ public:
     std::optional<std::uint32_t> MemoryReadCode(Dynarmic::A32::VAddr addr) override {
         if (cpu->log_mem)
             LOG_TRACE("Instruction fetch at addr 0x{:X}", addr);
+        translated_instructions++;
         return MemoryRead32(addr);
     }
 
@@ -252,21 +256,21 @@ public:
         case Dynarmic::A32::Exception::Yield:
             break;
         case Dynarmic::A32::Exception::UndefinedInstruction:
-            LOG_WARN("Undefined instruction at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
+            LOG_WARN("Undefined instruction at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryRead32(pc), disassemble(*parent, pc, nullptr));
             InterpreterFallback(pc, 1);
             break;
         case Dynarmic::A32::Exception::UnpredictableInstruction:
-            LOG_WARN("Unpredictable instruction at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
+            LOG_WARN("Unpredictable instruction at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryRead32(pc), disassemble(*parent, pc, nullptr));
             InterpreterFallback(pc, 1);
             break;
         case Dynarmic::A32::Exception::DecodeError: {
-            LOG_WARN("Decode error at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
+            LOG_WARN("Decode error at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryRead32(pc), disassemble(*parent, pc, nullptr));
             InterpreterFallback(pc, 1);
             break;
         }
         default:
             LOG_WARN("Unknown exception {} Raised at pc = 0x{:x}", static_cast<size_t>(exception), pc);
-            LOG_TRACE("at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
+            LOG_TRACE("at addr 0x{:X}, inst 0x{:X} ({})", pc, MemoryRead32(pc), disassemble(*parent, pc, nullptr));
         }
     }
 
@@ -283,33 +287,171 @@ public:
     }
 };
 
-std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
+uint64_t DynarmicJitCache::make_key(std::size_t core_id, bool fastmem, bool log_code, bool cpu_opt) {
+    return (static_cast<uint64_t>(core_id) << 3) | (static_cast<uint64_t>(fastmem) << 2) | (static_cast<uint64_t>(log_code) << 1) | static_cast<uint64_t>(cpu_opt);
+}
+
+DynarmicJitInstance DynarmicJitCache::acquire(uint64_t key, DynarmicCPU &cpu) {
+    DynarmicJitInstance instance;
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        const auto it = idle_jits.find(key);
+        if (it != idle_jits.end() && !it->second.empty()) {
+            instance = std::move(it->second.back());
+            it->second.pop_back();
+            idle_count--;
+            // Registered in the same step, so that no invalidation is missed in between
+            live_jits.emplace(instance.jit.get(), &cpu);
+            stats.reused++;
+            stats.reused_instructions += instance.cb->translated_instructions;
+            LOG_DEBUG("Reusing cached JIT for thread {} with {} translated instructions ({} reused, {} created)", cpu.parent->thread_id, instance.cb->translated_instructions, stats.reused, stats.created);
+        }
+    }
+
+    if (instance.jit) {
+        // Rebind the callbacks to the new owner, the translated code is kept as is
+        instance.cb->parent = cpu.parent;
+        instance.cb->cpu = &cpu;
+        instance.cp15->set_tpidruro(0);
+        instance.jit->Reset();
+        instance.jit->ClearExclusiveState();
+        return instance;
+    }
+
+    // A new JIT has no code yet, invalidations made before it is registered do not matter
+    instance = cpu.make_jit();
+    const std::lock_guard<std::mutex> guard(mutex);
+    live_jits.emplace(instance.jit.get(), &cpu);
+    stats.created++;
+
+    return instance;
+}
+
+void DynarmicJitCache::release(uint64_t key, DynarmicJitInstance instance, DynarmicCPU &cpu) {
+    bool delete_cache;
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        live_jits.erase(instance.jit.get());
+        // The JIT does not run anymore, catch up with what was queued for it
+        for (const auto &[start, length] : cpu.pending_invalidations)
+            instance.jit->InvalidateCacheRange(start, length);
+        cpu.pending_invalidations.clear();
+        cpu.invalidation_pending = false;
+
+        delete_cache = closed && live_jits.empty();
+        if (!closed && (idle_count < MAX_IDLE_JITS)) {
+            instance.cb->parent = nullptr;
+            instance.cb->cpu = nullptr;
+            idle_jits[key].push_back(std::move(instance));
+            idle_count++;
+            return;
+        }
+    }
+
+    if (delete_cache) {
+        instance = {};
+        delete this;
+    }
+}
+
+void DynarmicJitCache::invalidate(Address start, size_t length) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    for (const auto &[jit, cpu] : live_jits) {
+        cpu->pending_invalidations.emplace_back(start, length);
+        cpu->invalidation_pending = true;
+        // Make a running JIT return to its thread so that it applies the invalidation soon
+        jit->HaltExecution();
+    }
+
+    for (auto &[_, instances] : idle_jits) {
+        for (auto &instance : instances)
+            instance.jit->InvalidateCacheRange(start, length);
+    }
+}
+
+void DynarmicJitCache::apply_pending_invalidations(DynarmicCPU &cpu) {
+    std::vector<std::pair<Address, size_t>> ranges;
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        ranges.swap(cpu.pending_invalidations);
+        cpu.invalidation_pending = false;
+    }
+
+    for (const auto &[start, length] : ranges)
+        cpu.jit->InvalidateCacheRange(start, length);
+}
+
+void DynarmicJitCache::close() {
+    std::map<uint64_t, std::vector<DynarmicJitInstance>> idle;
+    bool unused;
+    {
+        const std::lock_guard<std::mutex> guard(mutex);
+        closed = true;
+        idle.swap(idle_jits);
+        idle_count = 0;
+        unused = live_jits.empty();
+    }
+
+    idle.clear();
+    if (unused)
+        delete this;
+}
+
+JitCacheStats DynarmicJitCache::get_stats() {
+    const std::lock_guard<std::mutex> guard(mutex);
+    return stats;
+}
+
+uint64_t DynarmicCPU::jit_key() const {
+    return DynarmicJitCache::make_key(core_id, !log_mem && cpu_opt, log_code, cpu_opt);
+}
+
+DynarmicJitInstance DynarmicCPU::make_jit() {
+    DynarmicJitInstance instance;
+    instance.cb = std::make_unique<ArmDynarmicCallback>(*parent, *this);
+    instance.cp15 = std::make_shared<ArmDynarmicCP15>();
+
     Dynarmic::A32::UserConfig config;
     config.arch_version = Dynarmic::A32::ArchVersion::v7;
-    config.callbacks = cb.get();
+    config.callbacks = instance.cb.get();
     config.fastmem_pointer = (log_mem || !cpu_opt) ? nullptr : parent->mem->memory.get();
     config.hook_hint_instructions = true;
     config.global_monitor = monitor;
-    config.coprocessors[15] = cp15;
+    config.coprocessors[15] = instance.cp15;
     config.page_table = nullptr;
     config.processor_id = core_id;
     config.optimizations = cpu_opt ? Dynarmic::all_safe_optimizations : Dynarmic::no_optimizations;
 
-    return std::make_unique<Dynarmic::A32::Jit>(config);
+    instance.jit = std::make_unique<Dynarmic::A32::Jit>(config);
+    return instance;
+}
+
+void DynarmicCPU::acquire_jit() {
+    DynarmicJitInstance instance = jit_cache ? jit_cache->acquire(jit_key(), *this) : make_jit();
+    cb = std::move(instance.cb);
+    cp15 = std::move(instance.cp15);
+    jit = std::move(instance.jit);
 }
 
-DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt)
+void DynarmicCPU::release_jit() {
+    if (!jit_cache)
+        return;
+
+    jit_cache->release(jit_key(), { std::move(cb), std::move(cp15), std::move(jit) }, *this);
+}
+
+DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, DynarmicJitCache *jit_cache, bool cpu_opt)
     : fallback(state)
     , parent(state)
-    , cb(std::make_unique<ArmDynarmicCallback>(*state, *this))
-    , cp15(std::make_shared<ArmDynarmicCP15>())
     , monitor(monitor)
+    , jit_cache(jit_cache)
     , core_id(processor_id)
     , cpu_opt(cpu_opt) {
-    jit = make_jit();
+    acquire_jit();
 }
 
 DynarmicCPU::~DynarmicCPU() {
+    release_jit();
 }
 
 int DynarmicCPU::run() {
@@ -317,12 +459,16 @@ int DynarmicCPU::run() {
     break_ = false;
     exit_request = false;
     parent->svc_called = false;
+    if (invalidation_pending)
+        jit_cache->apply_pending_invalidations(*this);
     jit->Run();
     return halted;
 }
 
 int DynarmicCPU::step() {
     parent->svc_called = false;
+    if (invalidation_pending)
+        jit_cache->apply_pending_invalidations(*this);
     jit->Step();
     return 0;
 }
@@ -340,16 +486,18 @@ void DynarmicCPU::set_log_code(bool log) {
     if (log_code == log)
         return;
 
+    release_jit();
     log_code = log;
-    jit = make_jit();
+    acquire_jit();
 }
 
 void DynarmicCPU::set_log_mem(bool log) {
     if (log_mem == log)
         return;
 
+    release_jit();
     log_mem = log;
-    jit = make_jit();
+    acquire_jit();
 }
 
 bool DynarmicCPU::get_log_code() {
@@ -470,6 +618,26 @@ void DynarmicCPU::invalidate_jit_cache(Address start, size_t length) {
     jit->InvalidateCacheRange(start, length);
 }
 
+JitCachePtr new_jit_cache() {
+    return new DynarmicJitCache();
+}
+
+void free_jit_cache(JitCachePtr cache) {
+    DynarmicJitCache *cache_ = reinterpret_cast<DynarmicJitCache *>(cache);
+    // Threads still running keep it alive until they release their JIT
+    cache_->close();
+}
+
+void invalidate_jit_cache(JitCachePtr cache, Address start, size_t length) {
+    DynarmicJitCache *cache_ = reinterpret_cast<DynarmicJitCache *>(cache);
+    cache_->invalidate(start, length);
+}
+
+JitCacheStats get_jit_cache_stats(JitCachePtr cache) {
+    DynarmicJitCache *cache_ = reinterpret_cast<DynarmicJitCache *>(cache);
+    return cache_->get_stats();
+}
+
 // TODO: proper abstraction
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores) {
     return new Dynarmic::ExclusiveMonitor(max_num_cores);
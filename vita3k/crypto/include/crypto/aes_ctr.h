@@ -0,0 +1,51 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <crypto/aes.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief AES-128 in counter mode, the counter of a block being the big-endian 128-bit IV plus the block index.
+ *
+ * Every block of the stream can be processed on its own, so one context can be shared by several threads.
+ * Uses AES-NI or the ARMv8 crypto extension when available, PolarSSL otherwise.
+ */
+struct Aes128Ctr {
+    Aes128Ctr(const uint8_t *key, const uint8_t *iv);
+
+    // Round keys point inside the context, it must not be copied
+    Aes128Ctr(const Aes128Ctr &) = delete;
+    Aes128Ctr &operator=(const Aes128Ctr &) = delete;
+
+    /**
+     * \brief Encrypts or decrypts data in place.
+     * \param block Index in the stream of the 16 bytes block data starts at.
+     */
+    void xor_stream(uint64_t block, uint8_t *data, size_t size) const;
+
+private:
+    aes_context ctx;
+    uint64_t iv_high;
+    uint64_t iv_low;
+};
+
+// Name of the implementation xor_stream uses on this CPU
+const char *aes128_ctr_implementation();
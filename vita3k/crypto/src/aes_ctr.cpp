@@ -0,0 +1,241 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <crypto/aes_ctr.h>
+
+#include <util/bytes.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <util/instrset_detect.h>
+
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#define AES_CTR_AESNI
+#if defined(__GNUC__) || defined(__clang__)
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+#else
+#define AESNI_TARGET
+#endif
+#elif defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+#include <arm_neon.h>
+#define AES_CTR_ARMV8
+#endif
+
+static constexpr int AES128_ROUNDS = 10;
+// Blocks encrypted together to hide the latency of the AES instructions
+static constexpr size_t PARALLEL_BLOCKS = 8;
+
+namespace {
+
+// Counter value of a block, as the 16 bytes fed to the cipher
+struct Counter {
+    uint64_t high;
+    uint64_t low;
+
+    Counter(uint64_t iv_high, uint64_t iv_low, uint64_t block) {
+        low = iv_low + block;
+        high = iv_high + (low < iv_low ? 1 : 0);
+    }
+
+    void next() {
+        low++;
+        if (low == 0)
+            high++;
+    }
+
+    // Written byte by byte so that it gets inlined as a byte swap in the hot loops
+    void store(uint8_t *out) const {
+        for (int i = 0; i < 8; i++) {
+            out[i] = static_cast<uint8_t>(high >> (56 - i * 8));
+            out[i + 8] = static_cast<uint8_t>(low >> (56 - i * 8));
+        }
+    }
+};
+
+} // namespace
+
+static void xor_bytes(uint8_t *data, const uint8_t *key_stream, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        data[i] ^= key_stream[i];
+}
+
+static void xor_stream_soft(aes_context *ctx, Counter counter, uint8_t *data, size_t size) {
+    uint8_t counter_bytes[16];
+    uint8_t key_stream[16];
+    while (size != 0) {
+        counter.store(counter_bytes);
+        aes_crypt_ecb(ctx, AES_ENCRYPT, counter_bytes, key_stream);
+
+        const size_t block_size = size < 16 ? size : 16;
+        xor_bytes(data, key_stream, block_size);
+        counter.next();
+        data += block_size;
+        size -= block_size;
+    }
+}
+
+#ifdef AES_CTR_AESNI
+AESNI_TARGET static __m128i load_counter_aesni(Counter &counter) {
+    uint8_t counter_bytes[16];
+    counter.store(counter_bytes);
+    counter.next();
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(counter_bytes));
+}
+
+AESNI_TARGET static void xor_stream_aesni(const uint8_t *round_keys, Counter counter, uint8_t *data, size_t size) {
+    __m128i keys[AES128_ROUNDS + 1];
+    for (int i = 0; i <= AES128_ROUNDS; i++)
+        keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(round_keys + i * 16));
+
+    // Counters are built in registers as two 64-bit lanes then byte swapped to big-endian
+    const __m128i swap_bytes = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i one = _mm_set_epi64x(0, 1);
+
+    while (size >= PARALLEL_BLOCKS * 16) {
+        __m128i state[PARALLEL_BLOCKS];
+        if (counter.low <= UINT64_MAX - PARALLEL_BLOCKS) {
+            __m128i value = _mm_set_epi64x(counter.high, counter.low);
+            for (size_t i = 0; i < PARALLEL_BLOCKS; i++) {
+                state[i] = _mm_xor_si128(_mm_shuffle_epi8(value, swap_bytes), keys[0]);
+                value = _mm_add_epi64(value, one);
+            }
+            counter.low += PARALLEL_BLOCKS;
+        } else {
+            // The low half wraps around in this batch
+            for (size_t i = 0; i < PARALLEL_BLOCKS; i++)
+                state[i] = _mm_xor_si128(load_counter_aesni(counter), keys[0]);
+        }
+        for (int round = 1; round < AES128_ROUNDS; round++) {
+            for (size_t i = 0; i < PARALLEL_BLOCKS; i++)
+                state[i] = _mm_aesenc_si128(state[i], keys[round]);
+        }
+        for (size_t i = 0; i < PARALLEL_BLOCKS; i++) {
+            __m128i *block = reinterpret_cast<__m128i *>(data) + i;
+            _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), _mm_aesenclast_si128(state[i], keys[AES128_ROUNDS])));
+        }
+        data += PARALLEL_BLOCKS * 16;
+        size -= PARALLEL_BLOCKS * 16;
+    }
+
+    while (size != 0) {
+        __m128i state = _mm_xor_si128(load_counter_aesni(counter), keys[0]);
+        for (int round = 1; round < AES128_ROUNDS; round++)
+            state = _mm_aesenc_si128(state, keys[round]);
+        state = _mm_aesenclast_si128(state, keys[AES128_ROUNDS]);
+
+        uint8_t key_stream[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(key_stream), state);
+        const size_t block_size = std::min<size_t>(size, 16);
+        xor_bytes(data, key_stream, block_size);
+        data += block_size;
+        size -= block_size;
+    }
+}
+#endif
+
+#ifdef AES_CTR_ARMV8
+static void xor_stream_armv8(const uint8_t *round_keys, Counter counter, uint8_t *data, size_t size) {
+    uint8x16_t keys[AES128_ROUNDS + 1];
+    for (int i = 0; i <= AES128_ROUNDS; i++)
+        keys[i] = vld1q_u8(round_keys + i * 16);
+
+    uint8_t counter_bytes[16];
+    while (size != 0) {
+        const size_t blocks = std::min<size_t>((size + 15) / 16, PARALLEL_BLOCKS);
+
+        uint8x16_t state[PARALLEL_BLOCKS];
+        for (size_t i = 0; i < blocks; i++) {
+            counter.store(counter_bytes);
+            state[i] = vld1q_u8(counter_bytes);
+            counter.next();
+        }
+        // aese does AddRoundKey before SubBytes and ShiftRows, so the last key is xored separately
+        for (int round = 0; round < AES128_ROUNDS - 1; round++) {
+            for (size_t i = 0; i < blocks; i++)
+                state[i] = vaesmcq_u8(vaeseq_u8(state[i], keys[round]));
+        }
+        for (size_t i = 0; i < blocks; i++)
+            state[i] = veorq_u8(vaeseq_u8(state[i], keys[AES128_ROUNDS - 1]), keys[AES128_ROUNDS]);
+
+        for (size_t i = 0; i < blocks; i++) {
+            if (size >= 16) {
+                vst1q_u8(data, veorq_u8(vld1q_u8(data), state[i]));
+                data += 16;
+                size -= 16;
+            } else {
+                uint8_t key_stream[16];
+                vst1q_u8(key_stream, state[i]);
+                xor_bytes(data, key_stream, size);
+                size = 0;
+            }
+        }
+    }
+}
+#endif
+
+#ifdef AES_CTR_AESNI
+static bool has_aesni() {
+    static const bool supported = util::instrset::hasAES();
+    return supported;
+}
+#endif
+
+Aes128Ctr::Aes128Ctr(const uint8_t *key, const uint8_t *iv) {
+    aes_setkey_enc(&ctx, key, 128);
+
+    uint64_t big_high, big_low;
+    memcpy(&big_high, iv, sizeof(big_high));
+    memcpy(&big_low, iv + 8, sizeof(big_low));
+    iv_high = network_to_host_order(big_high);
+    iv_low = network_to_host_order(big_low);
+}
+
+void Aes128Ctr::xor_stream(uint64_t block, uint8_t *data, size_t size) const {
+    const Counter counter(iv_high, iv_low, block);
+    // Round keys are stored as little-endian words, so on little-endian hosts
+    // their bytes are the key schedule the hardware instructions expect
+    const uint8_t *round_keys = reinterpret_cast<const uint8_t *>(ctx.rk);
+
+#ifdef AES_CTR_AESNI
+    if (get_system_endian_type() == LITTLE && has_aesni()) {
+        xor_stream_aesni(round_keys, counter, data, size);
+        return;
+    }
+#elif defined(AES_CTR_ARMV8)
+    if (get_system_endian_type() == LITTLE) {
+        xor_stream_armv8(round_keys, counter, data, size);
+        return;
+    }
+#endif
+    (void)round_keys;
+
+    // aes_crypt_ecb only reads the context
+    xor_stream_soft(const_cast<aes_context *>(&ctx), counter, data, size);
+}
+
+const char *aes128_ctr_implementation() {
+#ifdef AES_CTR_AESNI
+    if (has_aesni())
+        return "AES-NI";
+#elif defined(AES_CTR_ARMV8)
+    return "ARMv8 crypto";
+#endif
+    return "software";
+}
@@ -0,0 +1,144 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <crypto/aes_ctr.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+static void ctr_add(uint8_t *counter, uint64_t n) {
+    for (int i = 15; i >= 0; i--) {
+        n = n + counter[i];
+        counter[i] = (uint8_t)n;
+        n >>= 8;
+    }
+}
+
+// The per block PolarSSL loop the pkg installer used before Aes128Ctr
+static void aes128_ctr_xor(aes_context *ctx, const uint8_t *iv, uint64_t block, uint8_t *input, size_t size) {
+    uint8_t tmp[16];
+    uint8_t counter[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        counter[i] = iv[i];
+    }
+    ctr_add(counter, block);
+    while (size >= 16) {
+        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
+        for (uint32_t i = 0; i < 16; i++) {
+            *input++ ^= tmp[i];
+        }
+        ctr_add(counter, 1);
+        size -= 16;
+    }
+
+    if (size != 0) {
+        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
+        for (size_t i = 0; i < size; i++) {
+            *input++ ^= tmp[i];
+        }
+    }
+}
+
+static std::vector<uint8_t> random_bytes(std::mt19937 &rng, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes)
+        byte = static_cast<uint8_t>(rng());
+    return bytes;
+}
+
+TEST(aes_ctr, known_answer) {
+    // NIST SP 800-38A, F.5.1 CTR-AES128.Encrypt
+    const uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    const uint8_t iv[16] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+    const std::vector<uint8_t> plaintext = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    const std::vector<uint8_t> ciphertext = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+
+    const Aes128Ctr cipher(key, iv);
+
+    std::vector<uint8_t> data = plaintext;
+    cipher.xor_stream(0, data.data(), data.size());
+    EXPECT_EQ(data, ciphertext) << aes128_ctr_implementation();
+
+    // Starting in the middle of the stream gives the same blocks
+    data.assign(plaintext.begin() + 32, plaintext.end());
+    cipher.xor_stream(2, data.data(), data.size());
+    EXPECT_EQ(data, std::vector<uint8_t>(ciphertext.begin() + 32, ciphertext.end())) << aes128_ctr_implementation();
+
+    cipher.xor_stream(2, data.data(), data.size());
+    EXPECT_EQ(data, std::vector<uint8_t>(plaintext.begin() + 32, plaintext.end()));
+}
+
+TEST(aes_ctr, matches_per_block_xor) {
+    std::mt19937 rng(7);
+    const std::vector<uint8_t> key = random_bytes(rng, 16);
+
+    // Random IV, then IVs whose low 64 bits and whole 128 bits wrap inside the stream
+    std::vector<std::array<uint8_t, 16>> ivs(3);
+    const std::vector<uint8_t> random_iv = random_bytes(rng, 16);
+    std::copy(random_iv.begin(), random_iv.end(), ivs[0].begin());
+    ivs[1] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf8 };
+    ivs[2] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfc };
+
+    aes_context ctx;
+    aes_setkey_enc(&ctx, key.data(), 128);
+
+    for (const auto &iv : ivs) {
+        const Aes128Ctr cipher(key.data(), iv.data());
+        for (int i = 0; i < 500; i++) {
+            // Sizes around the 8 blocks done together and starts before the carry
+            const uint64_t block = rng() % 32;
+            const size_t size = rng() % (16 * 24 + 1);
+            const std::vector<uint8_t> input = random_bytes(rng, size);
+
+            std::vector<uint8_t> expected = input;
+            aes128_ctr_xor(&ctx, iv.data(), block, expected.data(), expected.size());
+
+            std::vector<uint8_t> result = input;
+            cipher.xor_stream(block, result.data(), result.size());
+
+            ASSERT_EQ(result, expected) << aes128_ctr_implementation() << ", block " << block << ", size " << size;
+        }
+    }
+
+    // Block indexes far in the stream can carry into the high half of the random IV,
+    // ctr_add overflows when the index is within a byte of UINT64_MAX
+    const Aes128Ctr cipher(key.data(), ivs[0].data());
+    for (const uint64_t block : { UINT64_MAX - 300, UINT64_MAX / 2, uint64_t(1) << 40 }) {
+        const std::vector<uint8_t> input = random_bytes(rng, 16 * 10 + 5);
+
+        std::vector<uint8_t> expected = input;
+        aes128_ctr_xor(&ctx, ivs[0].data(), block, expected.data(), expected.size());
+
+        std::vector<uint8_t> result = input;
+        cipher.xor_stream(block, result.data(), result.size());
+
+        ASSERT_EQ(result, expected) << aes128_ctr_implementation() << ", block " << block;
+    }
+}
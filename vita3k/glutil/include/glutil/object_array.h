@@ -22,6 +22,7 @@
 #include <array>
 #include <cassert>
 #include <cstddef>
+#include <vector>
 
 namespace renderer {
 typedef void Generator(GLsizei, GLuint *);
@@ -70,3 +71,43 @@ private:
     Names names;
     renderer::Deleter *deleter = nullptr;
 };
+
+// Same as GLObjectArray, for a count only known at runtime
+class GLObjectVector {
+public:
+    GLObjectVector() = default;
+
+    ~GLObjectVector() {
+        if (deleter && !names.empty()) {
+            deleter(static_cast<GLsizei>(names.size()), &names[0]);
+            names.clear();
+        }
+    }
+
+    bool init(renderer::Generator *generator, renderer::Deleter *deleter, size_t count) {
+        assert(generator != nullptr);
+        assert(deleter != nullptr);
+        assert(names.empty());
+        this->deleter = deleter;
+        names.resize(count, 0);
+        generator(static_cast<GLsizei>(names.size()), &names[0]);
+
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    const GLuint operator[](size_t i) const {
+        assert(i < names.size());
+        return names[i];
+    }
+
+    size_t size() const {
+        return names.size();
+    }
+
+private:
+    GLObjectVector(const GLObjectVector &);
+    const GLObjectVector &operator=(const GLObjectVector &);
+
+    std::vector<GLuint> names;
+    renderer::Deleter *deleter = nullptr;
+};
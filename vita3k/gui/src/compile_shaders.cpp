@@ -60,11 +60,12 @@ void draw_pre_compiling_shaders_progress(GuiState &gui, EmuEnvState &emuenv, con
     ImGui::SetCursorPos(ImVec2((ImGui::GetWindowWidth() / 2) - (PROGRESS_BAR_WIDTH / 2.f), ImGui::GetCursorPosY() + 30.f * emuenv.dpi_scale));
     ImGui::PushStyleColor(ImGuiCol_PlotHistogram, GUI_PROGRESS_BAR);
     ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 12.f);
-    const auto progress_programs = (emuenv.renderer->programs_count_pre_compiled * 100) / total;
+    const uint32_t programs_count_pre_compiled = emuenv.renderer->programs_count_pre_compiled;
+    const auto progress_programs = (programs_count_pre_compiled * 100) / total;
     ImGui::ProgressBar(progress_programs / 100.f, ImVec2(PROGRESS_BAR_WIDTH, 15.f * emuenv.dpi_scale), "");
     ImGui::PopStyleColor();
     ImGui::PopStyleVar();
-    const auto progress_programs_str = fmt::format("{}/{}", emuenv.renderer->programs_count_pre_compiled, total);
+    const auto progress_programs_str = fmt::format("{}/{}", programs_count_pre_compiled, total);
     ImGui::SetCursorPos(ImVec2((ImGui::GetWindowWidth() / 2.f) - (ImGui::CalcTextSize(progress_programs_str.c_str()).x / 2.f), ImGui::GetCursorPosY() + (6.f * emuenv.dpi_scale)));
     ImGui::TextColored(GUI_COLOR_TEXT, "%s", progress_programs_str.c_str());
     ImGui::End();
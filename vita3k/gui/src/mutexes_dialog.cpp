@@ -19,6 +19,7 @@
 
 #include <emuenv/state.h>
 
+#include <kernel/lw_sync.h>
 #include <kernel/state.h>
 #include <kernel/thread/thread_state.h>
 
@@ -51,13 +52,17 @@ void draw_lw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
 
     for (const auto &mutex : emuenv.kernel.lwmutexes) {
         std::shared_ptr<Mutex> mutex_state = mutex.second;
-        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d           %02zu                 %s",
+        // Lightweight mutexes are locked and unlocked on the guest workarea
+        const SceKernelLwMutexWork *workarea = mutex_state->workarea.get(emuenv.mem);
+        const SceUID owner_id = workarea->owner & ~LW_MUTEX_CONTENDED;
+        const auto owner = emuenv.kernel.threads.find(owner_id);
+        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02u        %01d           %02zu                 %s",
             mutex.first,
             mutex_state->name,
-            mutex_state->lock_count,
+            workarea->lockCount,
             mutex_state->attr,
             mutex_state->waiting_threads->size(),
-            mutex_state->owner == nullptr ? "not owned" : mutex_state->owner->name.c_str());
+            owner_id == 0 ? "not owned" : (owner == emuenv.kernel.threads.end() ? "unknown thread" : owner->second->name.c_str()));
     }
     ImGui::End();
 }
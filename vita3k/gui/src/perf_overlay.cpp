@@ -18,6 +18,7 @@
 #include "private.h"
 
 #include <config/state.h>
+#include <renderer/state.h>
 
 namespace gui {
 static const ImVec2 PERF_OVERLAY_PAD = ImVec2(12.f, 12.f);
@@ -45,7 +46,7 @@ static ImVec2 get_perf_pos(ImVec2 window_size, EmuEnvState &emuenv) {
 
 static float get_perf_height(EmuEnvState &emuenv) {
     switch (emuenv.cfg.performance_overlay_detail) {
-    case MAXIMUM: return 138.f;
+    case MAXIMUM: return 184.f;
     case MEDIUM: return 80.f;
     case LOW:
     case MINIMUM:
@@ -55,10 +56,42 @@ static float get_perf_height(EmuEnvState &emuenv) {
     return 57.f;
 }
 
+static float get_stats_height(EmuEnvState &emuenv) {
+    switch (emuenv.cfg.performance_overlay_detail) {
+    case MAXIMUM: return 104.f;
+    case MEDIUM: return 58.f;
+    case LOW:
+    case MINIMUM:
+    default: break;
+    }
+
+    return 35.f;
+}
+
+static void draw_texture_cache_stats(EmuEnvState &emuenv) {
+    if (!emuenv.renderer)
+        return;
+
+    const renderer::TextureCacheStats &stats = emuenv.renderer->texture_cache_stats;
+    const uint64_t hits = stats.hits;
+    const uint64_t lookups = hits + stats.misses;
+    const float hit_rate = lookups ? (100.f * hits / lookups) : 0.f;
+    ImGui::Text("Tex: %.1f%% Ev: %llu", hit_rate, static_cast<unsigned long long>(stats.evictions.load()));
+}
+
+static void draw_shader_compile_stats(EmuEnvState &emuenv) {
+    if (!emuenv.renderer)
+        return;
+
+    const renderer::ShaderCompileStats &stats = emuenv.renderer->shader_compile_stats;
+    ImGui::Text("Shd: Q %u Hitch %.1fms", stats.queue_depth.load(), stats.last_hitch_us / 1000.f);
+}
+
 void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     const auto MAIN_WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 95.5f : 152.f) * emuenv.dpi_scale, get_perf_height(emuenv) * emuenv.dpi_scale);
     const auto WINDOW_POS = get_perf_pos(MAIN_WINDOW_SIZE, emuenv);
-    const auto WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 72.5f : 130.f) * emuenv.dpi_scale, (emuenv.cfg.performance_overlay_detail <= LOW ? 35.f : 58.f) * emuenv.dpi_scale);
+    const auto WINDOW_SIZE = ImVec2((emuenv.cfg.performance_overlay_detail == MINIMUM ? 72.5f : 130.f) * emuenv.dpi_scale, get_stats_height(emuenv) * emuenv.dpi_scale);
+    const auto GRAPHIC_SIZE = ImVec2(130.f * emuenv.dpi_scale, 58.f * emuenv.dpi_scale);
 
     ImGui::SetNextWindowSize(MAIN_WINDOW_SIZE);
     ImGui::SetNextWindowPos(WINDOW_POS);
@@ -75,12 +108,17 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Separator();
         ImGui::Text("Min: %d Max: %d", emuenv.min_fps, emuenv.max_fps);
     }
+    if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
+        ImGui::Separator();
+        draw_texture_cache_stats(emuenv);
+        draw_shader_compile_stats(emuenv);
+    }
     ImGui::EndChild();
     ImGui::PopStyleVar();
     ImGui::PopStyleColor();
     if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
         ImGui::SetCursorPosY(ImGui::GetCursorPosY() - (5.f * emuenv.dpi_scale));
-        ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), WINDOW_SIZE);
+        ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), GRAPHIC_SIZE);
     }
     ImGui::End();
     ImGui::PopStyleVar();
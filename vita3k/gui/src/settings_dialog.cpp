@@ -127,7 +127,6 @@ static CPUBackend config_cpu_backend;
  * If a custom config is found, the configuration values found in the file will be assigned to
  * `config`.
  *
- * @param gui State of the Vita3K GUI
  * @param emuenv State of the emulated PlayStation Vita environment
  * @param app_path Path to the app or game to get the custom config for
  * @return true A custom config for the application has been found, and `config` has been set up with
@@ -135,7 +134,7 @@ static CPUBackend config_cpu_backend;
  * @return false A custom config for the application has not been found or a custom config has been found
  * but it's corrupted or invalid.
  */
-static bool get_custom_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+static bool get_custom_config(EmuEnvState &emuenv, const std::string &app_path) {
     const auto CUSTOM_CONFIG_PATH{ fs::path(emuenv.base_path) / "config" / fmt::format("config_{}.xml", app_path) };
 
     if (fs::exists(CUSTOM_CONFIG_PATH)) {
@@ -214,7 +213,7 @@ static int current_aniso_filter_log, max_aniso_filter_log, audio_backend_idx;
 void init_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
     // If no app-specific config file is being used for the initialized application,
     // set up `config` with the values set in the global emulator configuration
-    if (!get_custom_config(gui, emuenv, app_path)) {
+    if (!get_custom_config(emuenv, app_path)) {
         config.cpu_backend = emuenv.cfg.cpu_backend;
         config.cpu_opt = emuenv.cfg.cpu_opt;
         config.modules_mode = emuenv.cfg.modules_mode;
@@ -327,18 +326,17 @@ static void set_vsync_state(const bool &state) {
 }
 
 /**
- * @brief Set up the config parameters on the emulated PlayStation Vita environment
- * that are susceptible to vary via app-specific config files with the proper values
- * depending on whether app-specific config files are being used or not.
+ * @brief Set the current config of the emulated PlayStation Vita environment from the
+ * app-specific config file if there is one, else from the global emulator config.
+ * Does not touch the renderer, so it can be used before it is initialized.
  *
- * @param gui State of the Vita3K GUI
  * @param emuenv State of the emulated PlayStation Vita environment
  * @param app_path Path to the app or game to get the custom config for
  */
-void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+void set_current_config(EmuEnvState &emuenv, const std::string &app_path) {
     // If a config file is in use, call `get_custom_config()` and set the config
     // parameters with the values stored in the app-specific custom config file
-    if (get_custom_config(gui, emuenv, app_path))
+    if (get_custom_config(emuenv, app_path))
         emuenv.cfg.current_config = config;
     else {
         // Else inherit the values from the global emulator config
@@ -355,6 +353,19 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
         emuenv.cfg.current_config.ngs_enable = emuenv.cfg.ngs_enable;
         emuenv.cfg.current_config.psn_status = emuenv.cfg.psn_status;
     }
+}
+
+/**
+ * @brief Set up the config parameters on the emulated PlayStation Vita environment
+ * that are susceptible to vary via app-specific config files with the proper values
+ * depending on whether app-specific config files are being used or not.
+ *
+ * @param gui State of the Vita3K GUI
+ * @param emuenv State of the emulated PlayStation Vita environment
+ * @param app_path Path to the app or game to get the custom config for
+ */
+void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path) {
+    set_current_config(emuenv, app_path);
 
     // If backend render or resolution multiplier is changed when app run, reboot emu and app
     if (!emuenv.io.title_id.empty() && ((emuenv.renderer->current_backend != emuenv.backend_renderer) || (emuenv.renderer->res_multiplier != emuenv.cfg.current_config.resolution_multiplier))) {
@@ -511,6 +522,9 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
                 gpu_list.push_back(gpu.c_str());
             if (ImGui::Combo("GPU (Reboot to apply)", &emuenv.cfg.gpu_idx, gpu_list.data(), static_cast<int>(gpu_list.size())))
                 ImGui::SetTooltip("Select the GPU Vita3K should run on.");
+            ImGui::Checkbox("Surface readback", &emuenv.cfg.vulkan_surface_readback);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Check the box to copy the surfaces rendered on the GPU back to the memory of the game.\nNeeded by the few games reading them on the CPU, costs a copy of every scene.");
         } else {
             ImGui::Checkbox("Disable surface sync", &config.disable_surface_sync);
             if (ImGui::IsItemHovered())
@@ -902,15 +916,6 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::SliderInt("HTTP Timeout Sleep", &emuenv.cfg.http_timeout_sleep_ms, 50, 3000);
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Attempt sleep time when the server doesn't answer. Could be useful if you have very unstable or VERY SLOW internet");
-        ImGui::Spacing();
-        ImGui::Separator();
-        ImGui::Spacing();
-        ImGui::SliderInt("HTTP Read End Attempts", &emuenv.cfg.http_read_end_attempts, 0, 100);
-        if (ImGui::IsItemHovered())
-            ImGui::SetTooltip("How many attempts to do when there isn't more data to read, lower can improve performance but can make games unstable if you have bad enough internet.");
-        ImGui::SliderInt("HTTP Read End Sleep", &emuenv.cfg.http_read_end_sleep_ms, 50, 3000);
-        if (ImGui::IsItemHovered())
-            ImGui::SetTooltip("Attempt sleep time when there isn't more data to read, lower can improve performance but can make games unstable if you have bad enough internet.");
         ImGui::EndTabItem();
     } else
         ImGui::PopStyleColor();
@@ -17,8 +17,113 @@
 
 #include <gxm/functions.h>
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STREAM_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define STREAM_NEON
+#include <arm_neon.h>
+#endif
+
 namespace gxm {
 bool is_stream_instancing(SceGxmIndexSource source) {
     return (source == SCE_GXM_INDEX_SOURCE_EACH_INSTANCE_16BIT) || (source == SCE_GXM_INDEX_SOURCE_EACH_INSTANCE_32BIT);
 }
+
+// Index buffers come straight from guest memory and are only 2-byte aligned, vector loads are unaligned
+static uint32_t max_index_u16(const uint8_t *data, size_t count) {
+    size_t i = 0;
+    uint32_t result = 0;
+#if defined(__AVX2__)
+    __m256i max = _mm256_setzero_si256();
+    for (; i + 16 <= count; i += 16)
+        max = _mm256_max_epu16(max, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i * 2)));
+    __m128i max128 = _mm_max_epu16(_mm256_castsi256_si128(max), _mm256_extracti128_si256(max, 1));
+    // minpos on the complement gives the maximum
+    max128 = _mm_minpos_epu16(_mm_xor_si128(max128, _mm_set1_epi16(-1)));
+    result = static_cast<uint16_t>(~_mm_cvtsi128_si32(max128));
+#elif defined(STREAM_SSE2)
+    // No unsigned 16-bit max before SSE4.1, max(a, b) = (a -sat b) + b
+    __m128i max = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 2));
+        max = _mm_adds_epu16(_mm_subs_epu16(indices, max), max);
+    }
+    uint16_t lanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), max);
+    result = *std::max_element(lanes, lanes + 8);
+#elif defined(STREAM_NEON)
+    uint16x8_t max = vdupq_n_u16(0);
+    for (; i + 8 <= count; i += 8)
+        max = vmaxq_u16(max, vld1q_u16(reinterpret_cast<const uint16_t *>(data + i * 2)));
+    uint16_t lanes[8];
+    vst1q_u16(lanes, max);
+    result = *std::max_element(lanes, lanes + 8);
+#endif
+
+    for (; i < count; i++) {
+        uint16_t index;
+        memcpy(&index, data + i * 2, sizeof(index));
+        result = std::max<uint32_t>(result, index);
+    }
+
+    return result;
+}
+
+static uint32_t max_index_u32(const uint8_t *data, size_t count) {
+    size_t i = 0;
+    uint32_t result = 0;
+#if defined(__AVX2__)
+    __m256i max = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8)
+        max = _mm256_max_epu32(max, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i * 4)));
+    uint32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), max);
+    result = *std::max_element(lanes, lanes + 8);
+#elif defined(STREAM_SSE2)
+    // No unsigned 32-bit compare either, flip the sign bits and use the signed one
+    const __m128i sign = _mm_set1_epi32(INT32_MIN);
+    __m128i max = sign;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i indices = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 4)), sign);
+        const __m128i greater = _mm_cmpgt_epi32(indices, max);
+        max = _mm_or_si128(_mm_and_si128(greater, indices), _mm_andnot_si128(greater, max));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_xor_si128(max, sign));
+    result = *std::max_element(lanes, lanes + 4);
+#elif defined(STREAM_NEON)
+    uint32x4_t max = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4)
+        max = vmaxq_u32(max, vld1q_u32(reinterpret_cast<const uint32_t *>(data + i * 4)));
+    uint32_t lanes[4];
+    vst1q_u32(lanes, max);
+    result = *std::max_element(lanes, lanes + 4);
+#endif
+
+    for (; i < count; i++) {
+        uint32_t index;
+        memcpy(&index, data + i * 4, sizeof(index));
+        result = std::max(result, index);
+    }
+
+    return result;
+}
+
+uint32_t get_max_index(SceGxmIndexFormat format, const void *indices, size_t count) {
+    const uint8_t *const data = static_cast<const uint8_t *>(indices);
+    if (format == SCE_GXM_INDEX_FORMAT_U16)
+        return max_index_u16(data, count);
+    else
+        return max_index_u32(data, count);
+}
 } // namespace gxm
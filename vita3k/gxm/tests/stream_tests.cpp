@@ -0,0 +1,69 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gxm/functions.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// The scalar scan the draw functions used before get_max_index
+template <typename T>
+static uint32_t reference_max_index(const std::vector<uint8_t> &data, size_t count) {
+    std::vector<T> indices(count);
+    memcpy(indices.data(), data.data(), count * sizeof(T));
+    return count == 0 ? 0 : *std::max_element(indices.begin(), indices.end());
+}
+
+TEST(stream, max_index_edges) {
+    const uint16_t u16_indices[] = { 3, 0xFFFF, 7, 0x8000, 0x7FFF };
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U16, u16_indices, 5), 0xFFFF);
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U16, u16_indices, 1), 3);
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U16, u16_indices, 0), 0);
+
+    // Above and below the sign bit, the SSE2 path compares signed lanes
+    const uint32_t u32_indices[] = { 0x7FFFFFFF, 0x80000000, 1, 0, 0x7FFFFFFF, 2, 3, 4, 0xFFFFFFFF };
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U32, u32_indices, 9), 0xFFFFFFFF);
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U32, u32_indices, 8), 0x80000000);
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U32, u32_indices, 1), 0x7FFFFFFF);
+    EXPECT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U32, u32_indices, 0), 0);
+}
+
+TEST(stream, max_index_matches_scalar) {
+    std::mt19937 rng(8);
+
+    // Counts around the vector widths, at the 2-byte alignments the guest can give
+    for (size_t count = 0; count < 80; count++) {
+        for (const size_t offset : { 0, 2, 6 }) {
+            for (int i = 0; i < 20; i++) {
+                // Random bytes, or small indices with the largest one in a random lane
+                std::vector<uint8_t> buffer(offset + count * 4);
+                for (uint8_t &byte : buffer)
+                    byte = static_cast<uint8_t>(i % 2 ? rng() : rng() % 4);
+                const std::vector<uint8_t> data(buffer.begin() + offset, buffer.end());
+
+                ASSERT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U16, buffer.data() + offset, count), reference_max_index<uint16_t>(data, count))
+                    << "u16, count " << count << ", offset " << offset;
+                ASSERT_EQ(gxm::get_max_index(SCE_GXM_INDEX_FORMAT_U32, buffer.data() + offset, count), reference_max_index<uint32_t>(data, count))
+                    << "u32, count " << count << ", offset " << offset;
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace http {
+
+// A non-blocking TCP socket, with its TLS session on top of it for https
+struct Transport {
+    int sockfd = -1;
+    void *ssl = nullptr; // SSL *
+
+    bool is_open() const {
+        return sockfd >= 0;
+    }
+};
+
+struct ExchangeOptions {
+    // Longest time without any progress before giving up with SCE_HTTP_ERROR_TIMEOUT
+    int timeout_ms = 5000;
+    // Checked while waiting on the socket, makes the exchange fail with SCE_HTTP_ERROR_ABORTED
+    const std::atomic<bool> *abort = nullptr;
+};
+
+/**
+ * \brief Connects to the host, then does the TLS handshake if ssl_ctx is not null.
+ * \return 0 on success, a SceHttpErrorCode otherwise.
+ */
+int open_transport(Transport &transport, const std::string &hostname, const std::string &port, void *ssl_ctx, const ExchangeOptions &options);
+void close_transport(Transport &transport);
+// An idle keep-alive connection is dead once the server closed it or sent something unexpected
+bool is_transport_alive(const Transport &transport);
+
+// Incremental parser of one HTTP/1.x response, handles Content-Length, chunked and read until close bodies.
+struct ResponseParser {
+    enum class State {
+        HEADERS,
+        BODY_LENGTH,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        TRAILERS,
+        BODY_UNTIL_CLOSE,
+        DONE,
+        FAILED,
+    };
+
+    State state = State::HEADERS;
+    bool is_head_request = false;
+    size_t max_header_size;
+
+    int status_code = 0;
+    bool keep_alive = false;
+    int error = 0;
+    uint64_t bytes_received = 0;
+
+    // Status line and header fields, ending with the empty line
+    std::string header_block;
+    std::vector<char> body;
+
+    explicit ResponseParser(bool is_head_request = false, size_t max_header_size = 5 * 1024);
+
+    /**
+     * \brief Parses the bytes following the ones fed before.
+     * \return The number of bytes belonging to the response, less than size if the response ended before.
+     */
+    size_t feed(const char *data, size_t size);
+    // The server closed the connection
+    void on_close();
+
+    bool is_done() const {
+        return state == State::DONE;
+    }
+    bool has_failed() const {
+        return state == State::FAILED;
+    }
+
+private:
+    uint64_t remaining = 0;
+    std::string line;
+
+    void fail(int error_code);
+    void parse_headers();
+    bool take_line(const char *data, size_t size, size_t &pos);
+};
+
+/**
+ * \brief Sends the request head and body, then receives the whole response into the parser.
+ *
+ * Waits on the socket with poll, so it returns as soon as the response framing says it is complete.
+ * \return 0 on success, a SceHttpErrorCode otherwise.
+ */
+int exchange(Transport &transport, const std::string &head, const char *body, size_t body_size, ResponseParser &parser, const ExchangeOptions &options);
+
+} // namespace http
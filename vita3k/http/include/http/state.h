@@ -17,9 +17,13 @@
 
 #pragma once
 
+#include <http/client.h>
 #include <mem/ptr.h>
 
+#include <atomic>
+#include <future>
 #include <map>
+#include <memory>
 #include <string>
 #include <util/types.h>
 #include <vector>
@@ -181,6 +185,7 @@ enum SceHttpErrorCode {
     SCE_HTTP_ERROR_SSL = 0x80431073,
     SCE_HTTP_ERROR_ABORTED = 0x80431080,
     SCE_HTTP_ERROR_UNKNOWN = 0x80431081,
+    SCE_HTTP_ERROR_EAGAIN = 0x80431082,
 
     SCE_HTTP_ERROR_PARSE_HTTP_NOT_FOUND = 0x80432025,
     SCE_HTTP_ERROR_PARSE_HTTP_INVALID_RESPONSE = 0x80432060,
@@ -215,6 +220,9 @@ struct SceTemplate {
     SceHttpVersion httpVersion;
     SceBool autoProxyConf;
     void *ssl;
+    bool nonblock = false;
+    // Keep-alive connections left open by deleted connections, by host:port (+ "s" for https)
+    std::multimap<std::string, http::Transport> idleTransports;
 };
 
 struct SceConnection {
@@ -222,7 +230,12 @@ struct SceConnection {
     std::string url;
     SceBool keepAlive;
     bool isSecure;
-    int sockfd;
+    std::string hostname;
+    std::string port;
+    bool nonblock = false;
+    // A request is using the transport
+    bool busy = false;
+    http::Transport transport;
 };
 
 struct SceRequestResponse {
@@ -239,6 +252,21 @@ struct SceRequestResponse {
     char *body = nullptr;
 };
 
+// What the thread sending a request works on, kept alive until it is done even if the request is deleted
+struct HttpExchange {
+    http::Transport transport;
+    // The transport comes from a previous request, the server may have closed it since
+    bool reusedTransport = false;
+    std::string hostname;
+    std::string port;
+    void *sslCtx = nullptr;
+    std::string message;
+    std::vector<char> body;
+    http::ResponseParser parser;
+    std::atomic<bool> abort = false;
+    http::ExchangeOptions options;
+};
+
 struct SceRequest {
     int connId;
     int method;
@@ -249,15 +277,18 @@ struct SceRequest {
     std::map<std::string, std::string> headers;
     SceRequestResponse res;
     std::vector<Ptr<void>> guestPointers;
+    bool nonblock = false;
+    // Set while the request is being sent
+    std::shared_ptr<HttpExchange> exchange;
+    std::future<int> pending;
 };
 
 struct HTTPState {
     bool inited = false;
     bool sslInited = false;
     SceSize defaultResponseHeaderSize = SCE_HTTP_DEFAULT_RESPONSE_HEADER_MAX;
-    SceInt next_temp = 0;
-    SceInt next_conn = 0;
-    SceInt next_req = 0;
+    // Templates, connections and requests share the id space, sceHttpSetNonblock takes any of them
+    SceInt next_id = 1;
     std::map<SceInt, SceTemplate> templates;
     std::map<SceInt, SceConnection> connections;
     std::map<SceInt, SceRequest> requests;
@@ -0,0 +1,543 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <http/client.h>
+#include <http/state.h>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <openssl/ssl.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace http {
+
+// Longest poll while an abort flag has to be watched
+static constexpr int ABORT_CHECK_MS = 50;
+
+#ifdef MSG_NOSIGNAL
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static constexpr int SEND_FLAGS = 0;
+#endif
+
+static bool last_error_would_block() {
+#ifdef WIN32
+    const int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINPROGRESS || errno == EINTR;
+#endif
+}
+
+static void close_socket(int sockfd) {
+#ifdef WIN32
+    closesocket(sockfd);
+#else
+    close(sockfd);
+#endif
+}
+
+static bool set_non_blocking(int sockfd) {
+#ifdef WIN32
+    u_long mode = 1;
+    return ioctlsocket(sockfd, FIONBIO, &mode) == 0;
+#else
+    const int flags = fcntl(sockfd, F_GETFL);
+    return flags >= 0 && fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// Waits until the socket is ready for the events, returns 0 or a SceHttpErrorCode
+static int wait_socket(int sockfd, short events, const ExchangeOptions &options) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+    while (true) {
+        if (options.abort && options.abort->load())
+            return SCE_HTTP_ERROR_ABORTED;
+
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0)
+            return SCE_HTTP_ERROR_TIMEOUT;
+
+        int wait_ms = static_cast<int>(left);
+        if (options.abort)
+            wait_ms = std::min(wait_ms, ABORT_CHECK_MS);
+
+        pollfd fd = {};
+        fd.fd = sockfd;
+        fd.events = events;
+#ifdef WIN32
+        const int ret = WSAPoll(&fd, 1, wait_ms);
+#else
+        const int ret = poll(&fd, 1, wait_ms);
+#endif
+        if (ret > 0)
+            return 0; // errors and hang ups are reported by the following read or write
+        if (ret < 0 && !last_error_would_block())
+            return SCE_HTTP_ERROR_NETWORK;
+    }
+}
+
+// Waits for the socket state an OpenSSL call asked for, returns 0 or a SceHttpErrorCode
+static int wait_ssl(const Transport &transport, int ret, const ExchangeOptions &options) {
+    switch (SSL_get_error(static_cast<SSL *>(transport.ssl), ret)) {
+    case SSL_ERROR_WANT_READ:
+        return wait_socket(transport.sockfd, POLLIN, options);
+    case SSL_ERROR_WANT_WRITE:
+        return wait_socket(transport.sockfd, POLLOUT, options);
+    default:
+        return SCE_HTTP_ERROR_SSL;
+    }
+}
+
+static int send_all(Transport &transport, const char *data, size_t size, const ExchangeOptions &options) {
+    size_t sent = 0;
+    while (sent < size) {
+        const int to_send = static_cast<int>(std::min<size_t>(size - sent, INT32_MAX));
+        if (transport.ssl) {
+            const int ret = SSL_write(static_cast<SSL *>(transport.ssl), data + sent, to_send);
+            if (ret > 0) {
+                sent += ret;
+                continue;
+            }
+            if (const int error = wait_ssl(transport, ret, options))
+                return error;
+        } else {
+            const auto ret = send(transport.sockfd, data + sent, to_send, SEND_FLAGS);
+            if (ret > 0) {
+                sent += ret;
+                continue;
+            }
+            if (ret < 0 && !last_error_would_block()) {
+                LOG_ERROR("Error sending HTTP data, errno={}({})", errno, strerror(errno));
+                return SCE_HTTP_ERROR_NETWORK;
+            }
+            if (const int error = wait_socket(transport.sockfd, POLLOUT, options))
+                return error;
+        }
+    }
+
+    return 0;
+}
+
+// Reads what is available, waiting for it if needed. received is left to 0 when the connection was closed.
+static int receive_some(Transport &transport, char *data, size_t size, size_t &received, const ExchangeOptions &options) {
+    received = 0;
+    while (true) {
+        if (transport.ssl) {
+            const int ret = SSL_read(static_cast<SSL *>(transport.ssl), data, static_cast<int>(size));
+            if (ret > 0) {
+                received = ret;
+                return 0;
+            }
+            const int ssl_error = SSL_get_error(static_cast<SSL *>(transport.ssl), ret);
+            if (ssl_error == SSL_ERROR_ZERO_RETURN)
+                return 0;
+            if (ssl_error == SSL_ERROR_SYSCALL && ret == 0)
+                return 0; // closed without close_notify, still the end of the stream
+            if (const int error = wait_ssl(transport, ret, options))
+                return error;
+        } else {
+            const auto ret = recv(transport.sockfd, data, static_cast<int>(size), 0);
+            if (ret >= 0) {
+                received = ret;
+                return 0;
+            }
+            if (!last_error_would_block()) {
+                LOG_ERROR("Error receiving HTTP data, errno={}({})", errno, strerror(errno));
+                return SCE_HTTP_ERROR_NETWORK;
+            }
+            if (const int error = wait_socket(transport.sockfd, POLLIN, options))
+                return error;
+        }
+    }
+}
+
+static int connect_socket(int &sockfd, const std::string &hostname, const std::string &port, const ExchangeOptions &options) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+
+    const int ret = getaddrinfo(hostname.c_str(), port.c_str(), &hints, &result);
+    if (ret != 0 || !result) {
+        LOG_ERROR("getaddrinfo({},{},...) = {}", hostname, port, ret);
+        return SCE_HTTP_ERROR_RESOLVER_ENODNS;
+    }
+
+    int error = SCE_HTTP_ERROR_RESOLVER_ENOHOST;
+    for (addrinfo *addr = result; addr; addr = addr->ai_next) {
+        sockfd = static_cast<int>(socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol));
+        if (sockfd < 0)
+            continue;
+
+        if (set_non_blocking(sockfd)) {
+            if (connect(sockfd, addr->ai_addr, static_cast<int>(addr->ai_addrlen)) == 0) {
+                error = 0;
+                break;
+            }
+
+            if (last_error_would_block()) {
+                error = wait_socket(sockfd, POLLOUT, options);
+                if (error == 0) {
+                    int socket_error = 0;
+                    socklen_t length = sizeof(socket_error);
+                    getsockopt(sockfd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&socket_error), &length);
+                    if (socket_error == 0)
+                        break;
+
+                    LOG_ERROR("connect({}:{}) failed, error={}({})", hostname, port, socket_error, strerror(socket_error));
+                    error = SCE_HTTP_ERROR_RESOLVER_ENOHOST;
+                } else if (error == SCE_HTTP_ERROR_ABORTED) {
+                    close_socket(sockfd);
+                    sockfd = -1;
+                    break;
+                }
+            }
+        }
+
+        close_socket(sockfd);
+        sockfd = -1;
+    }
+
+    freeaddrinfo(result);
+    return error;
+}
+
+int open_transport(Transport &transport, const std::string &hostname, const std::string &port, void *ssl_ctx, const ExchangeOptions &options) {
+    transport = {};
+    if (const int error = connect_socket(transport.sockfd, hostname, port, options))
+        return error;
+
+    LOG_TRACE("Connected to {}:{}", hostname, port);
+
+    if (!ssl_ctx)
+        return 0;
+
+    SSL *ssl = SSL_new(static_cast<SSL_CTX *>(ssl_ctx));
+    transport.ssl = ssl;
+    SSL_set_fd(ssl, transport.sockfd);
+    SSL_set_tlsext_host_name(ssl, hostname.c_str());
+
+    while (true) {
+        const int ret = SSL_connect(ssl);
+        if (ret == 1)
+            break;
+
+        if (const int error = wait_ssl(transport, ret, options)) {
+            LOG_ERROR("SSL_connect(...) = {}, SSLERR = {}", ret, SSL_get_error(ssl, ret));
+            close_transport(transport);
+            return error;
+        }
+    }
+
+    const long verify_flag = SSL_get_verify_result(ssl);
+    if (verify_flag != X509_V_OK && verify_flag != X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY)
+        LOG_ERROR("Certificate verification error ({}) but continuing...", verify_flag);
+
+    return 0;
+}
+
+void close_transport(Transport &transport) {
+    if (transport.ssl) {
+        // The socket is non-blocking, do not wait for the server close_notify
+        SSL_shutdown(static_cast<SSL *>(transport.ssl));
+        SSL_free(static_cast<SSL *>(transport.ssl));
+    }
+    if (transport.is_open())
+        close_socket(transport.sockfd);
+
+    transport = {};
+}
+
+bool is_transport_alive(const Transport &transport) {
+    if (!transport.is_open())
+        return false;
+
+    pollfd fd = {};
+    fd.fd = transport.sockfd;
+    fd.events = POLLIN;
+#ifdef WIN32
+    const int ret = WSAPoll(&fd, 1, 0);
+#else
+    const int ret = poll(&fd, 1, 0);
+#endif
+    // Nothing is expected on an idle connection, being readable means it was closed
+    return ret == 0;
+}
+
+ResponseParser::ResponseParser(bool is_head_request, size_t max_header_size)
+    : is_head_request(is_head_request)
+    , max_header_size(max_header_size) {
+}
+
+void ResponseParser::fail(int error_code) {
+    state = State::FAILED;
+    error = error_code;
+    keep_alive = false;
+}
+
+// Accumulates a CRLF terminated line into line, returns true once it is complete (without the CRLF)
+bool ResponseParser::take_line(const char *data, size_t size, size_t &pos) {
+    const char *end = static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+    const size_t taken = end ? end - (data + pos) + 1 : size - pos;
+    line.append(data + pos, taken);
+    pos += taken;
+
+    // Chunk size lines and trailers are never long, anything else is garbage
+    if (line.size() > max_header_size) {
+        fail(SCE_HTTP_ERROR_CHUNK_ENC);
+        return false;
+    }
+
+    if (!end)
+        return false;
+
+    line.pop_back();
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    return true;
+}
+
+static std::string to_lower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return str;
+}
+
+static std::string trim(const std::string &str) {
+    const size_t begin = str.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+        return {};
+    const size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(begin, end - begin + 1);
+}
+
+void ResponseParser::parse_headers() {
+    // HTTP/1.1 200 OK
+    if (header_block.compare(0, 5, "HTTP/") != 0 || header_block.size() < 12) {
+        fail(SCE_HTTP_ERROR_BAD_RESPONSE);
+        return;
+    }
+
+    const bool is_http_1_0 = header_block.compare(5, 3, "1.0") == 0;
+    status_code = std::atoi(header_block.c_str() + 9);
+    if (status_code < 100 || status_code > 999) {
+        fail(SCE_HTTP_ERROR_BAD_RESPONSE);
+        return;
+    }
+
+    bool has_length = false;
+    bool is_chunked = false;
+    uint64_t content_length = 0;
+    keep_alive = !is_http_1_0;
+
+    size_t line_begin = header_block.find("\r\n") + 2;
+    while (line_begin < header_block.size()) {
+        const size_t line_end = header_block.find("\r\n", line_begin);
+        if (line_end == std::string::npos || line_end == line_begin)
+            break;
+
+        const std::string field = header_block.substr(line_begin, line_end - line_begin);
+        line_begin = line_end + 2;
+
+        const size_t colon = field.find(':');
+        if (colon == std::string::npos)
+            continue;
+
+        const std::string name = to_lower(trim(field.substr(0, colon)));
+        const std::string value = to_lower(trim(field.substr(colon + 1)));
+        if (name == "content-length") {
+            has_length = true;
+            content_length = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "transfer-encoding") {
+            is_chunked = value.find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            if (value.find("close") != std::string::npos)
+                keep_alive = false;
+            else if (value.find("keep-alive") != std::string::npos)
+                keep_alive = true;
+        }
+    }
+
+    // Interim responses are followed by the real one
+    if (status_code >= 100 && status_code < 200 && status_code != 101) {
+        header_block.clear();
+        return;
+    }
+
+    if (is_head_request || status_code == 101 || status_code == 204 || status_code == 304) {
+        state = State::DONE;
+    } else if (is_chunked) {
+        state = State::CHUNK_SIZE;
+    } else if (has_length) {
+        remaining = content_length;
+        body.reserve(static_cast<size_t>(content_length));
+        state = content_length ? State::BODY_LENGTH : State::DONE;
+    } else {
+        // Only the end of the connection tells where the body ends
+        keep_alive = false;
+        state = State::BODY_UNTIL_CLOSE;
+    }
+}
+
+size_t ResponseParser::feed(const char *data, size_t size) {
+    size_t pos = 0;
+    while (pos < size) {
+        switch (state) {
+        case State::HEADERS: {
+            // Only the last 3 bytes already stored can be the start of the empty line
+            const size_t search_from = header_block.size() < 3 ? 0 : header_block.size() - 3;
+            const size_t take = std::min(size - pos, max_header_size + 1 - std::min(header_block.size(), max_header_size));
+            header_block.append(data + pos, take);
+
+            const size_t end = header_block.find("\r\n\r\n", search_from);
+            if (end == std::string::npos) {
+                pos += take;
+                if (header_block.size() > max_header_size)
+                    fail(SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER);
+                break;
+            }
+
+            // Give back what follows the empty line
+            const size_t extra = header_block.size() - (end + 4);
+            header_block.resize(end + 4);
+            pos += take - extra;
+            parse_headers();
+            break;
+        }
+        case State::BODY_LENGTH: {
+            const size_t take = static_cast<size_t>(std::min<uint64_t>(size - pos, remaining));
+            body.insert(body.end(), data + pos, data + pos + take);
+            pos += take;
+            remaining -= take;
+            if (remaining == 0)
+                state = State::DONE;
+            break;
+        }
+        case State::CHUNK_SIZE: {
+            if (!take_line(data, size, pos))
+                break;
+
+            char *end = nullptr;
+            remaining = std::strtoull(line.c_str(), &end, 16);
+            if (end == line.c_str() || (*end && *end != ';' && *end != ' ' && *end != '\t')) {
+                fail(SCE_HTTP_ERROR_CHUNK_ENC);
+                break;
+            }
+            line.clear();
+            state = remaining ? State::CHUNK_DATA : State::TRAILERS;
+            break;
+        }
+        case State::CHUNK_DATA: {
+            const size_t take = static_cast<size_t>(std::min<uint64_t>(size - pos, remaining));
+            body.insert(body.end(), data + pos, data + pos + take);
+            pos += take;
+            remaining -= take;
+            if (remaining == 0)
+                state = State::CHUNK_DATA_END;
+            break;
+        }
+        case State::CHUNK_DATA_END: {
+            if (!take_line(data, size, pos))
+                break;
+
+            if (!line.empty()) {
+                fail(SCE_HTTP_ERROR_CHUNK_ENC);
+                break;
+            }
+            state = State::CHUNK_SIZE;
+            break;
+        }
+        case State::TRAILERS: {
+            if (!take_line(data, size, pos))
+                break;
+
+            // Trailer fields are ignored, the empty line ends the response
+            if (line.empty())
+                state = State::DONE;
+            line.clear();
+            break;
+        }
+        case State::BODY_UNTIL_CLOSE:
+            body.insert(body.end(), data + pos, data + size);
+            pos = size;
+            break;
+        case State::DONE:
+        case State::FAILED:
+            bytes_received += pos;
+            return pos;
+        }
+    }
+
+    bytes_received += pos;
+    return pos;
+}
+
+void ResponseParser::on_close() {
+    keep_alive = false;
+    if (state == State::BODY_UNTIL_CLOSE)
+        state = State::DONE;
+    else if (state != State::DONE && state != State::FAILED)
+        fail(bytes_received ? SCE_HTTP_ERROR_BAD_RESPONSE : SCE_HTTP_ERROR_NETWORK);
+}
+
+int exchange(Transport &transport, const std::string &head, const char *body, size_t body_size, ResponseParser &parser, const ExchangeOptions &options) {
+    if (const int error = send_all(transport, head.data(), head.size(), options))
+        return error;
+    if (body_size) {
+        if (const int error = send_all(transport, body, body_size, options))
+            return error;
+    }
+
+    char buffer[16 * 1024];
+    while (!parser.is_done()) {
+        size_t received;
+        if (const int error = receive_some(transport, buffer, sizeof(buffer), received, options))
+            return error;
+
+        if (received == 0) {
+            parser.on_close();
+            break;
+        }
+
+        const size_t used = parser.feed(buffer, received);
+        if (parser.has_failed())
+            break;
+
+        // Nothing was asked after this response, the connection can't be trusted anymore
+        if (used < received)
+            parser.keep_alive = false;
+    }
+
+    return parser.has_failed() ? parser.error : 0;
+}
+
+} // namespace http
@@ -0,0 +1,282 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <http/client.h>
+#include <http/state.h>
+
+#include <gtest/gtest.h>
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+
+static std::string body_of(const http::ResponseParser &parser) {
+    return std::string(parser.body.begin(), parser.body.end());
+}
+
+TEST(http_parser, content_length_byte_by_byte) {
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+    http::ResponseParser parser;
+    for (size_t i = 0; i < response.size(); i++)
+        ASSERT_EQ(parser.feed(&response[i], 1), 1u);
+
+    ASSERT_TRUE(parser.is_done());
+    ASSERT_EQ(parser.status_code, 200);
+    ASSERT_TRUE(parser.keep_alive);
+    ASSERT_EQ(body_of(parser), "hello");
+    ASSERT_EQ(parser.header_block, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n");
+}
+
+TEST(http_parser, stops_at_end_of_response) {
+    const std::string response = "HTTP/1.1 200 OK\r\ncontent-length: 2\r\n\r\nokHTTP/1.1";
+    http::ResponseParser parser;
+    ASSERT_EQ(parser.feed(response.data(), response.size()), response.size() - 8);
+    ASSERT_TRUE(parser.is_done());
+    ASSERT_EQ(body_of(parser), "ok");
+}
+
+TEST(http_parser, chunked_random_splits) {
+    const std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                 "5;ext=1\r\nhello\r\n"
+                                 "B\r\n, chunked w\r\n"
+                                 "4\r\norld\r\n"
+                                 "0\r\nX-Trailer: 1\r\n\r\n";
+
+    std::mt19937 rng(1234);
+    for (int run = 0; run < 100; run++) {
+        http::ResponseParser parser;
+        size_t pos = 0;
+        while (pos < response.size()) {
+            const size_t size = std::min<size_t>(response.size() - pos, 1 + rng() % 16);
+            ASSERT_EQ(parser.feed(response.data() + pos, size), size);
+            pos += size;
+        }
+
+        ASSERT_TRUE(parser.is_done());
+        ASSERT_EQ(body_of(parser), "hello, chunked world");
+    }
+}
+
+TEST(http_parser, bad_chunk_size) {
+    const std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+    http::ResponseParser parser;
+    parser.feed(response.data(), response.size());
+    ASSERT_TRUE(parser.has_failed());
+    ASSERT_EQ(parser.error, static_cast<int>(SCE_HTTP_ERROR_CHUNK_ENC));
+}
+
+TEST(http_parser, body_until_close) {
+    const std::string response = "HTTP/1.1 200 OK\r\n\r\nsome data";
+    http::ResponseParser parser;
+    parser.feed(response.data(), response.size());
+    ASSERT_FALSE(parser.is_done());
+    parser.on_close();
+    ASSERT_TRUE(parser.is_done());
+    ASSERT_FALSE(parser.keep_alive);
+    ASSERT_EQ(body_of(parser), "some data");
+}
+
+TEST(http_parser, closed_before_end) {
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort";
+    http::ResponseParser parser;
+    parser.feed(response.data(), response.size());
+    parser.on_close();
+    ASSERT_TRUE(parser.has_failed());
+    ASSERT_EQ(parser.error, static_cast<int>(SCE_HTTP_ERROR_BAD_RESPONSE));
+}
+
+TEST(http_parser, no_body_responses) {
+    const std::string head_response = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+    http::ResponseParser head_parser(true);
+    head_parser.feed(head_response.data(), head_response.size());
+    ASSERT_TRUE(head_parser.is_done());
+    ASSERT_TRUE(head_parser.body.empty());
+
+    const std::string no_content = "HTTP/1.1 204 No Content\r\n\r\n";
+    http::ResponseParser parser;
+    parser.feed(no_content.data(), no_content.size());
+    ASSERT_TRUE(parser.is_done());
+    ASSERT_TRUE(parser.keep_alive);
+}
+
+TEST(http_parser, skips_interim_response) {
+    const std::string response = "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 2\r\n\r\nok";
+    http::ResponseParser parser;
+    ASSERT_EQ(parser.feed(response.data(), response.size()), response.size());
+    ASSERT_TRUE(parser.is_done());
+    ASSERT_EQ(parser.status_code, 201);
+    ASSERT_EQ(parser.header_block, "HTTP/1.1 201 Created\r\nContent-Length: 2\r\n\r\n");
+    ASSERT_EQ(body_of(parser), "ok");
+}
+
+TEST(http_parser, keep_alive_rules) {
+    const std::string http_1_0 = "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n";
+    http::ResponseParser parser_1_0;
+    parser_1_0.feed(http_1_0.data(), http_1_0.size());
+    ASSERT_FALSE(parser_1_0.keep_alive);
+
+    const std::string http_1_0_keep_alive = "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n";
+    http::ResponseParser parser_1_0_keep_alive;
+    parser_1_0_keep_alive.feed(http_1_0_keep_alive.data(), http_1_0_keep_alive.size());
+    ASSERT_TRUE(parser_1_0_keep_alive.keep_alive);
+
+    const std::string http_1_1_close = "HTTP/1.1 200 OK\r\nconnection: close\r\nContent-Length: 0\r\n\r\n";
+    http::ResponseParser parser_1_1_close;
+    parser_1_1_close.feed(http_1_1_close.data(), http_1_1_close.size());
+    ASSERT_TRUE(parser_1_1_close.is_done());
+    ASSERT_FALSE(parser_1_1_close.keep_alive);
+}
+
+TEST(http_parser, too_large_headers) {
+    const std::string response = "HTTP/1.1 200 OK\r\nX-Padding: " + std::string(200, 'a') + "\r\n\r\n";
+    http::ResponseParser parser(false, 64);
+    parser.feed(response.data(), response.size());
+    ASSERT_TRUE(parser.has_failed());
+    ASSERT_EQ(parser.error, static_cast<int>(SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER));
+}
+
+#ifndef WIN32
+
+// Serves the responses in order on one connection, then closes it or waits for the client to do it
+struct LoopbackServer {
+    int listen_fd = -1;
+    std::string port;
+    std::thread thread;
+
+    explicit LoopbackServer(std::vector<std::string> responses, bool wait_for_client = false) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        listen(listen_fd, 1);
+
+        socklen_t length = sizeof(addr);
+        getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &length);
+        port = std::to_string(ntohs(addr.sin_port));
+
+        thread = std::thread([this, responses = std::move(responses), wait_for_client]() {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            std::string received;
+            char buffer[1024];
+            for (const std::string &response : responses) {
+                // Answer once the request head is there
+                size_t end;
+                while ((end = received.find("\r\n\r\n")) == std::string::npos) {
+                    const auto ret = recv(fd, buffer, sizeof(buffer), 0);
+                    if (ret <= 0) {
+                        close(fd);
+                        return;
+                    }
+                    received.append(buffer, ret);
+                }
+                received.erase(0, end + 4);
+                send(fd, response.data(), response.size(), 0);
+            }
+            while (wait_for_client && recv(fd, buffer, sizeof(buffer), 0) > 0) {
+            }
+            close(fd);
+        });
+    }
+
+    ~LoopbackServer() {
+        thread.join();
+        close(listen_fd);
+    }
+};
+
+TEST(http_client, keep_alive_exchanges) {
+    LoopbackServer server({ "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nfirst",
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n6\r\nsecond\r\n0\r\n\r\n" });
+
+    http::ExchangeOptions options;
+    http::Transport transport;
+    ASSERT_EQ(http::open_transport(transport, "127.0.0.1", server.port, nullptr, options), 0);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    http::ResponseParser first;
+    ASSERT_EQ(http::exchange(transport, "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", nullptr, 0, first, options), 0);
+    ASSERT_EQ(body_of(first), "first");
+    ASSERT_TRUE(first.keep_alive);
+    ASSERT_TRUE(http::is_transport_alive(transport));
+
+    const std::string body = "data";
+    http::ResponseParser second;
+    ASSERT_EQ(http::exchange(transport, "POST / HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 4\r\n\r\n", body.data(), body.size(), second, options), 0);
+    ASSERT_EQ(body_of(second), "second");
+
+    // Both responses are complete as soon as they arrive, there is no waiting for more data
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 100);
+
+    http::close_transport(transport);
+    ASSERT_FALSE(transport.is_open());
+}
+
+TEST(http_client, server_closes_connection) {
+    LoopbackServer server({});
+
+    http::ExchangeOptions options;
+    http::Transport transport;
+    ASSERT_EQ(http::open_transport(transport, "127.0.0.1", server.port, nullptr, options), 0);
+
+    // The server is gone once it closed its side
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (http::is_transport_alive(transport) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_FALSE(http::is_transport_alive(transport));
+
+    http::ResponseParser parser;
+    const int ret = http::exchange(transport, "GET / HTTP/1.1\r\n\r\n", nullptr, 0, parser, options);
+    ASSERT_EQ(ret, static_cast<int>(SCE_HTTP_ERROR_NETWORK));
+
+    http::close_transport(transport);
+}
+
+TEST(http_client, abort_while_waiting) {
+    // The server never answers
+    LoopbackServer server({}, true);
+
+    std::atomic<bool> abort = false;
+    http::ExchangeOptions options;
+    options.abort = &abort;
+    http::Transport transport;
+    ASSERT_EQ(http::open_transport(transport, "127.0.0.1", server.port, nullptr, options), 0);
+
+    std::thread aborter([&abort]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        abort = true;
+    });
+
+    http::ResponseParser parser;
+    ASSERT_EQ(http::exchange(transport, "GET / HTTP/1.1\r\n\r\n", nullptr, 0, parser, options), static_cast<int>(SCE_HTTP_ERROR_ABORTED));
+
+    aborter.join();
+    http::close_transport(transport);
+}
+
+#endif
@@ -38,10 +38,14 @@
 #include <touch/touch.h>
 #include <util/find.h>
 #include <util/log.h>
+#include <util/mapped_file.h>
 #include <util/string_utils.h>
+#include <util/thread_pool.h>
 
 #include <gui/imgui_impl_sdl.h>
 
+#include <atomic>
+#include <chrono>
 #include <regex>
 
 #include <SDL.h>
@@ -62,6 +66,21 @@ static size_t write_to_buffer(void *pOpaque, mz_uint64 file_ofs, const void *pBu
     return n;
 }
 
+struct ExtractedFile {
+    fs::ofstream stream;
+    std::atomic<uint64_t> &extracted_size;
+};
+
+static size_t write_to_file(void *pOpaque, mz_uint64 file_ofs, const void *pBuf, size_t n) {
+    ExtractedFile *const file = static_cast<ExtractedFile *>(pOpaque);
+    file->stream.write(static_cast<const char *>(pBuf), n);
+    if (!file->stream)
+        return 0;
+
+    file->extracted_size += n;
+    return n;
+}
+
 static const char *miniz_get_error(const ZipPtr &zip) {
     return mz_zip_get_error_string(mz_zip_get_last_error(zip.get()));
 }
@@ -92,6 +111,35 @@ static bool is_nonpdrm(EmuEnvState &emuenv, const fs::path &output_path) {
     return false;
 }
 
+struct ArchiveFile {
+    mz_uint index;
+    fs::path path;
+    uint64_t size;
+};
+
+// Extracts the files given by next_file until there are none left, with a reader of its own over the mapped archive
+static bool extract_archive_files(const MappedFile &archive, const std::vector<ArchiveFile> &files, std::atomic<size_t> &next_file, std::atomic<uint64_t> &extracted_size) {
+    const ZipPtr zip(new mz_zip_archive, delete_zip);
+    std::memset(zip.get(), 0, sizeof(*zip));
+    if (!mz_zip_reader_init_mem(zip.get(), archive.data(), archive.size(), 0)) {
+        LOG_CRITICAL("miniz error reading archive: {}", miniz_get_error(zip));
+        return false;
+    }
+
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+        const ArchiveFile &file = files[i];
+        ExtractedFile output{ fs::ofstream(file.path, std::ios::binary), extracted_size };
+        if (!output.stream || !mz_zip_reader_extract_to_callback(zip.get(), file.index, &write_to_file, &output, 0)) {
+            LOG_CRITICAL("miniz error: {} extracting file: {}", miniz_get_error(zip), file.path.generic_path().string());
+            // Let the other readers stop too
+            next_file = files.size();
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static bool set_content_path(EmuEnvState &emuenv, const bool is_theme, fs::path &dest_path) {
     const auto app_path = dest_path / "app" / emuenv.app_info.app_title_id;
 
@@ -119,7 +167,7 @@ static bool set_content_path(EmuEnvState &emuenv, const bool is_theme, fs::path
     return true;
 }
 
-bool install_archive_content(EmuEnvState &emuenv, GuiState *gui, const fs::path &archive_path, const ZipPtr &zip, const std::string &content_path, const std::function<void(ArchiveContents)> &progress_callback) {
+bool install_archive_content(EmuEnvState &emuenv, GuiState *gui, const MappedFile &archive, const ZipPtr &zip, const std::string &content_path, const std::function<void(ArchiveContents)> &progress_callback) {
     std::string sfo_path = "sce_sys/param.sfo";
     std::string theme_path = "theme.xml";
     vfs::FileBuffer buffer, theme;
@@ -180,6 +228,9 @@ bool install_archive_content(EmuEnvState &emuenv, GuiState *gui, const fs::path
             progress_callback({ {}, {}, { file_progress * 0.7f + decrypt_progress * 0.3f } });
     };
 
+    // Create the directories first, then extract the files on all cores
+    std::vector<ArchiveFile> files;
+    uint64_t total_size = 0;
     int num_files = mz_zip_reader_get_num_files(zip.get());
     for (auto i = 0; i < num_files; i++) {
         mz_zip_archive_file_stat file_stat;
@@ -188,9 +239,6 @@ bool install_archive_content(EmuEnvState &emuenv, GuiState *gui, const fs::path
         }
         const std::string m_filename = file_stat.m_filename;
         if (m_filename.find(content_path) != std::string::npos) {
-            file_progress = static_cast<float>(i) / num_files * 100.0f;
-            update_progress();
-
             std::string replace_filename = m_filename.substr(content_path.size());
             const fs::path file_output = { output_path / replace_filename };
             if (mz_zip_reader_is_file_a_directory(zip.get(), i)) {
@@ -200,11 +248,44 @@ bool install_archive_content(EmuEnvState &emuenv, GuiState *gui, const fs::path
                     fs::create_directories(file_output.parent_path());
 
                 LOG_INFO("Extracting {}", file_output.generic_path().string());
-                mz_zip_reader_extract_to_file(zip.get(), i, file_output.generic_path().string().c_str(), 0);
+                files.push_back({ static_cast<mz_uint>(i), file_output, file_stat.m_uncomp_size });
+                total_size += file_stat.m_uncomp_size;
             }
         }
     }
 
+    // Biggest files first, so that a big one is not left alone on a thread at the end
+    std::sort(files.begin(), files.end(), [](const ArchiveFile &a, const ArchiveFile &b) {
+        return a.size > b.size;
+    });
+
+    if (!files.empty()) {
+        // The calling thread only reports the progress
+        ThreadPool &pool = ThreadPool::shared();
+        const size_t worker_count = std::min(pool.thread_count(), files.size());
+        std::atomic<size_t> next_file = 0;
+        std::atomic<uint64_t> extracted_size = 0;
+        std::vector<std::future<bool>> results;
+        for (size_t i = 0; i < worker_count; i++) {
+            results.push_back(pool.submit([&]() {
+                return extract_archive_files(archive, files, next_file, extracted_size);
+            }));
+        }
+
+        bool extracted = true;
+        for (auto &result : results) {
+            while (result.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+                file_progress = total_size ? extracted_size * 100.f / total_size : 0.f;
+                update_progress();
+            }
+            extracted &= result.get();
+        }
+        if (!extracted)
+            return false;
+    }
+    file_progress = 100.f;
+    update_progress();
+
     // Rename directory on correct name when is request, Todo of extract zip, no support unicode
     if (emuenv.app_info.app_category == "theme") {
         const auto dest = string_utils::utf_to_wide(output_path.string());
@@ -276,28 +357,22 @@ std::vector<ContentInfo> install_archive(EmuEnvState &emuenv, GuiState *gui, con
         LOG_CRITICAL("Failed to load archive file in path: {}", archive_path.generic_path().string());
         return {};
     }
+    // Mapped so that every extraction thread can read it with a reader of its own
+    MappedFile archive;
+    if (!archive.open(archive_path))
+        return {};
+
     const ZipPtr zip(new mz_zip_archive, delete_zip);
     std::memset(zip.get(), 0, sizeof(*zip));
 
-    FILE *vpk_fp;
-
-#ifdef WIN32
-    _wfopen_s(&vpk_fp, archive_path.generic_path().wstring().c_str(), L"rb");
-#else
-    vpk_fp = fopen(archive_path.generic_path().string().c_str(), "rb");
-#endif
-
-    if (!mz_zip_reader_init_cfile(zip.get(), vpk_fp, 0, 0)) {
+    if (!mz_zip_reader_init_mem(zip.get(), archive.data(), archive.size(), 0)) {
         LOG_CRITICAL("miniz error reading archive: {}", miniz_get_error(zip));
-        fclose(vpk_fp);
         return {};
     }
 
     const auto content_path = get_archive_contents_path(zip);
-    if (content_path.empty()) {
-        fclose(vpk_fp);
+    if (content_path.empty())
         return {};
-    }
 
     const auto count = float(content_path.size());
     float current = 0.f;
@@ -311,11 +386,10 @@ std::vector<ContentInfo> install_archive(EmuEnvState &emuenv, GuiState *gui, con
     for (auto &path : content_path) {
         current++;
         update_progress();
-        const bool state = install_archive_content(emuenv, gui, archive_path, zip, path, progress_callback);
+        const bool state = install_archive_content(emuenv, gui, archive, zip, path, progress_callback);
         content_installed.push_back({ emuenv.app_info.app_title, emuenv.app_info.app_title_id, emuenv.app_info.app_category, emuenv.app_info.app_content_id, path, state });
     }
 
-    fclose(vpk_fp);
     return content_installed;
 }
 
@@ -412,6 +486,55 @@ uint32_t install_contents(EmuEnvState &emuenv, GuiState *gui, const fs::path &pa
     return installed;
 }
 
+bool mount_archive_app(EmuEnvState &emuenv, const fs::path &archive_path) {
+    const auto archive = std::make_shared<vfs::Archive>();
+    if (!archive->open(archive_path))
+        return false;
+
+    // The app is either at the root of the archive or in one of its top directories
+    if (!archive->find("sce_sys/param.sfo")) {
+        const auto &root_children = archive->find("")->children;
+        const auto app_dir = std::find_if(root_children.begin(), root_children.end(), [&](const std::string &child) {
+            return archive->find(child + "/sce_sys/param.sfo") != nullptr;
+        });
+        if (app_dir == root_children.end()) {
+            LOG_ERROR("No app found in archive {}", archive_path.string());
+            return false;
+        }
+
+        const std::string app_root = *app_dir + "/";
+        if (!archive->open(archive_path, app_root))
+            return false;
+    }
+
+    if (archive->find("sce_module/steroid.suprx")) {
+        LOG_CRITICAL("A Vitamin dump was detected, aborting...");
+        return false;
+    }
+
+    // is_nonpdrm decrypts the files in place, which needs an extracted tree
+    if (archive->find("sce_sys/package/work.bin")) {
+        LOG_ERROR("NoNpDrm dumps cannot be run from an archive, install {} instead", archive_path.string());
+        return false;
+    }
+
+    const auto sfo = archive->find("sce_sys/param.sfo");
+    vfs::FileBuffer param(sfo->size);
+    if (archive->read(*sfo, 0, param.data(), sfo->size) != static_cast<int64_t>(sfo->size))
+        return false;
+
+    sfo::get_param_info(emuenv.app_info, param, emuenv.cfg.sys_lang);
+    if (emuenv.app_info.app_category != "gd") {
+        LOG_ERROR("{} [{}] is not an app, only apps can be run from an archive", emuenv.app_info.app_title, emuenv.app_info.app_title_id);
+        return false;
+    }
+
+    vfs::mount_app_archive(emuenv.app_info.app_title_id, archive);
+    LOG_INFO("{} [{}] mounted from {}", emuenv.app_info.app_title, emuenv.app_info.app_title_id, archive_path.string());
+
+    return true;
+}
+
 static auto pre_load_module(EmuEnvState &emuenv, const std::vector<std::string> &lib_load_list, const VitaIoDevice &device) {
     for (const auto &module_path : lib_load_list) {
         vfs::FileBuffer module_buffer;
@@ -448,7 +571,10 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
     const auto call_import = [&emuenv](CPUState &cpu, uint32_t nid, SceUID thread_id) {
         ::call_import(emuenv, cpu, nid, thread_id);
     };
-    if (!emuenv.kernel.init(emuenv.mem, call_import, emuenv.kernel.cpu_backend, emuenv.kernel.cpu_opt)) {
+    const auto call_import_slot = [&emuenv](CPUState &cpu, uint32_t slot, SceUID thread_id) {
+        ::call_import_slot(emuenv, cpu, slot, thread_id);
+    };
+    if (!emuenv.kernel.init(emuenv.mem, call_import, call_import_slot, resolve_import, emuenv.kernel.cpu_backend, emuenv.kernel.cpu_opt)) {
         LOG_WARN("Failed to init kernel!");
         return KernelInitFailed;
     }
@@ -490,6 +616,8 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
     init_device_paths(emuenv.io);
     init_savedata_app_path(emuenv.io, emuenv.pref_path);
 
+    emuenv.kernel.module_cache_path = (fs::path(emuenv.base_path) / "cache/modules" / emuenv.io.title_id).string();
+
     for (const auto &var : get_var_exports()) {
         auto addr = var.factory(emuenv);
         emuenv.kernel.export_nids.emplace(var.nid, addr);
@@ -499,7 +627,10 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
 
     // Load pre-loaded libraries
     const auto module_app_path{ fs::path(emuenv.pref_path) / "ux0/app" / emuenv.io.app_path / "sce_module" };
-    const auto is_app = fs::exists(module_app_path) && !fs::is_empty(module_app_path);
+    const auto app_archive = vfs::find_app_archive(emuenv.io.app_path);
+    const auto archive_module_dir = app_archive ? app_archive->find("sce_module") : nullptr;
+    const auto is_app = app_archive ? archive_module_dir && archive_module_dir->is_directory && !archive_module_dir->children.empty()
+                                    : fs::exists(module_app_path) && !fs::is_empty(module_app_path);
     if (is_app) {
         // Load application module
         const std::vector<std::string> lib_load_list = {
@@ -550,6 +681,39 @@ static ExitCode load_app_impl(Ptr<const void> &entry_point, EmuEnvState &emuenv,
     return Success;
 }
 
+ExitCode populate_module_cache(EmuEnvState &emuenv) {
+    // An archive is served in place rather than installed, its app info comes from mounting it
+    std::string app_path;
+    if (emuenv.cfg.run_app_path) {
+        app_path = *emuenv.cfg.run_app_path;
+        vfs::FileBuffer param;
+        if (!vfs::read_app_file(param, emuenv.pref_path, app_path, "sce_sys/param.sfo")) {
+            LOG_ERROR("No installed app found at {}", app_path);
+            return InvalidApplicationPath;
+        }
+        sfo::get_param_info(emuenv.app_info, param, emuenv.cfg.sys_lang);
+    } else if (emuenv.cfg.content_path && mount_archive_app(emuenv, *emuenv.cfg.content_path))
+        app_path = emuenv.app_info.app_title_id;
+    else {
+        LOG_ERROR("Populating the module cache needs an app installed at --installed-path or a .vpk/.zip content path");
+        return InvalidApplicationPath;
+    }
+
+    emuenv.app_path = emuenv.io.app_path = app_path;
+    emuenv.io.title_id = emuenv.app_info.app_title_id;
+    emuenv.current_app_title = emuenv.app_info.app_title;
+
+    gui::set_current_config(emuenv, app_path);
+    emuenv.kernel.cpu_backend = emuenv.cfg.current_config.cpu_backend == "Dynarmic" ? CPUBackend::Dynarmic : CPUBackend::Unicorn;
+    emuenv.kernel.cpu_opt = emuenv.cfg.current_config.cpu_opt;
+
+    Ptr<const void> entry_point;
+    const auto err = load_app_impl(entry_point, emuenv, string_utils::utf_to_wide(app_path));
+    LOG_INFO_IF(err == Success, "Module cache of {} populated in {}", emuenv.io.title_id, emuenv.kernel.module_cache_path);
+
+    return err;
+}
+
 static void handle_window_event(EmuEnvState &state, const SDL_WindowEvent event) {
     switch (static_cast<SDL_WindowEventID>(event.event)) {
     case SDL_WINDOWEVENT_SIZE_CHANGED:
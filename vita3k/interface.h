@@ -56,6 +56,10 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui);
 
 std::vector<ContentInfo> install_archive(EmuEnvState &emuenv, GuiState *gui, const fs::path &archive_path, const std::function<void(ArchiveContents)> &progress_callback = nullptr);
 uint32_t install_contents(EmuEnvState &emuenv, GuiState *gui, const fs::path &path);
+// Serves the app of a .vpk/.zip from the archive itself instead of installing it, sets the app info on success
+bool mount_archive_app(EmuEnvState &emuenv, const fs::path &archive_path);
 
 ExitCode load_app(Ptr<const void> &entry_point, EmuEnvState &emuenv, const std::wstring &path);
+// Loads the modules of the app given on the command line to fill its module cache, without renderer or GUI
+ExitCode populate_module_cache(EmuEnvState &emuenv);
 ExitCode run_app(EmuEnvState &emuenv, Ptr<const void> &entry_point);
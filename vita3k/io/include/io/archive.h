@@ -0,0 +1,118 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+#include <util/mapped_file.h>
+
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vfs {
+
+/**
+ * \brief Read-only view of a .vpk/.zip archive, used to run an app without extracting it.
+ *
+ * The archive is mapped in memory and indexed once. Stored entries are read straight from the mapping,
+ * deflated ones are decompressed in chunks kept in a LRU cache. Safe to use from several threads.
+ */
+class Archive {
+public:
+    struct Entry {
+        // Relative to the root of the archive, without trailing slash
+        std::string path;
+        bool is_directory = false;
+        bool is_deflated = false;
+        uint64_t size = 0;
+        uint64_t compressed_size = 0;
+        // Offset of the (compressed) data in the archive
+        uint64_t data_offset = 0;
+        time_t modification_time = 0;
+        // Names of the entries in a directory
+        std::vector<std::string> children;
+    };
+
+    // Decompressed data is cached in chunks of this size
+    static constexpr uint64_t CHUNK_SIZE = 256 * 1024;
+
+    explicit Archive(size_t cache_size = 32 * 1024 * 1024);
+    ~Archive();
+
+    /**
+     * \brief Maps and indexes the archive.
+     * \param root Directory of the archive used as the root, with a trailing slash, empty for the whole archive.
+     */
+    bool open(const fs::path &path, const std::string &root = "");
+
+    // Case insensitive, path relative to the root with '/' separators, empty for the root itself
+    const Entry *find(const std::string &path) const;
+
+    // Reads up to size bytes of a file at offset, returns the number of bytes read or -1 on a decompression error
+    int64_t read(const Entry &entry, uint64_t offset, void *data, uint64_t size);
+
+    // Contents of a stored file without any copy, nullptr for deflated ones
+    const uint8_t *view(const Entry &entry) const;
+
+    // True if the decompressed chunk starting at index * CHUNK_SIZE of a deflated file is in the cache
+    bool is_chunk_cached(const Entry &entry, uint64_t index);
+
+private:
+    struct Inflater;
+    struct Chunk {
+        const Entry *entry;
+        uint64_t index;
+        std::vector<uint8_t> data;
+    };
+    typedef std::pair<const Entry *, uint64_t> ChunkKey;
+
+    Entry &add_directories(const std::string &path);
+    const Chunk *get_chunk(const Entry &entry, uint64_t index);
+    bool inflate_chunk(Inflater &inflater, std::vector<uint8_t> &data);
+    void cache_chunk(const Entry &entry, uint64_t index, std::vector<uint8_t> data);
+
+    MappedFile file;
+    // By lowercase path
+    std::unordered_map<std::string, Entry> entries;
+
+    std::mutex mutex;
+    size_t cache_size;
+    size_t cached_size = 0;
+    // Most recently used first
+    std::list<Chunk> chunks;
+    std::map<ChunkKey, std::list<Chunk>::iterator> chunk_index;
+    // Decompression cursors kept between reads so that sequential reads of a file do not restart from its beginning
+    std::list<std::unique_ptr<Inflater>> inflaters;
+};
+
+typedef std::shared_ptr<Archive> ArchivePtr;
+
+// File of an archive opened by the app, with its own position
+struct ArchiveFile {
+    ArchivePtr archive;
+    const Archive::Entry *entry;
+    uint64_t position = 0;
+};
+
+} // namespace vfs
@@ -41,6 +41,8 @@ bool find_case_isens_path(IOState &io, VitaIoDevice &device, const fs::path &tra
 fs::path find_in_cache(IOState &io, const std::string &system_path);
 
 std::string expand_path(IOState &io, const char *path, const std::wstring &pref_path);
+// Same as expand_path for host libraries which need a real file, the files of an app run from an archive are extracted to cache_path first
+std::string expand_host_path(IOState &io, const char *path, const std::wstring &pref_path, const fs::path &cache_path);
 std::string translate_path(const char *path, VitaIoDevice &device, const IOState::DevicePaths &device_paths);
 
 /**
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <io/archive.h>
 #include <io/filesystem.h>
 #include <io/types.h>
 #include <io/util.h>
@@ -28,6 +29,8 @@
 class FileStats : public VitaStats {
     // Shared file pointer
     FilePtr wrapped_file;
+    // Set instead of the file pointer for files read from an archive
+    std::shared_ptr<vfs::ArchiveFile> archive_file;
 
 public:
     // Constructor used for files
@@ -43,6 +46,18 @@ public:
         file_info.access_mode = SCE_S_IFREG;
     }
 
+    // Constructor used for read-only files of an archive
+    explicit FileStats(const char *vita, const std::string &t, const fs::path &file, vfs::ArchivePtr archive, const vfs::Archive::Entry &entry) {
+        archive_file = std::make_shared<vfs::ArchiveFile>(vfs::ArchiveFile{ std::move(archive), &entry });
+
+        file_info.vita_loc = vita;
+        file_info.translated = t;
+        file_info.sys_loc = file;
+        file_info.open_mode = SCE_O_RDONLY;
+        file_info.file_mode = SCE_SO_IFREG | SCE_SO_IROTH;
+        file_info.access_mode = SCE_S_IFREG;
+    }
+
     bool is_regular_file() const {
         return file_info.file_mode & SCE_SO_IFREG;
     }
@@ -60,6 +75,10 @@ public:
         return wrapped_file.get();
     }
 
+    const vfs::ArchiveFile *get_archive_file() const {
+        return archive_file.get();
+    }
+
     // File functions
     SceOff read(void *input_data, int element_size, SceSize element_count) const;
     SceOff write(const void *data, SceSize size, int count) const;
@@ -72,6 +91,10 @@ public:
 class DirStats : public VitaStats {
     // Shared directory pointer
     DirPtr dir_ptr;
+    // Set instead of the directory pointer for directories of an archive
+    vfs::ArchivePtr archive;
+    const vfs::Archive::Entry *archive_dir = nullptr;
+    std::shared_ptr<size_t> next_child;
 
 public:
     DirStats(const char *vita, const std::string &t, const fs::path &file, DirPtr ptr) {
@@ -85,10 +108,33 @@ public:
         file_info.access_mode = SCE_S_IFDIR | SCE_S_IRUSR;
     }
 
+    DirStats(const char *vita, const std::string &t, const fs::path &file, vfs::ArchivePtr archive, const vfs::Archive::Entry &entry)
+        : archive(std::move(archive))
+        , archive_dir(&entry)
+        , next_child(std::make_shared<size_t>(0)) {
+        file_info.vita_loc = vita;
+        file_info.translated = t;
+        file_info.sys_loc = file;
+        file_info.open_mode = SCE_O_RDONLY;
+        file_info.file_mode = SCE_SO_IFDIR | SCE_SO_IROTH;
+        file_info.access_mode = SCE_S_IFDIR | SCE_S_IRUSR;
+    }
+
     auto get_dir_ptr() const {
         return get_system_dir_ptr(dir_ptr);
     }
 
+    bool is_archive_dir() const {
+        return archive_dir != nullptr;
+    }
+
+    // Name of the next entry of an archive directory, empty once all were read
+    std::string next_archive_entry() const {
+        if (*next_child >= archive_dir->children.size())
+            return {};
+        return archive_dir->children[(*next_child)++];
+    }
+
     bool is_directory() const {
         return file_info.file_mode & SCE_SO_IFDIR;
     }
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <io/archive.h>
 #include <util/fs.h>
 #include <util/types.h>
 
@@ -34,5 +35,13 @@ using FileBuffer = std::vector<SceUInt8>;
 
 bool read_file(VitaIoDevice device, FileBuffer &buf, const std::wstring &pref_path, const fs::path &vfs_file_path);
 bool read_app_file(FileBuffer &buf, const std::wstring &pref_path, const std::string &app_path, const fs::path &vfs_file_path);
+
+// Serves ux0:app/<app_path>, and app0: of that app, from a read-only archive instead of the host directory.
+// Only the guest file functions, read_file and expand_host_path see the archive, code reading the host
+// directory directly (the GUI app list, live area and manual) finds it empty.
+void mount_app_archive(const std::string &app_path, ArchivePtr archive);
+void unmount_app_archive(const std::string &app_path);
+ArchivePtr find_app_archive(const std::string &app_path);
+
 SpaceInfo get_space_info(const VitaIoDevice device, const std::string &vfs_path, const std::wstring &pref_path);
 } // namespace vfs
@@ -0,0 +1,309 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/archive.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace vfs {
+
+// Decompressing cursors kept at once, each holds the 32 KiB window of its stream
+static constexpr size_t MAX_INFLATERS = 4;
+
+static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr uint64_t LOCAL_HEADER_SIZE = 30;
+
+struct Archive::Inflater {
+    const Entry *entry;
+    mz_stream stream;
+    // Decompressed bytes produced so far, always at a chunk boundary between reads
+    uint64_t position = 0;
+    uint64_t consumed = 0;
+
+    explicit Inflater(const Entry &entry)
+        : entry(&entry) {
+        memset(&stream, 0, sizeof(stream));
+        // Zip entries are raw deflate streams, without zlib header
+        mz_inflateInit2(&stream, -MZ_DEFAULT_WINDOW_BITS);
+    }
+
+    ~Inflater() {
+        mz_inflateEnd(&stream);
+    }
+};
+
+static uint16_t read_u16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+static uint32_t read_u32(const uint8_t *data) {
+    return read_u16(data) | (read_u16(data + 2) << 16);
+}
+
+Archive::Archive(size_t cache_size)
+    : cache_size(std::max<size_t>(cache_size, CHUNK_SIZE)) {
+}
+
+Archive::~Archive() = default;
+
+Archive::Entry &Archive::add_directories(const std::string &path) {
+    const std::string key = string_utils::tolower(path);
+    auto entry = entries.find(key);
+    if (entry != entries.end())
+        return entry->second;
+
+    Entry &directory = entries[key];
+    directory.path = path;
+    directory.is_directory = true;
+    if (!path.empty()) {
+        const auto separator = path.rfind('/');
+        Entry &parent = add_directories(separator == std::string::npos ? std::string() : path.substr(0, separator));
+        parent.children.push_back(separator == std::string::npos ? path : path.substr(separator + 1));
+    }
+
+    return directory;
+}
+
+bool Archive::open(const fs::path &path, const std::string &root) {
+    if (!file.open(path))
+        return false;
+
+    mz_zip_archive zip;
+    memset(&zip, 0, sizeof(zip));
+    if (!mz_zip_reader_init_mem(&zip, file.data(), file.size(), 0)) {
+        LOG_ERROR("miniz error reading archive {}: {}", path.string(), mz_zip_get_error_string(mz_zip_get_last_error(&zip)));
+        return false;
+    }
+
+    entries.clear();
+    chunks.clear();
+    chunk_index.clear();
+    cached_size = 0;
+    inflaters.clear();
+    add_directories("");
+
+    const mz_uint num_files = mz_zip_reader_get_num_files(&zip);
+    for (mz_uint i = 0; i < num_files; i++) {
+        mz_zip_archive_file_stat file_stat;
+        if (!mz_zip_reader_file_stat(&zip, i, &file_stat))
+            continue;
+
+        std::string entry_path = file_stat.m_filename;
+        string_utils::replace(entry_path, "\\", "/");
+        if (!entry_path.starts_with(root))
+            continue;
+        entry_path.erase(0, root.size());
+        while (!entry_path.empty() && entry_path.back() == '/')
+            entry_path.pop_back();
+        if (entry_path.empty())
+            continue;
+
+        if (file_stat.m_is_directory) {
+            add_directories(entry_path).modification_time = file_stat.m_time;
+            continue;
+        }
+
+        if (file_stat.m_is_encrypted || !file_stat.m_is_supported || (file_stat.m_method != 0 && file_stat.m_method != MZ_DEFLATED)) {
+            LOG_WARN("Unsupported compression of {} in archive, skipping it", entry_path);
+            continue;
+        }
+
+        // The data follows the local header, whose variable fields can differ from the central directory ones
+        const uint64_t header_offset = file_stat.m_local_header_ofs;
+        if (!file.contains(header_offset, LOCAL_HEADER_SIZE) || read_u32(file.data() + header_offset) != LOCAL_HEADER_SIGNATURE) {
+            LOG_WARN("Invalid local header for {} in archive, skipping it", entry_path);
+            continue;
+        }
+        const uint64_t data_offset = header_offset + LOCAL_HEADER_SIZE + read_u16(file.data() + header_offset + 26) + read_u16(file.data() + header_offset + 28);
+        if (!file.contains(data_offset, file_stat.m_comp_size)) {
+            LOG_WARN("{} is past the end of the archive, skipping it", entry_path);
+            continue;
+        }
+
+        const auto separator = entry_path.rfind('/');
+        Entry &parent = add_directories(separator == std::string::npos ? std::string() : entry_path.substr(0, separator));
+        const std::string key = string_utils::tolower(entry_path);
+        if (entries.contains(key))
+            continue;
+        parent.children.push_back(separator == std::string::npos ? entry_path : entry_path.substr(separator + 1));
+
+        Entry &entry = entries[key];
+        entry.path = entry_path;
+        entry.is_deflated = file_stat.m_method == MZ_DEFLATED;
+        entry.size = file_stat.m_uncomp_size;
+        entry.compressed_size = file_stat.m_comp_size;
+        entry.data_offset = data_offset;
+        entry.modification_time = file_stat.m_time;
+    }
+
+    mz_zip_reader_end(&zip);
+
+    LOG_INFO("Indexed {} entries of archive {}", entries.size(), path.string());
+    return true;
+}
+
+const Archive::Entry *Archive::find(const std::string &path) const {
+    std::string key = string_utils::tolower(path);
+    string_utils::replace(key, "\\", "/");
+    while (!key.empty() && key.back() == '/')
+        key.pop_back();
+    while (!key.empty() && key.front() == '/')
+        key.erase(0, 1);
+
+    const auto entry = entries.find(key);
+    return entry != entries.end() ? &entry->second : nullptr;
+}
+
+const uint8_t *Archive::view(const Entry &entry) const {
+    if (entry.is_directory || entry.is_deflated)
+        return nullptr;
+
+    return file.data() + entry.data_offset;
+}
+
+bool Archive::is_chunk_cached(const Entry &entry, uint64_t index) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return chunk_index.contains({ &entry, index });
+}
+
+int64_t Archive::read(const Entry &entry, uint64_t offset, void *data, uint64_t size) {
+    if (entry.is_directory)
+        return -1;
+    if (offset >= entry.size)
+        return 0;
+    size = std::min(size, entry.size - offset);
+
+    if (!entry.is_deflated) {
+        memcpy(data, file.data() + entry.data_offset + offset, size);
+        return size;
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    uint8_t *out = static_cast<uint8_t *>(data);
+    uint64_t remaining = size;
+    while (remaining != 0) {
+        const Chunk *chunk = get_chunk(entry, offset / CHUNK_SIZE);
+        if (!chunk)
+            return -1;
+
+        const uint64_t chunk_offset = offset % CHUNK_SIZE;
+        const uint64_t copy_size = std::min(remaining, chunk->data.size() - chunk_offset);
+        memcpy(out, chunk->data.data() + chunk_offset, copy_size);
+        out += copy_size;
+        offset += copy_size;
+        remaining -= copy_size;
+    }
+
+    return size;
+}
+
+const Archive::Chunk *Archive::get_chunk(const Entry &entry, uint64_t index) {
+    const auto cached = chunk_index.find({ &entry, index });
+    if (cached != chunk_index.end()) {
+        chunks.splice(chunks.begin(), chunks, cached->second);
+        return &chunks.front();
+    }
+
+    // Resume from the cursor closest before the chunk, or start over
+    const uint64_t target = index * CHUNK_SIZE;
+    auto best = inflaters.end();
+    for (auto it = inflaters.begin(); it != inflaters.end(); ++it) {
+        if ((*it)->entry == &entry && (*it)->position <= target && (best == inflaters.end() || (*best)->position < (*it)->position))
+            best = it;
+    }
+    if (best == inflaters.end()) {
+        if (inflaters.size() >= MAX_INFLATERS)
+            inflaters.pop_back();
+        inflaters.push_front(std::make_unique<Inflater>(entry));
+        best = inflaters.begin();
+    } else {
+        inflaters.splice(inflaters.begin(), inflaters, best);
+    }
+    Inflater &inflater = *inflaters.front();
+
+    // Every chunk decompressed on the way is cached too, a later seek backwards may need it
+    while (inflater.position <= target) {
+        const uint64_t chunk_index_of_position = inflater.position / CHUNK_SIZE;
+        std::vector<uint8_t> data(std::min(CHUNK_SIZE, entry.size - inflater.position));
+        if (!inflate_chunk(inflater, data)) {
+            LOG_ERROR("Failed to decompress {} from archive", entry.path);
+            inflaters.pop_front();
+            return nullptr;
+        }
+        if (!chunk_index.contains({ &entry, chunk_index_of_position }))
+            cache_chunk(entry, chunk_index_of_position, std::move(data));
+    }
+
+    // Finished streams are of no use anymore
+    if (inflater.position >= entry.size)
+        inflaters.pop_front();
+
+    const auto chunk = chunk_index.find({ &entry, index });
+    if (chunk == chunk_index.end())
+        return nullptr;
+    chunks.splice(chunks.begin(), chunks, chunk->second);
+    return &chunks.front();
+}
+
+bool Archive::inflate_chunk(Inflater &inflater, std::vector<uint8_t> &data) {
+    mz_stream &stream = inflater.stream;
+    stream.next_out = data.data();
+    stream.avail_out = static_cast<unsigned int>(data.size());
+
+    while (stream.avail_out != 0) {
+        const uint64_t available = inflater.entry->compressed_size - inflater.consumed;
+        stream.next_in = file.data() + inflater.entry->data_offset + inflater.consumed;
+        stream.avail_in = static_cast<unsigned int>(std::min<uint64_t>(available, UINT_MAX));
+
+        const unsigned int avail_in = stream.avail_in;
+        const int ret = mz_inflate(&stream, MZ_SYNC_FLUSH);
+        inflater.consumed += avail_in - stream.avail_in;
+        if (ret == MZ_STREAM_END)
+            break;
+        if (ret != MZ_OK)
+            return false;
+    }
+
+    if (stream.avail_out != 0)
+        return false;
+
+    inflater.position += data.size();
+    return true;
+}
+
+void Archive::cache_chunk(const Entry &entry, uint64_t index, std::vector<uint8_t> data) {
+    cached_size += data.size();
+    chunks.push_front({ &entry, index, std::move(data) });
+    chunk_index[{ &entry, index }] = chunks.begin();
+
+    // The chunk just added is never evicted, the cache holds at least one chunk
+    while (cached_size > cache_size && chunks.size() > 1) {
+        const Chunk &oldest = chunks.back();
+        cached_size -= oldest.data.size();
+        chunk_index.erase({ oldest.entry, oldest.index });
+        chunks.pop_back();
+    }
+}
+
+} // namespace vfs
@@ -36,9 +36,12 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <string>
 
 // ****************************
@@ -60,7 +63,50 @@ constexpr bool log_file_stat = false;
 
 namespace vfs {
 
+static std::mutex app_archives_mutex;
+// By app path
+static std::map<std::string, ArchivePtr> app_archives;
+
+void mount_app_archive(const std::string &app_path, ArchivePtr archive) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    app_archives[app_path] = std::move(archive);
+}
+
+void unmount_app_archive(const std::string &app_path) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    app_archives.erase(app_path);
+}
+
+ArchivePtr find_app_archive(const std::string &app_path) {
+    const std::lock_guard<std::mutex> lock(app_archives_mutex);
+    const auto archive = app_archives.find(app_path);
+    return archive != app_archives.end() ? archive->second : nullptr;
+}
+
+// Archive mounted in place of the ux0:app directory the translated path is in, along with the path inside the archive
+static ArchivePtr find_path_archive(const VitaIoDevice device, const std::string &translated_path, std::string &archive_path) {
+    if (device != VitaIoDevice::ux0 || !translated_path.starts_with("app/"))
+        return nullptr;
+
+    const auto app_end = translated_path.find('/', 4);
+    const auto archive = find_app_archive(translated_path.substr(4, app_end == std::string::npos ? std::string::npos : app_end - 4));
+    if (archive)
+        archive_path = app_end == std::string::npos ? std::string() : translated_path.substr(app_end + 1);
+
+    return archive;
+}
+
 bool read_file(const VitaIoDevice device, FileBuffer &buf, const std::wstring &pref_path, const fs::path &vfs_file_path) {
+    std::string archive_path;
+    if (const auto archive = find_path_archive(device, vfs_file_path.generic_string(), archive_path)) {
+        const auto entry = archive->find(archive_path);
+        if (!entry || entry->is_directory)
+            return false;
+
+        buf.resize(entry->size);
+        return archive->read(*entry, 0, buf.data(), entry->size) == static_cast<int64_t>(entry->size);
+    }
+
     const auto host_file_path = device::construct_emulated_path(device, vfs_file_path, pref_path).generic_path();
 
     fs::ifstream f{ host_file_path, fs::ifstream::binary };
@@ -269,6 +315,39 @@ std::string expand_path(IOState &io, const char *path, const std::wstring &pref_
     return device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio).string();
 }
 
+std::string expand_host_path(IOState &io, const char *path, const std::wstring &pref_path, const fs::path &cache_path) {
+    auto device = device::get_device(path);
+    const auto translated_path = translate_path(path, device, io.device_paths);
+
+    std::string archive_path;
+    const auto archive = vfs::find_path_archive(device, translated_path, archive_path);
+    const auto entry = archive ? archive->find(archive_path) : nullptr;
+    if (!entry || entry->is_directory)
+        return device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio).string();
+
+    // Kept for the next calls, the archive is read-only
+    const auto host_path{ cache_path / "archive" / translated_path };
+    if (fs::exists(host_path) && fs::file_size(host_path) == entry->size)
+        return host_path.string();
+
+    fs::create_directories(host_path.parent_path());
+    fs::ofstream file{ host_path, fs::ofstream::binary };
+    std::vector<char> buffer(std::min<uint64_t>(entry->size, vfs::Archive::CHUNK_SIZE));
+    for (uint64_t offset = 0; offset < entry->size;) {
+        const auto read = archive->read(*entry, offset, buffer.data(), buffer.size());
+        if (read <= 0) {
+            LOG_ERROR("Failed to extract {} from archive", archive_path);
+            file.close();
+            fs::remove(host_path);
+            break;
+        }
+        file.write(buffer.data(), read);
+        offset += read;
+    }
+
+    return host_path.string();
+}
+
 SceUID open_file(IOState &io, const char *path, const int flags, const std::wstring &pref_path, const char *export_name) {
     auto device = device::get_device(path);
     auto device_for_icase = device;
@@ -300,6 +379,29 @@ SceUID open_file(IOState &io, const char *path, const int flags, const std::wstr
     }
 
     auto system_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
+
+    std::string archive_path;
+    if (const auto archive = vfs::find_path_archive(device, translated_path, archive_path)) {
+        if (can_write(flags)) {
+            LOG_ERROR("Cannot open {} for writing, the app is run from an archive", path);
+            return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+        }
+
+        const auto entry = archive->find(archive_path);
+        if (!entry || entry->is_directory) {
+            LOG_ERROR("Missing file {} in archive (target path: {})", archive_path, path);
+            return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+        }
+
+        const auto normalized_path = device::construct_normalized_path(device, translated_path);
+        FileStats f{ path, normalized_path, system_path, archive, *entry };
+        const auto fd = io.next_fd++;
+        io.std_files.emplace(fd, f);
+
+        LOG_TRACE_IF(log_file_op, "{}: Opening file {} ({}) from archive, fd: {}", export_name, path, normalized_path, log_hex(fd));
+        return fd;
+    }
+
     // Do not allow any new files if they do not have a write flag.
     if (!fs::exists(system_path)) {
         if (!(flags & SCE_O_CREAT)) {
@@ -418,6 +520,10 @@ int truncate_file(const SceUID fd, unsigned long long length, const IOState &io,
     const auto file = io.std_files.find(fd);
     if (file == io.std_files.end())
         return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
+    if (file->second.get_archive_file()) {
+        LOG_ERROR("Cannot truncate fd: {}, the app is run from an archive", log_hex(fd));
+        return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+    }
     auto trunc = file->second.truncate(length);
     LOG_TRACE_IF(log_file_op, "{}: Truncating fd: {}, to size: {}", export_name, log_hex(fd), length);
     return trunc;
@@ -463,6 +569,9 @@ SceOff tell_file(IOState &io, const SceUID fd, const char *export_name) {
     return std_file->second.tell();
 }
 
+// Defined after stat_file, which undefines the st_*time macros of the host stat
+static void stat_archive_entry(const vfs::Archive::Entry &entry, SceIoStat *statp);
+
 int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstring &pref_path, const char *export_name,
     const SceUID fd) {
     assert(statp != nullptr);
@@ -479,6 +588,20 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
         }
 
         const auto translated_path = translate_path(file, device, io.device_paths);
+
+        std::string archive_path;
+        if (const auto archive = vfs::find_path_archive(device, translated_path, archive_path)) {
+            const auto entry = archive->find(archive_path);
+            if (!entry) {
+                LOG_ERROR("Missing file {} in archive (target path: {})", archive_path, file);
+                return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+            }
+
+            LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting file: {} ({}) from archive", export_name, file, device::construct_normalized_path(device, translated_path));
+            stat_archive_entry(*entry, statp);
+            return 0;
+        }
+
         file_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
 
         if (!fs::exists(file_path)) {
@@ -510,6 +633,12 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
         if (fd_file == io.std_files.end())
             return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 
+        if (const auto archive_file = fd_file->second.get_archive_file()) {
+            LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting fd: {} from archive", export_name, log_hex(fd));
+            stat_archive_entry(*archive_file->entry, statp);
+            return 0;
+        }
+
         file_path = fd_file->second.get_system_location();
         LOG_TRACE_IF(log_file_op && log_file_stat, "{}: Statting fd: {}", export_name, log_hex(fd));
 
@@ -559,6 +688,25 @@ int stat_file(IOState &io, const char *file, SceIoStat *statp, const std::wstrin
     return 0;
 }
 
+static void stat_archive_entry(const vfs::Archive::Entry &entry, SceIoStat *statp) {
+    // Archives only keep the modification time
+    const std::uint64_t modification_time_ticks = (uint64_t)entry.modification_time * VITA_CLOCKS_PER_SEC;
+
+    statp->st_mode = SCE_S_IRUSR | SCE_S_IRGRP | SCE_S_IROTH | SCE_S_IXUSR | SCE_S_IXGRP | SCE_S_IXOTH;
+    if (entry.is_directory) {
+        statp->st_attr = SCE_SO_IFDIR;
+        statp->st_mode |= SCE_S_IFDIR;
+    } else {
+        statp->st_size = entry.size;
+        statp->st_attr = SCE_SO_IFREG;
+        statp->st_mode |= SCE_S_IFREG;
+    }
+
+    __RtcTicksToPspTime(&statp->st_atime, modification_time_ticks);
+    __RtcTicksToPspTime(&statp->st_mtime, modification_time_ticks);
+    __RtcTicksToPspTime(&statp->st_ctime, modification_time_ticks);
+}
+
 int stat_file_by_fd(IOState &io, const SceUID fd, SceIoStat *statp, const std::wstring &pref_path, const char *export_name) {
     assert(statp != nullptr);
     memset(statp, '\0', sizeof(SceIoStat));
@@ -596,6 +744,12 @@ int remove_file(IOState &io, const char *file, const std::wstring &pref_path, co
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
+    std::string archive_path;
+    if (vfs::find_path_archive(device, translated_path, archive_path)) {
+        LOG_ERROR("Cannot remove file {}, the app is run from an archive", file);
+        return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+    }
+
     const auto emulated_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
     if (!fs::exists(emulated_path) || fs::is_directory(emulated_path)) {
         LOG_ERROR("File does not exist at path: {} (target path: {})", emulated_path.string(), file);
@@ -621,6 +775,23 @@ SceUID open_dir(IOState &io, const char *path, const std::wstring &pref_path, co
     const auto translated_path = translate_path(path, device, io.device_paths);
 
     auto dir_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio) / "/";
+
+    std::string archive_path;
+    if (const auto archive = vfs::find_path_archive(device, translated_path, archive_path)) {
+        const auto entry = archive->find(archive_path);
+        if (!entry || !entry->is_directory) {
+            LOG_ERROR("Directory {} does not exist in archive (target path: {})", archive_path, path);
+            return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
+        }
+
+        const auto normalized = device::construct_normalized_path(device, translated_path);
+        const DirStats d{ path, normalized, dir_path, archive, *entry };
+        const auto fd = io.next_fd++;
+        io.dir_entries.emplace(fd, d);
+
+        LOG_TRACE_IF(log_file_op, "{}: Opening dir {} ({}) from archive, fd: {}", export_name, path, normalized, log_hex(fd));
+        return fd;
+    }
     if (!fs::exists(dir_path)) {
         if (io.case_isens_find_enabled) {
             // Attempt a case-insensitive file search.
@@ -673,6 +844,20 @@ SceUID read_dir(IOState &io, const SceUID fd, SceIoDirent *dent, const std::wstr
         if (!dir->second.is_directory())
             return IO_ERROR(SCE_ERROR_ERRNO_EBADFD);
 
+        if (dir->second.is_archive_dir()) {
+            const auto name = dir->second.next_archive_entry();
+            if (name.empty())
+                return 0;
+
+            strncpy(dent->d_name, name.c_str(), sizeof(dent->d_name));
+            const auto file_path = std::string(dir->second.get_vita_loc()) + '/' + name;
+
+            LOG_TRACE_IF(log_file_op, "{}: Reading entry {} of fd: {}", export_name, file_path, log_hex(fd));
+            if (stat_file(io, file_path.c_str(), &dent->d_stat, pref_path, export_name) < 0)
+                return IO_ERROR(SCE_ERROR_ERRNO_EMFILE);
+            return 1; // move to the next file
+        }
+
         const auto d = dir->second.get_dir_ptr();
         if (!d)
             return 0;
@@ -742,6 +927,12 @@ int create_dir(IOState &io, const char *dir, int mode, const std::wstring &pref_
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
+    std::string archive_path;
+    if (vfs::find_path_archive(device, translated_path, archive_path)) {
+        LOG_ERROR("Cannot create directory {}, the app is run from an archive", dir);
+        return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+    }
+
     const auto emulated_path = device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio);
     if (recursive)
         return fs::create_directories(emulated_path);
@@ -789,6 +980,12 @@ int remove_dir(IOState &io, const char *dir, const std::wstring &pref_path, cons
         return IO_ERROR(SCE_ERROR_ERRNO_ENOENT);
     }
 
+    std::string archive_path;
+    if (vfs::find_path_archive(device, translated_path, archive_path)) {
+        LOG_ERROR("Cannot remove directory {}, the app is run from an archive", dir);
+        return IO_ERROR(SCE_ERROR_ERRNO_EROFS);
+    }
+
     LOG_TRACE_IF(log_file_op, "{}: Removing dir {} ({})", export_name, dir, device::construct_normalized_path(device, translated_path));
 
     if (!fs::remove_all(device::construct_emulated_path(device, translated_path, pref_path, io.redirect_stdio))) {
@@ -24,9 +24,18 @@
 #include <unistd.h>
 #endif
 
+#include <io/io.h>
 #include <io/state.h>
 
 SceOff FileStats::read(void *input_data, const int element_size, const SceSize element_count) const {
+    if (archive_file) {
+        const auto read = archive_file->archive->read(*archive_file->entry, archive_file->position, input_data, static_cast<uint64_t>(element_size) * element_count);
+        if (read < 0)
+            return -1;
+        archive_file->position += read;
+        return read / element_size;
+    }
+
     if (!wrapped_file)
         return -1;
 
@@ -41,6 +50,9 @@ SceOff FileStats::write(const void *data, const SceSize size, const int count) c
 }
 
 int FileStats::truncate(const SceSize size) const {
+    if (archive_file)
+        return SCE_ERROR_ERRNO_EROFS;
+
 #ifdef _WIN32
     return _chsize_s(_fileno(get_file_pointer()), size);
 #else
@@ -49,6 +61,27 @@ int FileStats::truncate(const SceSize size) const {
 }
 
 bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
+    if (archive_file) {
+        SceOff base = 0;
+        switch (seek_mode) {
+        case SCE_SEEK_SET:
+            break;
+        case SCE_SEEK_CUR:
+            base = archive_file->position;
+            break;
+        case SCE_SEEK_END:
+            base = archive_file->entry->size;
+            break;
+        default:
+            return false;
+        }
+        if (base + offset < 0)
+            return false;
+
+        archive_file->position = base + offset;
+        return true;
+    }
+
     if (!wrapped_file)
         return false;
 
@@ -75,6 +108,9 @@ bool FileStats::seek(const SceOff offset, const SceIoSeekMode seek_mode) const {
 }
 
 SceOff FileStats::tell() const {
+    if (archive_file)
+        return archive_file->position;
+
     if (!wrapped_file)
         return -1;
 
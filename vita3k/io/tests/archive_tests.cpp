@@ -0,0 +1,213 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <io/archive.h>
+
+#include <gtest/gtest.h>
+#include <miniz.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using vfs::Archive;
+
+static constexpr uint64_t CHUNK_SIZE = Archive::CHUNK_SIZE;
+
+class ArchiveTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 rng(3);
+
+        // Random bytes do not compress, the stored file is as big as the deflated one
+        stored.resize(2 * CHUNK_SIZE + 1234);
+        for (uint8_t &byte : stored)
+            byte = static_cast<uint8_t>(rng());
+
+        // Runs of a few values, deflated to a fraction of their size
+        deflated.resize(5 * CHUNK_SIZE + 4321);
+        for (size_t i = 0; i < deflated.size();) {
+            const size_t run = std::min<size_t>(rng() % 64 + 1, deflated.size() - i);
+            std::fill_n(deflated.begin() + i, run, static_cast<uint8_t>(rng() % 8));
+            i += run;
+        }
+
+        path = fs::temp_directory_path() / fs::unique_path("vita3k-archive-%%%%-%%%%.zip");
+        mz_zip_archive zip;
+        memset(&zip, 0, sizeof(zip));
+        ASSERT_TRUE(mz_zip_writer_init_file(&zip, path.string().c_str(), 0));
+        ASSERT_TRUE(mz_zip_writer_add_mem(&zip, "PCSA00000/eboot.bin", stored.data(), stored.size(), MZ_NO_COMPRESSION));
+        ASSERT_TRUE(mz_zip_writer_add_mem(&zip, "PCSA00000/Data/Level.dat", deflated.data(), deflated.size(), MZ_DEFAULT_LEVEL));
+        ASSERT_TRUE(mz_zip_writer_add_mem(&zip, "PCSA00000/sce_sys/param.sfo", "PSF", 3, MZ_DEFAULT_LEVEL));
+        ASSERT_TRUE(mz_zip_writer_add_mem(&zip, "PCSA00000/Empty/", nullptr, 0, 0));
+        ASSERT_TRUE(mz_zip_writer_add_mem(&zip, "readme.txt", "readme", 6, MZ_NO_COMPRESSION));
+        ASSERT_TRUE(mz_zip_writer_finalize_archive(&zip));
+        ASSERT_TRUE(mz_zip_writer_end(&zip));
+    }
+
+    void TearDown() override {
+        fs::remove(path);
+    }
+
+    static std::vector<uint8_t> read(Archive &archive, const Archive::Entry &entry, uint64_t offset, uint64_t size) {
+        std::vector<uint8_t> data(size);
+        const int64_t read = archive.read(entry, offset, data.data(), size);
+        EXPECT_GE(read, 0);
+        data.resize(std::max<int64_t>(read, 0));
+        return data;
+    }
+
+    static std::vector<uint8_t> slice(const std::vector<uint8_t> &data, uint64_t offset, uint64_t size) {
+        offset = std::min<uint64_t>(offset, data.size());
+        size = std::min<uint64_t>(size, data.size() - offset);
+        return std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + size);
+    }
+
+    fs::path path;
+    std::vector<uint8_t> stored;
+    std::vector<uint8_t> deflated;
+};
+
+TEST_F(ArchiveTest, index_lookup) {
+    Archive archive;
+    ASSERT_TRUE(archive.open(path));
+
+    const auto root = archive.find("");
+    ASSERT_NE(root, nullptr);
+    EXPECT_TRUE(root->is_directory);
+    EXPECT_EQ(root->children.size(), 2);
+
+    // Case insensitive, with any separators, leading and trailing slashes
+    const auto eboot = archive.find("pcsa00000/EBOOT.BIN");
+    ASSERT_NE(eboot, nullptr);
+    EXPECT_EQ(archive.find("/PCSA00000\\eboot.bin"), eboot);
+    EXPECT_EQ(eboot->path, "PCSA00000/eboot.bin");
+    EXPECT_FALSE(eboot->is_directory);
+    EXPECT_FALSE(eboot->is_deflated);
+    EXPECT_EQ(eboot->size, stored.size());
+
+    const auto level = archive.find("PCSA00000/data/level.dat");
+    ASSERT_NE(level, nullptr);
+    EXPECT_TRUE(level->is_deflated);
+    EXPECT_EQ(level->size, deflated.size());
+    EXPECT_LT(level->compressed_size, level->size);
+
+    // Directories exist whether the archive has entries for them or not
+    const auto data_dir = archive.find("PCSA00000/Data/");
+    ASSERT_NE(data_dir, nullptr);
+    EXPECT_TRUE(data_dir->is_directory);
+    EXPECT_EQ(data_dir->children, std::vector<std::string>{ "Level.dat" });
+    const auto empty_dir = archive.find("PCSA00000/Empty");
+    ASSERT_NE(empty_dir, nullptr);
+    EXPECT_TRUE(empty_dir->is_directory);
+    EXPECT_TRUE(empty_dir->children.empty());
+
+    EXPECT_EQ(archive.find("PCSA00000/missing.bin"), nullptr);
+    EXPECT_EQ(archive.find("PCSA00000/eboot.bin/x"), nullptr);
+
+    // Only the entries under the root are kept, relative to it
+    ASSERT_TRUE(archive.open(path, "PCSA00000/"));
+    EXPECT_NE(archive.find("sce_sys/param.sfo"), nullptr);
+    EXPECT_NE(archive.find("EBOOT.bin"), nullptr);
+    EXPECT_EQ(archive.find("readme.txt"), nullptr);
+    EXPECT_EQ(archive.find("")->children.size(), 4);
+}
+
+TEST_F(ArchiveTest, stored_reads) {
+    Archive archive;
+    ASSERT_TRUE(archive.open(path));
+    const auto &entry = *archive.find("PCSA00000/eboot.bin");
+
+    ASSERT_NE(archive.view(entry), nullptr);
+    EXPECT_EQ(memcmp(archive.view(entry), stored.data(), stored.size()), 0);
+
+    for (const uint64_t offset : { uint64_t(0), CHUNK_SIZE - 10, CHUNK_SIZE, 2 * CHUNK_SIZE + 1000 }) {
+        EXPECT_EQ(read(archive, entry, offset, 5000), slice(stored, offset, 5000)) << offset;
+    }
+
+    // Reads stop at the end of the file
+    EXPECT_EQ(read(archive, entry, stored.size() - 100, 5000).size(), 100);
+    EXPECT_TRUE(read(archive, entry, stored.size(), 10).empty());
+    EXPECT_TRUE(read(archive, entry, stored.size() + 10, 10).empty());
+}
+
+TEST_F(ArchiveTest, deflated_reads_across_chunks) {
+    Archive archive;
+    ASSERT_TRUE(archive.open(path));
+    const auto &entry = *archive.find("PCSA00000/Data/Level.dat");
+    EXPECT_EQ(archive.view(entry), nullptr);
+
+    // Sequential reads whose size is not a divisor of the chunk size
+    std::vector<uint8_t> data;
+    for (uint64_t offset = 0; offset < entry.size; offset += 100000) {
+        const auto part = read(archive, entry, offset, 100000);
+        data.insert(data.end(), part.begin(), part.end());
+    }
+    EXPECT_EQ(data, deflated);
+
+    // A single read over every chunk
+    Archive fresh;
+    ASSERT_TRUE(fresh.open(path));
+    EXPECT_EQ(read(fresh, *fresh.find("PCSA00000/Data/Level.dat"), 0, deflated.size() + 10), deflated);
+
+    EXPECT_EQ(read(archive, entry, deflated.size() - 10, 100), slice(deflated, deflated.size() - 10, 100));
+    EXPECT_TRUE(read(archive, entry, deflated.size(), 100).empty());
+}
+
+TEST_F(ArchiveTest, deflated_backward_seeks) {
+    // Room for a single chunk, going back always decompresses again
+    Archive archive(CHUNK_SIZE);
+    ASSERT_TRUE(archive.open(path));
+    const auto &entry = *archive.find("PCSA00000/Data/Level.dat");
+
+    for (const uint64_t offset : { 4 * CHUNK_SIZE + 7, 3 * CHUNK_SIZE - 7, uint64_t(5), 5 * CHUNK_SIZE, 2 * CHUNK_SIZE - 1, CHUNK_SIZE }) {
+        EXPECT_EQ(read(archive, entry, offset, 3000), slice(deflated, offset, 3000)) << offset;
+    }
+
+    std::mt19937 rng(4);
+    for (int i = 0; i < 50; i++) {
+        const uint64_t offset = rng() % deflated.size();
+        const uint64_t size = rng() % (2 * CHUNK_SIZE);
+        ASSERT_EQ(read(archive, entry, offset, size), slice(deflated, offset, size)) << offset << ", " << size;
+    }
+}
+
+TEST_F(ArchiveTest, lru_eviction) {
+    Archive archive(2 * CHUNK_SIZE);
+    ASSERT_TRUE(archive.open(path));
+    const auto &entry = *archive.find("PCSA00000/Data/Level.dat");
+
+    // The chunks decompressed on the way to the one read are cached too
+    EXPECT_EQ(read(archive, entry, 2 * CHUNK_SIZE, 10), slice(deflated, 2 * CHUNK_SIZE, 10));
+    EXPECT_FALSE(archive.is_chunk_cached(entry, 0));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 1));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 2));
+
+    // Using chunk 1 makes chunk 2 the least recently used one
+    EXPECT_EQ(read(archive, entry, CHUNK_SIZE, 10), slice(deflated, CHUNK_SIZE, 10));
+    EXPECT_EQ(read(archive, entry, 3 * CHUNK_SIZE, 10), slice(deflated, 3 * CHUNK_SIZE, 10));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 1));
+    EXPECT_FALSE(archive.is_chunk_cached(entry, 2));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 3));
+
+    // Evicted chunks are decompressed again
+    EXPECT_EQ(read(archive, entry, 0, CHUNK_SIZE + 10), slice(deflated, 0, CHUNK_SIZE + 10));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 0));
+    EXPECT_TRUE(archive.is_chunk_cached(entry, 1));
+    EXPECT_FALSE(archive.is_chunk_cached(entry, 3));
+}
@@ -22,16 +22,19 @@
 struct KernelState;
 
 typedef std::function<void(CPUState &cpu, uint32_t nid, SceUID thread_id)> CallImportFunc;
+typedef std::function<void(CPUState &cpu, uint32_t slot, SceUID thread_id)> CallImportSlotFunc;
 
 struct CPUProtocol : public CPUProtocolBase {
-    CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func);
+    CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func, const CallImportSlotFunc &slot_func);
     ~CPUProtocol() override = default;
     void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override;
     Address get_watch_memory_addr(Address addr) override;
     ExclusiveMonitorPtr get_exlusive_monitor() override;
+    JitCachePtr get_jit_cache() override;
 
 private:
     CallImportFunc call_import;
+    CallImportSlotFunc call_import_slot;
     KernelState *kernel;
     MemState *mem;
 };
@@ -71,6 +71,8 @@ struct Debugger {
     void remove_breakpoint(MemState &mem, uint32_t addr);
     void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback);
     Trampoline *get_trampoline(Address addr);
+    // Trampoline whose body raised the handler SVC right before pc
+    Trampoline *get_trampoline_from_body(Address pc);
     void remove_trampoline(MemState &mem, uint32_t addr);
     Address get_watch_memory_addr(Address addr);
     void update_watches();
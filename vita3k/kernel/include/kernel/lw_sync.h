@@ -0,0 +1,97 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <kernel/types.h>
+#include <mem/atomic.h>
+
+// Uncontended lightweight mutex operations, done directly on the guest workarea.
+// The owner word is the lock word: 0 when free, the owner thread id otherwise.
+// LW_MUTEX_CONTENDED is set on it by threads that went to sleep on the mutex,
+// so that the owner release goes through the kernel and hands the mutex over.
+// Thread ids never have this bit set.
+constexpr uint32_t LW_MUTEX_CONTENDED = 0x80000000;
+
+enum class LwFastPath {
+    Done, // Handled on the workarea, no kernel object involved
+    Recursive, // Non recursive mutex locked again by its owner
+    Slow, // Needs the kernel wait queue
+};
+
+inline LwFastPath lwmutex_try_lock_fast(SceKernelLwMutexWork &work, SceUID thread_id, int lock_count) {
+    if (lock_count <= 0)
+        return LwFastPath::Slow;
+
+    volatile uint32_t *owner = &work.owner;
+    if (atomic_compare_and_swap(owner, static_cast<uint32_t>(thread_id), 0)) {
+        work.lockCount = lock_count;
+        return LwFastPath::Done;
+    }
+
+    if ((*owner & ~LW_MUTEX_CONTENDED) != static_cast<uint32_t>(thread_id))
+        return LwFastPath::Slow;
+
+    // Owned by ourselves, nobody else writes lockCount while we hold it
+    if (!(work.attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE))
+        return LwFastPath::Recursive;
+
+    work.lockCount += lock_count;
+    return LwFastPath::Done;
+}
+
+inline LwFastPath lwmutex_unlock_fast(SceKernelLwMutexWork &work, SceUID thread_id, int unlock_count) {
+    volatile uint32_t *owner = &work.owner;
+    // Errors and hand-overs to waiting threads are left to the kernel
+    if ((*owner != static_cast<uint32_t>(thread_id)) || (unlock_count <= 0) || (static_cast<uint32_t>(unlock_count) > work.lockCount))
+        return LwFastPath::Slow;
+
+    if (work.lockCount > static_cast<uint32_t>(unlock_count)) {
+        work.lockCount -= unlock_count;
+        return LwFastPath::Done;
+    }
+
+    work.lockCount = 0;
+    if (atomic_compare_and_swap(owner, 0, static_cast<uint32_t>(thread_id)))
+        return LwFastPath::Done;
+
+    // A thread started waiting meanwhile
+    work.lockCount = unlock_count;
+    return LwFastPath::Slow;
+}
+
+// Waiters are counted on the workarea so that signaling a lightweight condition
+// variable nobody waits on doesn't need to look up the kernel object.
+inline void lwcond_add_waiters(SceKernelLwCondWork &work, int32_t count) {
+    volatile uint32_t *waiters = &work.waiters;
+    uint32_t current;
+    do {
+        current = *waiters;
+    } while (!atomic_compare_and_swap(waiters, current + count, current));
+}
+
+inline bool lwcond_has_waiters(const SceKernelLwCondWork &work) {
+    return *static_cast<const volatile uint32_t *>(&work.waiters) != 0;
+}
+
+// Waiters register while holding the associated mutex and only release it once queued
+// in the kernel, so the count is only up to date for the thread holding that mutex.
+// Anyone else has to check the kernel wait queue under its lock.
+inline bool lwcond_can_skip_signal(const SceKernelLwCondWork &work, const SceKernelLwMutexWork &mutex_work, SceUID thread_id) {
+    const uint32_t mutex_owner = *static_cast<const volatile uint32_t *>(&mutex_work.owner);
+    return ((mutex_owner & ~LW_MUTEX_CONTENDED) == static_cast<uint32_t>(thread_id)) && !lwcond_has_waiters(work);
+}
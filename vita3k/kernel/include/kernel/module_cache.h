@@ -0,0 +1,53 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/ptr.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MemState;
+
+struct ModuleCacheSegment {
+    uint16_t index; // segment index in the ELF program headers
+    Address addr; // segment address in guest memory
+    uint32_t size; // segment file size, the part which is inflated and relocated
+};
+using ModuleCacheSegments = std::vector<ModuleCacheSegment>;
+
+/**
+ * \brief Computes the key of a module in the module cache.
+ * \param self SELF file loaded in memory
+ * \param size Size of the SELF file
+ */
+uint64_t get_module_cache_hash(const void *self, uint64_t size);
+
+/**
+ * \brief Fills the loaded segments of a module with their cached post-relocation content.
+ * \param cache_path Module cache directory of the current title
+ * \param hash Module key returned by get_module_cache_hash
+ * \return True if the cache entry matches the segments and has been loaded, false otherwise
+ */
+bool load_module_cache(const std::string &cache_path, const std::string &module_name, uint64_t hash, const ModuleCacheSegments &segments, MemState &mem);
+
+/**
+ * \brief Saves the post-relocation content of the loaded segments of a module.
+ */
+void save_module_cache(const std::string &cache_path, const std::string &module_name, uint64_t hash, const ModuleCacheSegments &segments, const MemState &mem);
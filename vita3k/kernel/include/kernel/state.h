@@ -24,6 +24,7 @@
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
 #include <mem/allocator.h>
+#include <mem/heap.h>
 #include <mem/ptr.h>
 #include <mem/util.h>
 #include <rtc/rtc.h>
@@ -41,6 +42,8 @@
 
 struct ThreadState;
 
+struct EmuEnvState;
+
 struct Breakpoint;
 
 struct SDL_Thread;
@@ -65,6 +68,19 @@ typedef std::map<Address, uint32_t> NidFromExport;
 typedef std::map<Address, uint32_t> NotFoundVars;
 typedef std::unique_ptr<CPUProtocol> CPUProtocolPtr;
 
+typedef std::function<void(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id)> ImportFn;
+typedef std::function<const ImportFn *(uint32_t nid)> ResolveImportFunc;
+
+// SVC immediates with this bit set carry the import slot of the stub instead of 0
+constexpr uint32_t IMPORT_SLOT_SVC = 0x800000;
+constexpr uint32_t MAX_IMPORT_SLOTS = 0x10000;
+
+struct ImportSlot {
+    uint32_t nid = 0;
+    // HLE implementation of the NID, nullptr when it is unimplemented or exported by a loaded module
+    std::atomic<const ImportFn *> fn = nullptr;
+};
+
 struct CodecEngineBlock {
     uint32_t size;
     int32_t vaddr;
@@ -115,9 +131,12 @@ struct CorenumAllocator {
 
 struct KernelState {
     KernelState();
+    ~KernelState();
 
     std::mutex mutex;
     CodecEngineBlocks codec_blocks;
+    // Backs malloc and friends of SceLibc
+    std::unique_ptr<GuestHeap> libc_heap;
 
     Ptr<const void> tls_address = Ptr<const void>(0);
     unsigned int tls_psize = 0;
@@ -142,11 +161,22 @@ struct KernelState {
     std::shared_mutex export_nids_mutex;
     NidFromExport nid_from_export;
 
+    // Dense table of imported NIDs, indexed by the slot encoded in the import stubs
+    std::unique_ptr<ImportSlot[]> import_slots;
+    std::unordered_map<uint32_t, uint32_t> import_slot_from_nid;
+    uint32_t import_slot_count = 0;
+    std::mutex import_slots_mutex;
+    ResolveImportFunc resolve_import;
+
     bool cpu_opt;
     CPUBackend cpu_backend;
     CorenumAllocator corenum_allocator;
     CPUProtocolPtr cpu_protocol;
     ExclusiveMonitorPtr exclusive_monitor;
+    JitCachePtr jit_cache = nullptr;
+
+    // Lightweight mutex/condvar calls completed on the guest workarea without entering the kernel objects
+    std::atomic<uint64_t> lw_sync_fast_path_count{ 0 };
 
     ObjectStore obj_store;
 
@@ -157,13 +187,16 @@ struct KernelState {
 
     NotFoundVars not_found_vars;
 
+    // Directory where post-relocation module images of the current title are cached, empty to disable it
+    std::string module_cache_path;
+
     Debugger debugger;
 
     SceUID get_next_uid() {
         return next_uid++;
     }
 
-    bool init(MemState &mem, CallImportFunc call_import, CPUBackend cpu_backend, bool cpu_opt);
+    bool init(MemState &mem, CallImportFunc call_import, CallImportSlotFunc call_import_slot, ResolveImportFunc resolve_import, CPUBackend cpu_backend, bool cpu_opt);
     void load_process_param(MemState &mem, Ptr<uint32_t> ptr);
     ThreadStatePtr create_thread(MemState &mem, const char *name, Ptr<const void> entry_point = Ptr<const void>(0));
     ThreadStatePtr create_thread(MemState &mem, const char *name, Ptr<const void> entry_point, int init_priority, SceInt32 affinity_mask, int stack_size, const SceKernelThreadOptParam *option);
@@ -174,6 +207,8 @@ struct KernelState {
 
     void set_memory_watch(bool enabled);
     void invalidate_jit_cache(Address start, size_t length);
+    std::optional<uint32_t> get_import_slot(uint32_t nid);
+    void unbind_import_slot(uint32_t nid);
     std::shared_ptr<SceKernelModuleInfo> find_module_by_addr(Address address);
 
 private:
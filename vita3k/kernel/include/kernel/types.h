@@ -588,7 +588,7 @@ struct SceKernelLMOption {
     SceSize size;
 };
 
-// We only use workarea for uid
+// We only use workarea for uid, and owner/lockCount for the uncontended fast path
 struct SceKernelLwMutexWork {
     std::uint32_t owner;
     std::uint32_t unknown0;
@@ -612,13 +612,17 @@ struct SceKernelLwMutexInfo {
     SceUInt32 numWaitThreads; /**< Number of threads waiting for the lightweight mutex */
 };
 
-// We only use workarea for uid
+// We only use workarea for uid, the number of waiting threads and the associated mutex
 struct SceKernelLwCondWork {
     SceUID uid;
+    std::uint32_t waiters;
+    Ptr<SceKernelLwMutexWork> mutex_workarea;
 
-    std::uint8_t padding[28];
+    std::uint8_t padding[20];
 };
 
+static_assert(sizeof(SceKernelLwCondWork) == 32, "Incorrect size");
+
 struct SceKernelCreateLwMutex_opt {
     int init_count;
     Ptr<SceKernelLwMutexOptParam> opt_param;
@@ -19,14 +19,16 @@
 #include <kernel/state.h>
 #include <util/lock_and_find.h>
 
-CPUProtocol::CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func)
+CPUProtocol::CPUProtocol(KernelState &kernel, MemState &mem, const CallImportFunc &func, const CallImportSlotFunc &slot_func)
     : call_import(func)
+    , call_import_slot(slot_func)
     , kernel(&kernel)
     , mem(&mem) {
 }
 
 void CPUProtocol::call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) {
     // Handle trampoline
+    // SVCs with these numbers which do not come from a trampoline are usual service calls
     // 1. Handle trampoline jumper
     // to save the space we use interrupt to implement jumper
     // as thumb instructions require total three instructions to jump to any pc without limitations
@@ -36,15 +38,25 @@ void CPUProtocol::call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState
         // find thumb32 or arm trampoline
         if (!tr)
             tr = kernel->debugger.get_trampoline(pc - 4);
-        write_pc(cpu, tr->trampoline_addr);
-        return;
+        if (tr) {
+            write_pc(cpu, tr->trampoline_addr);
+            return;
+        }
     }
 
     // 2. Call trampoline callback
     // this interrupt is made inside trampoline body
     if (svc == TRAMPOLINE_HANDLER_SVC) {
-        Trampoline *tr = *Ptr<Trampoline *>(pc).get(*mem);
-        tr->callback(cpu, *mem, tr->lr);
+        if (Trampoline *tr = kernel->debugger.get_trampoline_from_body(pc)) {
+            tr->callback(cpu, *mem, tr->lr);
+            return;
+        }
+    }
+
+    // 3. Import stub resolved at load time, the SVC immediate holds its slot
+    if (svc & IMPORT_SLOT_SVC) {
+        call_import_slot(cpu, svc & ~IMPORT_SLOT_SVC, thread.id);
+        clear_exclusive(kernel->exclusive_monitor, get_processor_id(cpu));
         return;
     }
 
@@ -65,3 +77,7 @@ Address CPUProtocol::get_watch_memory_addr(Address addr) {
 ExclusiveMonitorPtr CPUProtocol::get_exlusive_monitor() {
     return kernel->exclusive_monitor;
 }
+
+JitCachePtr CPUProtocol::get_jit_cache() {
+    return kernel->jit_cache;
+}
@@ -93,8 +93,6 @@ void Debugger::add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, Tram
     uint32_t *trampoline_insts = reinterpret_cast<uint32_t *>(&mem.memory[trampoline_addr]);
     trampoline_insts[0] = back_inst; // original instruction; if thumb16 it's nop + original thumb16 instruction
     trampoline_insts[1] = thumb_mode ? 0xDF53BF00 : 0xEF000053; // SVC 0x53
-    Trampoline **trampoline_host_ptr = Ptr<Trampoline *>(trampoline_addr + 8).get(mem); // interrupt handler will read this
-    *trampoline_host_ptr = tr.get();
 
     std::lock_guard<std::mutex> lock(mutex);
     trampolines.emplace(addr, std::move(tr));
@@ -109,6 +107,16 @@ Trampoline *Debugger::get_trampoline(Address addr) {
     return it->second.get();
 }
 
+Trampoline *Debugger::get_trampoline_from_body(Address pc) {
+    const auto lock = std::lock_guard(mutex);
+    for (const auto &[_, tr] : trampolines) {
+        // The handler SVC is the second instruction of the body
+        if ((tr->trampoline_addr & ~1) + 8 == pc)
+            return tr.get();
+    }
+    return nullptr;
+}
+
 void Debugger::remove_trampoline(MemState &mem, uint32_t addr) {
     std::lock_guard<std::mutex> lock(mutex);
     const auto it = trampolines.find(addr);
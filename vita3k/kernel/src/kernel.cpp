@@ -75,6 +75,9 @@ static int SDLCALL thread_function(void *data) {
     thread->run_loop();
     const uint32_t r0 = read_reg(*thread->cpu, 0);
 
+    if (params.kernel->libc_heap)
+        params.kernel->libc_heap->release_thread_cache(thread->id);
+
     std::lock_guard<std::mutex> lock(params.kernel->mutex);
     params.kernel->threads.erase(thread->id);
     params.kernel->corenum_allocator.free_corenum(get_processor_id(*thread->cpu));
@@ -86,14 +89,24 @@ KernelState::KernelState()
     : debugger(*this) {
 }
 
-bool KernelState::init(MemState &mem, CallImportFunc call_import, CPUBackend cpu_backend, bool cpu_opt) {
+KernelState::~KernelState() {
+    if (jit_cache)
+        free_jit_cache(jit_cache);
+}
+
+bool KernelState::init(MemState &mem, CallImportFunc call_import, CallImportSlotFunc call_import_slot, ResolveImportFunc resolve_import, CPUBackend cpu_backend, bool cpu_opt) {
     constexpr std::size_t MAX_CORE_COUNT = 150;
 
     corenum_allocator.set_max_core_count(MAX_CORE_COUNT);
     exclusive_monitor = new_exclusive_monitor(MAX_CORE_COUNT);
+    if (cpu_backend == CPUBackend::Dynarmic)
+        jit_cache = new_jit_cache();
     start_tick = rtc_get_ticks(rtc_base_ticks());
     base_tick = { rtc_base_ticks() };
-    cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import);
+    cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import, call_import_slot);
+    import_slots = std::make_unique<ImportSlot[]>(MAX_IMPORT_SLOTS);
+    libc_heap = std::make_unique<GuestHeap>(mem, "SceLibc heap");
+    this->resolve_import = resolve_import;
     this->cpu_backend = cpu_backend;
     this->cpu_opt = cpu_opt;
 
@@ -124,12 +137,43 @@ void KernelState::set_memory_watch(bool enabled) {
 }
 
 void KernelState::invalidate_jit_cache(Address start, size_t length) {
+    // The JIT cache covers the JITs of every thread as well as the idle ones kept for reuse
+    if (jit_cache) {
+        ::invalidate_jit_cache(jit_cache, start, length);
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(mutex);
     for (auto thread : threads) {
         ::invalidate_jit_cache(*thread.second->cpu, start, length);
     }
 }
 
+std::optional<uint32_t> KernelState::get_import_slot(uint32_t nid) {
+    const std::lock_guard<std::mutex> lock(import_slots_mutex);
+    const auto it = import_slot_from_nid.find(nid);
+    if (it != import_slot_from_nid.end())
+        return it->second;
+
+    if (import_slot_count == MAX_IMPORT_SLOTS)
+        return std::nullopt;
+
+    const uint32_t slot = import_slot_count++;
+    import_slots[slot].nid = nid;
+    import_slots[slot].fn = resolve_import(nid);
+    import_slot_from_nid.emplace(nid, slot);
+
+    return slot;
+}
+
+void KernelState::unbind_import_slot(uint32_t nid) {
+    const std::lock_guard<std::mutex> lock(import_slots_mutex);
+    const auto it = import_slot_from_nid.find(nid);
+    if (it != import_slot_from_nid.end())
+        // Dispatch falls back to call_import, which patches the stub to the LLE export
+        import_slots[it->second].fn = nullptr;
+}
+
 ThreadStatePtr KernelState::get_thread(SceUID thread_id) {
     return lock_and_find(thread_id, threads, mutex);
 }
@@ -168,6 +212,12 @@ Ptr<Ptr<void>> KernelState::get_thread_tls_addr(MemState &mem, SceUID thread_id,
 }
 
 void KernelState::exit_delete_all_threads() {
+    LOG_INFO("Lightweight sync fast path: {} kernel object accesses avoided", lw_sync_fast_path_count.load());
+    if (jit_cache) {
+        const JitCacheStats stats = get_jit_cache_stats(jit_cache);
+        LOG_INFO("JIT cache: {} JITs created, {} reused from exited threads with {} translated instructions", stats.created, stats.reused, stats.reused_instructions);
+    }
+
     const std::lock_guard<std::mutex> lock(mutex);
     for (auto [_, thread] : threads) {
         thread->exit_delete();
@@ -17,6 +17,7 @@
 
 #include <cpu/functions.h>
 #include <kernel/load_self.h>
+#include <kernel/module_cache.h>
 #include <kernel/relocation.h>
 #include <kernel/state.h>
 #include <kernel/types.h>
@@ -25,6 +26,7 @@
 #include <util/arm.h>
 #include <util/fs.h>
 #include <util/log.h>
+#include <util/thread_pool.h>
 
 #include <spdlog/fmt/fmt.h>
 #include <util/elf.h>
@@ -37,6 +39,7 @@
 #include <self.h>
 
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
@@ -133,7 +136,8 @@ static bool load_func_imports(const uint32_t *nids, const Ptr<uint32_t> *entries
         */
 
         if (export_address == kernel.export_nids.end()) {
-            stub[0] = 0xef000000; // svc #0 - Call our interrupt hook.
+            const auto slot = kernel.get_import_slot(nid);
+            stub[0] = 0xef000000 | (slot ? (IMPORT_SLOT_SVC | *slot) : 0); // svc #slot - Call our interrupt hook.
             stub[1] = 0xe1a0f00e; // mov pc, lr - Return to the caller.
             stub[2] = nid; // Our interrupt hook will read this.
         } else {
@@ -225,6 +229,7 @@ static bool load_func_exports(Ptr<const void> &entry_point, const uint32_t *nids
             kernel.export_nids.emplace(nid, entry.address());
         }
         kernel.nid_from_export.emplace(entry.address(), nid);
+        kernel.unbind_import_slot(nid);
 
         if (kernel.debugger.log_exports) {
             const char *const name = import_name(nid);
@@ -309,6 +314,8 @@ static bool load_exports(Ptr<const void> &entry_point, const sce_module_info_raw
  * \return Negative on failure
  */
 SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &mem, const void *self, const std::string &self_path) {
+    const auto load_start = std::chrono::steady_clock::now();
+
     // TODO: use raw I/O from path when io becomes less bad
     const uint8_t *const self_bytes = static_cast<const uint8_t *>(self);
     const SCE_header &self_header = *static_cast<const SCE_header *>(self);
@@ -412,9 +419,10 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
         }
     };
 
+    // Allocate all loadable segments first, the module cache can only be used if they land at the same addresses
+    ModuleCacheSegments cache_segments;
     for (Elf_Half seg_index = 0; seg_index < elf.e_phnum; ++seg_index) {
         const Elf32_Phdr &seg_header = segments[seg_index];
-        const uint8_t *const seg_bytes = self_bytes + self_header.header_len + seg_header.p_offset;
 
         LOG_DEBUG_IF(LOG_MODULE_LOADING, "    [{}] (p_type: {}): p_offset: {}, p_vaddr: {}, p_paddr: {}, p_filesz: {}, p_memsz: {}, p_flags: {}, p_align: {}", get_seg_header_string(seg_header.p_type), log_hex(seg_header.p_type), log_hex(seg_header.p_offset), log_hex(seg_header.p_vaddr), log_hex(seg_header.p_paddr), log_hex(seg_header.p_filesz), log_hex(seg_header.p_memsz), log_hex(seg_header.p_flags), log_hex(seg_header.p_align));
 
@@ -424,68 +432,112 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
             return -1;
         }
 
-        if (seg_header.p_type == PT_NULL) {
-            // Nothing to do.
-        } else if (seg_header.p_type == PT_LOAD) {
-            if (seg_header.p_memsz != 0) {
-                Address segment_address = 0;
-                auto alloc_name = fmt::format("{}:seg%d", self_path, seg_index);
-
-                // TODO: when the virtual process bringup is fixed, uncomment this
-                // Try allocating at image base for RELEXEC to avoid having to relocate the main module
-                /*
-                segment_address = try_alloc_at(mem, seg_header.p_vaddr, seg_header.p_memsz, alloc_name.c_str());
-
-                if (!segment_address) {
-                    if (isRelocatable) { //Try allocating somewhere else
-                        segment_address = alloc(mem, seg_header.p_memsz, alloc_name.c_str());
-                    }
-
-                    if (!isRelocatable || !segment_address) {
-                        LOG_CRITICAL("Loading {} ELF {} failed: Could not allocate {} bytes @ {} for segment {}.", (isRelocatable) ? "relocatable" : "fixed", self_path, log_hex(seg_header.p_memsz), log_hex(seg_header.p_vaddr), seg_index);
-                        free_all_segments(mem, segment_reloc_info);
-                        return SCE_KERNEL_ERROR_NO_MEMORY; //TODO is this correct?
-                    }
-                }
-                */
+        if ((seg_header.p_type == PT_LOAD) && (seg_header.p_memsz != 0)) {
+            Address segment_address = 0;
+            auto alloc_name = fmt::format("{}:seg%d", self_path, seg_index);
+
+            // TODO: when the virtual process bringup is fixed, uncomment this
+            // Try allocating at image base for RELEXEC to avoid having to relocate the main module
+            /*
+            segment_address = try_alloc_at(mem, seg_header.p_vaddr, seg_header.p_memsz, alloc_name.c_str());
 
-                if (isRelocatable) {
+            if (!segment_address) {
+                if (isRelocatable) { //Try allocating somewhere else
                     segment_address = alloc(mem, seg_header.p_memsz, alloc_name.c_str());
-                } else {
-                    segment_address = alloc_at(mem, seg_header.p_vaddr, seg_header.p_memsz, alloc_name.c_str());
                 }
 
-                if (!segment_address) {
+                if (!isRelocatable || !segment_address) {
                     LOG_CRITICAL("Loading {} ELF {} failed: Could not allocate {} bytes @ {} for segment {}.", (isRelocatable) ? "relocatable" : "fixed", self_path, log_hex(seg_header.p_memsz), log_hex(seg_header.p_vaddr), seg_index);
                     free_all_segments(mem, segment_reloc_info);
-                    return SCE_KERNEL_ERROR_NO_MEMORY; // TODO is this correct?
+                    return SCE_KERNEL_ERROR_NO_MEMORY; //TODO is this correct?
                 }
+            }
+            */
+
+            if (isRelocatable) {
+                segment_address = alloc(mem, seg_header.p_memsz, alloc_name.c_str());
+            } else {
+                segment_address = alloc_at(mem, seg_header.p_vaddr, seg_header.p_memsz, alloc_name.c_str());
+            }
 
-                const Ptr<uint8_t> seg_ptr(segment_address);
-                if (seg_infos[seg_index].compression == 2) {
-                    unsigned long dest_bytes = seg_header.p_filesz;
-                    const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
+            if (!segment_address) {
+                LOG_CRITICAL("Loading {} ELF {} failed: Could not allocate {} bytes @ {} for segment {}.", (isRelocatable) ? "relocatable" : "fixed", self_path, log_hex(seg_header.p_memsz), log_hex(seg_header.p_vaddr), seg_index);
+                free_all_segments(mem, segment_reloc_info);
+                return SCE_KERNEL_ERROR_NO_MEMORY; // TODO is this correct?
+            }
 
-                    int res = mz_uncompress(reinterpret_cast<uint8_t *>(seg_ptr.get(mem)), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                    assert(res == MZ_OK);
-                } else {
-                    memcpy(seg_ptr.get(mem), seg_bytes, seg_header.p_filesz);
-                }
+            segment_reloc_info[seg_index] = { segment_address, seg_header.p_vaddr, seg_header.p_memsz };
+            cache_segments.push_back({ seg_index, segment_address, seg_header.p_filesz });
+        }
+    }
+
+    const uint64_t module_hash = get_module_cache_hash(self_bytes, self_header.self_filesize);
+    const bool loaded_from_cache = load_module_cache(kernel.module_cache_path, self_path, module_hash, cache_segments, mem);
+    LOG_DEBUG_IF(loaded_from_cache, "Module {} loaded from module cache", self_path);
+
+    // Inflate all the compressed segments at once, loadable ones straight into guest memory
+    struct InflateJob {
+        Elf_Half seg_index;
+        uint8_t *dest;
+        unsigned long dest_size;
+        int result;
+    };
+    std::vector<InflateJob> inflate_jobs;
+    std::map<Elf_Half, std::unique_ptr<uint8_t[]>> inflated_relocations;
+    const auto inflate_start = std::chrono::steady_clock::now();
+    if (!loaded_from_cache) {
+        for (Elf_Half seg_index = 0; seg_index < elf.e_phnum; ++seg_index) {
+            const Elf32_Phdr &seg_header = segments[seg_index];
+            if (seg_infos[seg_index].compression != 2)
+                continue;
+
+            if ((seg_header.p_type == PT_LOAD) && (seg_header.p_memsz != 0)) {
+                inflate_jobs.push_back({ seg_index, Ptr<uint8_t>(segment_reloc_info[seg_index].addr).get(mem), seg_header.p_filesz, MZ_OK });
+            } else if (seg_header.p_type == PT_SCE_RELA) {
+                auto &uncompressed = inflated_relocations[seg_index];
+                uncompressed.reset(new uint8_t[seg_header.p_filesz]);
+                inflate_jobs.push_back({ seg_index, uncompressed.get(), seg_header.p_filesz, MZ_OK });
+            }
+        }
+    }
+
+    const auto inflate_segment = [&](size_t job_index) {
+        InflateJob &job = inflate_jobs[job_index];
+        const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[job.seg_index].offset;
+        job.result = mz_uncompress(job.dest, &job.dest_size, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[job.seg_index].length));
+    };
+    if (inflate_jobs.size() > 1)
+        ThreadPool::shared().parallel_for(inflate_jobs.size(), inflate_segment);
+    else if (!inflate_jobs.empty())
+        inflate_segment(0);
+
+    for (const auto &job : inflate_jobs) {
+        if (job.result != MZ_OK) {
+            LOG_ERROR("Cannot load ELF {}: failed to inflate segment {} ({}).", self_path, job.seg_index, mz_error(job.result));
+            free_all_segments(mem, segment_reloc_info);
+            return -1;
+        }
+    }
+    const auto inflate_end = std::chrono::steady_clock::now();
+
+    for (Elf_Half seg_index = 0; seg_index < elf.e_phnum; ++seg_index) {
+        const Elf32_Phdr &seg_header = segments[seg_index];
+        const uint8_t *const seg_bytes = self_bytes + self_header.header_len + seg_header.p_offset;
 
-                segment_reloc_info[seg_index] = { segment_address, seg_header.p_vaddr, seg_header.p_memsz };
+        if (seg_header.p_type == PT_NULL) {
+            // Nothing to do.
+        } else if (seg_header.p_type == PT_LOAD) {
+            if ((seg_header.p_memsz != 0) && !loaded_from_cache && (seg_infos[seg_index].compression != 2)) {
+                const Ptr<uint8_t> seg_ptr(segment_reloc_info[seg_index].addr);
+                memcpy(seg_ptr.get(mem), seg_bytes, seg_header.p_filesz);
             }
         } else if (seg_header.p_type == PT_SCE_RELA) {
-            if (seg_infos[seg_index].compression == 2) {
-                unsigned long dest_bytes = seg_header.p_filesz;
-                const uint8_t *const compressed_segment_bytes = self_bytes + seg_infos[seg_index].offset;
-                std::unique_ptr<uint8_t[]> uncompressed(new uint8_t[dest_bytes]);
-
-                int res = mz_uncompress(uncompressed.get(), &dest_bytes, compressed_segment_bytes, static_cast<mz_ulong>(seg_infos[seg_index].length));
-                assert(res == MZ_OK);
-                if (!relocate(uncompressed.get(), seg_header.p_filesz, segment_reloc_info, mem)) {
+            if (loaded_from_cache) {
+                // Already applied to the cached content
+            } else if (seg_infos[seg_index].compression == 2) {
+                if (!relocate(inflated_relocations[seg_index].get(), seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
                 }
-
             } else {
                 if (!relocate(seg_bytes, seg_header.p_filesz, segment_reloc_info, mem)) {
                     return -1;
@@ -498,6 +550,11 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
             LOG_CRITICAL("{}: Skipping segment with unknown p_type {}!", self_path, log_hex(seg_header.p_type));
         }
     }
+    inflated_relocations.clear();
+    const auto relocation_end = std::chrono::steady_clock::now();
+
+    if (!loaded_from_cache)
+        save_module_cache(kernel.module_cache_path, self_path, module_hash, cache_segments, mem);
 
     if (kernel.debugger.dump_elfs) {
         // Dump elf
@@ -596,6 +653,16 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
     sceKernelModuleInfo->start_entry = entry_point;
     // TODO: module_stop
 
+    const auto load_end = std::chrono::steady_clock::now();
+    const auto elapsed_ms = [](auto start, auto end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+    if (loaded_from_cache)
+        LOG_INFO("Module {} loaded in {:.2f} ms from the module cache (linking: {:.2f} ms)", self_path, elapsed_ms(load_start, load_end), elapsed_ms(relocation_end, load_end));
+    else
+        LOG_INFO("Module {} loaded in {:.2f} ms (inflating {} segments: {:.2f} ms, relocation: {:.2f} ms, linking: {:.2f} ms)", self_path, elapsed_ms(load_start, load_end),
+            inflate_jobs.size(), elapsed_ms(inflate_start, inflate_end), elapsed_ms(inflate_end, relocation_end), elapsed_ms(relocation_end, load_end));
+
     const std::lock_guard<std::mutex> lock(kernel.mutex);
     const SceUID uid = kernel.get_next_uid();
     sceKernelModuleInfo->modid = uid;
@@ -0,0 +1,140 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/module_cache.h>
+
+#include <util/fs.h>
+#include <util/log.h>
+
+#include <xxh3.h>
+
+// Bump this when the layout of the cache or the way modules are relocated changes
+static constexpr uint32_t MODULE_CACHE_VERSION = 1;
+static constexpr uint32_t MODULE_CACHE_MAGIC = 0x4D43334B; // "K3CM"
+
+struct ModuleCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash; // hash of the SELF file
+    uint64_t content_hash; // hash of the cached segments content, used to validate the entry
+    uint32_t segment_count;
+};
+
+struct ModuleCacheSegmentHeader {
+    uint16_t index;
+    uint32_t addr;
+    uint32_t size;
+};
+
+static fs::path get_module_cache_file(const std::string &cache_path, const std::string &module_name, uint64_t hash) {
+    // Module names are Vita paths (e.g. app0:sce_module/libc.suprx), keep only the file name
+    const auto base_name = module_name.substr(module_name.find_last_of(":/") + 1);
+    const auto file_name = fmt::format("{}-{:016X}.bin", fs::path(base_name).stem().string(), hash);
+    return fs_utils::construct_file_name(cache_path, "", file_name);
+}
+
+uint64_t get_module_cache_hash(const void *self, uint64_t size) {
+    return XXH3_64bits(self, size);
+}
+
+bool load_module_cache(const std::string &cache_path, const std::string &module_name, uint64_t hash, const ModuleCacheSegments &segments, MemState &mem) {
+    if (cache_path.empty())
+        return false;
+
+    const auto cache_file = get_module_cache_file(cache_path, module_name, hash);
+    fs::ifstream is(cache_file, std::ios::in | std::ios::binary);
+    if (!is.is_open())
+        return false;
+
+    ModuleCacheHeader header{};
+    is.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!is || header.magic != MODULE_CACHE_MAGIC || header.version != MODULE_CACHE_VERSION || header.hash != hash) {
+        LOG_WARN("Module cache of {} is outdated, recreate it.", module_name);
+        is.close();
+        fs::remove(cache_file);
+        return false;
+    }
+
+    // The relocated content is only valid if the module is loaded at the same addresses
+    if (header.segment_count != segments.size())
+        return false;
+
+    for (const auto &segment : segments) {
+        ModuleCacheSegmentHeader segment_header{};
+        is.read(reinterpret_cast<char *>(&segment_header), sizeof(segment_header));
+        if (!is || segment_header.index != segment.index || segment_header.addr != segment.addr || segment_header.size != segment.size) {
+            LOG_DEBUG("Module cache of {} does not match the current segment layout", module_name);
+            return false;
+        }
+    }
+
+    // Read straight into guest memory, nothing is left to inflate or relocate
+    XXH3_state_t *const state = XXH3_createState();
+    XXH3_64bits_reset(state);
+    for (const auto &segment : segments) {
+        char *const dest = Ptr<char>(segment.addr).get(mem);
+        is.read(dest, segment.size);
+        XXH3_64bits_update(state, dest, segment.size);
+    }
+    const auto content_hash = XXH3_64bits_digest(state);
+    XXH3_freeState(state);
+
+    if (!is || content_hash != header.content_hash) {
+        LOG_WARN("Module cache of {} is corrupted, recreate it.", module_name);
+        is.close();
+        fs::remove(cache_file);
+        return false;
+    }
+
+    return true;
+}
+
+void save_module_cache(const std::string &cache_path, const std::string &module_name, uint64_t hash, const ModuleCacheSegments &segments, const MemState &mem) {
+    if (cache_path.empty())
+        return;
+
+    if (!fs::exists(cache_path))
+        fs::create_directories(cache_path);
+
+    XXH3_state_t *const state = XXH3_createState();
+    XXH3_64bits_reset(state);
+    for (const auto &segment : segments)
+        XXH3_64bits_update(state, Ptr<const char>(segment.addr).get(mem), segment.size);
+
+    ModuleCacheHeader header{};
+    header.magic = MODULE_CACHE_MAGIC;
+    header.version = MODULE_CACHE_VERSION;
+    header.hash = hash;
+    header.content_hash = XXH3_64bits_digest(state);
+    header.segment_count = static_cast<uint32_t>(segments.size());
+    XXH3_freeState(state);
+
+    const auto cache_file = get_module_cache_file(cache_path, module_name, hash);
+    fs::ofstream os(cache_file, std::ios::out | std::ios::binary);
+    if (!os.is_open()) {
+        LOG_WARN("Failed to write module cache of {} to {}", module_name, cache_file.string());
+        return;
+    }
+
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &segment : segments) {
+        const ModuleCacheSegmentHeader segment_header{ segment.index, segment.addr, segment.size };
+        os.write(reinterpret_cast<const char *>(&segment_header), sizeof(segment_header));
+    }
+    for (const auto &segment : segments)
+        os.write(Ptr<const char>(segment.addr).get(mem), segment.size);
+}
@@ -20,6 +20,7 @@
 
 #include <self.h>
 
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <string>
@@ -299,6 +300,43 @@ static bool relocate_entry(void *data, uint32_t code, uint32_t symval, uint32_t
     return true; // ignore unhandled relocations
 }
 
+// Segment start addresses indexed by the 4 bits segment fields of the entries, looked up for every entry
+struct SegmentTable {
+    std::array<Address, 16> starts{};
+    std::array<bool, 16> present{};
+    // In index order, to find which segment a rebased value points to
+    std::array<SegmentInfoForReloc, 16> loaded{};
+    size_t loaded_count = 0;
+
+    explicit SegmentTable(const SegmentInfosForReloc &segments) {
+        for (const auto &[index, segment] : segments) {
+            if (index >= starts.size())
+                continue;
+            starts[index] = segment.addr;
+            present[index] = true;
+            loaded[loaded_count++] = segment;
+        }
+    }
+
+    Address start(uint32_t index) const {
+        return starts[index];
+    }
+
+    // Segment a rebased value points to, the last one in index order if several contain it
+    Address rebase(uint32_t value, Address &saddr) const {
+        Address segbase = 0;
+        for (size_t i = 0; i < loaded_count; i++) {
+            const SegmentInfoForReloc &seg = loaded[i];
+            if (value >= seg.p_vaddr && value < seg.p_vaddr + seg.size) {
+                segbase = seg.p_vaddr;
+                saddr = seg.addr;
+            }
+        }
+
+        return segbase;
+    }
+};
+
 bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &segments, const MemState &mem, bool is_var_import, uint32_t explicit_symval) {
     const void *const end = static_cast<const uint8_t *>(entries) + size;
     const Entry *entry = static_cast<const Entry *>(entries);
@@ -311,6 +349,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             LOG_DEBUG("    Segment: {} -> {} (size: {})", seg.first, log_hex(seg.second.addr), seg.second.size);
     }
 
+    const SegmentTable segment_table(segments);
+
     // initialized in format 1 and 2
     Address g_addr = 0,
             g_offset = 0,
@@ -334,9 +374,9 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             const EntryFormat0 *const format0_entry = static_cast<const EntryFormat0 *>(entry);
 
             const auto symbol_seg = format0_entry->symbol_segment;
-            const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
+            const auto symbol_seg_start = segment_table.start(symbol_seg);
             const auto patch_seg = format0_entry->patch_segment;
-            const auto patch_seg_start = segments.find(patch_seg)->second.addr;
+            const auto patch_seg_start = segment_table.start(patch_seg);
 
             const Address s = (format0_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
             const Address p = patch_seg_start + format0_entry->offset;
@@ -375,9 +415,9 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 const EntryFormat1 *const format1_entry = static_cast<const EntryFormat1 *>(entry);
 
                 const auto symbol_seg = format1_entry->symbol_segment;
-                const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
+                const auto symbol_seg_start = segment_table.start(symbol_seg);
                 const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start = segments.find(patch_seg)->second.addr;
+                const auto patch_seg_start = segment_table.start(patch_seg);
                 const Address s = (format1_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
 
                 const Address offset = format1_entry->offset_lo | (format1_entry->offset_hi << 12);
@@ -403,16 +443,13 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 const EntryFormat1Alt *const format1_entry = static_cast<const EntryFormat1Alt *>(entry);
 
                 const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start_it = segments.find(patch_seg);
                 const Address s = explicit_symval;
 
-                Address patch_seg_start{};
-                if (patch_seg_start_it != segments.end())
-                    patch_seg_start = patch_seg_start_it->second.addr;
-                else {
+                if (!segment_table.present[patch_seg]) {
                     LOG_WARN("[FORMAT1_VAR_IMPORT] patch segment {} not found. Skipping relocation. s: {} ", patch_seg, log_hex(s));
                     goto advance_entry;
                 }
+                const Address patch_seg_start = segment_table.start(patch_seg);
 
                 const Address offset = format1_entry->offset;
                 const Address p = patch_seg_start + offset;
@@ -441,7 +478,7 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 const EntryFormat2 *const format2_entry = static_cast<const EntryFormat2 *>(entry);
 
                 const auto symbol_seg = format2_entry->symbol_segment;
-                const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
+                const auto symbol_seg_start = segment_table.start(symbol_seg);
 
                 g_offset += format2_entry->offset;
                 g_saddr = (format2_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
@@ -464,16 +501,13 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 const EntryFormat2Alt *const format1_entry = static_cast<const EntryFormat2Alt *>(entry);
 
                 const auto patch_seg = format1_entry->patch_segment;
-                const auto patch_seg_start_it = segments.find(patch_seg);
                 const Address s = explicit_symval;
 
-                Address patch_seg_start{};
-                if (patch_seg_start_it != segments.end())
-                    patch_seg_start = patch_seg_start_it->second.addr;
-                else {
+                if (!segment_table.present[patch_seg]) {
                     LOG_WARN("[FORMAT2_VAR_IMPORT] patch segment {} not found. Skipping relocation. s: {} ", patch_seg, log_hex(s));
                     goto advance_entry;
                 }
+                const Address patch_seg_start = segment_table.start(patch_seg);
 
                 const Address offset = format1_entry->offset;
                 const Address p = patch_seg_start + offset;
@@ -503,7 +537,7 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
                 log_hex(format3_entry->symbol_segment), format3_entry->mode, format3_entry->mode ? "THUMB" : "ARM", log_hex(format3_entry->offset), log_hex(format3_entry->dist2), log_hex(format3_entry->addend));
 
             const auto symbol_seg = format3_entry->symbol_segment;
-            const auto symbol_seg_start = segments.find(symbol_seg)->second.addr;
+            const auto symbol_seg_start = segment_table.start(symbol_seg);
             const Address s = (format3_entry->symbol_segment == 0xf) ? 0 : symbol_seg_start;
             const auto mode = format3_entry->mode;
             const auto offset = format3_entry->offset;
@@ -594,18 +628,12 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
 
             g_offset += format6_entry->offset;
 
-            const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
-
-            const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
+            const auto patch_seg_start = segment_table.start(g_patchseg);
+            uint32_t *const data = Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
 
-            uint32_t segbase = 0;
-            for (const auto &seg_ : segments) {
-                const auto seg = seg_.second;
-                if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size) {
-                    segbase = seg.p_vaddr;
-                    g_saddr = seg.addr;
-                }
-            }
+            uint32_t orgval;
+            memcpy(&orgval, data, sizeof(orgval));
+            const uint32_t segbase = segment_table.rebase(orgval, g_saddr);
 
             assert((uint32_t)orgval >= (uint32_t)segbase);
             const auto addend = orgval - segbase;
@@ -613,13 +641,8 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             g_type2 = 0;
             g_type = Abs32;
 
-            const auto s = g_saddr;
-            const auto a = addend;
-            const auto p = g_addr + g_offset;
-
-            if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                return false;
-            }
+            LOG_DEBUG_IF(LOG_RELOCATIONS, "[FORMAT6]: offset: {}, s: {}, p: {}, a: {}", log_hex(format6_entry->offset), log_hex(g_saddr), log_hex(g_addr + g_offset), log_hex(addend));
+            write(data, g_saddr + addend);
 
             break;
         }
@@ -642,38 +665,27 @@ bool relocate(const void *entries, uint32_t size, const SegmentInfosForReloc &se
             }
             // clang-format on
 
+            const auto patch_seg_start = segment_table.start(g_patchseg);
             do {
                 auto offset = (offsets & mask) * sizeof(uint32_t);
                 g_offset += static_cast<Address>(offset);
 
-                const auto patch_seg_start = segments.find(g_patchseg)->second.addr;
+                uint32_t *const data = Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
 
-                const uint32_t orgval = *Ptr<uint32_t>(patch_seg_start + g_offset).get(mem);
-
-                uint32_t segbase = 0;
-                for (const auto &seg_ : segments) {
-                    const auto seg = seg_.second;
-                    if (orgval >= seg.p_vaddr && orgval < seg.p_vaddr + seg.size) {
-                        segbase = seg.p_vaddr;
-                        g_saddr = seg.addr;
-                    }
-                }
+                uint32_t orgval;
+                memcpy(&orgval, data, sizeof(orgval));
+                const uint32_t segbase = segment_table.rebase(orgval, g_saddr);
 
                 assert((uint32_t)orgval >= (uint32_t)segbase);
                 const auto addend = orgval - segbase;
 
-                g_type2 = 0;
-                g_type = Abs32;
-
-                const auto s = g_saddr;
-                const auto a = addend;
-                const auto p = g_addr + g_offset;
-
-                if (!relocate_entry(Ptr<uint32_t>(p).get(mem), g_type, s, a, p)) {
-                    return false;
-                }
+                // Rebased words are always absolute, the relocation code is implied
+                write(data, g_saddr + addend);
             } while (offsets >>= bitsize);
 
+            g_type2 = 0;
+            g_type = Abs32;
+
             break;
         }
         default: {
@@ -16,6 +16,7 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <cpu/functions.h>
+#include <kernel/lw_sync.h>
 #include <kernel/state.h>
 #include <kernel/sync_primitives.h>
 
@@ -345,8 +346,7 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     if (weight == SyncWeight::Light) {
         SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
         workarea_mem->lockCount = init_count;
-        if (workarea_mem->lockCount)
-            workarea_mem->owner = thread_id;
+        workarea_mem->owner = init_count ? thread_id : 0;
         workarea_mem->attr = attr;
     }
 
@@ -366,6 +366,103 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     return SCE_KERNEL_OK;
 }
 
+// Lightweight mutexes keep their state in the guest workarea, see lw_sync.h
+inline int lwmutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, MutexPtr &mutex, SceUInt *timeout, bool only_try) {
+    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+
+    std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
+
+    SceKernelLwMutexWork *workarea = mutex->workarea.get(mem);
+    volatile uint32_t *owner = &workarea->owner;
+
+    while (true) {
+        const uint32_t current_owner = *owner;
+
+        // Not owned
+        if (current_owner == 0) {
+            const uint32_t new_owner = thread_id | (mutex->waiting_threads->empty() ? 0 : LW_MUTEX_CONTENDED);
+            if (!atomic_compare_and_swap(owner, new_owner, 0))
+                continue;
+
+            workarea->lockCount = lock_count;
+            return SCE_KERNEL_OK;
+        }
+
+        // Owned by ourselves
+        if ((current_owner & ~LW_MUTEX_CONTENDED) == static_cast<uint32_t>(thread_id)) {
+            if (mutex->attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE) {
+                workarea->lockCount += lock_count;
+                return SCE_KERNEL_OK;
+            }
+
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
+        }
+
+        // Owned by someone else
+
+        // Don't sleep if only_try is set
+        if (only_try)
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
+
+        // Make the owner release the mutex through the kernel
+        if ((current_owner & LW_MUTEX_CONTENDED) || atomic_compare_and_swap(owner, current_owner | LW_MUTEX_CONTENDED, current_owner))
+            break;
+    }
+
+    // Sleep thread! Ownership is handed over by lwmutex_unlock_impl
+    std::unique_lock<std::mutex> thread_lock(thread->mutex);
+    thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+
+    WaitingThreadData data;
+    data.thread = thread;
+    data.lock_count = lock_count;
+    data.priority = thread->priority;
+
+    const auto data_it = mutex->waiting_threads->push(data);
+    thread_lock.unlock();
+
+    return handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
+}
+
+inline int lwmutex_unlock_impl(MemState &mem, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex) {
+    const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
+
+    SceKernelLwMutexWork *workarea = mutex->workarea.get(mem);
+    volatile uint32_t *owner = &workarea->owner;
+    const uint32_t current_owner = *owner;
+
+    if ((current_owner & ~LW_MUTEX_CONTENDED) != static_cast<uint32_t>(thread_id))
+        return SCE_KERNEL_OK;
+
+    if ((unlock_count < 0) || (static_cast<uint32_t>(unlock_count) > workarea->lockCount)) {
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_UNLOCK_UDF);
+    }
+
+    workarea->lockCount -= unlock_count;
+    if (workarea->lockCount > 0)
+        return SCE_KERNEL_OK;
+
+    // Only threads holding mutex->mutex change an owned lock word, so these swaps can't fail
+    if (mutex->waiting_threads->empty()) {
+        atomic_compare_and_swap(owner, 0, current_owner);
+        return SCE_KERNEL_OK;
+    }
+
+    const auto waiting_thread_data = *mutex->waiting_threads->begin();
+    const auto waiting_thread = waiting_thread_data.thread;
+
+    const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
+    mutex->waiting_threads->pop();
+
+    workarea->lockCount = waiting_thread_data.lock_count;
+    const uint32_t new_owner = waiting_thread->id | (mutex->waiting_threads->empty() ? 0 : LW_MUTEX_CONTENDED);
+    atomic_compare_and_swap(owner, new_owner, current_owner);
+
+    waiting_thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+
+    return SCE_KERNEL_OK;
+}
+
 inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, MutexPtr &mutex, SyncWeight weight, SceUInt *timeout, bool only_try) {
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} timeout: {} waiting_threads: {}",
@@ -373,6 +470,9 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
             mutex->waiting_threads->size());
     }
 
+    if (weight == SyncWeight::Light)
+        return lwmutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, timeout, only_try);
+
     const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
 
     std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
@@ -385,25 +485,16 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         if (mutex->owner == thread) {
             if (is_recursive) {
                 mutex->lock_count += lock_count;
-                if (weight == SyncWeight::Light)
-                    mutex->workarea.get(mem)->lockCount += lock_count;
-
                 return SCE_KERNEL_OK;
             }
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
 
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_RECURSIVE);
         }
         // Owned by someone else
 
         // Don't sleep if only_try is set
-        if (only_try) {
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
-
+        if (only_try)
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_FAILED_TO_OWN);
-        }
 
         // Sleep thread!
         std::unique_lock<std::mutex> thread_lock(thread->mutex);
@@ -417,16 +508,7 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         const auto data_it = mutex->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int res = handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
-
-        if (weight == SyncWeight::Light) {
-            mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-            if (mutex->owner == thread) {
-                mutex->workarea.get(mem)->owner = thread_id;
-            }
-        }
-
-        return res;
+        return handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
     }
     // Not owned
     // Take ownership!
@@ -434,13 +516,6 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
     mutex->lock_count += lock_count;
     mutex->owner = thread;
 
-    if (weight == SyncWeight::Light) {
-        mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-        if (mutex->owner == thread) {
-            mutex->workarea.get(mem)->owner = thread_id;
-        }
-    }
-
     return SCE_KERNEL_OK;
 }
 
@@ -464,7 +539,10 @@ int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name,
     return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, weight, nullptr, true);
 }
 
-inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex) {
+inline int mutex_unlock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex, SyncWeight weight) {
+    if (weight == SyncWeight::Light)
+        return lwmutex_unlock_impl(mem, export_name, thread_id, unlock_count, mutex);
+
     const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
 
     const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
@@ -497,7 +575,7 @@ inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUI
     return SCE_KERNEL_OK;
 }
 
-int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight) {
+int mutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight) {
     assert(mutexid >= 0);
 
     MutexPtr mutex;
@@ -510,7 +588,7 @@ int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id,
             mutex->waiting_threads->size());
     }
 
-    return mutex_unlock_impl(kernel, export_name, thread_id, unlock_count, mutex);
+    return mutex_unlock_impl(kernel, mem, export_name, thread_id, unlock_count, mutex, weight);
 }
 
 int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
@@ -554,6 +632,63 @@ MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_i
     return mutex;
 }
 
+// ********************
+// * Lightweight sync *
+// ********************
+
+int lwmutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *timeout, bool only_try) {
+    SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
+    switch (lwmutex_try_lock_fast(*workarea_mem, thread_id, lock_count)) {
+    case LwFastPath::Done:
+        ++kernel.lw_sync_fast_path_count;
+        return SCE_KERNEL_OK;
+    case LwFastPath::Recursive:
+        ++kernel.lw_sync_fast_path_count;
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
+    case LwFastPath::Slow:
+    default: break;
+    }
+
+    if (only_try)
+        return mutex_try_lock(kernel, mem, export_name, thread_id, workarea_mem->uid, lock_count, SyncWeight::Light);
+
+    return mutex_lock(kernel, mem, export_name, thread_id, workarea_mem->uid, lock_count, timeout, SyncWeight::Light);
+}
+
+int lwmutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
+    SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
+    if (lwmutex_unlock_fast(*workarea_mem, thread_id, unlock_count) == LwFastPath::Done) {
+        ++kernel.lw_sync_fast_path_count;
+        return SCE_KERNEL_OK;
+    }
+
+    return mutex_unlock(kernel, mem, export_name, thread_id, workarea_mem->uid, unlock_count, SyncWeight::Light);
+}
+
+int lwcond_wait(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwCondWork> workarea, SceUInt *timeout) {
+    SceKernelLwCondWork *workarea_mem = workarea.get(mem);
+
+    // The waiter holds the associated mutex here, so a signaling thread holding it sees the waiter
+    lwcond_add_waiters(*workarea_mem, 1);
+    const int res = condvar_wait(kernel, mem, export_name, thread_id, workarea_mem->uid, timeout, SyncWeight::Light);
+    lwcond_add_waiters(*workarea_mem, -1);
+
+    return res;
+}
+
+int lwcond_signal(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwCondWork> workarea, Condvar::SignalTarget signal_target) {
+    SceKernelLwCondWork *workarea_mem = workarea.get(mem);
+
+    // Nothing to wake up, which only the owner of the associated mutex can tell without locking
+    if ((signal_target.type != Condvar::SignalTarget::Type::Specific) && workarea_mem->mutex_workarea
+        && lwcond_can_skip_signal(*workarea_mem, *workarea_mem->mutex_workarea.get(mem), thread_id)) {
+        ++kernel.lw_sync_fast_path_count;
+        return SCE_KERNEL_OK;
+    }
+
+    return condvar_signal(kernel, export_name, thread_id, workarea_mem->uid, signal_target, SyncWeight::Light);
+}
+
 // **************
 // * RWLock *
 // **************
@@ -925,7 +1060,7 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
 
     std::unique_lock<std::mutex> condition_variable_lock(condvar->mutex);
 
-    if (auto error = mutex_unlock_impl(kernel, export_name, thread_id, 1, condvar->associated_mutex))
+    if (auto error = mutex_unlock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex, weight))
         return error;
 
     std::unique_lock<std::mutex> thread_lock(thread->mutex);
@@ -0,0 +1,207 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/lw_sync.h>
+#include <kernel/state.h>
+#include <kernel/sync_primitives.h>
+#include <kernel/thread/thread_state.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem);
+    EXPECT_TRUE(initialized);
+    return mem;
+}
+
+static SceKernelLwMutexWork make_workarea(SceUInt attr) {
+    SceKernelLwMutexWork work{};
+    work.attr = attr;
+    return work;
+}
+
+TEST(lw_sync, lock_unlock_uncontended) {
+    SceKernelLwMutexWork work = make_workarea(0);
+
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_EQ(work.owner, 0x40010003u);
+    ASSERT_EQ(work.lockCount, 1u);
+
+    // Owned by someone else
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010005, 1), LwFastPath::Slow);
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010005, 1), LwFastPath::Slow);
+
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_EQ(work.owner, 0u);
+    ASSERT_EQ(work.lockCount, 0u);
+}
+
+TEST(lw_sync, recursive_lock) {
+    SceKernelLwMutexWork work = make_workarea(SCE_KERNEL_MUTEX_ATTR_RECURSIVE);
+
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010003, 2), LwFastPath::Done);
+    ASSERT_EQ(work.lockCount, 3u);
+
+    // Unlocking more than locked is an error reported by the kernel
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010003, 4), LwFastPath::Slow);
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010003, 2), LwFastPath::Done);
+    ASSERT_EQ(work.owner, 0x40010003u);
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_EQ(work.owner, 0u);
+
+    SceKernelLwMutexWork non_recursive = make_workarea(0);
+    ASSERT_EQ(lwmutex_try_lock_fast(non_recursive, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_EQ(lwmutex_try_lock_fast(non_recursive, 0x40010003, 1), LwFastPath::Recursive);
+    ASSERT_EQ(non_recursive.lockCount, 1u);
+}
+
+TEST(lw_sync, contended_unlock_goes_to_kernel) {
+    SceKernelLwMutexWork work = make_workarea(0);
+
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010003, 1), LwFastPath::Done);
+    // What a thread going to sleep on the mutex does
+    work.owner |= LW_MUTEX_CONTENDED;
+
+    ASSERT_EQ(lwmutex_try_lock_fast(work, 0x40010005, 1), LwFastPath::Slow);
+    ASSERT_EQ(lwmutex_unlock_fast(work, 0x40010003, 1), LwFastPath::Slow);
+    ASSERT_EQ(work.owner, 0x40010003u | LW_MUTEX_CONTENDED);
+    ASSERT_EQ(work.lockCount, 1u);
+}
+
+TEST(lw_sync, stress_many_threads) {
+    constexpr int THREAD_COUNT = 8;
+    constexpr int ITERATIONS = 20000;
+
+    SceKernelLwMutexWork work = make_workarea(0);
+    int counter = 0;
+    std::atomic<int> failed_unlocks = 0;
+
+    // gtest assertions only work on the main thread, failures are counted and checked after the join
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back([&, thread_id = 0x40010003 + i * 2] {
+            for (int j = 0; j < ITERATIONS; j++) {
+                while (lwmutex_try_lock_fast(work, thread_id, 1) != LwFastPath::Done)
+                    std::this_thread::yield();
+
+                ++counter;
+
+                if (lwmutex_unlock_fast(work, thread_id, 1) != LwFastPath::Done)
+                    ++failed_unlocks;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    ASSERT_EQ(failed_unlocks, 0);
+    ASSERT_EQ(counter, THREAD_COUNT * ITERATIONS);
+    ASSERT_EQ(work.owner, 0u);
+}
+
+TEST(lw_sync, contended_lock_wakes_through_kernel) {
+    MemState &mem = get_mem();
+    KernelState kernel;
+
+    const auto add_thread = [&] {
+        const auto thread = std::make_shared<ThreadState>(kernel.get_next_uid(), mem);
+        thread->update_status(ThreadStatus::run);
+        kernel.threads.emplace(thread->id, thread);
+        return thread;
+    };
+    const auto owner = add_thread();
+    const auto waiter = add_thread();
+
+    const Address workarea_addr = alloc(mem, sizeof(SceKernelLwMutexWork), "lw_sync test");
+    ASSERT_NE(workarea_addr, 0u);
+    const Ptr<SceKernelLwMutexWork> workarea(workarea_addr);
+    SceKernelLwMutexWork &work = *workarea.get(mem);
+    ASSERT_EQ(mutex_create(&work.uid, kernel, mem, "test", "contended", owner->id, 0, 0, workarea, SyncWeight::Light), SCE_KERNEL_OK);
+
+    ASSERT_EQ(lwmutex_lock(kernel, mem, "test", owner->id, workarea, 1, nullptr, false), SCE_KERNEL_OK);
+
+    // The waiter marks the lock word and sleeps in the kernel wait queue
+    std::atomic<int> waiter_result = -1;
+    std::thread waiter_thread([&] {
+        waiter_result = lwmutex_lock(kernel, mem, "test", waiter->id, workarea, 2, nullptr, false);
+    });
+
+    // The lock word is marked under the kernel mutex lock, which is only released once queued
+    volatile uint32_t *owner_word = &work.owner;
+    while (!(*owner_word & LW_MUTEX_CONTENDED))
+        std::this_thread::yield();
+    EXPECT_EQ(waiter_result, -1);
+
+    const uint64_t fast_path_count = kernel.lw_sync_fast_path_count;
+    ASSERT_EQ(lwmutex_unlock(kernel, mem, "test", owner->id, workarea, 1), SCE_KERNEL_OK);
+    waiter_thread.join();
+
+    // Handed over by the kernel, with the waiter lock count and nobody else waiting
+    EXPECT_EQ(kernel.lw_sync_fast_path_count, fast_path_count);
+    EXPECT_EQ(waiter_result, SCE_KERNEL_OK);
+    EXPECT_EQ(waiter->status, ThreadStatus::run);
+    EXPECT_EQ(work.owner, static_cast<uint32_t>(waiter->id));
+    EXPECT_EQ(work.lockCount, 2u);
+
+    // Uncontended again, back on the fast path
+    EXPECT_EQ(lwmutex_unlock(kernel, mem, "test", waiter->id, workarea, 2), SCE_KERNEL_OK);
+    EXPECT_EQ(kernel.lw_sync_fast_path_count, fast_path_count + 1);
+    EXPECT_EQ(work.owner, 0u);
+
+    free(mem, workarea_addr);
+}
+
+TEST(lw_sync, cond_waiters) {
+    SceKernelLwCondWork work{};
+
+    ASSERT_FALSE(lwcond_has_waiters(work));
+    lwcond_add_waiters(work, 1);
+    lwcond_add_waiters(work, 1);
+    ASSERT_TRUE(lwcond_has_waiters(work));
+    lwcond_add_waiters(work, -1);
+    lwcond_add_waiters(work, -1);
+    ASSERT_FALSE(lwcond_has_waiters(work));
+}
+
+TEST(lw_sync, cond_skip_signal_needs_mutex) {
+    SceKernelLwCondWork work{};
+    SceKernelLwMutexWork mutex_work = make_workarea(0);
+
+    // Not holding the mutex, a waiter may be registering
+    ASSERT_FALSE(lwcond_can_skip_signal(work, mutex_work, 0x40010003));
+    ASSERT_EQ(lwmutex_try_lock_fast(mutex_work, 0x40010005, 1), LwFastPath::Done);
+    ASSERT_FALSE(lwcond_can_skip_signal(work, mutex_work, 0x40010003));
+    ASSERT_EQ(lwmutex_unlock_fast(mutex_work, 0x40010005, 1), LwFastPath::Done);
+
+    ASSERT_EQ(lwmutex_try_lock_fast(mutex_work, 0x40010003, 1), LwFastPath::Done);
+    ASSERT_TRUE(lwcond_can_skip_signal(work, mutex_work, 0x40010003));
+    lwcond_add_waiters(work, 1);
+    ASSERT_FALSE(lwcond_can_skip_signal(work, mutex_work, 0x40010003));
+
+    // Still the owner while others wait on the mutex
+    lwcond_add_waiters(work, -1);
+    mutex_work.owner |= LW_MUTEX_CONTENDED;
+    ASSERT_TRUE(lwcond_can_skip_signal(work, mutex_work, 0x40010003));
+}
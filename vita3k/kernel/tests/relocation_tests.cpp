@@ -0,0 +1,126 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#include <kernel/relocation.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+// Two segments linked at 0x81000000 and loaded somewhere else
+static constexpr Address TEXT_ADDR = 0x10000;
+static constexpr Address DATA_ADDR = 0x20000;
+static constexpr Address TEXT_VADDR = 0x81000000;
+static constexpr Address DATA_VADDR = 0x81001000;
+
+// Relocation codes
+static constexpr uint32_t ABS32 = 2;
+static constexpr uint32_t CALL = 28;
+
+struct RelocationTest : testing::Test {
+    std::vector<uint8_t> memory = std::vector<uint8_t>(0x30000);
+    MemState mem;
+    SegmentInfosForReloc segments;
+
+    void SetUp() override {
+        mem.memory = Memory(memory.data(), [](uint8_t *) {});
+        segments[0] = { TEXT_ADDR, TEXT_VADDR, 0x1000 };
+        segments[1] = { DATA_ADDR, DATA_VADDR, 0x1000 };
+    }
+
+    void TearDown() override {
+        mem.memory.release();
+    }
+
+    uint32_t read(Address addr) const {
+        uint32_t value;
+        memcpy(&value, &memory[addr], sizeof(value));
+        return value;
+    }
+
+    void write(Address addr, uint32_t value) {
+        memcpy(&memory[addr], &value, sizeof(value));
+    }
+
+    bool relocate(const std::vector<uint32_t> &entries, bool is_var_import = false, uint32_t symval = 0) {
+        return ::relocate(entries.data(), static_cast<uint32_t>(entries.size() * sizeof(uint32_t)), segments, mem, is_var_import, symval);
+    }
+};
+
+static uint32_t format1(uint32_t symbol_segment, uint32_t code, uint32_t patch_segment, uint32_t offset) {
+    return 1 | (symbol_segment << 4) | (code << 8) | (patch_segment << 16) | ((offset & 0xFFF) << 20);
+}
+
+static uint32_t format1_hi(uint32_t offset, uint32_t addend) {
+    return (offset >> 12) | (addend << 10);
+}
+
+TEST_F(RelocationTest, absolute_and_call) {
+    write(TEXT_ADDR + 0x20, 0xEB000000); // bl
+    const std::vector<uint32_t> entries = {
+        format1(1, ABS32, 0, 0x10), format1_hi(0x10, 0x24),
+        2 | (0 << 4) | (CALL << 8) | (0x10 << 16), 0x100, // format 2, 0x10 bytes after the previous entry
+    };
+    ASSERT_TRUE(relocate(entries));
+
+    EXPECT_EQ(read(TEXT_ADDR + 0x10), DATA_ADDR + 0x24);
+    EXPECT_EQ(read(TEXT_ADDR + 0x20), 0xEB000000 | ((0x100 - 0x20) >> 2));
+}
+
+TEST_F(RelocationTest, rebase_pointers) {
+    write(DATA_ADDR + 0x4, TEXT_VADDR + 0x40);
+    write(DATA_ADDR + 0xC, DATA_VADDR + 0x8);
+    write(DATA_ADDR + 0x10, DATA_VADDR + 0xFFC);
+    const std::vector<uint32_t> entries = {
+        format1(1, ABS32, 1, 0), format1_hi(0, 0),
+        7 | (1 << 4) | (2 << 11), // format 7, 1 then 2 words further
+        6 | (0x4 << 4), // format 6, 1 word further
+    };
+    ASSERT_TRUE(relocate(entries));
+
+    EXPECT_EQ(read(DATA_ADDR), DATA_ADDR);
+    EXPECT_EQ(read(DATA_ADDR + 0x4), TEXT_ADDR + 0x40);
+    EXPECT_EQ(read(DATA_ADDR + 0xC), DATA_ADDR + 0x8);
+    EXPECT_EQ(read(DATA_ADDR + 0x10), DATA_ADDR + 0xFFC);
+}
+
+TEST_F(RelocationTest, thumb_movw_movt) {
+    const std::vector<uint32_t> entries = {
+        format1(0, 0, 0, 0), format1_hi(0, 0), // sets the patch segment only
+        3 | (1 << 4) | (1 << 8) | (0x40 << 9) | (4u << 27), 0x1234, // format 3, thumb
+    };
+    ASSERT_TRUE(relocate(entries));
+
+    const auto thumb_mov_immediate = [&](Address addr) {
+        const uint32_t insn = read(addr);
+        const uint32_t upper = insn & 0xFFFF, lower = insn >> 16;
+        return ((upper & 0xF) << 12) | (((upper >> 10) & 1) << 11) | (((lower >> 12) & 7) << 8) | (lower & 0xFF);
+    };
+    EXPECT_EQ(thumb_mov_immediate(TEXT_ADDR + 0x40), (DATA_ADDR + 0x1234) & 0xFFFF);
+    EXPECT_EQ(thumb_mov_immediate(TEXT_ADDR + 0x44), (DATA_ADDR + 0x1234) >> 16);
+}
+
+TEST_F(RelocationTest, var_import_skips_missing_segment) {
+    const std::vector<uint32_t> entries = {
+        1 | (0 << 4) | (ABS32 << 8) | (4 << 16), 0x8, // format 1 of var imports
+        1 | (5 << 4) | (ABS32 << 8), 0x8, // not loaded segment
+    };
+    ASSERT_TRUE(relocate(entries, true, 0xCAFE0000));
+
+    EXPECT_EQ(read(TEXT_ADDR + 0x8), 0xCAFE0004);
+}
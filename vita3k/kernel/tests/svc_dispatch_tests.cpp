@@ -0,0 +1,226 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <cpu/functions.h>
+#include <kernel/cpu_protocol.h>
+#include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem);
+    EXPECT_TRUE(initialized);
+    return mem;
+}
+
+// Captures as much as the bridge of an export with a few arguments
+static ImportFn make_test_import() {
+    const std::array<uint32_t, 8> args_layout = {};
+    return [args_layout](EmuEnvState &, CPUState &, SceUID) {
+        (void)args_layout;
+    };
+}
+
+// Stands for the HLE implementations, each NID of the list resolves to one of them
+static const std::vector<ImportFn> test_imports(8, make_test_import());
+
+static const ImportFn *resolve_test_import(uint32_t nid) {
+    switch (nid) {
+#define VAR_NID(name, nid)
+#define NID(name, nid) \
+    case nid:          \
+        return &test_imports[nid & 7];
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+    }
+
+    return nullptr;
+}
+
+// NIDs picked over the whole list, so that the switch is not always hit at the same place
+static std::vector<uint32_t> get_test_nids() {
+    std::vector<uint32_t> nids;
+#define VAR_NID(name, nid)
+#define NID(name, nid) nids.push_back(nid);
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+
+    std::vector<uint32_t> picked;
+    for (size_t i = 0; i < nids.size(); i += nids.size() / 64)
+        picked.push_back(nids[i]);
+    return picked;
+}
+
+struct SvcDispatchTest : testing::Test {
+    MemState &mem = get_mem();
+    KernelState kernel;
+    CPUStatePtr cpu;
+    std::unique_ptr<ThreadState> thread;
+    Address code = 0;
+
+    std::vector<uint32_t> imported_nids;
+    std::vector<uint32_t> imported_slots;
+
+    void SetUp() override {
+        const auto call_import = [this](CPUState &, uint32_t nid, SceUID) {
+            imported_nids.push_back(nid);
+        };
+        const auto call_import_slot = [this](CPUState &, uint32_t slot, SceUID) {
+            imported_slots.push_back(slot);
+        };
+        ASSERT_TRUE(kernel.init(mem, call_import, call_import_slot, resolve_test_import, CPUBackend::Unicorn, false));
+
+        thread = std::make_unique<ThreadState>(kernel.get_next_uid(), mem);
+        cpu = init_cpu(CPUBackend::Unicorn, false, thread->id, 0, mem, kernel.cpu_protocol.get());
+        ASSERT_TRUE(cpu);
+
+        code = alloc(mem, 0x100, "svc dispatch test");
+        ASSERT_NE(code, 0u);
+    }
+
+    void TearDown() override {
+        cpu.reset();
+        if (code)
+            free(mem, code);
+    }
+
+    void write(Address addr, uint32_t value) {
+        *Ptr<uint32_t>(addr).get(mem) = value;
+    }
+
+    void call_svc(uint32_t svc, Address pc) {
+        kernel.cpu_protocol->call_svc(*cpu, svc, pc, *thread);
+    }
+};
+
+TEST_F(SvcDispatchTest, import_stub) {
+    // svc #0, mov pc, lr, nid
+    write(code, 0xEF000000);
+    write(code + 8, 0x12345678);
+    call_svc(0, code + 4);
+
+    ASSERT_EQ(imported_nids, std::vector<uint32_t>{ 0x12345678 });
+    ASSERT_TRUE(imported_slots.empty());
+}
+
+TEST_F(SvcDispatchTest, import_slot) {
+    call_svc(IMPORT_SLOT_SVC | 5, code + 4);
+
+    ASSERT_EQ(imported_slots, std::vector<uint32_t>{ 5 });
+    ASSERT_TRUE(imported_nids.empty());
+}
+
+TEST_F(SvcDispatchTest, trampoline_numbers_without_trampoline) {
+    // A game raising the trampoline SVC numbers by itself gets the usual service call
+    write(code + 8, 0x11111111);
+    call_svc(TRAMPOLINE_JUMPER_SVC, code + 4);
+    write(code + 8, 0x22222222);
+    call_svc(TRAMPOLINE_HANDLER_SVC, code + 4);
+
+    ASSERT_EQ(imported_nids, (std::vector<uint32_t>{ 0x11111111, 0x22222222 }));
+}
+
+TEST_F(SvcDispatchTest, trampoline) {
+    Address callback_lr = 0;
+    kernel.debugger.add_trampoile(mem, code, false, [&](CPUState &, MemState &, Address lr) {
+        callback_lr = lr;
+        return true;
+    });
+    Trampoline *const tr = kernel.debugger.get_trampoline(code);
+    ASSERT_NE(tr, nullptr);
+
+    // The jumper replacing the patched instruction goes to the trampoline body
+    call_svc(TRAMPOLINE_JUMPER_SVC, code + 4);
+    ASSERT_EQ(read_pc(*cpu), tr->trampoline_addr);
+
+    // The body calls the callback
+    ASSERT_EQ(kernel.debugger.get_trampoline_from_body(tr->trampoline_addr + 8), tr);
+    call_svc(TRAMPOLINE_HANDLER_SVC, tr->trampoline_addr + 8);
+    ASSERT_EQ(callback_lr, code + 4);
+
+    ASSERT_TRUE(imported_nids.empty());
+    kernel.debugger.remove_trampoline(mem, code);
+}
+
+TEST_F(SvcDispatchTest, slots_match_nids) {
+    for (const uint32_t nid : get_test_nids()) {
+        const auto slot = kernel.get_import_slot(nid);
+        ASSERT_TRUE(slot);
+        ASSERT_EQ(kernel.get_import_slot(nid), slot);
+        ASSERT_EQ(kernel.import_slots[*slot].nid, nid);
+        ASSERT_EQ(kernel.import_slots[*slot].fn.load(), resolve_test_import(nid));
+    }
+
+    // Once a loaded module exports the NID, calls go to call_import again
+    const uint32_t nid = get_test_nids().front();
+    kernel.unbind_import_slot(nid);
+    ASSERT_EQ(kernel.import_slots[*kernel.get_import_slot(nid)].fn.load(), nullptr);
+}
+
+// Cost of finding the HLE implementation of an import on each SVC, through the NID read from the
+// stub as call_import does, and through the slot held by the SVC immediate.
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST_F(SvcDispatchTest, DISABLED_benchmark_lookup) {
+    constexpr size_t CALL_COUNT = 2'000'000;
+    const std::vector<uint32_t> nids = get_test_nids();
+    std::vector<uint32_t> slots;
+    for (const uint32_t nid : nids)
+        slots.push_back(*kernel.get_import_slot(nid));
+    // Imports resolved to LLE exports are looked up first
+    kernel.export_nids.emplace(0xDEADBEEF, 0x81000000);
+
+    const auto nid_lookup = [&](uint32_t nid) {
+        {
+            const std::shared_lock<std::shared_mutex> lock(kernel.export_nids_mutex);
+            if (kernel.export_nids.find(nid) != kernel.export_nids.end())
+                return false;
+        }
+        // Copied as the NID switch used to return it by value
+        const ImportFn fn = *resolve_test_import(nid);
+        return static_cast<bool>(fn);
+    };
+    const auto slot_lookup = [&](uint32_t slot) {
+        return kernel.import_slots[slot].fn.load(std::memory_order_acquire) != nullptr;
+    };
+
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CALL_COUNT; i++)
+        found += nid_lookup(nids[i % nids.size()]);
+    const std::chrono::duration<double, std::nano> nid_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < CALL_COUNT; i++)
+        found += slot_lookup(slots[i % slots.size()]);
+    const std::chrono::duration<double, std::nano> slot_time = std::chrono::steady_clock::now() - start;
+
+    ASSERT_EQ(found, 2 * CALL_COUNT);
+    std::printf("Import lookup: %.1f ns by NID, %.1f ns by slot\n", nid_time.count() / CALL_COUNT, slot_time.count() / CALL_COUNT);
+}
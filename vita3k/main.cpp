@@ -138,6 +138,7 @@ int main(int argc, char *argv[]) {
                 fs::remove_all(fs::path(root_paths.get_pref_path()) / "ux0/addcont" / *cfg.delete_title_id);
                 fs::remove_all(fs::path(root_paths.get_pref_path()) / "ux0/user/00/savedata" / *cfg.delete_title_id);
                 fs::remove_all(fs::path(root_paths.get_base_path()) / "cache/shaders" / *cfg.delete_title_id);
+                fs::remove_all(fs::path(root_paths.get_base_path()) / "cache/modules" / *cfg.delete_title_id);
             }
             if (cfg.pkg_path.has_value() && cfg.pkg_zrif.has_value()) {
                 LOG_INFO("Installing pkg from {} ", *cfg.pkg_path);
@@ -150,6 +151,14 @@ int main(int argc, char *argv[]) {
         return InitConfigFailed;
     }
 
+    // Headless warm-up: loading the modules is enough to fill the module cache, no window, renderer or GUI is needed
+    if (cfg.populate_module_cache) {
+        if (!app::init_headless(emuenv, cfg, root_paths))
+            return InitConfigFailed;
+        init_libraries(emuenv);
+        return populate_module_cache(emuenv);
+    }
+
 #ifdef WIN32
     auto res = CoInitializeEx(NULL, COINIT_MULTITHREADED);
     LOG_ERROR_IF(res == S_FALSE, "Failed to initialize COM Library");
@@ -219,6 +228,9 @@ int main(int argc, char *argv[]) {
         const auto is_directory = fs::is_directory(*cfg.content_path);
 
         const auto content_is_app = [&]() {
+            if (cfg.run_from_archive)
+                return mount_archive_app(emuenv, *cfg.content_path);
+
             std::vector<ContentInfo> contents_info = install_archive(emuenv, gui_ptr, string_utils::utf_to_wide(cfg.content_path->string()));
             const auto content_index = std::find_if(contents_info.begin(), contents_info.end(), [&](const ContentInfo &c) {
                 return c.category == "gd";
@@ -363,13 +375,15 @@ int main(int argc, char *argv[]) {
     emuenv.renderer->self_name = emuenv.self_name.c_str();
     if (renderer::get_shaders_cache_hashs(*emuenv.renderer) && cfg.shader_cache) {
         SDL_SetWindowTitle(emuenv.window.get(), fmt::format("{} | {} ({}) | Please wait, compiling shaders...", window_title, emuenv.current_app_title, emuenv.io.title_id).c_str());
-        for (const auto &hash : emuenv.renderer->shaders_cache_hashs) {
+        const auto total = uint32_t(emuenv.renderer->shaders_cache_hashs.size());
+        bool precompiled = false;
+        while (!precompiled) {
             handle_events(emuenv, gui);
             gui::draw_begin(gui, emuenv);
             draw_app_background(gui, emuenv);
 
-            emuenv.renderer->precompile_shader(hash);
-            gui::draw_pre_compiling_shaders_progress(gui, emuenv, uint32_t(emuenv.renderer->shaders_cache_hashs.size()));
+            precompiled = emuenv.renderer->precompile_shaders();
+            gui::draw_pre_compiling_shaders_progress(gui, emuenv, total);
 
             gui::draw_end(gui, emuenv.window.get());
             emuenv.renderer->swap_window(emuenv.window.get());
@@ -0,0 +1,113 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/block.h>
+#include <mem/util.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+struct MemState;
+
+struct GuestHeapStats {
+    uint64_t system_size = 0; // Guest memory currently reserved by the heap
+    uint64_t max_system_size = 0;
+    uint64_t inuse_size = 0; // Bytes handed out, rounded up to their size class
+    uint64_t max_inuse_size = 0;
+    uint64_t allocation_count = 0;
+};
+
+// Allocator for guest heaps living in guest memory.
+// Small allocations are served from size classes carved out of spans taken with alloc_block,
+// every guest thread keeping a few free blocks of each class to itself.
+// Bigger allocations get their own pages.
+class GuestHeap {
+public:
+    static constexpr uint32_t SPAN_SIZE = KiB(64);
+    static constexpr uint32_t MIN_ALIGNMENT = 16;
+    static constexpr uint32_t MAX_SMALL_SIZE = 2048;
+    static constexpr uint32_t THREAD_CACHE_SIZE = 32; // Free blocks of each class kept per thread
+    static constexpr std::array<uint32_t, 24> SIZE_CLASSES = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        160, 192, 224, 256, 320, 384, 448, 512,
+        640, 768, 896, 1024, 1280, 1536, 1792, 2048
+    };
+    static constexpr size_t CLASS_COUNT = SIZE_CLASSES.size();
+
+    GuestHeap(MemState &mem, const char *name);
+    ~GuestHeap();
+
+    // Returns 0 when out of memory or when alignment isn't a power of two
+    Address alloc(int32_t thread_id, uint32_t size, uint32_t alignment = 0);
+    Address realloc(int32_t thread_id, Address address, uint32_t size, uint32_t alignment = 0);
+    // Returns false when the address doesn't belong to the heap
+    bool free(int32_t thread_id, Address address);
+    // Returns 0 when the address doesn't belong to the heap
+    uint32_t usable_size(Address address);
+    // Gives the blocks cached by a thread back to the heap
+    void release_thread_cache(int32_t thread_id);
+
+    GuestHeapStats get_stats();
+
+private:
+    typedef std::array<std::vector<Address>, CLASS_COUNT> FreeLists;
+
+    struct ThreadCache {
+        FreeLists blocks;
+    };
+
+    struct LargeAllocation {
+        Block block;
+        uint32_t size;
+        uint32_t reserved; // Pages it takes, in bytes
+    };
+
+    int get_size_class(Address address) const;
+    ThreadCache &get_thread_cache(int32_t thread_id);
+    void refill(int size_class, std::vector<Address> &blocks);
+    void drain(int size_class, std::vector<Address> &blocks, size_t keep);
+    bool grow(int size_class);
+    Address alloc_large(uint32_t size, uint32_t alignment);
+    void add_inuse(int64_t size);
+
+    MemState &mem;
+    const char *name;
+
+    // Guards everything below but thread caches and statistics
+    std::mutex mutex;
+    std::vector<Block> spans;
+    FreeLists free_lists;
+    std::unordered_map<Address, LargeAllocation> large_allocations;
+    // Size class + 1 of the span every guest page belongs to, 0 for pages outside of spans
+    std::unique_ptr<uint8_t[]> page_classes;
+    uint64_t system_size = 0;
+    uint64_t max_system_size = 0;
+
+    std::shared_mutex thread_caches_mutex;
+    std::unordered_map<int32_t, std::unique_ptr<ThreadCache>> thread_caches;
+
+    std::atomic<uint64_t> inuse_size{ 0 };
+    std::atomic<uint64_t> max_inuse_size{ 0 };
+    std::atomic<uint64_t> allocation_count{ 0 };
+};
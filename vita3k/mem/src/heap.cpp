@@ -0,0 +1,275 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/functions.h>
+#include <mem/heap.h>
+#include <mem/state.h>
+#include <util/align.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Blocks moved at once between a thread cache and the shared free lists
+static constexpr size_t BATCH_SIZE = GuestHeap::THREAD_CACHE_SIZE / 2;
+
+static uint64_t page_count(const MemState &mem) {
+    return GiB(4) / mem.page_size;
+}
+
+static bool is_power_of_two(uint32_t value) {
+    return value && !(value & (value - 1));
+}
+
+// Smallest class fitting the size whose blocks all respect the alignment, -1 if there is none
+static int size_class_for(uint32_t size, uint32_t alignment) {
+    if (size > GuestHeap::MAX_SMALL_SIZE)
+        return -1;
+
+    const auto first = std::lower_bound(GuestHeap::SIZE_CLASSES.begin(), GuestHeap::SIZE_CLASSES.end(), size);
+    for (auto it = first; it != GuestHeap::SIZE_CLASSES.end(); ++it) {
+        // Spans are page aligned, so blocks are aligned to any power of two dividing their size
+        if (*it % alignment == 0)
+            return static_cast<int>(it - GuestHeap::SIZE_CLASSES.begin());
+    }
+
+    return -1;
+}
+
+GuestHeap::GuestHeap(MemState &mem, const char *name)
+    : mem(mem)
+    , name(name)
+    , page_classes(new uint8_t[page_count(mem)]()) {
+}
+
+GuestHeap::~GuestHeap() = default;
+
+int GuestHeap::get_size_class(Address address) const {
+    return static_cast<int>(page_classes[address / mem.page_size]) - 1;
+}
+
+GuestHeap::ThreadCache &GuestHeap::get_thread_cache(int32_t thread_id) {
+    {
+        const std::shared_lock<std::shared_mutex> lock(thread_caches_mutex);
+        const auto it = thread_caches.find(thread_id);
+        if (it != thread_caches.end())
+            return *it->second;
+    }
+
+    const std::unique_lock<std::shared_mutex> lock(thread_caches_mutex);
+    auto &cache = thread_caches[thread_id];
+    if (!cache)
+        cache = std::make_unique<ThreadCache>();
+
+    return *cache;
+}
+
+bool GuestHeap::grow(int size_class) {
+    Block span = alloc_block(mem, SPAN_SIZE, name);
+    if (!span)
+        return false;
+
+    const Address base = span.get();
+    const uint32_t block_size = SIZE_CLASSES[size_class];
+    const uint32_t block_count = SPAN_SIZE / block_size;
+
+    std::fill_n(&page_classes[base / mem.page_size], SPAN_SIZE / mem.page_size, static_cast<uint8_t>(size_class + 1));
+
+    // Lowest addresses are handed out first
+    auto &free_list = free_lists[size_class];
+    for (uint32_t i = block_count; i > 0; i--)
+        free_list.push_back(base + (i - 1) * block_size);
+
+    spans.push_back(std::move(span));
+    system_size += SPAN_SIZE;
+    max_system_size = std::max(max_system_size, system_size);
+
+    return true;
+}
+
+void GuestHeap::refill(int size_class, std::vector<Address> &blocks) {
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    auto &free_list = free_lists[size_class];
+    if (free_list.empty() && !grow(size_class))
+        return;
+
+    const size_t count = std::min(BATCH_SIZE, free_list.size());
+    blocks.insert(blocks.end(), free_list.end() - count, free_list.end());
+    free_list.resize(free_list.size() - count);
+}
+
+void GuestHeap::drain(int size_class, std::vector<Address> &blocks, size_t keep) {
+    if (blocks.size() <= keep)
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    auto &free_list = free_lists[size_class];
+    free_list.insert(free_list.end(), blocks.begin() + keep, blocks.end());
+    blocks.resize(keep);
+}
+
+Address GuestHeap::alloc_large(uint32_t size, uint32_t alignment) {
+    // Page allocations are always page aligned
+    const uint32_t extra_alignment = alignment > mem.page_size ? alignment : 0;
+    const Address address = ::alloc(mem, size, name, extra_alignment);
+    if (!address)
+        return 0;
+
+    const uint32_t reserved = align(size, mem.page_size);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    large_allocations.emplace(address, LargeAllocation{ Block(address, [&mem = mem](Address address) { ::free(mem, address); }), size, reserved });
+    system_size += reserved;
+    max_system_size = std::max(max_system_size, system_size);
+
+    return address;
+}
+
+void GuestHeap::add_inuse(int64_t size) {
+    const uint64_t inuse = inuse_size += size;
+    uint64_t max_inuse = max_inuse_size;
+    while (inuse > max_inuse && !max_inuse_size.compare_exchange_weak(max_inuse, inuse)) {
+    }
+}
+
+Address GuestHeap::alloc(int32_t thread_id, uint32_t size, uint32_t alignment) {
+    alignment = std::max(alignment, MIN_ALIGNMENT);
+    if (!is_power_of_two(alignment))
+        return 0;
+
+    // Every allocation gets its own address, even empty ones
+    size = std::max(size, 1u);
+
+    const int size_class = size_class_for(size, alignment);
+    if (size_class < 0) {
+        const Address address = alloc_large(size, alignment);
+        if (address) {
+            add_inuse(size);
+            ++allocation_count;
+        }
+        return address;
+    }
+
+    auto &blocks = get_thread_cache(thread_id).blocks[size_class];
+    if (blocks.empty()) {
+        refill(size_class, blocks);
+        if (blocks.empty())
+            return 0;
+    }
+
+    const Address address = blocks.back();
+    blocks.pop_back();
+
+    add_inuse(SIZE_CLASSES[size_class]);
+    ++allocation_count;
+
+    return address;
+}
+
+bool GuestHeap::free(int32_t thread_id, Address address) {
+    const int size_class = get_size_class(address);
+    if (size_class < 0) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto it = large_allocations.find(address);
+        if (it == large_allocations.end())
+            return false;
+
+        const uint32_t size = it->second.size;
+        system_size -= it->second.reserved;
+        large_allocations.erase(it);
+
+        add_inuse(-static_cast<int64_t>(size));
+        --allocation_count;
+        return true;
+    }
+
+    auto &blocks = get_thread_cache(thread_id).blocks[size_class];
+    blocks.push_back(address);
+    if (blocks.size() > THREAD_CACHE_SIZE)
+        drain(size_class, blocks, THREAD_CACHE_SIZE - BATCH_SIZE);
+
+    add_inuse(-static_cast<int64_t>(SIZE_CLASSES[size_class]));
+    --allocation_count;
+    return true;
+}
+
+uint32_t GuestHeap::usable_size(Address address) {
+    const int size_class = get_size_class(address);
+    if (size_class >= 0)
+        return SIZE_CLASSES[size_class];
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = large_allocations.find(address);
+    if (it == large_allocations.end())
+        return 0;
+
+    return it->second.size;
+}
+
+Address GuestHeap::realloc(int32_t thread_id, Address address, uint32_t size, uint32_t alignment) {
+    if (!address)
+        return alloc(thread_id, size, alignment);
+
+    const uint32_t old_size = usable_size(address);
+    if (!old_size)
+        return 0;
+
+    // Keep the block when it still fits without wasting more than half of it
+    const bool aligned = !alignment || (address % alignment == 0);
+    if (aligned && (size <= old_size) && (size > old_size / 2))
+        return address;
+
+    const Address new_address = alloc(thread_id, size, alignment);
+    if (!new_address)
+        return 0;
+
+    memcpy(&mem.memory[new_address], &mem.memory[address], std::min(old_size, size));
+    free(thread_id, address);
+
+    return new_address;
+}
+
+void GuestHeap::release_thread_cache(int32_t thread_id) {
+    std::unique_ptr<ThreadCache> cache;
+    {
+        const std::unique_lock<std::shared_mutex> lock(thread_caches_mutex);
+        const auto it = thread_caches.find(thread_id);
+        if (it == thread_caches.end())
+            return;
+
+        cache = std::move(it->second);
+        thread_caches.erase(it);
+    }
+
+    for (size_t size_class = 0; size_class < CLASS_COUNT; size_class++)
+        drain(static_cast<int>(size_class), cache->blocks[size_class], 0);
+}
+
+GuestHeapStats GuestHeap::get_stats() {
+    GuestHeapStats stats;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        stats.system_size = system_size;
+        stats.max_system_size = max_system_size;
+    }
+    stats.inuse_size = inuse_size;
+    stats.max_inuse_size = max_inuse_size;
+    stats.allocation_count = allocation_count;
+
+    return stats;
+}
@@ -0,0 +1,181 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/functions.h>
+#include <mem/heap.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem);
+    EXPECT_TRUE(initialized);
+    return mem;
+}
+
+TEST(guest_heap, small_allocations_share_pages) {
+    MemState &mem = get_mem();
+    GuestHeap heap(mem, "heap test");
+
+    std::set<Address> addresses;
+    for (int i = 0; i < 1000; i++) {
+        const Address address = heap.alloc(1, 16);
+        ASSERT_NE(address, 0u);
+        ASSERT_EQ(address % GuestHeap::MIN_ALIGNMENT, 0u);
+        ASSERT_TRUE(addresses.insert(address).second);
+    }
+
+    // 1000 pages with the page allocator
+    ASSERT_EQ(heap.get_stats().system_size, GuestHeap::SPAN_SIZE);
+    ASSERT_EQ(heap.get_stats().inuse_size, 1000u * 16);
+
+    for (const Address address : addresses)
+        ASSERT_TRUE(heap.free(1, address));
+    ASSERT_EQ(heap.get_stats().inuse_size, 0u);
+    ASSERT_EQ(heap.get_stats().allocation_count, 0u);
+}
+
+TEST(guest_heap, alignment) {
+    MemState &mem = get_mem();
+    GuestHeap heap(mem, "heap test");
+
+    for (uint32_t alignment = 1; alignment <= KiB(64); alignment <<= 1) {
+        const Address address = heap.alloc(1, 24, alignment);
+        ASSERT_NE(address, 0u);
+        ASSERT_EQ(address % alignment, 0u);
+        ASSERT_GE(heap.usable_size(address), 24u);
+    }
+
+    ASSERT_EQ(heap.alloc(1, 24, 24), 0u);
+}
+
+TEST(guest_heap, realloc_keeps_content) {
+    MemState &mem = get_mem();
+    GuestHeap heap(mem, "heap test");
+
+    Address address = heap.alloc(1, 8);
+    for (uint32_t i = 0; i < 8; i++)
+        mem.memory[address + i] = 0x40 + i;
+
+    for (uint32_t size = 16; size <= KiB(32); size *= 2) {
+        address = heap.realloc(1, address, size);
+        ASSERT_NE(address, 0u);
+        ASSERT_GE(heap.usable_size(address), size);
+        for (uint32_t i = 0; i < 8; i++)
+            ASSERT_EQ(mem.memory[address + i], 0x40 + i);
+    }
+
+    ASSERT_TRUE(heap.free(1, address));
+    ASSERT_EQ(heap.get_stats().inuse_size, 0u);
+    ASSERT_EQ(heap.get_stats().allocation_count, 0u);
+}
+
+TEST(guest_heap, threads) {
+    MemState &mem = get_mem();
+    GuestHeap heap(mem, "heap test");
+
+    std::vector<std::thread> threads;
+    for (int32_t thread_id = 1; thread_id <= 4; thread_id++) {
+        threads.emplace_back([&heap, &mem, thread_id] {
+            std::vector<Address> addresses;
+            for (int i = 0; i < 2000; i++) {
+                const Address address = heap.alloc(thread_id, 1 + (i * 7) % 300);
+                ASSERT_NE(address, 0u);
+                mem.memory[address] = static_cast<uint8_t>(thread_id);
+                addresses.push_back(address);
+                if (i % 3 == 0) {
+                    ASSERT_EQ(mem.memory[addresses.front()], thread_id);
+                    ASSERT_TRUE(heap.free(thread_id, addresses.front()));
+                    addresses.erase(addresses.begin());
+                }
+            }
+            for (const Address address : addresses) {
+                ASSERT_EQ(mem.memory[address], thread_id);
+                ASSERT_TRUE(heap.free(thread_id, address));
+            }
+            heap.release_thread_cache(thread_id);
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    ASSERT_EQ(heap.get_stats().inuse_size, 0u);
+    ASSERT_EQ(heap.get_stats().allocation_count, 0u);
+}
+
+// Throughput and footprint of malloc sized requests, against the page allocator SceLibc used before.
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST(guest_heap, DISABLED_benchmark) {
+    constexpr int ALLOCATION_COUNT = 5000;
+
+    MemState &mem = get_mem();
+    std::vector<uint32_t> sizes;
+    for (int i = 0; i < ALLOCATION_COUNT; i++)
+        sizes.push_back(1 + (i * 37) % 300);
+
+    std::vector<Address> addresses(ALLOCATION_COUNT);
+    int failed_allocations = 0;
+    const auto run = [&](int round_count, const auto &alloc_fn, const auto &free_fn) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < round_count; round++) {
+            for (int i = 0; i < ALLOCATION_COUNT; i++) {
+                addresses[i] = alloc_fn(sizes[i]);
+                failed_allocations += !addresses[i];
+            }
+            for (int i = 0; i < ALLOCATION_COUNT; i++) {
+                if (addresses[i])
+                    free_fn(addresses[i]);
+            }
+        }
+        const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+        return time.count() / (round_count * ALLOCATION_COUNT);
+    };
+
+    GuestHeap heap(mem, "heap benchmark");
+    const auto heap_alloc = [&](uint32_t size) {
+        return heap.alloc(1, size);
+    };
+    const auto heap_free = [&](Address address) {
+        heap.free(1, address);
+    };
+    const double heap_time = run(100, heap_alloc, heap_free);
+    const uint64_t heap_footprint = heap.get_stats().max_system_size;
+
+    // Every allocation took whole pages, found by a scan of the page table too slow for many rounds
+    uint64_t page_footprint = 0;
+    for (const uint32_t size : sizes)
+        page_footprint += (size + mem.page_size - 1) / mem.page_size * mem.page_size;
+    const auto page_alloc = [&](uint32_t size) {
+        return alloc(mem, size, "page benchmark");
+    };
+    const auto page_free = [&](Address address) {
+        free(mem, address);
+    };
+    const double page_time = run(1, page_alloc, page_free);
+
+    ASSERT_EQ(failed_allocations, 0);
+
+    std::printf("%d allocations of 1 to 300 bytes: %.1f ns and %llu KiB with the heap, %.1f ns and %llu KiB with the page allocator\n",
+        ALLOCATION_COUNT, heap_time, static_cast<unsigned long long>(heap_footprint / 1024), page_time, static_cast<unsigned long long>(page_footprint / 1024));
+}
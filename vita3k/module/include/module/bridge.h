@@ -29,8 +29,8 @@
 #include <config/functions.h>
 #include <config/state.h>
 #include <emuenv/state.h>
+#include <kernel/state.h>
 
-using ImportFn = std::function<void(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id)>;
 using ImportVarFactory = std::function<Address(EmuEnvState &emuenv)>;
 
 // Function returns a value that is written to CPU registers.
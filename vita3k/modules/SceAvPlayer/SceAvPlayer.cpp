@@ -242,7 +242,7 @@ EXPORT(int32_t, sceAvPlayerAddSource, SceUID player_handle, Ptr<const char> path
 
     const auto thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
 
-    auto file_path = expand_path(emuenv.io, path.get(emuenv.mem), emuenv.pref_path);
+    auto file_path = expand_host_path(emuenv.io, path.get(emuenv.mem), emuenv.pref_path, fs::path(emuenv.base_path) / "cache");
     if (!fs::exists(file_path) && player_info->file_manager.open_file && player_info->file_manager.close_file && player_info->file_manager.read_file && player_info->file_manager.file_size) {
         const auto cache_path{ fs::path(emuenv.base_path) / "cache" };
         if (!fs::exists(cache_path))
@@ -413,8 +413,8 @@ EXPORT(bool, sceAvPlayerGetVideoData, SceUID player_handle, SceAvPlayerFrameInfo
         } else {
             buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), true);
 
-            std::vector<uint8_t> data = player_info->player.receive_video();
-            std::memcpy(buffer.get(emuenv.mem), data.data(), data.size());
+            // the frame was decoded ahead by the player thread, it is copied straight to the guest buffer
+            player_info->player.receive_video(buffer.get(emuenv.mem));
         }
     } else {
         buffer = get_buffer(player_info, MediaType::VIDEO, emuenv.mem, H264DecoderState::buffer_size(size), false);
@@ -461,7 +461,7 @@ EXPORT(bool, sceAvPlayerIsActive, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
 
-    return !player_info->player.video_playing.empty();
+    return player_info->player.is_playing();
 }
 
 EXPORT(int, sceAvPlayerJumpToTime) {
@@ -507,9 +507,7 @@ EXPORT(int, sceAvPlayerSetTrickSpeed) {
 EXPORT(int, sceAvPlayerStart, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, state->mutex);
-    if (!player_info->player.videos_queue.empty()) {
-        player_info->player.pop_video();
-    }
+    player_info->player.pop_video();
     const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_PLAY, 0, Ptr<void>(0));
     return 0;
@@ -518,7 +516,7 @@ EXPORT(int, sceAvPlayerStart, SceUID player_handle) {
 EXPORT(int, sceAvPlayerStop, SceUID player_handle) {
     const auto state = emuenv.kernel.obj_store.get<AvPlayerState>();
     const PlayerPtr &player_info = lock_and_find(player_handle, state->players, emuenv.kernel.mutex);
-    player_info->player.free_video();
+    player_info->player.stop();
     const auto thread = emuenv.kernel.get_thread(thread_id);
     run_event_callback(emuenv, thread, player_info, SCE_AVPLAYER_STATE_STOP, 0, Ptr<void>(0));
     return 0;
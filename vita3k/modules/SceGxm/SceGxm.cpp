@@ -1101,7 +1101,7 @@ struct SceGxmContext {
             int offset = command_allocator.allocate_from(0, size);
 
             if (offset < 0) {
-                new_command = new renderer::Command;
+                new_command = renderer::generic_command_allocate();
                 new_command->flags |= renderer::Command::FLAG_FROM_HOST;
             } else {
                 new_command = reinterpret_cast<renderer::Command *>(alloc_space) + offset;
@@ -1120,7 +1120,7 @@ struct SceGxmContext {
     void free_new_command(renderer::Command *cmd) {
         if (!(cmd->flags & renderer::Command::FLAG_NO_FREE)) {
             if (cmd->flags & renderer::Command::FLAG_FROM_HOST) {
-                delete cmd;
+                renderer::generic_command_free(cmd);
             } else {
                 const std::lock_guard<std::mutex> guard(lock);
 
@@ -1989,6 +1989,10 @@ EXPORT(int, sceGxmDisplayQueueFinish) {
 }
 
 static void gxmSetUniformBuffers(renderer::State &state, GxmState &gxm, SceGxmContext *context, const SceGxmProgram &program, const UniformBuffers &buffers, const UniformBufferSizes &sizes, KernelState &kern, const MemState &mem, const SceUID current_thread) {
+    // Sorted addresses of the UB friends, only needed for the buffers with an unknown size
+    std::array<Address, SCE_GXM_MAX_UNIFORM_BUFFERS> friend_addresses;
+    bool friend_addresses_sorted = false;
+
     for (std::size_t i = 0; i < buffers.size(); i++) {
         if (!buffers[i] || sizes.at(i) == 0) {
             continue;
@@ -2002,15 +2006,17 @@ static void gxmSetUniformBuffers(renderer::State &state, GxmState &gxm, SceGxmCo
                 bytes_to_copy = std::min<std::uint32_t>(ite->first + ite->second.size - buffers[i].address(), bytes_to_copy);
             }
 
-            // Check other UB friends and bound the size
-            for (std::size_t j = 0; j < SCE_GXM_MAX_UNIFORM_BUFFERS; j++) {
-                if (i == j) {
-                    continue;
-                }
+            // Bound the size with the closest UB friend after this one
+            if (!friend_addresses_sorted) {
+                for (std::size_t j = 0; j < SCE_GXM_MAX_UNIFORM_BUFFERS; j++)
+                    friend_addresses[j] = buffers[j].address();
+                std::sort(friend_addresses.begin(), friend_addresses.end());
+                friend_addresses_sorted = true;
+            }
 
-                if (buffers[j].address() > buffers[i].address()) {
-                    bytes_to_copy = std::min<std::uint32_t>(buffers[j].address() - buffers[i].address(), bytes_to_copy);
-                }
+            const auto next_friend = std::upper_bound(friend_addresses.begin(), friend_addresses.end(), buffers[i].address());
+            if (next_friend != friend_addresses.end()) {
+                bytes_to_copy = std::min<std::uint32_t>(*next_friend - buffers[i].address(), bytes_to_copy);
             }
         }
         renderer::set_uniform_buffer(state, context->renderer.get(), !program.is_fragment(), i, bytes_to_copy, buffers[i]);
@@ -2074,14 +2080,7 @@ static int gxmDrawElementGeneral(EmuEnvState &emuenv, const char *export_name, c
 
     // Update vertex data. We should stores a copy of the data to pass it to GPU later, since another scene
     // may start to overwrite stuff when this scene is being processed in our queue (in case of OpenGL).
-    size_t max_index = 0;
-    if (indexType == SCE_GXM_INDEX_FORMAT_U16) {
-        const uint16_t *const data = static_cast<const uint16_t *>(indexData);
-        max_index = *std::max_element(&data[0], &data[indexCount]);
-    } else {
-        const uint32_t *const data = static_cast<const uint32_t *>(indexData);
-        max_index = *std::max_element(&data[0], &data[indexCount]);
-    }
+    const size_t max_index = gxm::get_max_index(indexType, indexData, indexCount);
 
     size_t max_data_length[SCE_GXM_MAX_VERTEX_STREAMS] = {};
     std::uint32_t stream_used = 0;
@@ -2175,14 +2174,7 @@ EXPORT(int, sceGxmDrawPrecomputed, SceGxmContext *context, SceGxmPrecomputedDraw
 
     // Update vertex data. We should stores a copy of the data to pass it to GPU later, since another scene
     // may start to overwrite stuff when this scene is being processed in our queue (in case of OpenGL).
-    size_t max_index = 0;
-    if (draw->index_format == SCE_GXM_INDEX_FORMAT_U16) {
-        const uint16_t *const data = draw->index_data.cast<const uint16_t>().get(emuenv.mem);
-        max_index = *std::max_element(&data[0], &data[draw->vertex_count]);
-    } else {
-        const uint32_t *const data = draw->index_data.cast<const uint32_t>().get(emuenv.mem);
-        max_index = *std::max_element(&data[0], &data[draw->vertex_count]);
-    }
+    const size_t max_index = gxm::get_max_index(draw->index_format, draw->index_data.get(emuenv.mem), draw->vertex_count);
 
     // set all textures that are used and mark them as dirty
     const gxp::TextureInfo vert_textures_sync = vertex_program->renderer_data->textures_used;
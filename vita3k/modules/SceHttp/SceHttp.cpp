@@ -17,17 +17,7 @@
 
 #include "SceHttp.h"
 
-#ifdef WIN32 // windows moment
-#include <io.h>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#define write(x, y, z) _write(x, y, z)
-#define read(x, y, z) _read(x, y, z)
-#else
-#include <netdb.h>
-#include <sys/socket.h>
-#endif
-
+#include <http/client.h>
 #include <http/state.h>
 
 #include <openssl/err.h>
@@ -36,8 +26,9 @@
 #include <util/net_utils.h>
 #include <util/tracy.h>
 
+#include <chrono>
+#include <future>
 #include <string>
-#include <thread>
 
 TRACY_MODULE_NAME(SceHttp);
 
@@ -111,9 +102,101 @@ std::string to_debug_str<SceHttpsFlags>(const MemState &mem, SceHttpsFlags type)
     return out;
 }
 
-EXPORT(int, sceHttpAbortRequest) {
-    TRACY_FUNC(sceHttpAbortRequest);
-    return UNIMPLEMENTED();
+// Most idle keep-alive connections kept per server and template
+static constexpr size_t MAX_IDLE_TRANSPORTS = 4;
+
+static std::string transport_key(const SceConnection &conn) {
+    return conn.hostname + ":" + conn.port + (conn.isSecure ? "s" : "");
+}
+
+// Runs on its own thread, the exchange is not touched by the emulator until it returns
+static int run_exchange(HttpExchange &exchange) {
+    while (true) {
+        if (!exchange.transport.is_open()) {
+            exchange.reusedTransport = false;
+            if (const int error = http::open_transport(exchange.transport, exchange.hostname, exchange.port, exchange.sslCtx, exchange.options))
+                return error;
+        }
+
+        const int ret = http::exchange(exchange.transport, exchange.message, exchange.body.data(), exchange.body.size(), exchange.parser, exchange.options);
+
+        // The server can close an idle keep-alive connection at any time, try again on a new one if it did
+        const bool retry = ret == static_cast<int>(SCE_HTTP_ERROR_NETWORK) || ret == static_cast<int>(SCE_HTTP_ERROR_SSL);
+        if (retry && exchange.reusedTransport && exchange.parser.bytes_received == 0) {
+            LOG_TRACE("Keep-alive connection to {}:{} was closed, reconnecting", exchange.hostname, exchange.port);
+            http::close_transport(exchange.transport);
+            exchange.parser = http::ResponseParser(exchange.parser.is_head_request, exchange.parser.max_header_size);
+            continue;
+        }
+
+        return ret;
+    }
+}
+
+static bool is_request_pending(const SceRequest &req) {
+    return req.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+// Waits for the request to be sent, gives the connection back and stores the response
+static int finish_request(HTTPState &http, SceRequest &req) {
+    const int ret = req.pending.get();
+    const std::shared_ptr<HttpExchange> exchange = std::move(req.exchange);
+    const http::ResponseParser &parser = exchange->parser;
+
+    const auto conn = http.connections.find(req.connId);
+    const bool keep_alive = ret == 0 && parser.keep_alive && conn != http.connections.end() && conn->second.keepAlive;
+    if (conn != http.connections.end())
+        conn->second.busy = false;
+    if (keep_alive)
+        conn->second.transport = exchange->transport;
+    else
+        http::close_transport(exchange->transport);
+
+    if (ret != 0)
+        return ret;
+
+    LOG_TRACE("Received {} response with {} bytes of body from {}", parser.status_code, parser.body.size(), req.url);
+
+    SceRequestResponse &res = req.res;
+    delete[] res.responseRaw;
+    res = {};
+    res.responseRaw = new char[parser.body.size() + 1];
+    memcpy(res.responseRaw, parser.body.data(), parser.body.size());
+    res.responseRaw[parser.body.size()] = '\0';
+    res.body = res.responseRaw;
+
+    net_utils::parseResponse(parser.header_block, res);
+    // The body may be chunked or read until the connection ends, its size is what was received
+    res.contentLength = parser.body.size();
+
+    return 0;
+}
+
+// Completes the request sent before, returns SCE_HTTP_ERROR_EAGAIN if it is still being sent in non-blocking mode
+static int sync_request(HTTPState &http, SceRequest &req) {
+    if (!req.exchange)
+        return 0;
+
+    if (req.nonblock && is_request_pending(req))
+        return SCE_HTTP_ERROR_EAGAIN;
+
+    return finish_request(http, req);
+}
+
+EXPORT(SceInt, sceHttpAbortRequest, SceInt reqId) {
+    TRACY_FUNC(sceHttpAbortRequest, reqId);
+    if (!emuenv.http.inited)
+        return RET_ERROR(SCE_HTTP_ERROR_BEFORE_INIT);
+
+    const auto req = emuenv.http.requests.find(reqId);
+    if (req == emuenv.http.requests.end())
+        return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
+
+    // The send fails with SCE_HTTP_ERROR_ABORTED as soon as the thread sending it sees it
+    if (req->second.exchange)
+        req->second.exchange->abort = true;
+
+    return 0;
 }
 
 EXPORT(int, sceHttpAbortRequestForce) {
@@ -203,8 +286,8 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
 
     auto tmpl = emuenv.http.templates.find(tmplId);
 
-    int connId = emuenv.http.next_conn;
-    emuenv.http.next_conn++;
+    int connId = emuenv.http.next_id;
+    emuenv.http.next_id++;
 
     net_utils::parsedUrl parsed;
     auto parseRet = net_utils::parse_url(url, parsed);
@@ -239,63 +322,34 @@ EXPORT(SceInt, sceHttpCreateConnectionWithURL, SceInt tmplId, const char *url, S
         port = parsed.port;
     // If fifth character is an s (meaning https) use 443, else 80
 
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    assert(sockfd);
-    if (sockfd < 0) {
-        LOG_ERROR("ERROR opening socket");
-        return RET_ERROR(SCE_HTTP_ERROR_UNKNOWN);
+    if (emuenv.cfg.http_enable && isSecure && !emuenv.http.sslInited) {
+        LOG_ERROR("SSL not inited on secure connection");
+        return RET_ERROR(SCE_HTTP_ERROR_SSL);
     }
 
-    if (!emuenv.cfg.http_enable) {
-        // Need to push the connection here so the id exists when "sending" the request
-        emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
-        return 0;
-    }
-
-    const addrinfo hints = {
-        AI_PASSIVE, /* For wildcard IP address */
-        AF_UNSPEC, /* Allow IPv4 or IPv6 */
-        SOCK_DGRAM, /* Datagram socket */
-        0, /* Any protocol */
-    };
-    addrinfo *result = { 0 };
-
-    auto ret = getaddrinfo(parsed.hostname.c_str(), port.c_str(), &hints, &result);
-    if (ret < 0) {
-        LOG_ERROR("getaddrinfo({},{},...) = {}", url, port, ret);
-        return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENODNS);
-    }
-
-    ret = connect(sockfd, result->ai_addr, result->ai_addrlen);
-    if (ret < 0) {
-        LOG_ERROR("connect({},...) = {}, errno={}({})", sockfd, ret, errno, strerror(errno));
-        return RET_ERROR(SCE_HTTP_ERROR_RESOLVER_ENOHOST);
-    }
-
-    LOG_TRACE("Connected to {}", url);
-
-    if (isSecure) {
-        if (!emuenv.http.sslInited) {
-            LOG_ERROR("SSL not inited on secure connection");
-            return RET_ERROR(SCE_HTTP_ERROR_SSL);
-        }
-
-        SSL_set_fd((SSL *)tmpl->second.ssl, sockfd);
-
-        int err = SSL_connect((SSL *)tmpl->second.ssl);
-        if (err != 1) {
-            int sslErr = SSL_get_error((SSL *)tmpl->second.ssl, err);
-            LOG_ERROR("SSL_connect(...) = {}, SSLERR = {}", err, sslErr);
-            if (sslErr == SSL_ERROR_SSL)
-                return RET_ERROR(SCE_HTTP_ERROR_UNKNOWN);
+    SceConnection conn;
+    conn.tmplId = tmplId;
+    conn.url = urlStr;
+    conn.keepAlive = enableKeepalive;
+    conn.isSecure = isSecure;
+    conn.hostname = parsed.hostname;
+    conn.port = port;
+    conn.nonblock = tmpl->second.nonblock;
+
+    // Reuse a connection to the same server left open by a deleted one, otherwise it is opened when sending the first request
+    auto &idle = tmpl->second.idleTransports;
+    auto [idle_it, idle_end] = idle.equal_range(transport_key(conn));
+    while (idle_it != idle_end) {
+        http::Transport transport = idle_it->second;
+        idle_it = idle.erase(idle_it);
+        if (http::is_transport_alive(transport)) {
+            conn.transport = transport;
+            break;
         }
-
-        long verify_flag = SSL_get_verify_result((SSL *)tmpl->second.ssl);
-        if (verify_flag != X509_V_OK && verify_flag != X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY)
-            LOG_ERROR("Certificate verification error ({}) but continuing...\n", (int)verify_flag);
+        http::close_transport(transport);
     }
 
-    emuenv.http.connections.emplace(connId, SceConnection{ tmplId, urlStr, enableKeepalive, isSecure, sockfd });
+    emuenv.http.connections.emplace(connId, std::move(conn));
 
     return connId;
 }
@@ -355,8 +409,8 @@ EXPORT(SceInt, sceHttpCreateRequestWithURL, SceInt connId, SceHttpMethods method
     if (conn->second.url != urlStr)
         LOG_WARN("URL != Connection URL");
 
-    int reqId = emuenv.http.next_req;
-    emuenv.http.next_req++;
+    int reqId = emuenv.http.next_id;
+    emuenv.http.next_id++;
 
     std::string httpVer = tmpl->second.httpVersion == SCE_HTTP_VERSION_1_0 ? "HTTP/1.0" : "HTTP/1.1";
 
@@ -433,8 +487,9 @@ EXPORT(SceInt, sceHttpCreateRequestWithURL, SceInt connId, SceHttpMethods method
     }
 
     req.requestLine = methodStr + " " + resourcePath + " " + httpVer;
+    req.nonblock = conn->second.nonblock;
 
-    emuenv.http.requests.emplace(reqId, req);
+    emuenv.http.requests.emplace(reqId, std::move(req));
 
     return reqId;
 }
@@ -505,8 +560,8 @@ EXPORT(SceInt, sceHttpCreateTemplate, const char *userAgent, SceHttpVersion http
     if (httpVer != SceHttpVersion::SCE_HTTP_VERSION_1_0 && httpVer != SceHttpVersion::SCE_HTTP_VERSION_1_1)
         return RET_ERROR(SCE_HTTP_ERROR_INVALID_VERSION);
 
-    SceInt tmplId = emuenv.http.next_temp;
-    emuenv.http.next_temp++;
+    SceInt tmplId = emuenv.http.next_id;
+    emuenv.http.next_id++;
 
     void *ssl_ctx = nullptr;
     if (emuenv.http.sslInited)
@@ -532,8 +587,17 @@ EXPORT(SceInt, sceHttpDeleteConnection, SceInt connId) {
         return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
 
     auto connIt = emuenv.http.connections.find(connId);
-
-    close(connIt->second.sockfd);
+    SceConnection &conn = connIt->second;
+
+    // Keep the connection open for the next ones to the same server
+    if (conn.transport.is_open()) {
+        const auto tmpl = emuenv.http.templates.find(conn.tmplId);
+        const std::string key = transport_key(conn);
+        if (conn.keepAlive && tmpl != emuenv.http.templates.end() && tmpl->second.idleTransports.count(key) < MAX_IDLE_TRANSPORTS)
+            tmpl->second.idleTransports.emplace(key, conn.transport);
+        else
+            http::close_transport(conn.transport);
+    }
 
     emuenv.http.connections.erase(connIt);
 
@@ -549,6 +613,10 @@ EXPORT(SceInt, sceHttpDeleteRequest, SceInt reqId) {
         return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
 
     auto it = emuenv.http.requests.find(reqId);
+    if (it->second.exchange) {
+        it->second.exchange->abort = true;
+        finish_request(emuenv.http, it->second);
+    }
     if (it->second.res.responseRaw)
         delete[] it->second.res.responseRaw;
     for (auto &pointer : it->second.guestPointers) {
@@ -569,6 +637,9 @@ EXPORT(SceInt, sceHttpDeleteTemplate, SceInt tmplId) {
 
     auto it = emuenv.http.templates.find(tmplId);
 
+    for (auto &[key, transport] : it->second.idleTransports)
+        http::close_transport(transport);
+
     SSL_free((SSL *)it->second.ssl);
 
     emuenv.http.templates.erase(it);
@@ -596,6 +667,12 @@ EXPORT(SceInt, sceHttpGetAllResponseHeaders, SceInt reqId, Ptr<char> *header, Sc
 
     auto req = emuenv.http.requests.find(reqId);
 
+    const int ret = sync_request(emuenv.http, req->second);
+    if (ret == static_cast<int>(SCE_HTTP_ERROR_EAGAIN))
+        return ret;
+    if (ret != 0)
+        return RET_ERROR(ret);
+
     auto headers = net_utils::constructHeaders(req->second.res.headers);
 
     // is alloc name ok?
@@ -688,6 +765,12 @@ EXPORT(SceInt, sceHttpGetResponseContentLength, SceInt reqId, SceULong64 *conten
 
     auto req = emuenv.http.requests.find(reqId);
 
+    const int ret = sync_request(emuenv.http, req->second);
+    if (ret == static_cast<int>(SCE_HTTP_ERROR_EAGAIN))
+        return ret;
+    if (ret != 0)
+        return RET_ERROR(ret);
+
     auto length_it = req->second.res.headers.find("Content-Length");
     if (length_it == req->second.res.headers.end())
         return RET_ERROR(SCE_HTTP_ERROR_NO_CONTENT_LENGTH);
@@ -710,6 +793,12 @@ EXPORT(SceInt, sceHttpGetStatusCode, SceInt reqId, SceInt *statusCode) {
 
     auto req = emuenv.http.requests.find(reqId);
 
+    const int ret = sync_request(emuenv.http, req->second);
+    if (ret == static_cast<int>(SCE_HTTP_ERROR_EAGAIN))
+        return ret;
+    if (ret != 0)
+        return RET_ERROR(ret);
+
     *statusCode = req->second.res.statusCode;
     return 0;
 }
@@ -829,30 +918,31 @@ EXPORT(SceInt, sceHttpReadData, SceInt reqId, void *data, SceSize size) {
 
     auto req = emuenv.http.requests.find(reqId);
 
+    const int ret = sync_request(emuenv.http, req->second);
+    if (ret == static_cast<int>(SCE_HTTP_ERROR_EAGAIN))
+        return ret;
+    if (ret != 0)
+        return RET_ERROR(ret);
+
     // These methods have no body
     if (req->second.method == SCE_HTTP_METHOD_HEAD || req->second.method == SCE_HTTP_METHOD_OPTIONS)
         return 0;
 
-    auto conn = emuenv.http.connections.find(req->second.connId);
-    auto tmpl = emuenv.http.templates.find(conn->second.tmplId);
-
-    SceSize read = 0;
-
     // If the game wants to read more than whats available, change the read ammount to what is available
     if (size > (req->second.res.contentLength - req->second.res.responseRead)) {
         size = req->second.res.contentLength - req->second.res.responseRead;
     }
 
-    if (req->second.res.responseRead == req->second.res.contentLength) {
+    if (size == 0) {
         // If we already have read all the response.
         return 0;
     }
 
     memcpy(data, req->second.res.body + req->second.res.responseRead, size);
 
-    req->second.res.responseRead += read;
+    req->second.res.responseRead += size;
 
-    return read;
+    return size;
 }
 
 EXPORT(int, sceHttpRedirectCacheFlush) {
@@ -910,185 +1000,77 @@ EXPORT(SceInt, sceHttpSendRequest, SceInt reqId, const char *postData, SceSize s
         return 0;
 
     auto req = emuenv.http.requests.find(reqId);
-    auto conn = emuenv.http.connections.find(req->second.connId);
-    auto tmpl = emuenv.http.templates.find(conn->second.tmplId);
 
-    LOG_DEBUG("Sending {} request to {}", net_utils::int_method_to_char(req->second.method), req->second.url);
+    // A non-blocking request which was already sent is checked again until it is done
+    if (!req->second.exchange) {
+        auto conn = emuenv.http.connections.find(req->second.connId);
+        if (conn == emuenv.http.connections.end())
+            return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
 
-    // TODO: Also support file scheme, doesn't really require any connections, not sure how it handles headers and such
-
-    /* TODO:
-        TRACE
-        CONNECT
-     */
-    int bytes, sent, received, total;
-    switch (req->second.method) {
-    case SCE_HTTP_METHOD_GET:
-    case SCE_HTTP_METHOD_HEAD:
-    case SCE_HTTP_METHOD_OPTIONS:
-    case SCE_HTTP_METHOD_DELETE: {
-        auto headers = net_utils::constructHeaders(req->second.headers);
+        auto tmpl = emuenv.http.templates.find(conn->second.tmplId);
+        if (conn->second.isSecure && tmpl == emuenv.http.templates.end())
+            return RET_ERROR(SCE_HTTP_ERROR_SSL);
 
-        req->second.message = req->second.requestLine + "\r\n" + headers + "\r\n";
+        // Only one request at a time can use a connection
+        if (conn->second.busy)
+            return RET_ERROR(SCE_HTTP_ERROR_BUSY);
 
-        total = req->second.message.length();
-        sent = 0;
-        do {
-            if (conn->second.isSecure)
-                bytes = SSL_write((SSL *)tmpl->second.ssl, req->second.message.c_str() + sent, total - sent);
-            else
-                bytes = write(conn->second.sockfd, req->second.message.c_str() + sent, total - sent);
-
-            if (bytes < 0) {
-                LOG_ERROR("ERROR writing GET message to socket");
-                assert(false);
-                return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-            }
-            LOG_TRACE("Sent {} bytes to {}", bytes, req->second.url);
-            if (bytes == 0)
-                break;
-            sent += bytes;
-        } while (sent < total);
-
-        // Make sockets non blocking only for the response
-        // as we can run out of data to read so it blocks like a whole minute
-        if (!net_utils::socketSetBlocking(conn->second.sockfd, false)) {
-            LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, false);
-            assert(false);
+        if (req->second.method < 0 || req->second.method >= SCE_HTTP_METHOD_INVALID) { // Outside any known method
+            LOG_ERROR("Invalid method {}", req->second.method);
+            return RET_ERROR(SCE_HTTP_ERROR_UNKNOWN_METHOD);
         }
 
-        /* receive the response */
-        int attempts = 1;
-        auto reqResponse = new char[emuenv.http.defaultResponseHeaderSize]();
-        total = emuenv.http.defaultResponseHeaderSize - 1;
-        received = 0;
-        do {
-            if (conn->second.isSecure)
-                bytes = SSL_read((SSL *)tmpl->second.ssl, reqResponse + received, total - received);
-            else
-                bytes = read(conn->second.sockfd, reqResponse + received, total - received);
-            if (bytes < 0) {
-                if (bytes == -1) {
-                    if (errno == EWOULDBLOCK) {
-                        if (attempts > emuenv.cfg.http_read_end_attempts)
-                            break; // we can assume there is no more data to read
-                        LOG_TRACE("No data available. Sleep for {}. Attempt {}", emuenv.cfg.http_read_end_sleep_ms, attempts);
-                        std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_read_end_sleep_ms));
-                        attempts++;
-                        continue;
-                    } else {
-                        LOG_ERROR("ERROR reading GET response");
-                        assert(false);
-                        delete[] reqResponse;
-                        return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-                    }
-                }
-            }
-            LOG_TRACE("Received {} bytes from {}", bytes, req->second.url);
-            if (bytes == 0) {
-                if (strcmp(reqResponse, "") == 0) {
-                    if (attempts > emuenv.cfg.http_timeout_attempts)
-                        break; // Give up
-                    LOG_TRACE("Response is null. Sleep for {}. Attempt {}", emuenv.cfg.http_timeout_sleep_ms, attempts);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_timeout_sleep_ms));
-                    attempts++;
-                    continue;
-                }
-                break; // we have  2 line ends, meaning that its the end of the headers
-            }
-
-            received += bytes;
-        } while (received < total);
-
-        LOG_TRACE("Finished reading data");
+        // TODO: Also support file scheme, doesn't really require any connections, not sure how it handles headers and such
 
-        if (!net_utils::socketSetBlocking(conn->second.sockfd, true)) {
-            LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, true);
-            assert(false);
-        }
-        /*
-         * if the number of received bytes is the total size of the
-         * array then we have run out of space to store the response
-         * and it hasn't all arrived yet - so that's a BAD thing
+        /* TODO:
+            TRACE
+            CONNECT
          */
-        if (received == total) {
-            LOG_ERROR("ERROR storing complete GET response");
-            assert(false);
-            delete[] reqResponse;
-            return RET_ERROR(SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER);
-        }
-
-        if (strcmp(reqResponse, "") == 0) {
-            LOG_ERROR("Received empty GET response. Probably due to unknown protocol");
-            assert(false);
-            delete[] reqResponse;
-            return RET_ERROR(SCE_HTTP_ERROR_BAD_RESPONSE);
+        if (req->second.method == SCE_HTTP_METHOD_TRACE || req->second.method == SCE_HTTP_METHOD_CONNECT) {
+            LOG_WARN("Unimplemented method {}, report to devs", req->second.method);
+            return 0;
         }
 
-        // we need to separate the body and the headers
-        std::string reqResponseHeaders;
-        std::string reqResponseStr = std::string(reqResponse);
-        auto headerEndPos = reqResponseStr.find("\r\n\r\n");
-        char *ptr;
-        ptr = strtok(reqResponseStr.data(), "\r\n");
-        // use while loop to check ptr is not null
-        while (ptr != nullptr) {
-            reqResponseHeaders.append(ptr);
-            reqResponseHeaders.append("\r\n");
-
-            auto headerLen = reqResponseHeaders.length();
-            // -2 because its the length of the remaining \r\n on the last header
-            if (headerLen - 2 == headerEndPos)
-                break;
-
-            ptr = strtok(NULL, "\r\n");
-        };
-
-        req->second.res.responseRaw = reqResponse;
-        req->second.res.body = reqResponse + reqResponseHeaders.length() + 2;
-
-        // partialResponse is now the contents of the headers, we should parse them
-        net_utils::parseResponse(reqResponseHeaders, req->second.res);
-
-        break;
-    }
-    // PUT and POST are equal
-    case SCE_HTTP_METHOD_PUT:
-    case SCE_HTTP_METHOD_POST: {
-        // If there is a length header, use that header as length
-        // else
-        // size and predefined length are equal?
-        // if they are then we ok, use that
-        // else use the predefined one
-
-        // Priority: Header > Predefined > size
-
-        if (req->second.headers.find("Content-Length") != req->second.headers.end()) {
-            // There is a content length header, probably by the game, use it
-            auto contHeader = req->second.headers.find("Content-Length");
-            SceSize contLen = std::stoi(contHeader->second);
-
-            // Its ok to have the content length be less or equal than size,
-            // but not the other way around. It would be sending undefined data leading to undefined behavior
-            if (contLen > size)
-                LOG_WARN("POST/PUT request Header: ContentLength > size.");
-
-            // Set size to contLen to not send extra stuff the server will ignore
-            size = contLen;
-        } else {
-            // No Content-Length header
-
-            // if size and predefined aren't equal, we will use predefined
-            if (req->second.contentLength != size) {
-                LOG_WARN("POST/PUT request Header: predefined != size.");
-                size = req->second.contentLength;
-            }
+        LOG_DEBUG("Sending {} request to {}", net_utils::int_method_to_char(req->second.method), req->second.url);
+
+        // PUT and POST are equal
+        const bool has_body = req->second.method == SCE_HTTP_METHOD_PUT || req->second.method == SCE_HTTP_METHOD_POST;
+        if (has_body) {
+            // If there is a length header, use that header as length
+            // else
+            // size and predefined length are equal?
+            // if they are then we ok, use that
+            // else use the predefined one
+
+            // Priority: Header > Predefined > size
+
+            if (req->second.headers.find("Content-Length") != req->second.headers.end()) {
+                // There is a content length header, probably by the game, use it
+                auto contHeader = req->second.headers.find("Content-Length");
+                SceSize contLen = std::stoi(contHeader->second);
+
+                // Its ok to have the content length be less or equal than size,
+                // but not the other way around. It would be sending undefined data leading to undefined behavior
+                if (contLen > size)
+                    LOG_WARN("POST/PUT request Header: ContentLength > size.");
+
+                // Set size to contLen to not send extra stuff the server will ignore
+                size = std::min(size, contLen);
+            } else {
+                // No Content-Length header
+
+                // if size and predefined aren't equal, we will use predefined
+                if (req->second.contentLength != size) {
+                    LOG_WARN("POST/PUT request Header: predefined != size.");
+                    size = req->second.contentLength;
+                }
 
-            auto contLen = std::to_string(size);
-            auto ret = CALL_EXPORT(sceHttpAddRequestHeader, reqId, "Content-Length", contLen.c_str(), SCE_HTTP_HEADER_ADD);
-            if (ret < 0) {
-                LOG_WARN("huh?");
-                assert(false);
+                auto contLen = std::to_string(size);
+                auto ret = CALL_EXPORT(sceHttpAddRequestHeader, reqId, "Content-Length", contLen.c_str(), SCE_HTTP_HEADER_ADD);
+                if (ret < 0) {
+                    LOG_WARN("huh?");
+                    assert(false);
+                }
             }
         }
 
@@ -1096,152 +1078,37 @@ EXPORT(SceInt, sceHttpSendRequest, SceInt reqId, const char *postData, SceSize s
 
         req->second.message = req->second.requestLine + "\r\n" + headers + "\r\n";
 
-        total = req->second.message.length();
-        sent = 0;
-        do {
-            if (conn->second.isSecure)
-                bytes = SSL_write((SSL *)tmpl->second.ssl, req->second.message.c_str() + sent, total - sent);
-            else
-                bytes = write(conn->second.sockfd, req->second.message.c_str() + sent, total - sent);
-
-            if (bytes < 0) {
-                LOG_ERROR("ERROR writing POST message to socket");
-                assert(false);
-                return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-            }
-            LOG_TRACE("Sent {} bytes to {}", bytes, req->second.url);
-            if (bytes == 0)
-                break;
-            sent += bytes;
-        } while (sent < total);
-
-        //  Once we send the request we need to send the actual data
-        auto dataSent = 0;
-        auto dataBytes = 0;
-        do {
-            if (conn->second.isSecure)
-                dataBytes = SSL_write((SSL *)tmpl->second.ssl, postData + dataSent, size - dataSent);
-            else
-                dataBytes = write(conn->second.sockfd, postData + dataSent, size - dataSent);
-
-            if (dataBytes < 0) {
-                LOG_ERROR("ERROR writing POST data to socket");
-                assert(false);
-                return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-            }
-            LOG_TRACE("Sent {} data bytes to {}", dataBytes, req->second.url);
-            if (dataBytes == 0)
-                break;
-            dataSent += dataBytes;
-        } while (dataSent < size);
-
-        if (!net_utils::socketSetBlocking(conn->second.sockfd, false)) {
-            LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, false);
-            assert(false);
-        }
-        /* receive the response */
-        int attempts = 1;
-        auto reqResponse = new char[emuenv.http.defaultResponseHeaderSize]();
-        total = emuenv.http.defaultResponseHeaderSize - 1;
-        received = 0;
-        do {
-            if (conn->second.isSecure)
-                bytes = SSL_read((SSL *)tmpl->second.ssl, reqResponse + received, total - received);
-            else
-                bytes = read(conn->second.sockfd, reqResponse + received, total - received);
-            if (bytes < 0) {
-                if (bytes == -1) {
-                    if (errno == EWOULDBLOCK) {
-                        if (attempts > emuenv.cfg.http_read_end_attempts)
-                            break; // we can assume there is no more data to read
-                        LOG_TRACE("No data available. Sleep for {}. Attempt {}", emuenv.cfg.http_read_end_sleep_ms, attempts);
-                        std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_read_end_sleep_ms));
-                        attempts++;
-                        continue;
-                    } else {
-                        LOG_ERROR("ERROR reading POST response");
-                        assert(false);
-                        delete[] reqResponse;
-                        return RET_ERROR(SCE_HTTP_ERROR_NETWORK);
-                    }
-                }
-            }
-            LOG_TRACE("Received {} bytes from {}", bytes, req->second.url);
-            if (bytes == 0) {
-                if (strcmp(reqResponse, "") == 0) {
-                    if (attempts > emuenv.cfg.http_timeout_attempts)
-                        break; // Give up
-                    LOG_TRACE("Response is null. Sleep for {}. Attempt {}", emuenv.cfg.http_timeout_sleep_ms, attempts);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(emuenv.cfg.http_timeout_sleep_ms));
-                    attempts++;
-                    continue;
-                }
-                break; // we have  2 line ends, meaning that its the end of the headers
-            }
-            received += bytes;
-        } while (received < total);
-
-        LOG_TRACE("Finished reading data");
-
-        if (!net_utils::socketSetBlocking(conn->second.sockfd, true)) {
-            LOG_WARN("Failed to change blocking, socket={}, blocking={}", conn->second.sockfd, true);
-            assert(false);
-        }
-
-        /*
-         * if the number of received bytes is the total size of the
-         * array then we have run out of space to store the response
-         * and it hasn't all arrived yet - so that's a BAD thing
-         */
-        if (received == total) {
-            LOG_ERROR("ERROR storing complete POST response from socket");
-            assert(false);
-            delete[] reqResponse;
-            return RET_ERROR(SCE_HTTP_ERROR_TOO_LARGE_RESPONSE_HEADER);
-        }
-
-        if (strcmp(reqResponse, "") == 0) {
-            LOG_ERROR("Received empty GET response");
-            assert(false);
-            delete[] reqResponse;
-            return RET_ERROR(SCE_HTTP_ERROR_BAD_RESPONSE);
-        }
-
-        // we need to separate the body and the headers
-        std::string reqResponseHeaders;
-        std::string reqResponseStr = std::string(reqResponse);
-        auto headerEndPos = reqResponseStr.find("\r\n\r\n");
-        char *ptr;
-        ptr = strtok(reqResponseStr.data(), "\r\n");
-        // use while loop to check ptr is not null
-        while (ptr != NULL) {
-            reqResponseHeaders.append(ptr);
-            reqResponseHeaders.append("\r\n");
-
-            auto headerLen = reqResponseHeaders.length();
-            // -2 because its the length of the remaining \r\n on the last header
-            if (headerLen - 2 == headerEndPos)
-                break;
-
-            ptr = strtok(NULL, "\r\n");
-        };
-
-        req->second.res.responseRaw = reqResponse;
-        req->second.res.body = reqResponse + reqResponseHeaders.length() + 2;
-
-        // partialResponse is now the contents of the headers, we should parse them
-        net_utils::parseResponse(reqResponseHeaders, req->second.res);
-
-        break;
-    }
-    default: {
-        if (req->second.method < 0 || req->second.method >= SCE_HTTP_METHOD_INVALID) { // Outside any known method
-            LOG_ERROR("Invalid method {}", req->second.method);
-            return RET_ERROR(SCE_HTTP_ERROR_UNKNOWN_METHOD);
-        } else { // its a known method but its not implemented
-            LOG_WARN("Unimplemented method {}, report to devs", req->second.method);
-        }
+        auto exchange = std::make_shared<HttpExchange>();
+        exchange->hostname = conn->second.hostname;
+        exchange->port = conn->second.port;
+        if (conn->second.isSecure)
+            exchange->sslCtx = SSL_get_SSL_CTX((SSL *)tmpl->second.ssl);
+        exchange->message = req->second.message;
+        if (has_body && postData)
+            exchange->body.assign(postData, postData + size);
+        exchange->parser = http::ResponseParser(req->second.method == SCE_HTTP_METHOD_HEAD, emuenv.http.defaultResponseHeaderSize);
+        // Same total time as the attempts the configuration allows
+        exchange->options.timeout_ms = emuenv.cfg.http_timeout_attempts * emuenv.cfg.http_timeout_sleep_ms;
+        exchange->options.abort = &exchange->abort;
+
+        // The request has the connection until it is done
+        exchange->transport = conn->second.transport;
+        exchange->reusedTransport = conn->second.transport.is_open();
+        conn->second.transport = {};
+        conn->second.busy = true;
+
+        req->second.exchange = exchange;
+        req->second.pending = std::async(std::launch::async, [exchange]() {
+            return run_exchange(*exchange);
+        });
     }
+
+    const int ret = sync_request(emuenv.http, req->second);
+    if (ret == static_cast<int>(SCE_HTTP_ERROR_EAGAIN))
+        return ret;
+    if (ret != 0) {
+        LOG_ERROR("Sending request to {} failed", req->second.url);
+        return RET_ERROR(ret);
     }
 
     return 0;
@@ -1332,9 +1199,22 @@ EXPORT(int, sceHttpSetInflateGZIPEnabled) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceHttpSetNonblock) {
-    TRACY_FUNC(sceHttpSetNonblock);
-    return UNIMPLEMENTED();
+EXPORT(SceInt, sceHttpSetNonblock, SceInt id, SceBool enable) {
+    TRACY_FUNC(sceHttpSetNonblock, id, enable);
+    if (!emuenv.http.inited)
+        return RET_ERROR(SCE_HTTP_ERROR_BEFORE_INIT);
+
+    // The connections and requests created after inherit the setting
+    if (auto req = emuenv.http.requests.find(id); req != emuenv.http.requests.end())
+        req->second.nonblock = enable;
+    else if (auto conn = emuenv.http.connections.find(id); conn != emuenv.http.connections.end())
+        conn->second.nonblock = enable;
+    else if (auto tmpl = emuenv.http.templates.find(id); tmpl != emuenv.http.templates.end())
+        tmpl->second.nonblock = enable;
+    else
+        return RET_ERROR(SCE_HTTP_ERROR_INVALID_ID);
+
+    return 0;
 }
 
 EXPORT(int, sceHttpSetRecvTimeOut) {
@@ -1404,22 +1284,16 @@ EXPORT(SceInt, sceHttpTerm) {
     if (!emuenv.http.inited)
         return RET_ERROR(SCE_HTTP_ERROR_BEFORE_INIT);
 
-    // clear everything
+    // clear everything, the requests give their connection back before it is deleted
 
-    for (auto &tmpl : emuenv.http.templates) {
-        CALL_EXPORT(sceHttpDeleteTemplate, tmpl.first);
-    }
-    emuenv.http.templates.clear();
+    while (!emuenv.http.requests.empty())
+        CALL_EXPORT(sceHttpDeleteRequest, emuenv.http.requests.begin()->first);
 
-    for (auto &conn : emuenv.http.connections) {
-        CALL_EXPORT(sceHttpDeleteConnection, conn.first);
-    }
-    emuenv.http.connections.clear();
+    while (!emuenv.http.connections.empty())
+        CALL_EXPORT(sceHttpDeleteConnection, emuenv.http.connections.begin()->first);
 
-    for (auto &req : emuenv.http.requests) {
-        CALL_EXPORT(sceHttpDeleteRequest, req.first);
-    }
-    emuenv.http.requests.clear();
+    while (!emuenv.http.templates.empty())
+        CALL_EXPORT(sceHttpDeleteTemplate, emuenv.http.templates.begin()->first);
 
     for (auto &pointer : emuenv.http.guestPointers) {
         free(emuenv.mem, pointer.address());
@@ -19,6 +19,7 @@
 #include <modules/module_parent.h>
 
 #include <kernel/callback.h>
+#include <kernel/lw_sync.h>
 #include <kernel/state.h>
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
@@ -108,6 +109,8 @@ EXPORT(SceUID, _sceKernelCreateEventFlag, const char *pName, SceUInt32 attr, Sce
 EXPORT(int, _sceKernelCreateLwCond, Ptr<SceKernelLwCondWork> workarea, const char *name, SceUInt attr, Ptr<SceKernelCreateLwCond_opt> opt) {
     TRACY_FUNC(_sceKernelCreateLwCond, workarea, name, attr, opt);
     const auto uid_out = &workarea.get(emuenv.mem)->uid;
+    workarea.get(emuenv.mem)->waiters = 0;
+    workarea.get(emuenv.mem)->mutex_workarea = opt.get(emuenv.mem)->workarea_mutex;
     const auto assoc_mutex_uid = opt.get(emuenv.mem)->workarea_mutex.get(emuenv.mem)->uid;
 
     return condvar_create(uid_out, emuenv.kernel, export_name, name, thread_id, attr, assoc_mutex_uid, SyncWeight::Light);
@@ -282,24 +285,10 @@ EXPORT(int, _sceKernelGetLwMutexInfoById, SceUID lightweight_mutex_id, Ptr<SceKe
         info_data->attr = mutex->attr;
         info_data->pWork = mutex->workarea;
         info_data->initCount = mutex->init_count;
-        info_data->currentCount = mutex->lock_count;
-        if (mutex->owner == 0) {
-            info_data->currentOwnerId = 0;
-        } else {
-            auto workarea_mutex_owner = mutex->workarea.get(emuenv.mem)->owner;
-            auto threads = emuenv.kernel.threads;
-            if (threads[workarea_mutex_owner] == mutex->owner) { // something like optimisation
-                info_data->currentOwnerId = workarea_mutex_owner;
-            } else {
-                info_data->currentOwnerId = -1;
-                for (auto it = threads.begin(); it != threads.end(); ++it) {
-                    if (it->second == mutex->owner) {
-                        info_data->currentOwnerId = it->first;
-                        break;
-                    }
-                }
-            }
-        }
+        // Uncontended lock operations only update the workarea
+        const SceKernelLwMutexWork *workarea = mutex->workarea.get(emuenv.mem);
+        info_data->currentCount = workarea->lockCount;
+        info_data->currentOwnerId = workarea->owner & ~LW_MUTEX_CONTENDED;
         info_data->numWaitThreads = static_cast<SceUInt32>(mutex->waiting_threads->size());
         if (info_size < sizeof(SceKernelLwMutexInfo)) {
             memcpy(info.get(emuenv.mem), &info_data_local, info_size);
@@ -474,8 +463,7 @@ EXPORT(int, _sceKernelLockLwMutex, Ptr<SceKernelLwMutexWork> workarea, int lock_
     if (!workarea)
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
 
-    const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lwmutexid, lock_count, ptimeout, SyncWeight::Light);
+    return lwmutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, workarea, lock_count, ptimeout, false);
 }
 
 EXPORT(int, _sceKernelLockMutex, SceUID mutexid, int lock_count, unsigned int *timeout) {
@@ -598,16 +586,14 @@ EXPORT(int, _sceKernelSetTimerTime) {
 
 EXPORT(int, _sceKernelSignalLwCond, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(_sceKernelSignalLwCond, workarea);
-    SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
-        Condvar::SignalTarget(Condvar::SignalTarget::Type::Any), SyncWeight::Light);
+    return lwcond_signal(emuenv.kernel, emuenv.mem, export_name, thread_id, workarea,
+        Condvar::SignalTarget(Condvar::SignalTarget::Type::Any));
 }
 
 EXPORT(int, _sceKernelSignalLwCondAll, Ptr<SceKernelLwCondWork> workarea) {
     TRACY_FUNC(_sceKernelSignalLwCondAll, workarea);
-    SceUID condid = workarea.get(emuenv.mem)->uid;
-    return condvar_signal(emuenv.kernel, export_name, thread_id, condid,
-        Condvar::SignalTarget(Condvar::SignalTarget::Type::All), SyncWeight::Light);
+    return lwcond_signal(emuenv.kernel, emuenv.mem, export_name, thread_id, workarea,
+        Condvar::SignalTarget(Condvar::SignalTarget::Type::All));
 }
 
 EXPORT(int, _sceKernelSignalLwCondTo) {
@@ -695,15 +681,13 @@ EXPORT(int, _sceKernelWaitExceptionCB) {
 
 EXPORT(int, _sceKernelWaitLwCond, Ptr<SceKernelLwCondWork> workarea, SceUInt32 *timeout) {
     TRACY_FUNC(_sceKernelWaitLwCond, workarea, timeout);
-    const auto cond_id = workarea.get(emuenv.mem)->uid;
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, cond_id, timeout, SyncWeight::Light);
+    return lwcond_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, workarea, timeout);
 }
 
 EXPORT(SceInt32, _sceKernelWaitLwCondCB, Ptr<SceKernelLwCondWork> pWork, SceUInt32 *pTimeout) {
     TRACY_FUNC(_sceKernelWaitLwCondCB, pWork, pTimeout);
     process_callbacks(emuenv.kernel, thread_id);
-    const auto cond_id = pWork.get(emuenv.mem)->uid;
-    return condvar_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, cond_id, pTimeout, SyncWeight::Light);
+    return lwcond_wait(emuenv.kernel, emuenv.mem, export_name, thread_id, pWork, pTimeout);
 }
 
 EXPORT(int, _sceKernelWaitMultipleEvents) {
@@ -1343,7 +1327,7 @@ EXPORT(int, sceKernelTryLockWriteRWLock) {
 
 EXPORT(int, sceKernelUnlockMutex, SceUID mutexid, int unlock_count) {
     TRACY_FUNC(sceKernelUnlockMutex, mutexid, unlock_count);
-    return mutex_unlock(emuenv.kernel, export_name, thread_id, mutexid, unlock_count, SyncWeight::Heavy);
+    return mutex_unlock(emuenv.kernel, emuenv.mem, export_name, thread_id, mutexid, unlock_count, SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelUnlockReadRWLock, SceUID lock_id) {
@@ -30,6 +30,13 @@ TRACY_MODULE_NAME(SceLibc);
 
 Ptr<void> g_dso;
 
+struct SceLibcMallocManagedSize {
+    SceSize maxSystemSize;
+    SceSize currentSystemSize;
+    SceSize maxInuseSize;
+    SceSize currentInuseSize;
+};
+
 EXPORT(int, _Assert) {
     TRACY_FUNC(_Assert);
     return UNIMPLEMENTED();
@@ -332,9 +339,17 @@ EXPORT(int, c32rtomb) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, calloc) {
-    TRACY_FUNC(calloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, calloc, SceSize nelem, SceSize size) {
+    TRACY_FUNC(calloc, nelem, size);
+    const uint64_t total_size = static_cast<uint64_t>(nelem) * size;
+    if (total_size > UINT32_MAX)
+        return Ptr<void>();
+
+    const Address address = emuenv.kernel.libc_heap->alloc(thread_id, static_cast<uint32_t>(total_size));
+    if (address)
+        memset(Ptr<void>(address).get(emuenv.mem), 0, total_size);
+
+    return Ptr<void>(address);
 }
 
 EXPORT(int, clearerr) {
@@ -475,7 +490,12 @@ EXPORT(int, fread) {
 
 EXPORT(void, free, Address mem) {
     TRACY_FUNC(free, mem);
-    free(emuenv.mem, mem);
+    if (!mem)
+        return;
+
+    // Not from the heap, give back the pages it was allocated on
+    if (!emuenv.kernel.libc_heap->free(thread_id, mem))
+        free(emuenv.mem, mem);
 }
 
 EXPORT(int, freopen) {
@@ -758,24 +778,38 @@ EXPORT(int, longjmp) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, malloc, SceSize size) {
+EXPORT(Ptr<void>, malloc, SceSize size) {
     TRACY_FUNC(malloc, size);
-    return alloc(emuenv.mem, size, __FUNCTION__);
+    return Ptr<void>(emuenv.kernel.libc_heap->alloc(thread_id, size));
 }
 
-EXPORT(int, malloc_stats) {
+EXPORT(void, malloc_stats) {
     TRACY_FUNC(malloc_stats);
-    return UNIMPLEMENTED();
+    const GuestHeapStats stats = emuenv.kernel.libc_heap->get_stats();
+    LOG_INFO("system: {} (max {}), in use: {} (max {}), allocations: {}",
+        stats.system_size, stats.max_system_size, stats.inuse_size, stats.max_inuse_size, stats.allocation_count);
 }
 
-EXPORT(int, malloc_stats_fast) {
-    TRACY_FUNC(malloc_stats_fast);
-    return UNIMPLEMENTED();
+EXPORT(int, malloc_stats_fast, SceLibcMallocManagedSize *mmsize) {
+    TRACY_FUNC(malloc_stats_fast, mmsize);
+    if (!mmsize)
+        return -1;
+
+    const GuestHeapStats stats = emuenv.kernel.libc_heap->get_stats();
+    mmsize->maxSystemSize = static_cast<SceSize>(stats.max_system_size);
+    mmsize->currentSystemSize = static_cast<SceSize>(stats.system_size);
+    mmsize->maxInuseSize = static_cast<SceSize>(stats.max_inuse_size);
+    mmsize->currentInuseSize = static_cast<SceSize>(stats.inuse_size);
+
+    return 0;
 }
 
-EXPORT(int, malloc_usable_size) {
-    TRACY_FUNC(malloc_usable_size);
-    return UNIMPLEMENTED();
+EXPORT(SceSize, malloc_usable_size, Address mem) {
+    TRACY_FUNC(malloc_usable_size, mem);
+    if (!mem)
+        return 0;
+
+    return emuenv.kernel.libc_heap->usable_size(mem);
 }
 
 EXPORT(int, mblen) {
@@ -835,12 +869,7 @@ EXPORT(int, mbtowc) {
 
 EXPORT(Ptr<void>, memalign, uint32_t alignment, uint32_t size) {
     TRACY_FUNC(memalign, alignment, size);
-    Address address = alloc(emuenv.mem, size, "memalign", alignment);
-
-    STUBBED("No actual alignment.");
-    LOG_WARN_IF(address % alignment != 0, "Address {} does not fit alignment of {}.", log_hex(address), alignment);
-
-    return Ptr<void>(address);
+    return Ptr<void>(emuenv.kernel.libc_heap->alloc(thread_id, size, alignment));
 }
 
 EXPORT(int, memchr) {
@@ -1035,14 +1064,14 @@ EXPORT(int, rand_r) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, realloc) {
-    TRACY_FUNC(realloc);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, realloc, Address mem, SceSize size) {
+    TRACY_FUNC(realloc, mem, size);
+    return Ptr<void>(emuenv.kernel.libc_heap->realloc(thread_id, mem, size));
 }
 
-EXPORT(int, reallocalign) {
-    TRACY_FUNC(reallocalign);
-    return UNIMPLEMENTED();
+EXPORT(Ptr<void>, reallocalign, Address mem, SceSize size, SceSize alignment) {
+    TRACY_FUNC(reallocalign, mem, size, alignment);
+    return Ptr<void>(emuenv.kernel.libc_heap->realloc(thread_id, mem, size, alignment));
 }
 
 EXPORT(int, remove) {
@@ -178,9 +178,15 @@ EXPORT(int, sceNetEmulationSet) {
     return UNIMPLEMENTED();
 }
 
-EXPORT(int, sceNetEpollAbort) {
-    TRACY_FUNC(sceNetEpollAbort);
-    return UNIMPLEMENTED();
+EXPORT(int, sceNetEpollAbort, int eid, int flags) {
+    TRACY_FUNC(sceNetEpollAbort, eid, flags);
+
+    auto epoll = lock_and_find(eid, emuenv.net.epolls, emuenv.kernel.mutex);
+    if (!epoll) {
+        return RET_ERROR(SCE_NET_ERROR_EBADF);
+    }
+
+    return epoll->abort();
 }
 
 EXPORT(int, sceNetEpollControl, int eid, SceNetEpollControlFlag op, int id, SceNetEpollEvent *ev) {
@@ -225,10 +231,15 @@ EXPORT(int, sceNetEpollDestroy, int eid) {
     TRACY_FUNC(sceNetEpollDestroy, eid);
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
-    if (emuenv.net.epolls.erase(eid) == 0) {
+    auto it = emuenv.net.epolls.find(eid);
+    if (it == emuenv.net.epolls.end()) {
         return -1;
     }
 
+    // Wake up the threads still waiting on it
+    it->second->abort();
+    emuenv.net.epolls.erase(it);
+
     return 0;
 }
 
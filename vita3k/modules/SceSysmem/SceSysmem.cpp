@@ -326,7 +326,7 @@ EXPORT(int, sceKernelSyncVMDomain, SceUID block_uid, Address base, uint32_t size
     if (block->mappedBase.address() > base_end || base > block_base_end) {
         return RET_ERROR(SCE_KERNEL_ERROR_BLOCK_ERROR);
     }
-    invalidate_jit_cache(*emuenv.kernel.get_thread(thread_id)->cpu, base, size);
+    emuenv.kernel.invalidate_jit_cache(base, size);
 
     return 0;
 }
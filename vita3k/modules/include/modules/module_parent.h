@@ -27,6 +27,8 @@ struct KernelState;
 
 void init_libraries(EmuEnvState &emuenv);
 void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id);
+void call_import_slot(EmuEnvState &emuenv, CPUState &cpu, uint32_t slot, SceUID thread_id);
+const ImportFn *resolve_import(uint32_t nid);
 bool load_module(EmuEnvState &emuenv, SceUID thread_id, SceSysmoduleModuleId module_id);
 Address resolve_export(KernelState &kernel, uint32_t nid);
 uint32_t resolve_nid(KernelState &kernel, Address addr);
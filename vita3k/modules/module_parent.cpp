@@ -46,18 +46,18 @@ static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
 
 struct EmuEnvState;
 
-static ImportFn resolve_import(uint32_t nid) {
+const ImportFn *resolve_import(uint32_t nid) {
     switch (nid) {
 #define VAR_NID(name, nid)
 #define NID(name, nid) \
     case nid:          \
-        return import_##name;
+        return &import_##name;
 #include <nids/nids.inc>
 #undef NID
 #undef VAR_NID
     }
 
-    return ImportFn();
+    return nullptr;
 }
 
 const std::array<VarExport, var_exports_size> &get_var_exports() {
@@ -135,9 +135,9 @@ void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread
             auto lr = read_lr(cpu);
             log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
         }
-        const ImportFn fn = resolve_import(nid);
+        const ImportFn *const fn = resolve_import(nid);
         if (fn) {
-            fn(emuenv, cpu, thread_id);
+            (*fn)(emuenv, cpu, thread_id);
         } else if (emuenv.missing_nids.count(nid) == 0 || LOG_UNK_NIDS_ALWAYS) {
             const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
             LOG_ERROR("Import function for NID {} not found (thread name: {}, thread ID: {})", log_hex(nid), thread->name, thread_id);
@@ -168,11 +168,23 @@ void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread
         const std::unordered_set<uint32_t> lle_nid_blacklist = {};
         log_import_call('L', nid, thread_id, lle_nid_blacklist, pc);
         write_pc(cpu, export_pc);
-        // TODO: invalidate cache for all threads. Now invalidate_jit_cache is not thread safe.
-        invalidate_jit_cache(cpu, pc, 4 * 3);
+        emuenv.kernel.invalidate_jit_cache(pc, 4 * 3);
     }
 }
 
+void call_import_slot(EmuEnvState &emuenv, CPUState &cpu, uint32_t slot, SceUID thread_id) {
+    const ImportSlot &import_slot = emuenv.kernel.import_slots[slot];
+    const ImportFn *const fn = import_slot.fn.load(std::memory_order_acquire);
+
+    // Unimplemented NIDs, NIDs now exported by a loaded module and logged calls take the slow path
+    if (!fn || emuenv.kernel.debugger.watch_import_calls) {
+        call_import(emuenv, cpu, import_slot.nid, thread_id);
+        return;
+    }
+
+    (*fn)(emuenv, cpu, thread_id);
+}
+
 /**
  * \return False on failure, true on success
  */
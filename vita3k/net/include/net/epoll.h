@@ -2,6 +2,10 @@
 
 #include <net/socket.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 struct Epoll;
 
 typedef std::shared_ptr<Epoll> EpollPtr;
@@ -12,11 +16,36 @@ struct EpollSocket {
     abs_socket sock;
 };
 
+// Guest epoll backed by a host epoll (Linux), kqueue (macOS/BSD) or WSAPoll (Windows).
+// Sockets are registered with the host once in add/mod/del, wait only asks the host for ready ones.
 struct Epoll {
+    std::mutex mutex;
     std::map<int, EpollSocket> eventEntries;
 
+#ifdef _WIN32
+    // WSAPoll has no persistent registration, the poll set is rebuilt when the entries change
+    std::vector<WSAPOLLFD> pollFds;
+    std::vector<int> pollIds;
+    bool pollFdsDirty = true;
+    // Loopback UDP socket connected to itself, sceNetEpollAbort sends a byte to it
+    abs_socket abortSock = INVALID_SOCKET;
+#else
+    int hostFd = -1;
+    // Number of entries per host fd, the fd of a closed socket can be given to a socket added under another id
+    std::map<abs_socket, int> hostFdUses;
+#ifdef __linux__
+    // eventfd written by sceNetEpollAbort
+    int abortFd = -1;
+#endif
+#endif
+
+    Epoll();
+    ~Epoll();
+
     int add(int id, abs_socket sock, SceNetEpollEvent *ev);
     int del(int id, abs_socket sock, SceNetEpollEvent *ev);
     int mod(int id, abs_socket sock, SceNetEpollEvent *ev);
     int wait(SceNetEpollEvent *events, int maxevents, int timeout);
+    // Makes the current wait return SCE_NET_ERROR_EINTR
+    int abort();
 };
@@ -1,25 +1,79 @@
 #include <net/epoll.h>
 
+#include <algorithm>
+#include <array>
+
+#ifdef _WIN32
+#elif defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+// Most host events handled by one wait call, the guest gets the others on the next call
+static constexpr int MAX_HOST_EVENTS = 64;
+
+#ifdef _WIN32
+
+static constexpr int ABORT_ID = -1;
+
+Epoll::Epoll() {
+    abortSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addrlen = sizeof(addr);
+    bind(abortSock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    getsockname(abortSock, reinterpret_cast<sockaddr *>(&addr), &addrlen);
+    connect(abortSock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+
+    u_long mode = 1;
+    ioctlsocket(abortSock, FIONBIO, &mode);
+}
+
+Epoll::~Epoll() {
+    closesocket(abortSock);
+}
+
+static int host_error() {
+    switch (WSAGetLastError()) {
+    case WSAENOTSOCK:
+        return SCE_NET_ERROR_EBADF;
+    case WSAENOBUFS:
+        return SCE_NET_ERROR_ENOMEM;
+    default:
+        return SCE_NET_ERROR_EINVAL;
+    }
+}
+
 int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
     auto it = eventEntries.find(id);
     if (it != eventEntries.end()) {
         return SCE_NET_ERROR_EEXIST;
     }
 
     eventEntries.emplace(id, EpollSocket{ ev->events, ev->data, sock });
+    pollFdsDirty = true;
 
     return 0;
 }
 
 int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
     if (eventEntries.erase(id) == 0) {
         return SCE_NET_ERROR_ENOENT;
     }
 
+    pollFdsDirty = true;
     return 0;
 }
 
 int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
     auto it = eventEntries.find(id);
     if (it == eventEntries.end()) {
         return SCE_NET_ERROR_ENOENT;
@@ -27,70 +81,463 @@ int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
 
     it->second.events = ev->events;
     it->second.data = ev->data;
+    pollFdsDirty = true;
     return 0;
 }
 
-static void add_event_fd_set(fd_set *set, int *maxFd, abs_socket sock) {
-    FD_SET(sock, set);
-#ifndef _WIN32
-    if (sock > *maxFd) {
-        *maxFd = sock;
+int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
+    if (maxevents <= 0) {
+        return SCE_NET_ERROR_EINVAL;
     }
-#endif
-}
 
-int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
-    fd_set readFds, writeFds, exceptFds;
-    FD_ZERO(&readFds);
-    FD_ZERO(&writeFds);
-    FD_ZERO(&exceptFds);
-    int maxFd = 0;
+    std::vector<WSAPOLLFD> fds;
+    std::vector<int> ids;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (pollFdsDirty) {
+            pollFds.clear();
+            pollIds.clear();
+            pollFds.push_back(WSAPOLLFD{ abortSock, POLLRDNORM, 0 });
+            pollIds.push_back(ABORT_ID);
+            for (auto &[id, entry] : eventEntries) {
+                SHORT host_events = 0;
+                if (entry.events & SCE_NET_EPOLLIN) {
+                    host_events |= POLLRDNORM;
+                }
+                if (entry.events & SCE_NET_EPOLLOUT) {
+                    host_events |= POLLWRNORM;
+                }
+                pollFds.push_back(WSAPOLLFD{ entry.sock, host_events, 0 });
+                pollIds.push_back(id);
+            }
+            pollFdsDirty = false;
+        }
+        fds = pollFds;
+        ids = pollIds;
+    }
+
+    const INT timeout_ms = timeout_microseconds < 0 ? -1 : (timeout_microseconds + 999) / 1000;
+    const int ret = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+    if (ret < 0) {
+        return host_error();
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    int eventCount = 0;
+    bool aborted = false;
+    for (size_t i = 0; i < fds.size() && eventCount < maxevents; i++) {
+        const SHORT revents = fds[i].revents;
+        if (revents == 0) {
+            continue;
+        }
 
-    for (auto &pair : eventEntries) {
-        auto &epollSocket = pair.second;
-        if (pair.second.events & SCE_NET_EPOLLIN) {
-            add_event_fd_set(&readFds, &maxFd, pair.second.sock);
+        if (ids[i] == ABORT_ID) {
+            char buf[16];
+            while (recv(abortSock, buf, sizeof(buf), 0) > 0) {
+            }
+            aborted = true;
+            continue;
         }
-        if (pair.second.events & SCE_NET_EPOLLOUT) {
-            add_event_fd_set(&writeFds, &maxFd, pair.second.sock);
+
+        // The socket may have been removed while waiting
+        auto it = eventEntries.find(ids[i]);
+        if (it == eventEntries.end()) {
+            continue;
         }
-        if (pair.second.events & SCE_NET_EPOLLERR) {
-            add_event_fd_set(&exceptFds, &maxFd, pair.second.sock);
+
+        unsigned int eventTypes = 0;
+        if (revents & POLLRDNORM) {
+            eventTypes |= SCE_NET_EPOLLIN;
+        }
+        if (revents & POLLWRNORM) {
+            eventTypes |= SCE_NET_EPOLLOUT;
         }
+        if (revents & (POLLERR | POLLNVAL)) {
+            eventTypes |= SCE_NET_EPOLLERR;
+        }
+        if (revents & POLLHUP) {
+            eventTypes |= SCE_NET_EPOLLHUP;
+        }
+
+        events[eventCount].events = eventTypes;
+        events[eventCount].data = it->second.data;
+        eventCount++;
     }
 
-    timeval timeout;
-    timeout.tv_sec = timeout_microseconds / 1000000;
-    timeout.tv_usec = timeout_microseconds % 1000000;
-    auto ret = select(maxFd, &readFds, &writeFds, &exceptFds, &timeout);
+    if (aborted) {
+        return SCE_NET_ERROR_EINTR;
+    }
+
+    return eventCount;
+}
+
+int Epoll::abort() {
+    const char byte = 0;
+    send(abortSock, &byte, 1, 0);
+    return 0;
+}
+
+#else
+
+static int host_error() {
+    switch (errno) {
+    case EBADF:
+        return SCE_NET_ERROR_EBADF;
+    case ENOENT:
+        return SCE_NET_ERROR_ENOENT;
+    case EEXIST:
+        return SCE_NET_ERROR_EEXIST;
+    case ENOMEM:
+        return SCE_NET_ERROR_ENOMEM;
+    case EINTR:
+        return SCE_NET_ERROR_EINTR;
+    default:
+        return SCE_NET_ERROR_EINVAL;
+    }
+}
+
+// The host drops the registration of a closed socket by itself, and its fd can then be reused by another socket
+// added under another id. Removing the stale entry from the host would remove that socket instead.
+static bool is_host_fd_reused(const std::map<abs_socket, int> &host_fd_uses, abs_socket sock) {
+    const auto it = host_fd_uses.find(sock);
+    return it != host_fd_uses.end() && it->second > 1;
+}
+
+static void release_host_fd(std::map<abs_socket, int> &host_fd_uses, abs_socket sock) {
+    const auto it = host_fd_uses.find(sock);
+    if (--it->second == 0)
+        host_fd_uses.erase(it);
+}
+
+#ifdef __linux__
+
+static constexpr uint64_t ABORT_ID = UINT64_MAX;
+
+static uint32_t to_host_events(unsigned int events) {
+    uint32_t host_events = 0;
+    if (events & SCE_NET_EPOLLIN) {
+        host_events |= EPOLLIN;
+    }
+    if (events & SCE_NET_EPOLLOUT) {
+        host_events |= EPOLLOUT;
+    }
+    // EPOLLERR and EPOLLHUP are always reported
+    return host_events;
+}
+
+Epoll::Epoll() {
+    hostFd = epoll_create1(EPOLL_CLOEXEC);
+    abortFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = ABORT_ID;
+    epoll_ctl(hostFd, EPOLL_CTL_ADD, abortFd, &ev);
+}
+
+Epoll::~Epoll() {
+    close(abortFd);
+    close(hostFd);
+}
+
+static int control(int hostFd, int op, int id, abs_socket sock, unsigned int events) {
+    epoll_event ev = {};
+    ev.events = to_host_events(events);
+    ev.data.u64 = static_cast<uint32_t>(id);
+    return epoll_ctl(hostFd, op, sock, &ev);
+}
+
+int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it != eventEntries.end()) {
+        return SCE_NET_ERROR_EEXIST;
+    }
+
+    if (control(hostFd, EPOLL_CTL_ADD, id, sock, ev->events) < 0) {
+        return host_error();
+    }
+
+    eventEntries.emplace(id, EpollSocket{ ev->events, ev->data, sock });
+    hostFdUses[sock]++;
+
+    return 0;
+}
+
+int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    // Fails if the socket was closed before, the host already removed it then
+    if (!is_host_fd_reused(hostFdUses, it->second.sock)) {
+        epoll_ctl(hostFd, EPOLL_CTL_DEL, it->second.sock, nullptr);
+    }
+    release_host_fd(hostFdUses, it->second.sock);
+    eventEntries.erase(it);
+
+    return 0;
+}
+
+int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    // The closed socket is not registered anymore, the host fd now belongs to another entry
+    if (is_host_fd_reused(hostFdUses, it->second.sock)) {
+        return SCE_NET_ERROR_EBADF;
+    }
+
+    if (control(hostFd, EPOLL_CTL_MOD, id, it->second.sock, ev->events) < 0) {
+        return host_error();
+    }
+
+    it->second.events = ev->events;
+    it->second.data = ev->data;
+    return 0;
+}
+
+int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
+    if (maxevents <= 0) {
+        return SCE_NET_ERROR_EINVAL;
+    }
+
+    std::array<epoll_event, MAX_HOST_EVENTS> hostEvents;
+    // The abort event can take a slot too
+    const int hostMaxEvents = std::min(maxevents, MAX_HOST_EVENTS - 1) + 1;
+    const int timeout_ms = timeout_microseconds < 0 ? -1 : (timeout_microseconds + 999) / 1000;
+    const int ret = epoll_wait(hostFd, hostEvents.data(), hostMaxEvents, timeout_ms);
     if (ret < 0) {
-        // TODO: translate error code
-        return -1;
+        return host_error();
     }
 
+    const std::lock_guard<std::mutex> lock(mutex);
     int eventCount = 0;
-    for (auto &pair : eventEntries) {
-        auto id = pair.first;
-        auto &epollSocket = pair.second;
+    bool aborted = false;
+    for (int i = 0; i < ret && eventCount < maxevents; i++) {
+        const epoll_event &hostEvent = hostEvents[i];
+        if (hostEvent.data.u64 == ABORT_ID) {
+            uint64_t value;
+            if (read(abortFd, &value, sizeof(value)) < 0) {
+                // Another wait got the abort first
+            }
+            aborted = true;
+            continue;
+        }
+
+        // The socket may have been removed while waiting
+        auto it = eventEntries.find(static_cast<int>(hostEvent.data.u64));
+        if (it == eventEntries.end()) {
+            continue;
+        }
 
         unsigned int eventTypes = 0;
-        if (FD_ISSET(pair.second.sock, &readFds)) {
+        if (hostEvent.events & EPOLLIN) {
             eventTypes |= SCE_NET_EPOLLIN;
         }
-        if (FD_ISSET(pair.second.sock, &writeFds)) {
+        if (hostEvent.events & EPOLLOUT) {
             eventTypes |= SCE_NET_EPOLLOUT;
         }
-        if (FD_ISSET(pair.second.sock, &exceptFds)) {
+        if (hostEvent.events & EPOLLERR) {
             eventTypes |= SCE_NET_EPOLLERR;
         }
+        if (hostEvent.events & EPOLLHUP) {
+            eventTypes |= SCE_NET_EPOLLHUP;
+        }
+
+        events[eventCount].events = eventTypes;
+        events[eventCount].data = it->second.data;
+        eventCount++;
+    }
+
+    if (aborted) {
+        return SCE_NET_ERROR_EINTR;
+    }
+
+    return eventCount;
+}
+
+int Epoll::abort() {
+    const uint64_t value = 1;
+    if (write(abortFd, &value, sizeof(value)) < 0) {
+        return host_error();
+    }
+    return 0;
+}
+
+#else // kqueue
+
+static constexpr uintptr_t ABORT_IDENT = 0;
+
+Epoll::Epoll() {
+    hostFd = kqueue();
+
+    struct kevent change;
+    EV_SET(&change, ABORT_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    kevent(hostFd, &change, 1, nullptr, 0, nullptr);
+}
+
+Epoll::~Epoll() {
+    close(hostFd);
+}
+
+// Adds the filters for the new events and removes the ones for the old events which are not wanted anymore
+static int update_filters(int hostFd, int id, abs_socket sock, unsigned int oldEvents, unsigned int newEvents) {
+    std::array<struct kevent, 2> changes;
+    int changeCount = 0;
+    void *udata = reinterpret_cast<void *>(static_cast<intptr_t>(id));
+
+    const std::array<std::pair<unsigned int, int16_t>, 2> filters = { { { SCE_NET_EPOLLIN, EVFILT_READ }, { SCE_NET_EPOLLOUT, EVFILT_WRITE } } };
+    for (auto &[event, filter] : filters) {
+        if (newEvents & event) {
+            EV_SET(&changes[changeCount++], sock, filter, EV_ADD | EV_ENABLE, 0, 0, udata);
+        } else if (oldEvents & event) {
+            EV_SET(&changes[changeCount++], sock, filter, EV_DELETE, 0, 0, udata);
+        }
+    }
+
+    if (changeCount == 0) {
+        return 0;
+    }
+
+    return kevent(hostFd, changes.data(), changeCount, nullptr, 0, nullptr);
+}
+
+int Epoll::add(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it != eventEntries.end()) {
+        return SCE_NET_ERROR_EEXIST;
+    }
+
+    if (update_filters(hostFd, id, sock, 0, ev->events) < 0) {
+        return host_error();
+    }
+
+    eventEntries.emplace(id, EpollSocket{ ev->events, ev->data, sock });
+    hostFdUses[sock]++;
+
+    return 0;
+}
+
+int Epoll::del(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    // Fails if the socket was closed before, the host already removed it then
+    if (!is_host_fd_reused(hostFdUses, it->second.sock)) {
+        update_filters(hostFd, id, it->second.sock, it->second.events, 0);
+    }
+    release_host_fd(hostFdUses, it->second.sock);
+    eventEntries.erase(it);
+
+    return 0;
+}
+
+int Epoll::mod(int id, abs_socket sock, SceNetEpollEvent *ev) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    auto it = eventEntries.find(id);
+    if (it == eventEntries.end()) {
+        return SCE_NET_ERROR_ENOENT;
+    }
+
+    // The closed socket is not registered anymore, the host fd now belongs to another entry
+    if (is_host_fd_reused(hostFdUses, it->second.sock)) {
+        return SCE_NET_ERROR_EBADF;
+    }
+
+    if (update_filters(hostFd, id, it->second.sock, it->second.events, ev->events) < 0) {
+        return host_error();
+    }
+
+    it->second.events = ev->events;
+    it->second.data = ev->data;
+    return 0;
+}
+
+int Epoll::wait(SceNetEpollEvent *events, int maxevents, int timeout_microseconds) {
+    if (maxevents <= 0) {
+        return SCE_NET_ERROR_EINVAL;
+    }
+
+    std::array<struct kevent, MAX_HOST_EVENTS> hostEvents;
+    // A socket can have a read and a write event, and the abort event can take a slot too
+    const int hostMaxEvents = std::min(maxevents, (MAX_HOST_EVENTS - 1) / 2) * 2 + 1;
+    timespec timeout;
+    timeout.tv_sec = timeout_microseconds / 1000000;
+    timeout.tv_nsec = (timeout_microseconds % 1000000) * 1000;
+    const int ret = kevent(hostFd, nullptr, 0, hostEvents.data(), hostMaxEvents, timeout_microseconds < 0 ? nullptr : &timeout);
+    if (ret < 0) {
+        return host_error();
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    std::array<int, MAX_HOST_EVENTS> eventIds;
+    int eventCount = 0;
+    bool aborted = false;
+    for (int i = 0; i < ret; i++) {
+        const struct kevent &hostEvent = hostEvents[i];
+        if (hostEvent.filter == EVFILT_USER) {
+            aborted = true;
+            continue;
+        }
 
-        if (eventTypes != 0 && eventCount < maxevents) {
-            auto i = eventCount++;
+        const int id = static_cast<int>(reinterpret_cast<intptr_t>(hostEvent.udata));
+        auto it = eventEntries.find(id);
+        if (it == eventEntries.end()) {
+            continue;
+        }
+
+        unsigned int eventTypes = hostEvent.filter == EVFILT_READ ? SCE_NET_EPOLLIN : SCE_NET_EPOLLOUT;
+        if (hostEvent.flags & EV_ERROR) {
+            eventTypes = SCE_NET_EPOLLERR;
+        } else if (hostEvent.flags & EV_EOF) {
+            eventTypes |= SCE_NET_EPOLLHUP;
+            if (hostEvent.fflags != 0) {
+                eventTypes |= SCE_NET_EPOLLERR;
+            }
+        }
 
-            events[i].events = eventTypes;
-            events[i].data = pair.second.data;
+        // The read and write events of a socket are merged
+        const auto previous = std::find(eventIds.begin(), eventIds.begin() + eventCount, id);
+        if (previous != eventIds.begin() + eventCount) {
+            events[previous - eventIds.begin()].events |= eventTypes;
+            continue;
         }
+
+        if (eventCount == maxevents) {
+            continue;
+        }
+
+        eventIds[eventCount] = id;
+        events[eventCount].events = eventTypes;
+        events[eventCount].data = it->second.data;
+        eventCount++;
+    }
+
+    if (aborted) {
+        return SCE_NET_ERROR_EINTR;
     }
 
     return eventCount;
 }
+
+int Epoll::abort() {
+    struct kevent change;
+    EV_SET(&change, ABORT_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    if (kevent(hostFd, &change, 1, nullptr, 0, nullptr) < 0) {
+        return host_error();
+    }
+    return 0;
+}
+
+#endif
+#endif
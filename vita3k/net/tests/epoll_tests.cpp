@@ -0,0 +1,217 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <net/epoll.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Loopback UDP socket bound to an ephemeral port
+struct LoopbackSocket {
+    abs_socket sock;
+    sockaddr_in addr = {};
+
+    LoopbackSocket() {
+        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrlen = sizeof(addr);
+        bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        getsockname(sock, reinterpret_cast<sockaddr *>(&addr), &addrlen);
+    }
+
+    void close() {
+#ifdef _WIN32
+        closesocket(sock);
+#else
+        ::close(sock);
+#endif
+    }
+
+    void send_to(abs_socket from) const {
+        const char byte = 0;
+        sendto(from, &byte, 1, 0, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+    }
+};
+
+class EpollTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    }
+
+    void TearDown() override {
+#ifdef _WIN32
+        closesocket(sender);
+        WSACleanup();
+#else
+        close(sender);
+#endif
+    }
+
+    static SceNetEpollEvent make_event(int id, unsigned int events) {
+        SceNetEpollEvent ev = {};
+        ev.events = events;
+        std::memcpy(ev.data.data, &id, sizeof(id));
+        return ev;
+    }
+
+    static int event_id(const SceNetEpollEvent &ev) {
+        int id;
+        std::memcpy(&id, ev.data.data, sizeof(id));
+        return id;
+    }
+
+    // Waits until the expected number of sockets are ready or nothing comes for a while
+    static std::set<int> wait_ids(Epoll &epoll, size_t expected_count) {
+        std::set<int> ids;
+        std::vector<SceNetEpollEvent> events(64);
+        while (ids.size() < expected_count) {
+            const int count = epoll.wait(events.data(), static_cast<int>(events.size()), 200000);
+            if (count <= 0)
+                break;
+            for (int i = 0; i < count; i++)
+                ids.insert(event_id(events[i]));
+        }
+        return ids;
+    }
+
+    abs_socket sender;
+};
+
+TEST_F(EpollTest, reports_only_ready_sockets) {
+    constexpr int socket_count = 256;
+
+    Epoll epoll;
+    std::vector<LoopbackSocket> sockets(socket_count);
+    for (int id = 0; id < socket_count; id++) {
+        SceNetEpollEvent ev = make_event(id, SCE_NET_EPOLLIN);
+        ASSERT_EQ(epoll.add(id, sockets[id].sock, &ev), 0);
+    }
+
+    std::set<int> expected;
+    for (int id = 0; id < socket_count; id += 3) {
+        sockets[id].send_to(sender);
+        expected.insert(id);
+    }
+
+    EXPECT_EQ(wait_ids(epoll, expected.size()), expected);
+
+    for (int id = 0; id < socket_count; id++) {
+        SceNetEpollEvent ev = {};
+        ASSERT_EQ(epoll.del(id, sockets[id].sock, &ev), 0);
+        sockets[id].close();
+    }
+}
+
+TEST_F(EpollTest, add_twice_and_del_unknown) {
+    Epoll epoll;
+    LoopbackSocket socket;
+    SceNetEpollEvent ev = make_event(1, SCE_NET_EPOLLIN);
+    EXPECT_EQ(epoll.add(1, socket.sock, &ev), 0);
+    EXPECT_EQ(epoll.add(1, socket.sock, &ev), SCE_NET_ERROR_EEXIST);
+    EXPECT_EQ(epoll.del(2, socket.sock, &ev), SCE_NET_ERROR_ENOENT);
+    EXPECT_EQ(epoll.mod(2, socket.sock, &ev), SCE_NET_ERROR_ENOENT);
+    EXPECT_EQ(epoll.del(1, socket.sock, &ev), 0);
+    socket.close();
+}
+
+#ifndef _WIN32
+TEST_F(EpollTest, del_closed_socket_keeps_reused_fd) {
+    Epoll epoll;
+
+    LoopbackSocket closed;
+    SceNetEpollEvent ev = make_event(1, SCE_NET_EPOLLIN);
+    ASSERT_EQ(epoll.add(1, closed.sock, &ev), 0);
+    closed.close();
+
+    // The lowest free fd is given to the next socket
+    LoopbackSocket reused;
+    ASSERT_EQ(reused.sock, closed.sock);
+    ev = make_event(2, SCE_NET_EPOLLIN);
+    ASSERT_EQ(epoll.add(2, reused.sock, &ev), 0);
+
+    EXPECT_EQ(epoll.mod(1, closed.sock, &ev), SCE_NET_ERROR_EBADF);
+    EXPECT_EQ(epoll.del(1, closed.sock, &ev), 0);
+
+    reused.send_to(sender);
+    EXPECT_EQ(wait_ids(epoll, 1), std::set<int>{ 2 });
+
+    EXPECT_EQ(epoll.del(2, reused.sock, &ev), 0);
+    reused.close();
+}
+#endif
+
+// Time of the add, wait and del calls with hundreds of registered sockets
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST_F(EpollTest, DISABLED_benchmark) {
+    constexpr int socket_count = 512;
+    constexpr int round_count = 50;
+    constexpr int ready_per_round = 8;
+
+    Epoll epoll;
+    std::vector<LoopbackSocket> sockets(socket_count);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int id = 0; id < socket_count; id++) {
+        SceNetEpollEvent ev = make_event(id, SCE_NET_EPOLLIN);
+        ASSERT_EQ(epoll.add(id, sockets[id].sock, &ev), 0);
+    }
+    const auto added = std::chrono::steady_clock::now();
+
+    char buffer[16];
+    for (int round = 0; round < round_count; round++) {
+        std::set<int> expected;
+        for (int i = 0; i < ready_per_round; i++) {
+            const int id = (round * 97 + i * 61) % socket_count;
+            sockets[id].send_to(sender);
+            expected.insert(id);
+        }
+
+        ASSERT_EQ(wait_ids(epoll, expected.size()), expected);
+        for (const int id : expected)
+            recv(sockets[id].sock, buffer, sizeof(buffer), 0);
+    }
+    const auto waited = std::chrono::steady_clock::now();
+
+    for (int id = 0; id < socket_count; id++) {
+        SceNetEpollEvent ev = {};
+        ASSERT_EQ(epoll.del(id, sockets[id].sock, &ev), 0);
+    }
+    const auto deleted = std::chrono::steady_clock::now();
+
+    for (auto &socket : sockets)
+        socket.close();
+
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    std::cout << socket_count << " sockets: add " << Microseconds(added - start).count() / socket_count
+              << " us, wait " << Microseconds(waited - added).count() / round_count
+              << " us per round of " << ready_per_round << " ready, del " << Microseconds(deleted - waited).count() / socket_count << " us" << std::endl;
+}
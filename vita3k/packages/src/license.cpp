@@ -21,6 +21,7 @@
  */
 
 #include <emuenv/state.h>
+#include <io/vfs.h>
 
 #include <util/bytes.h>
 #include <util/log.h>
@@ -98,7 +99,8 @@ int32_t get_license_sku_flag(EmuEnvState &emuenv, const std::string &content_id)
         sku_flag = byte_swap(license_buf.sku_flag);
     } else {
         const auto RETAIL_APP_PATH{ fs::path(emuenv.pref_path) / "ux0/app" / title_id / "sce_sys/retail/livearea" };
-        if (fs::exists(RETAIL_APP_PATH))
+        const auto app_archive = vfs::find_app_archive(title_id);
+        if (app_archive ? app_archive->find("sce_sys/retail/livearea") != nullptr : fs::exists(RETAIL_APP_PATH))
             sku_flag = 1;
         else
             sku_flag = 0;
@@ -26,6 +26,7 @@
 #include <rif2zrif.h>
 
 #include <crypto/aes.h>
+#include <crypto/aes_ctr.h>
 #include <io/device.h>
 #include <io/functions.h>
 
@@ -38,41 +39,54 @@
 
 #include <util/bytes.h>
 #include <util/log.h>
+#include <util/mapped_file.h>
 #include <util/string_utils.h>
+#include <util/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
 
 // Credits to mmozeiko https://github.com/mmozeiko/pkg2zip
 
-static void ctr_add(uint8_t *counter, uint64_t n) {
-    for (int i = 15; i >= 0; i--) {
-        n = n + counter[i];
-        counter[i] = (uint8_t)n;
-        n >>= 8;
+// Files are split in parts of this size so that big ones are spread over several threads too
+static constexpr uint64_t PKG_CHUNK_SIZE = 16 * 1024 * 1024;
+static constexpr size_t PKG_DECRYPT_BUFFER_SIZE = 1024 * 1024;
+
+struct PkgFile {
+    fs::path path;
+    // From the start of the data section
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+// Decrypts [offset, offset + size) of the file from the mapped pkg and writes it at the same place in the output
+static bool extract_pkg_chunk(const uint8_t *pkg_data, const Aes128Ctr &cipher, const PkgFile &file, uint64_t offset, uint64_t size, std::atomic<uint64_t> &extracted_size) {
+    fs::fstream outfile(file.path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!outfile) {
+        LOG_ERROR("Could not open {} for writing", file.path.string());
+        return false;
     }
-}
-
-static void aes128_ctr_xor(aes_context *ctx, const uint8_t *iv, uint64_t block, uint8_t *input, size_t size) {
-    uint8_t tmp[16];
-    uint8_t counter[16];
-    for (uint32_t i = 0; i < 16; i++) {
-        counter[i] = iv[i];
+    outfile.seekp(offset);
+
+    std::vector<uint8_t> buffer(std::min<uint64_t>(size, PKG_DECRYPT_BUFFER_SIZE));
+    while (size != 0) {
+        const size_t part_size = std::min<uint64_t>(size, buffer.size());
+        const uint64_t data_offset = file.data_offset + offset;
+        memcpy(buffer.data(), pkg_data + data_offset, part_size);
+        cipher.xor_stream(data_offset / 16, buffer.data(), part_size);
+        outfile.write(reinterpret_cast<const char *>(buffer.data()), part_size);
+
+        offset += part_size;
+        size -= part_size;
+        extracted_size += part_size;
     }
-    ctr_add(counter, block);
 
-    while (size >= 16) {
-        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
-        for (uint32_t i = 0; i < 16; i++) {
-            *input++ ^= tmp[i];
-        }
-        ctr_add(counter, 1);
-        size -= 16;
-    }
-
-    if (size != 0) {
-        aes_crypt_ecb(ctx, AES_ENCRYPT, counter, tmp);
-        for (size_t i = 0; i < size; i++) {
-            *input++ ^= tmp[i];
-        }
+    if (!outfile) {
+        LOG_ERROR("Could not write {}", file.path.string());
+        return false;
     }
+    return true;
 }
 
 bool decrypt_install_nonpdrm(EmuEnvState &emuenv, std::string &drmlicpath, const std::string &title_path) {
@@ -111,12 +125,18 @@ bool decrypt_install_nonpdrm(EmuEnvState &emuenv, std::string &drmlicpath, const
 
 bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRIF, const std::function<void(float)> &progress_callback) {
     std::wstring pkg_path = string_utils::utf_to_wide(pkg);
-    fs::ifstream infile(pkg_path, std::ios::binary);
+    MappedFile pkg_file;
+    if (!pkg_file.open(pkg_path))
+        return false;
+
     PkgHeader pkg_header;
     PkgExtHeader ext_header;
-    infile.read(reinterpret_cast<char *>(&pkg_header), sizeof(PkgHeader));
-    infile.seekg(sizeof(PkgHeader));
-    infile.read(reinterpret_cast<char *>(&ext_header), sizeof(PkgExtHeader));
+    if (!pkg_file.contains(0, sizeof(PkgHeader) + sizeof(PkgExtHeader))) {
+        LOG_ERROR("Not a valid pkg file!");
+        return false;
+    }
+    memcpy(&pkg_header, pkg_file.data(), sizeof(PkgHeader));
+    memcpy(&ext_header, pkg_file.data() + sizeof(PkgHeader), sizeof(PkgExtHeader));
 
     progress_callback(0);
 
@@ -125,12 +145,12 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         return false;
     }
 
-    if (fs::file_size(pkg_path) < byte_swap(pkg_header.total_size)) {
+    if (pkg_file.size() < byte_swap(pkg_header.total_size)) {
         LOG_ERROR("The pkg file is too small");
         return false;
     }
 
-    if (fs::file_size(pkg_path) < byte_swap(pkg_header.data_offset) + byte_swap(pkg_header.file_count) * 32) {
+    if (pkg_file.size() < byte_swap(pkg_header.data_offset) + byte_swap(pkg_header.file_count) * 32) {
         LOG_ERROR("The pkg file is too small");
         return false;
     }
@@ -144,8 +164,11 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
 
     for (uint32_t i = 0; i < byte_swap(pkg_header.info_count); i++) {
         uint32_t block[4];
-        infile.seekg(info_offset);
-        infile.read((char *)block, sizeof(block));
+        if (!pkg_file.contains(info_offset, sizeof(block))) {
+            LOG_ERROR("The pkg file is too small");
+            return false;
+        }
+        memcpy(block, pkg_file.data() + info_offset, sizeof(block));
 
         auto type = byte_swap(block[0]);
         auto size = byte_swap(block[1]);
@@ -210,12 +233,14 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         break;
     }
 
-    aes_setkey_enc(&aes_ctx, main_key, 128);
+    const Aes128Ctr data_cipher(main_key, pkg_header.pkg_data_iv);
 
-    std::vector<uint8_t> sfo_buffer(sfo_size);
+    if (!pkg_file.contains(sfo_offset, sfo_size)) {
+        LOG_ERROR("The pkg file is too small");
+        return false;
+    }
+    std::vector<uint8_t> sfo_buffer(pkg_file.data() + sfo_offset, pkg_file.data() + sfo_offset + sfo_size);
     SfoFile sfo_file;
-    infile.seekg(sfo_offset);
-    infile.read((char *)&sfo_buffer[0], sfo_size);
     sfo::load(sfo_file, sfo_buffer);
     sfo::get_param_info(emuenv.app_info, sfo_buffer, emuenv.cfg.sys_lang);
 
@@ -250,23 +275,32 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         break;
     }
 
+    const uint8_t *pkg_data = pkg_file.data() + byte_swap(pkg_header.data_offset);
+    const uint64_t pkg_data_size = pkg_file.size() - byte_swap(pkg_header.data_offset);
+
+    // Directories are created right away, files are extracted once they are all known
+    std::vector<PkgFile> files;
+    uint64_t total_size = 0;
     for (uint32_t i = 0; i < byte_swap(pkg_header.file_count); i++) {
         PkgEntry entry;
         uint64_t file_offset = items_offset + i * 32;
-        infile.seekg(byte_swap(pkg_header.data_offset) + file_offset, std::ios_base::beg);
-        infile.read(reinterpret_cast<char *>(&entry), sizeof(PkgEntry));
-        aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, file_offset / 16, reinterpret_cast<unsigned char *>(&entry), sizeof(PkgEntry));
-
-        if (fs::file_size(pkg_path) < byte_swap(pkg_header.data_offset) + byte_swap(entry.name_offset) + byte_swap(entry.name_size) || fs::file_size(pkg_path) < byte_swap(pkg_header.data_offset) + byte_swap(entry.data_offset) + byte_swap(entry.data_size)) {
+        if (file_offset + sizeof(PkgEntry) > pkg_data_size) {
             LOG_ERROR("The pkg file size is too small, possibly corrupted");
             return false;
         }
-        const auto file_count = (float)byte_swap(pkg_header.file_count);
-        progress_callback(i / file_count * 100.f * 0.6f);
-        std::vector<unsigned char> name(byte_swap(entry.name_size));
-        infile.seekg(byte_swap(pkg_header.data_offset) + byte_swap(entry.name_offset));
-        infile.read((char *)&name[0], byte_swap(entry.name_size));
-        aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, byte_swap(entry.name_offset) / 16, &name[0], byte_swap(entry.name_size));
+        memcpy(&entry, pkg_data + file_offset, sizeof(PkgEntry));
+        data_cipher.xor_stream(file_offset / 16, reinterpret_cast<unsigned char *>(&entry), sizeof(PkgEntry));
+
+        const uint64_t name_offset = byte_swap(entry.name_offset);
+        const uint64_t name_size = byte_swap(entry.name_size);
+        const uint64_t data_offset = byte_swap(entry.data_offset);
+        const uint64_t data_size = byte_swap(entry.data_size);
+        if (pkg_data_size < name_offset + name_size || data_offset > pkg_data_size || pkg_data_size - data_offset < data_size) {
+            LOG_ERROR("The pkg file size is too small, possibly corrupted");
+            return false;
+        }
+        std::vector<unsigned char> name(pkg_data + name_offset, pkg_data + name_offset + name_size);
+        data_cipher.xor_stream(name_offset / 16, name.data(), name.size());
 
         auto string_name = std::string(name.begin(), name.end());
         LOG_INFO(string_name);
@@ -274,26 +308,53 @@ bool install_pkg(const std::string &pkg, EmuEnvState &emuenv, std::string &p_zRI
         if ((byte_swap(entry.type) & 0xFF) == 4 || (byte_swap(entry.type) & 0xFF) == 18) { // Directory
             fs::create_directories(path.string() + "/" + string_name);
         } else { // File
-            std::ofstream outfile(path.string() + "/" + string_name, std::ios::binary);
+            files.push_back({ fs::path(path.string() + "/" + string_name), data_offset, data_size });
+            total_size += data_size;
+        }
+    }
 
-            auto offset = byte_swap(entry.data_offset);
-            auto data_size = byte_swap(entry.data_size);
-            while (data_size != 0) {
-                unsigned char buffer[0x10000];
-                auto size = data_size < sizeof(buffer) ? data_size : sizeof(buffer);
-                infile.seekg(byte_swap(pkg_header.data_offset) + offset);
-                infile.read((char *)buffer, size);
+    // Create the files at their final size first, so that their parts can be written in any order
+    struct Chunk {
+        size_t file_index;
+        uint64_t offset;
+        uint64_t size;
+    };
+    std::vector<Chunk> chunks;
+    for (size_t i = 0; i < files.size(); i++) {
+        const PkgFile &file = files[i];
+        fs::ofstream(file.path, std::ios::binary);
+        boost::system::error_code error_code;
+        fs::resize_file(file.path, file.data_size, error_code);
+        if (error_code) {
+            LOG_ERROR("Could not create {}: {}", file.path.string(), error_code.message());
+            return false;
+        }
 
-                aes128_ctr_xor(&aes_ctx, pkg_header.pkg_data_iv, offset / 16, buffer, size);
+        for (uint64_t offset = 0; offset < file.data_size; offset += PKG_CHUNK_SIZE)
+            chunks.push_back({ i, offset, std::min(file.data_size - offset, PKG_CHUNK_SIZE) });
+    }
 
-                outfile.write((char *)buffer, size);
-                offset += size;
-                data_size -= size;
-            }
-            outfile.close();
-        }
+    // The calling thread only reports the progress
+    std::atomic<uint64_t> extracted_size = 0;
+    std::vector<std::future<bool>> results;
+    results.reserve(chunks.size());
+    for (const Chunk &chunk : chunks) {
+        results.push_back(ThreadPool::shared().submit([&, chunk]() {
+            return extract_pkg_chunk(pkg_data, data_cipher, files[chunk.file_index], chunk.offset, chunk.size, extracted_size);
+        }));
     }
-    infile.close();
+
+    bool extracted = true;
+    for (auto &result : results) {
+        while (result.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+            progress_callback(extracted_size * 100.f * 0.6f / total_size);
+        extracted &= result.get();
+    }
+    progress_callback(60);
+    pkg_file.close();
+
+    if (!extracted)
+        return false;
 
     std::string title_id_src = path.string();
     std::string title_id_dst = path.string() + "_dec";
@@ -83,6 +83,8 @@ enum class CommandOpcode : std::uint8_t {
     DestroyContext
 };
 
+constexpr std::size_t COMMAND_OPCODE_COUNT = static_cast<std::size_t>(CommandOpcode::DestroyContext) + 1;
+
 enum CommandErrorCode {
     CommandErrorCodeNone = 0,
     CommandErrorCodePending = -1,
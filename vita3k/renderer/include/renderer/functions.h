@@ -23,6 +23,7 @@
 struct MemState;
 struct FeatureState;
 struct Config;
+class ThreadPool;
 
 typedef uint32_t TextureCacheHash;
 
@@ -53,6 +54,20 @@ bool wishlist(SceGxmSyncObject *sync_object, const uint32_t timestamp, const int
  */
 void subject_done(SceGxmSyncObject *sync_object, const uint32_t timestamp);
 
+struct TransferColorKey {
+    SceGxmTransferColorKeyMode mode;
+    uint32_t value;
+    uint32_t mask;
+};
+
+// Row kernels of the transfer commands.
+// Copies a row of pixels, converting them if the formats differ. Returns false if they can't be converted.
+// Rows copied without color key nor conversion may overlap.
+bool transfer_copy_row(uint8_t *dest, SceGxmTransferFormat dest_format, const uint8_t *src, SceGxmTransferFormat src_format, uint32_t width, const TransferColorKey &key);
+void transfer_fill_row(uint8_t *dest, uint32_t width, uint32_t bytes_per_pixel, uint32_t color);
+// Keeps one pixel out of two of the source row
+void transfer_downscale_row(uint8_t *dest, const uint8_t *src, uint32_t dest_width, uint32_t bytes_per_pixel);
+
 int wait_for_status(State &state, int *status, int signal, bool wake_on_equal);
 void reset_command_list(CommandList &command_list);
 void submit_command_list(State &state, renderer::Context *context, CommandList &command_list);
@@ -151,7 +166,8 @@ namespace texture {
 // Paletted textures.
 void palette_texture_to_rgba_4(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
 void palette_texture_to_rgba_8(uint32_t *dst, const uint8_t *src, size_t width, size_t height, const size_t stride, const uint32_t *palette);
-void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height);
+// YUV420 textures (both the 2 and 3 planes layouts), converted to RGBA rows dst_stride bytes apart. Has no shared state.
+void yuv420_texture_to_rgba(uint8_t *dst, size_t dst_stride, const uint8_t *src, size_t width, size_t height, SceGxmTextureFormat format);
 const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState &mem);
 
 /**
@@ -164,8 +180,9 @@ const uint32_t *get_texture_palette(const SceGxmTexture &texture, const MemState
  * \param block_storage     Pointer to compressed blocks.
  * \param image             Pointer to the image where the decompressed pixels will be stored.
  * \param bc_type           Block compressed type. BC1 (DXT1), BC2 (DXT3), BC3 (DXT5), BC4U (RGTC1), BC4S (RGTC1), BC5U (RGTC2) or BC5S (RGTC2).
+ * \param pool              Pool decompressing big textures in parts, in parallel. Can be null.
  */
-void decompress_bc_swizz_image(std::uint32_t width, std::uint32_t height, const std::uint8_t *block_storage, std::uint32_t *image, const std::uint8_t bc_type);
+void decompress_bc_swizz_image(std::uint32_t width, std::uint32_t height, const std::uint8_t *block_storage, std::uint32_t *image, const std::uint8_t bc_type, ThreadPool *pool = nullptr);
 
 /**
  * \brief Solves Z-order on all the blocks of a block compressed texture and stores the resulting pixels in 'dest'.
@@ -185,7 +202,9 @@ void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t
 
 uint16_t get_upload_mip(const uint16_t true_mip, const uint16_t width, const uint16_t height, const SceGxmTextureBaseFormat base_format);
 
-void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem);
+// Sizes the cache for capacity textures and forgets all the cached ones
+void init_cache(TextureCacheState &cache, size_t capacity);
+void upload_bound_texture(TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem);
 void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_texture, MemState &mem);
 size_t bits_per_pixel(SceGxmTextureBaseFormat base_format);
 bool is_compressed_format(SceGxmTextureBaseFormat base_format);
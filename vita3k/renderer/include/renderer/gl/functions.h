@@ -37,7 +37,9 @@ namespace renderer::gl {
 
 // Compile program.
 SharedGLObject compile_program(GLState &renderer, GLContext &context, const GxmRecordState &state, const FeatureState &features, const MemState &mem, bool shader_cache, bool spirv, bool maskupdate, const char *base_path, const char *title_id, const char *self_name);
-void pre_compile_program(GLState &renderer, const char *base_path, const char *title_id, const char *self_name, const ShadersHash &hashs);
+// Can be called from any thread
+ProgramSources pre_load_program(const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, const ShadersHash &hash);
+void pre_compile_program(GLState &renderer, const ShadersHash &hash, const ProgramSources &sources);
 
 // Uniforms.
 bool set_uniform_buffer(GLContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data);
@@ -102,7 +104,7 @@ GLenum get_gl_texture_type(const SceGxmTexture &gxm_texture);
 size_t bits_per_pixel(SceGxmTextureBaseFormat base_format);
 
 // Texture cache.
-bool init(GLTextureCacheState &cache, const bool hashless_texture_cache);
+bool init(GLTextureCacheState &cache, const bool hashless_texture_cache, const size_t capacity);
 void dump(const SceGxmTexture &gxm_texture, const MemState &mem, const std::string &name, const std::string &base_path, const std::string &title_id, Sha256Hash hash);
 
 } // namespace texture
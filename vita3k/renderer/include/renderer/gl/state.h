@@ -28,7 +28,9 @@
 
 #include <SDL.h>
 
+#include <future>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -45,6 +47,10 @@ struct GLState : public renderer::State {
 
     ScreenRenderer screen_renderer;
 
+    // Boot time precompilation: sources are read by the shared thread pool ahead of the programs compiled on this thread
+    std::vector<std::future<ProgramSources>> precompile_sources;
+    size_t precompile_next = 0;
+
     bool init(const char *base_path, const bool hashless_texture_cache) override;
     void render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &viewport_size, const DisplayState &display,
         const GxmState &gxm, MemState &mem) override;
@@ -53,7 +59,7 @@ struct GLState : public renderer::State {
     int get_max_anisotropic_filtering() override;
     void set_anisotropic_filtering(int anisotropic_filtering) override;
 
-    void precompile_shader(const ShadersHash &hash) override;
+    bool precompile_shaders() override;
     void preclose_action() override;
 };
 
@@ -29,6 +29,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -53,8 +54,14 @@ typedef std::map<ProgramHashes, SharedGLObject> ProgramCache;
 typedef std::vector<ExcludedUniform> ExcludedUniforms; // vector instead of unordered_set since it's much faster for few elements
 typedef std::map<GLuint, GLenum> UniformTypes;
 
+// GLSL sources of a program from the shader cache, empty when not found
+struct ProgramSources {
+    std::string frag;
+    std::string vert;
+};
+
 struct GLTextureCacheState : public renderer::TextureCacheState {
-    GLObjectArray<TextureCacheSize> textures;
+    GLObjectVector textures;
 };
 
 struct GLRenderTarget;
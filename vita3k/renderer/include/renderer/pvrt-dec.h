@@ -32,6 +32,9 @@
 */
 #pragma once
 #include <stdint.h>
+
+class ThreadPool;
+
 namespace pvr {
 
 /// <summary>Decompresses PVRTC to RGBA 8888.</summary>
@@ -41,8 +44,9 @@ namespace pvr {
 /// <param name="yDim">Y dimension of the texture</param>
 /// <param name="doPvrtType">Signifies whether the data is PVRTC-I or PVRTC-II</param>
 /// <param name="outResultImage">The decompressed texture data</param>
+/// <param name="pool">Pool decompressing big textures in parts, in parallel. Can be null</param>
 /// <returns>Return the amount of data that was decompressed.</returns>
-uint32_t PVRTDecompressPVRTC(const void *compressedData, uint32_t do2bitMode, uint32_t xDim, uint32_t yDim, uint32_t doPvrtType, uint8_t *outResultImage);
+uint32_t PVRTDecompressPVRTC(const void *compressedData, uint32_t do2bitMode, uint32_t xDim, uint32_t yDim, uint32_t doPvrtType, uint8_t *outResultImage, ThreadPool *pool = nullptr);
 
 /// <summary>Decompresses ETC to RGBA 8888.</summary>
 /// <param name="srcData">The ETC texture data to decompress</param>
@@ -19,9 +19,12 @@
 
 #include <features/state.h>
 #include <renderer/commands.h>
+#include <renderer/texture_cache_state.h>
 #include <renderer/types.h>
-#include <threads/queue.h>
+#include <threads/ring_queue.h>
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 
@@ -31,6 +34,33 @@ struct DisplayState;
 struct GxmState;
 
 namespace renderer {
+// Command lists submitted but not processed yet before submitters have to wait
+constexpr size_t COMMAND_BUFFER_QUEUE_SIZE = 32;
+
+struct ShaderCompileStats {
+    std::atomic<uint32_t> queue_depth{ 0 }; // Shaders and pipelines waiting for or being compiled
+    std::atomic<uint64_t> hitch_count{ 0 }; // Draws the render thread stopped on to compile
+    std::atomic<uint64_t> hitch_time_us{ 0 };
+    std::atomic<uint64_t> last_hitch_us{ 0 };
+    std::atomic<uint64_t> max_hitch_us{ 0 };
+    std::atomic<uint64_t> fallback_draws{ 0 };
+    std::atomic<uint64_t> skipped_draws{ 0 };
+};
+
+struct CommandOpcodeStats {
+    uint32_t count = 0;
+    uint64_t time_ns = 0; // Time spent in the handler
+};
+
+typedef std::array<CommandOpcodeStats, COMMAND_OPCODE_COUNT> CommandHistogram;
+
+// Commands processed by opcode, only kept with the log-command-stats option
+struct CommandStats {
+    CommandHistogram frame; // Since the last NewFrame
+    CommandHistogram last_frame; // Between the last two NewFrame
+    uint64_t frame_count = 0;
+};
+
 struct State {
     const char *base_path;
     const char *title_id;
@@ -40,11 +70,15 @@ struct State {
     FeatureState features;
     int res_multiplier;
     bool disable_surface_sync;
+    size_t texture_cache_size = DEFAULT_TEXTURE_CACHE_SIZE;
+    TextureCacheStats texture_cache_stats;
+    ShaderCompileStats shader_compile_stats;
+    CommandStats command_stats;
 
     Context *context;
 
     GXPPtrMap gxp_ptr_map;
-    Queue<CommandList> command_buffer_queue;
+    RingQueue<CommandList, COMMAND_BUFFER_QUEUE_SIZE> command_buffer_queue;
     std::condition_variable command_finish_one;
     std::mutex command_finish_one_mutex;
 
@@ -57,7 +91,8 @@ struct State {
     int last_scene_id = 0;
 
     uint32_t shaders_count_compiled = 0;
-    uint32_t programs_count_pre_compiled = 0;
+    // Also written by the precompilation workers
+    std::atomic<uint32_t> programs_count_pre_compiled = 0;
 
     bool should_display;
 
@@ -73,7 +108,9 @@ struct State {
         return { "Automatic" };
     }
 
-    virtual void precompile_shader(const ShadersHash &hash) = 0;
+    // Precompiles the programs of shaders_cache_hashs, called on every frame of the boot screen until it returns true.
+    // The remaining ones may keep being compiled in the background once it has.
+    virtual bool precompile_shaders() = 0;
     virtual void preclose_action() = 0;
 
     virtual ~State() = default;
@@ -21,14 +21,22 @@
 
 #include <gxm/types.h>
 
-#include <array>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 struct MemState;
 
 namespace renderer {
-static constexpr size_t TextureCacheSize = 1024;
+static constexpr size_t DEFAULT_TEXTURE_CACHE_SIZE = 1024;
+static constexpr uint32_t TEXTURE_CACHE_NO_INDEX = UINT32_MAX;
+// Memory kept for textures decompressed on the CPU
+static constexpr size_t DECODED_TEXTURE_CACHE_SIZE = 64 * 1024 * 1024;
 typedef uint64_t TextureCacheTimestamp;
 typedef uint32_t TextureCacheHash;
 enum class Backend : uint32_t;
@@ -37,8 +45,13 @@ struct TextureCacheInfo {
     bool use_hash = false;
     bool dirty = false;
     TextureCacheHash hash = 0;
+    TextureCacheHash sample_hash = 0;
+    uint64_t hash_frame = 0; // Frame during which the whole texture was last hashed
     uint64_t timestamp = 0;
     SceGxmTexture texture;
+    // Neighbours in the LRU list, towards the most and least recently used entries
+    uint32_t lru_newer = TEXTURE_CACHE_NO_INDEX;
+    uint32_t lru_older = TEXTURE_CACHE_NO_INDEX;
 
     explicit TextureCacheInfo(SceGxmTexture texture)
         : texture(texture) {}
@@ -46,9 +59,40 @@ struct TextureCacheInfo {
     TextureCacheInfo() = default;
 };
 
+// Texture descriptors are compared bytewise, the cache key is the whole descriptor
+struct TextureCacheKeyHash {
+    size_t operator()(const SceGxmTexture &texture) const;
+};
+
+struct TextureCacheKeyEqual {
+    bool operator()(const SceGxmTexture &lhs, const SceGxmTexture &rhs) const {
+        return memcmp(&lhs, &rhs, sizeof(SceGxmTexture)) == 0;
+    }
+};
+
+struct TextureCacheStats {
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    std::atomic<uint64_t> evictions{ 0 };
+};
+
+// Pixels of a texture decompressed on the CPU
+struct DecodedTexture {
+    uint64_t key = 0;
+    std::vector<uint8_t> pixels;
+    size_t source_size = 0;
+};
+
+// Most recently used first, keyed by hash of the compressed data, its format and its size,
+// so that uploading the same data again skips decompressing it
+typedef std::list<DecodedTexture> DecodedTextureCache;
+typedef std::unordered_map<uint64_t, DecodedTextureCache::iterator> DecodedTextureIndex;
+
 struct TextureCacheState;
 
-typedef std::array<TextureCacheInfo, TextureCacheSize> TextureCacheInfoes;
+// Allocated once when the cache is initialized, entries must not move as texture protections point to them
+typedef std::vector<TextureCacheInfo> TextureCacheInfoes;
+typedef std::unordered_map<SceGxmTexture, uint32_t, TextureCacheKeyHash, TextureCacheKeyEqual> TextureCacheLookup;
 typedef std::function<void(std::size_t, const void *)> TextureCacheStateSelectCallback;
 typedef std::function<void(TextureCacheState &, const void *)> TextureCacheStateConfigureTextureCallback;
 typedef std::function<void(SceGxmTextureBaseFormat base_format, uint32_t width, uint32_t height, uint32_t mip_index, const void *pixels, int face, bool is_compressed, size_t pixels_per_stride)> TextureCacheStateUploadTextureCallback;
@@ -56,11 +100,19 @@ typedef std::function<void()> TextureCacheStateUploadDoneCallback;
 
 struct TextureCacheState {
     Backend *backend;
+    TextureCacheStats *stats = nullptr;
     bool use_protect = false;
     int anisotropic_filtering = 1;
     size_t used = 0;
     TextureCacheTimestamp timestamp = 1;
+    uint64_t frame = 1; // Increased every time the guest queues a frame for display
     TextureCacheInfoes infoes;
+    TextureCacheLookup lookup;
+    uint32_t lru_newest = TEXTURE_CACHE_NO_INDEX;
+    uint32_t lru_oldest = TEXTURE_CACHE_NO_INDEX;
+    DecodedTextureCache decoded;
+    DecodedTextureIndex decoded_index;
+    size_t decoded_size = 0;
     TextureCacheStateSelectCallback select_callback;
     TextureCacheStateConfigureTextureCallback configure_texture_callback;
     TextureCacheStateUploadTextureCallback upload_texture_callback;
@@ -37,11 +37,18 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     void *indices, size_t count, uint32_t instance_count, MemState &mem, const Config &config);
 
 void new_frame(VKContext &context);
+// Copies the color surface of the last scene. The copy is written to guest memory when the guest first accesses it,
+// or right away if immediate is set. The surface memory must be unprotected when calling this function.
+void readback_surface(VKContext &context, MemState &mem, const SceGxmColorSurface &surface, const bool immediate);
+// Writes the pending copies to guest memory and destroys the readback objects, must be called before the context is destroyed
+void destroy_readbacks(VKContext &context, MemState &mem);
 void update_sync_target(SceGxmSyncObject *sync, VKRenderTarget *target);
 void update_sync_signal(SceGxmSyncObject *sync);
 
 void set_context(VKContext &context, const MemState &mem, VKRenderTarget *rt, const FeatureState &features);
 void set_uniform_buffer(VKContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data);
+// Uploads the uniform storage if a uniform buffer has been set since the last draw, unless a recent identical copy is in the ring buffer
+void upload_uniform_storage(vkutil::RingBuffer &ring_buffer, UniformStorage &storage, vk::CommandBuffer cmd_buffer);
 
 void sync_clipping(VKContext &context);
 void sync_stencil_func(VKContext &context, const bool is_back);
@@ -60,7 +67,7 @@ void refresh_pipeline(VKContext &context);
 
 namespace texture {
 
-bool init(VKTextureCacheState &cache, const bool hashless_texture_cache);
+bool init(VKTextureCacheState &cache, const bool hashless_texture_cache, const size_t capacity);
 
 void configure_bound_texture(VKTextureCacheState &cache, const SceGxmTexture &gxm_texture);
 vk::Sampler create_sampler(VKState &state, const SceGxmTexture &gxm_texture, const uint16_t mip_count = 1);
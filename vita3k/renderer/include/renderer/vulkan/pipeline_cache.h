@@ -18,23 +18,32 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include <vkutil/objects.h>
 
+struct Config;
 struct SceGxmProgram;
 enum SceGxmPrimitiveType : uint32_t;
 struct SceGxmVertexAttribute;
 struct MemState;
+class ThreadPool;
 
 using Sha256Hash = std::array<uint8_t, 32>;
 
 namespace renderer::vulkan {
 struct VKState;
 struct VKContext;
+struct PipelineDescription;
 
 class PipelineCache {
 private:
@@ -61,9 +70,42 @@ private:
     std::vector<vk::VertexInputBindingDescription> binding_descr;
     std::vector<vk::VertexInputAttributeDescription> attr_descr;
 
+    // Asynchronous compilation: shaders and pipelines are created by the shared thread pool,
+    // and only moved to the maps above by the render thread once they are done
+    struct PendingShader {
+        std::shared_future<vk::ShaderModule> module;
+        bool is_vertex;
+    };
+    struct PendingPipeline {
+        std::shared_future<vk::Pipeline> pipeline;
+        uint64_t fallback_key;
+    };
+
+    std::map<Sha256Hash, PendingShader> pending_shaders;
+    std::unordered_map<uint64_t, PendingPipeline> pending_pipelines;
+    // Last pipeline created with a given pair of shaders, vertex layout, primitive type and render pass.
+    // It only differs by fixed function states from the ones it stands in for while they compile.
+    std::unordered_map<uint64_t, vk::Pipeline> fallback_pipelines;
+
+    // Shader modules of the disk cache created by the shared thread pool at boot, moved to shaders by the render thread
+    std::mutex precompiled_mutex;
+    std::vector<std::pair<Sha256Hash, vk::ShaderModule>> precompiled_shaders;
+    std::atomic<bool> has_precompiled = false;
+    std::vector<std::future<void>> precompile_jobs;
+    // Set by cleanup, the precompile jobs not started yet return right away
+    std::atomic<bool> cancel_precompile = false;
+    bool precompile_started = false;
+    std::chrono::steady_clock::time_point precompile_start;
+
     vk::PipelineShaderStageCreateInfo retrieve_shader(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, MemState &mem, const std::vector<SceGxmVertexAttribute> *hint_attributes);
+    std::shared_future<vk::ShaderModule> retrieve_shader_async(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, const std::vector<SceGxmVertexAttribute> *hint_attributes);
+    void add_compiled_shader(const Sha256Hash &hash, vk::ShaderModule shader, bool is_vertex);
+    void collect_compiled();
+    void collect_precompiled();
+    void record_hitch(std::chrono::steady_clock::time_point start);
     vk::PipelineLayout retrieve_pipeline_layout(const uint16_t vert_texture_count, const uint16_t frag_texture_count);
     vk::PipelineVertexInputStateCreateInfo get_vertex_input_state(MemState &mem);
+    PipelineDescription describe_pipeline(VKContext &context, SceGxmPrimitiveType type, MemState &mem);
 
 public:
     // if not 0, next time the pipeline cache should be saved (in seconds since epoch)
@@ -80,14 +122,21 @@ public:
     vk::PipelineLayout pipeline_layouts[17][17] = {};
 
     explicit PipelineCache(VKState &state);
+    ~PipelineCache();
     void init();
+    // Waits for the pipelines being compiled, must be called before the device is destroyed
+    void cleanup();
 
     void read_pipeline_cache();
     void save_pipeline_cache();
 
     vk::RenderPass retrieve_render_pass(vk::Format format, uint32_t zls_control);
-    vk::Pipeline retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem);
+    // With asynchronous compilation, can return a fallback pipeline or nullptr if the draw must be skipped.
+    // context.refresh_pipeline is then set so that the right pipeline is retrieved again on the next draw.
+    vk::Pipeline retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem, const Config &config);
 
     bool precompile_shader(const Sha256Hash &hash);
+    // Loads the shaders of the disk cache on the shared thread pool, see State::precompile_shaders
+    bool precompile_shaders();
 };
 } // namespace renderer::vulkan
\ No newline at end of file
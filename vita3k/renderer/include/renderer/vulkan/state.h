@@ -75,7 +75,7 @@ struct VKState : public renderer::State {
     void set_anisotropic_filtering(int anisotropic_filtering) override;
     std::vector<std::string> get_gpu_list() override;
 
-    void precompile_shader(const ShadersHash &hash) override;
+    bool precompile_shaders() override;
     void preclose_action() override;
 };
 } // namespace renderer::vulkan
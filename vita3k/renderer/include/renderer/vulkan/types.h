@@ -22,6 +22,10 @@
 
 #include <vkutil/objects.h>
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 namespace renderer::vulkan {
 
 struct VKState;
@@ -29,6 +33,7 @@ struct VKRenderTarget;
 
 constexpr int MAX_FRAMES_RENDERING = 3;
 constexpr int NB_TEXTURE_STAGING_BUFFERS = 16;
+constexpr int NB_SURFACE_READBACKS = 4;
 
 struct TextureStagingBuffer {
     vkutil::Buffer buffer;
@@ -52,7 +57,7 @@ struct VKTextureCacheState : public renderer::TextureCacheState {
     uint32_t staging_idx = 0;
     uint64_t last_waited_scene = 0;
 
-    std::array<TextureCacheEntry, TextureCacheSize> textures;
+    std::vector<TextureCacheEntry> textures;
 
     TextureCacheEntry *current_texture = nullptr;
     const SceGxmTexture *gxm_texture = nullptr;
@@ -77,6 +82,67 @@ struct FrameObject {
     vkutil::DestroyQueue destroy_queue;
 };
 
+// copy of guest vertex or index data in a ring buffer
+struct StreamCacheEntry {
+    uint32_t size;
+    uint64_t hash;
+    // ring buffer position and offset of the copy
+    uint64_t position;
+    uint32_t offset;
+};
+
+// copies of guest vertex or index data reused by the following draws as long as
+// the guest data is the same and the ring buffer has not overwritten them
+struct StreamCache {
+    // key is the guest data pointer for vertex and index data, the content hash for uniforms
+    std::unordered_map<uint64_t, StreamCacheEntry> entries;
+
+    // bytes copied to the ring buffer and bytes whose copy was reused, for the current and the last frame
+    uint64_t bytes_uploaded = 0;
+    uint64_t bytes_reused = 0;
+    uint64_t last_frame_bytes_uploaded = 0;
+    uint64_t last_frame_bytes_reused = 0;
+};
+
+// copy of a color surface waiting to be written to guest memory
+struct SurfaceReadback {
+    vkutil::Buffer buffer;
+    vk::CommandBuffer cmd_buffer;
+    vk::Fence fence;
+    // the fence has been submitted since it was last reset
+    bool submitted = false;
+
+    // the following fields are only accessed with the memory protect mutex held
+    // the copy has not been written to guest memory yet
+    bool pending = false;
+    // changed each time the readback is reused, the protect callbacks of previous surfaces then do nothing
+    uint64_t generation = 0;
+    Address address = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bytes_per_pixel = 0;
+    uint32_t stride_in_bytes = 0;
+    // size in bytes of the guest surface
+    uint32_t size = 0;
+    // size in bytes of a row in the buffer
+    uint32_t buffer_row_size = 0;
+    // the surface is rendered at a higher resolution, only one pixel out of res_multiplier is written back in each direction
+    uint32_t res_multiplier = 1;
+};
+
+// uniform buffers of a shader stage, gathered on the CPU and uploaded at draw time
+// only if no identical copy is left in the ring buffer
+struct UniformStorage {
+    std::vector<uint8_t> data;
+    // size of the storage of the current program
+    uint32_t size = 0;
+    // a uniform buffer has been set since the last upload
+    bool dirty = false;
+    // offset in the ring buffer of the storage used by the next draw
+    uint32_t offset = 0;
+    StreamCache cache;
+};
+
 struct VKContext : public renderer::Context {
     // GXM Context Info
     VKState &state;
@@ -93,11 +159,19 @@ struct VKContext : public renderer::Context {
     vkutil::LocalRingBuffer vertex_info_uniform_buffer;
     vkutil::LocalRingBuffer fragment_info_uniform_buffer;
 
+    StreamCache vertex_stream_cache;
+    StreamCache index_stream_cache;
+
+    // copies of the color surfaces, used in turn. Shared with the protect callbacks, which can outlive the context
+    std::array<std::shared_ptr<SurfaceReadback>, NB_SURFACE_READBACKS> readbacks;
+    uint32_t readback_idx = 0;
+    vk::CommandPool readback_pool;
+
     vk::DescriptorImageInfo vertex_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
     vk::DescriptorImageInfo fragment_textures[SCE_GXM_MAX_TEXTURE_UNITS] = {};
 
-    bool vertex_uniform_storage_allocated = false;
-    bool fragment_uniform_storage_allocated = false;
+    UniformStorage vertex_uniform_storage;
+    UniformStorage fragment_uniform_storage;
 
     std::array<vk::DeviceSize, SCE_GXM_MAX_VERTEX_STREAMS> vertex_buffer_offsets = {};
 
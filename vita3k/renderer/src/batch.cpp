@@ -24,19 +24,94 @@
 #include <renderer/vulkan/types.h>
 
 #include <config/state.h>
-#include <functional>
 #include <util/log.h>
 #include <util/string_utils.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 struct FeatureState;
 
 namespace renderer {
+// Commands not allocated by a context, carved out of slabs which are kept until exit.
+// Freed commands go to a shared lock-free list which submitting threads take as a whole
+// when their own list runs out, so the lock is only taken to add a slab.
+// A thread's own list goes back to the shared one when the thread exits.
+class CommandSlabPool {
+public:
+    Command *allocate() {
+        thread_local LocalFreeList local_free_list;
+
+        if (!local_free_list.first) {
+            local_free_list.pool = this;
+            local_free_list.first = returned.exchange(nullptr, std::memory_order_acquire);
+        }
+        if (!local_free_list.first)
+            local_free_list.first = new_slab();
+
+        Command *cmd = local_free_list.first;
+        local_free_list.first = cmd->next;
+
+        return new (cmd) Command;
+    }
+
+    void free(Command *cmd) {
+        give_back(cmd, cmd);
+    }
+
+private:
+    static constexpr size_t SLAB_SIZE = 256;
+
+    struct LocalFreeList {
+        CommandSlabPool *pool = nullptr;
+        Command *first = nullptr;
+
+        ~LocalFreeList() {
+            if (!first)
+                return;
+
+            Command *last = first;
+            while (last->next)
+                last = last->next;
+            pool->give_back(first, last);
+        }
+    };
+
+    // Pushes the commands from first to last, already linked together
+    void give_back(Command *first, Command *last) {
+        last->next = returned.load(std::memory_order_relaxed);
+        while (!returned.compare_exchange_weak(last->next, first, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    Command *new_slab() {
+        auto slab = std::make_unique<Command[]>(SLAB_SIZE);
+        for (size_t i = 0; i < SLAB_SIZE - 1; i++)
+            slab[i].next = &slab[i + 1];
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        slabs.push_back(std::move(slab));
+
+        return slabs.back().get();
+    }
+
+    std::atomic<Command *> returned = nullptr;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Command[]>> slabs;
+};
+
+static CommandSlabPool generic_command_pool;
+
 Command *generic_command_allocate() {
-    return new Command;
+    return generic_command_pool.allocate();
 }
 
 void generic_command_free(Command *cmd) {
-    delete cmd;
+    generic_command_pool.free(cmd);
 }
 
 void complete_command(State &state, CommandHelper &helper, const int code) {
@@ -66,43 +141,83 @@ bool wait_cmd(MemState &mem, CommandList &command_list) {
     return renderer::wishlist(sync, timestamp, 500);
 }
 
-void process_batch(renderer::State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list) {
-    using CommandHandlerFunc = std::function<void(renderer::State &, MemState &, Config &,
-        CommandHelper &, const FeatureState &, Context *, const char *, const char *, const char *)>;
-
-    const static std::map<CommandOpcode, CommandHandlerFunc> handlers = {
-        { CommandOpcode::SetContext, cmd_handle_set_context },
-        { CommandOpcode::SyncSurfaceData, cmd_handle_sync_surface_data },
-        { CommandOpcode::CreateContext, cmd_handle_create_context },
-        { CommandOpcode::CreateRenderTarget, cmd_handle_create_render_target },
-        { CommandOpcode::Draw, cmd_handle_draw },
-        { CommandOpcode::TransferCopy, cmd_handle_transfer_copy },
-        { CommandOpcode::TransferDownscale, cmd_handle_transfer_downscale },
-        { CommandOpcode::TransferFill, cmd_handle_transfer_fill },
-        { CommandOpcode::Nop, cmd_handle_nop },
-        { CommandOpcode::SetState, cmd_handle_set_state },
-        { CommandOpcode::SignalSyncObject, cmd_handle_signal_sync_object },
-        { CommandOpcode::WaitSyncObject, cmd_handle_wait_sync_object },
-        { CommandOpcode::SignalNotification, cmd_handle_notification },
-        { CommandOpcode::NewFrame, cmd_new_frame },
-        { CommandOpcode::DestroyRenderTarget, cmd_handle_destroy_render_target },
-        { CommandOpcode::DestroyContext, cmd_handle_destroy_context }
+typedef void (*CommandHandlerFunc)(renderer::State &, MemState &, Config &, CommandHelper &, const FeatureState &, Context *, const char *, const char *, const char *);
+
+struct CommandHandler {
+    CommandHandlerFunc func;
+    const char *name;
+};
+
+static constexpr std::array<CommandHandler, COMMAND_OPCODE_COUNT> command_handlers = [] {
+    std::array<CommandHandler, COMMAND_OPCODE_COUNT> handlers{};
+    const auto set = [&](CommandOpcode opcode, CommandHandlerFunc func, const char *name) {
+        handlers[static_cast<size_t>(opcode)] = { func, name };
     };
 
+    set(CommandOpcode::SetContext, cmd_handle_set_context, "SetContext");
+    set(CommandOpcode::SyncSurfaceData, cmd_handle_sync_surface_data, "SyncSurfaceData");
+    set(CommandOpcode::CreateContext, cmd_handle_create_context, "CreateContext");
+    set(CommandOpcode::CreateRenderTarget, cmd_handle_create_render_target, "CreateRenderTarget");
+    set(CommandOpcode::Draw, cmd_handle_draw, "Draw");
+    set(CommandOpcode::TransferCopy, cmd_handle_transfer_copy, "TransferCopy");
+    set(CommandOpcode::TransferDownscale, cmd_handle_transfer_downscale, "TransferDownscale");
+    set(CommandOpcode::TransferFill, cmd_handle_transfer_fill, "TransferFill");
+    set(CommandOpcode::Nop, cmd_handle_nop, "Nop");
+    set(CommandOpcode::SetState, cmd_handle_set_state, "SetState");
+    set(CommandOpcode::SignalSyncObject, cmd_handle_signal_sync_object, "SignalSyncObject");
+    set(CommandOpcode::WaitSyncObject, cmd_handle_wait_sync_object, "WaitSyncObject");
+    set(CommandOpcode::SignalNotification, cmd_handle_notification, "SignalNotification");
+    set(CommandOpcode::NewFrame, cmd_new_frame, "NewFrame");
+    set(CommandOpcode::DestroyRenderTarget, cmd_handle_destroy_render_target, "DestroyRenderTarget");
+    set(CommandOpcode::DestroyContext, cmd_handle_destroy_context, "DestroyContext");
+
+    return handlers;
+}();
+
+// Frames between two histograms written to the log
+static constexpr uint64_t COMMAND_STATS_LOG_INTERVAL = 60;
+
+static void end_command_stats_frame(CommandStats &stats) {
+    stats.last_frame = stats.frame;
+    stats.frame = {};
+
+    if (++stats.frame_count % COMMAND_STATS_LOG_INTERVAL != 0)
+        return;
+
+    std::string histogram;
+    for (size_t opcode = 0; opcode < COMMAND_OPCODE_COUNT; opcode++) {
+        const CommandOpcodeStats &opcode_stats = stats.last_frame[opcode];
+        if (opcode_stats.count == 0)
+            continue;
+
+        histogram += fmt::format(" {} {} ({:.3f}ms)", command_handlers[opcode].name, opcode_stats.count, opcode_stats.time_ns / 1000000.0);
+    }
+    LOG_INFO("Commands of frame {}:{}", stats.frame_count, histogram);
+}
+
+void process_batch(renderer::State &state, const FeatureState &features, MemState &mem, Config &config, CommandList &command_list) {
+    const bool log_command_stats = config.log_command_stats;
     Command *cmd = command_list.first;
 
     // Take a batch, and execute it. Hope it's not too large
-    do {
-        if (cmd == nullptr) {
-            break;
-        }
+    while (cmd != nullptr) {
+        const size_t opcode = static_cast<size_t>(cmd->opcode);
+        const CommandHandlerFunc handler = (opcode < COMMAND_OPCODE_COUNT) ? command_handlers[opcode].func : nullptr;
+        if (!handler) {
+            LOG_ERROR("Unimplemented command opcode {}", opcode);
+        } else if (log_command_stats) {
+            const auto start = std::chrono::steady_clock::now();
+            CommandHelper helper(cmd);
+            handler(state, mem, config, helper, features, command_list.context, state.base_path, state.title_id, state.self_name);
 
-        auto handler = handlers.find(cmd->opcode);
-        if (handler == handlers.end()) {
-            LOG_ERROR("Unimplemented command opcode {}", static_cast<int>(cmd->opcode));
+            CommandOpcodeStats &opcode_stats = state.command_stats.frame[opcode];
+            opcode_stats.count++;
+            opcode_stats.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            if (cmd->opcode == CommandOpcode::NewFrame)
+                end_command_stats_frame(state.command_stats);
         } else {
             CommandHelper helper(cmd);
-            handler->second(state, mem, config, helper, features, command_list.context, state.base_path, state.title_id, state.self_name);
+            handler(state, mem, config, helper, features, command_list.context, state.base_path, state.title_id, state.self_name);
         }
 
         Command *last_cmd = cmd;
@@ -113,13 +228,13 @@ void process_batch(renderer::State &state, const FeatureState &features, MemStat
         } else {
             generic_command_free(last_cmd);
         }
-    } while (true);
+    }
 }
 
 void process_batches(renderer::State &state, const FeatureState &features, MemState &mem, Config &config) {
     while (!state.should_display) {
         // Try to wait for a batch (about 2 or 3ms, game should be fast for this)
-        auto cmd_list = state.command_buffer_queue.top(3);
+        CommandList *cmd_list = state.command_buffer_queue.top(3);
 
         if (!cmd_list || !is_cmd_ready(mem, *cmd_list)) {
             // beginning of the game or homebrew not using gxm
@@ -135,8 +250,10 @@ void process_batches(renderer::State &state, const FeatureState &features, MemSt
                 continue;
         }
 
+        // the slot is reused as soon as it is popped
+        CommandList command_list = *cmd_list;
         state.command_buffer_queue.pop();
-        process_batch(state, features, mem, config, *cmd_list);
+        process_batch(state, features, mem, config, command_list);
     }
 }
 
@@ -34,6 +34,8 @@
 #include <util/string_utils.h>
 #include <util/tracy.h>
 
+#include <algorithm>
+
 namespace renderer {
 
 static void layout_ssbo_offset_from_uniform_buffer_sizes(UniformBufferSizes &sizes, UniformBufferSizes &offsets, std::size_t &total_hold) {
@@ -90,6 +92,9 @@ COMMAND(handle_create_context) {
 COMMAND(handle_destroy_context) {
     TRACY_FUNC_COMMANDS(handle_destroy_context);
     std::unique_ptr<Context> *ctx = helper.pop<std::unique_ptr<Context> *>();
+    // the protect callbacks of the pending readbacks write to guest memory
+    if (renderer.current_backend == Backend::Vulkan)
+        vulkan::destroy_readbacks(*reinterpret_cast<vulkan::VKContext *>(ctx->get()), mem);
     ctx->reset();
 
     complete_command(renderer, helper, 0);
@@ -225,12 +230,14 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
     switch (backend) {
     case Backend::OpenGL:
         state = std::make_unique<gl::GLState>();
+        state->texture_cache_size = std::max(config.texture_cache_size, 1);
         if (!gl::create(window, state, base_path, config.hashless_texture_cache))
             return false;
         break;
 
     case Backend::Vulkan:
         state = std::make_unique<vulkan::VKState>(config.gpu_idx);
+        state->texture_cache_size = std::max(config.texture_cache_size, 1);
         if (!vulkan::create(window, state, base_path))
             return false;
         break;
@@ -242,9 +249,6 @@ bool init(SDL_Window *window, std::unique_ptr<State> &state, Backend backend, co
 
     state->current_backend = backend;
 
-    // Can change this
-    state->command_buffer_queue.maxPendingCount_ = 30;
-
     return true;
 }
 } // namespace renderer
@@ -153,13 +153,15 @@ static SharedGLObject compile_program(ProgramCache &program_cache, const SharedG
     return program;
 }
 
-static SharedGLObject compile_shader(const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, const std::string &hash_hex,
-    const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash) {
+static std::string load_shader(const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, const Sha256Hash &hash, const char *type_str) {
     // Set Shader version with hash
-    const std::string hash_hex_ver = shader_version + "-" + hash_hex;
+    const std::string hash_hex_ver = shader_version + "-" + convert_hash_to_hex(hash);
 
-    // Load Shader
-    const std::string shader = pre_load_shader_glsl(hash_hex_ver.c_str(), type_str, base_path, title_id, self_name);
+    return pre_load_shader_glsl(hash_hex_ver.c_str(), type_str, base_path, title_id, self_name);
+}
+
+static SharedGLObject compile_shader(const std::string &shader, const char *type_str, const GLenum type, ShaderCache &cache, const Sha256Hash &hash) {
+    const auto hash_hex = convert_hash_to_hex(hash);
     if (shader.empty()) {
         LOG_WARN("{} shader is empty or not found:\n{}", type_str, hash_hex);
         return SharedGLObject();
@@ -187,31 +189,35 @@ static std::vector<ShadersHash>::iterator get_shaders_hash_index(std::vector<Sha
     return shader_hash_index;
 }
 
-void pre_compile_program(GLState &renderer, const char *base_path, const char *title_id, const char *self_name, const ShadersHash &hash) {
+ProgramSources pre_load_program(const char *base_path, const char *title_id, const char *self_name, const std::string &shader_version, const ShadersHash &hash) {
     const auto shader_path{ fs::path(base_path) / "cache/shaders" / title_id / self_name };
-    if (fs::exists(shader_path) && !fs::is_empty(shader_path)) {
-        // Compile Fragment Shader
-        const auto frag_hash_hex = convert_hash_to_hex(hash.frag);
-        const SharedGLObject frag_shader = compile_shader(base_path, title_id, self_name, renderer.shader_version,
-            frag_hash_hex, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag);
-        if (!frag_shader) {
-            return;
-        }
+    if (!fs::exists(shader_path) || fs::is_empty(shader_path))
+        return {};
 
-        // Compile Vertex Shader
-        const auto vert_hash_hex = convert_hash_to_hex(hash.vert);
-        const SharedGLObject vert_shader = compile_shader(base_path, title_id, self_name, renderer.shader_version,
-            vert_hash_hex, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert);
-        if (!vert_shader) {
-            return;
-        }
+    return {
+        load_shader(base_path, title_id, self_name, shader_version, hash.frag, "frag"),
+        load_shader(base_path, title_id, self_name, shader_version, hash.vert, "vert")
+    };
+}
+
+void pre_compile_program(GLState &renderer, const ShadersHash &hash, const ProgramSources &sources) {
+    // Compile Fragment Shader
+    const SharedGLObject frag_shader = compile_shader(sources.frag, "frag", GL_FRAGMENT_SHADER, renderer.fragment_shader_cache, hash.frag);
+    if (!frag_shader) {
+        return;
+    }
 
-        // Compile Program
-        const ProgramHashes hashes(hash.frag, hash.vert);
-        compile_program(renderer.program_cache, frag_shader, vert_shader, hashes);
-        renderer.programs_count_pre_compiled++;
-        LOG_INFO("Program Compiled {}/{}", renderer.programs_count_pre_compiled, renderer.shaders_cache_hashs.size());
+    // Compile Vertex Shader
+    const SharedGLObject vert_shader = compile_shader(sources.vert, "vert", GL_VERTEX_SHADER, renderer.vertex_shader_cache, hash.vert);
+    if (!vert_shader) {
+        return;
     }
+
+    // Compile Program
+    const ProgramHashes hashes(hash.frag, hash.vert);
+    compile_program(renderer.program_cache, frag_shader, vert_shader, hashes);
+    const uint32_t count = ++renderer.programs_count_pre_compiled;
+    LOG_INFO("Program Compiled {}/{}", count, renderer.shaders_cache_hashs.size());
 }
 
 static SharedGLObject get_or_compile_shader(const SceGxmProgram *program, const FeatureState &features, const Sha256Hash &hash,
@@ -33,11 +33,13 @@
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <util/log.h>
+#include <util/thread_pool.h>
 
 #include <SDL.h>
 #include <SDL_video.h>
 
 #include <cassert>
+#include <chrono>
 #include <sstream>
 
 namespace renderer::gl {
@@ -54,7 +56,7 @@ GLContext::GLContext()
 }
 
 namespace texture {
-bool init(GLTextureCacheState &cache, const bool hashless_texture_cache) {
+bool init(GLTextureCacheState &cache, const bool hashless_texture_cache, const size_t capacity) {
     cache.select_callback = [&](const std::size_t index, const void *texture) {
         const SceGxmTexture *texture_casted = reinterpret_cast<const SceGxmTexture *>(texture);
 
@@ -71,8 +73,9 @@ bool init(GLTextureCacheState &cache, const bool hashless_texture_cache) {
     cache.upload_done_callback = []() {};
 
     cache.use_protect = hashless_texture_cache;
+    renderer::texture::init_cache(cache, capacity);
 
-    return cache.textures.init(reinterpret_cast<renderer::Generator *>(glGenTextures), reinterpret_cast<renderer::Deleter *>(glDeleteTextures));
+    return cache.textures.init(reinterpret_cast<renderer::Generator *>(glGenTextures), reinterpret_cast<renderer::Deleter *>(glDeleteTextures), cache.infoes.size());
 }
 } // namespace texture
 
@@ -277,7 +280,8 @@ bool create(SDL_Window *window, std::unique_ptr<State> &state, const char *base_
 
 bool GLState::init(const char *base_path, const bool hashless_texture_cache) {
     texture_cache.backend = &current_backend;
-    if (!texture::init(texture_cache, hashless_texture_cache)) {
+    texture_cache.stats = &texture_cache_stats;
+    if (!texture::init(texture_cache, hashless_texture_cache, texture_cache_size)) {
         LOG_ERROR("Failed to initialize texture cache!");
         return false;
     }
@@ -760,8 +764,33 @@ void GLState::set_anisotropic_filtering(int anisotropic_filtering) {
     texture_cache.anisotropic_filtering = anisotropic_filtering;
 }
 
-void GLState::precompile_shader(const ShadersHash &hash) {
-    pre_compile_program(*this, base_path, title_id, self_name, hash);
+// Time spent compiling programs on every frame of the boot screen
+static constexpr auto PRECOMPILE_FRAME_TIME = std::chrono::milliseconds(16);
+
+bool GLState::precompile_shaders() {
+    if (precompile_sources.empty()) {
+        precompile_sources.reserve(shaders_cache_hashs.size());
+        for (const ShadersHash &hash : shaders_cache_hashs) {
+            precompile_sources.push_back(ThreadPool::shared().submit([base_path = base_path, title_id = title_id, self_name = self_name, shader_version = shader_version, hash] {
+                return pre_load_program(base_path, title_id, self_name, shader_version, hash);
+            }));
+        }
+    }
+
+    // GL objects can only be created on this thread
+    const auto deadline = std::chrono::steady_clock::now() + PRECOMPILE_FRAME_TIME;
+    while (precompile_next < precompile_sources.size() && std::chrono::steady_clock::now() < deadline) {
+        pre_compile_program(*this, shaders_cache_hashs[precompile_next], precompile_sources[precompile_next].get());
+        precompile_next++;
+    }
+
+    if (precompile_next < precompile_sources.size())
+        return false;
+
+    precompile_sources.clear();
+    precompile_next = 0;
+
+    return true;
 }
 
 void GLState::preclose_action() {}
@@ -39,6 +39,7 @@
 #include <vector>
 
 #include <renderer/pvrt-dec.h>
+#include <util/thread_pool.h>
 
 namespace pvr {
 enum {
@@ -46,6 +47,8 @@ enum {
     ETC_MIN_TEXHEIGHT = 4,
     DXT_MIN_TEXWIDTH = 4,
     DXT_MIN_TEXHEIGHT = 4,
+    // Big textures are decompressed in parts of about this many words, big enough to be worth sending to another thread
+    DECOMPRESS_WORDS_PER_PART = 2048,
 };
 
 struct Pixel32 {
@@ -349,7 +352,7 @@ static void unpackModulations(const PVRTCWord &word, const PVRTCWord &nwWord, in
                     if (isII && hardTransitionBit && (y + offsetY >= 2) && (y + offsetY <= 5)
                         && (x + offsetX >= 2) && (x + offsetX <= 5)) {
                         // Use palette built up
-                        i32ModulationValues += 30;
+                        i32ModulationValues[y + offsetY][x + offsetX] += 30;
                     } else {
                         // if (i32ModulationValues==0) {}. We don't need to check 0, 0 = 0/8.
                         if (i32ModulationValues[y + offsetY][x + offsetX] == 1) {
@@ -727,7 +730,7 @@ static void mapDecompressedData(Pixel32 *pOutput, int width, const Pixel32 *pWor
         }
     }
 }
-static int pvrtcDecompress(uint8_t *pCompressedData, Pixel32 *pDecompressedData, uint32_t ui32Width, uint32_t ui32Height, uint8_t ui8Bpp, uint32_t uiII) {
+static int pvrtcDecompress(uint8_t *pCompressedData, Pixel32 *pDecompressedData, uint32_t ui32Width, uint32_t ui32Height, uint8_t ui8Bpp, uint32_t uiII, ThreadPool *pool) {
     uint32_t ui32WordWidth = 4;
     uint32_t ui32WordHeight = 4;
     if (ui8Bpp == 2) {
@@ -741,54 +744,78 @@ static int pvrtcDecompress(uint8_t *pCompressedData, Pixel32 *pDecompressedData,
     int i32NumXWords = static_cast<int>(ui32Width / ui32WordWidth);
     int i32NumYWords = static_cast<int>(ui32Height / ui32WordHeight);
 
-    // Structs used for decompression
-    PVRTCWordIndices indices;
-    std::vector<Pixel32> pPixels(ui32WordWidth * ui32WordHeight);
-
-    // For each row of words
-    for (int wordY = -1; wordY < i32NumYWords - 1; wordY++) {
-        // for each column of words
-        for (int wordX = -1; wordX < i32NumXWords - 1; wordX++) {
-            indices.P[0] = wrapWordIndex(i32NumXWords, wordX);
-            indices.P[1] = wrapWordIndex(i32NumYWords, wordY);
-            indices.Q[0] = wrapWordIndex(i32NumXWords, wordX + 1);
-            indices.Q[1] = wrapWordIndex(i32NumYWords, wordY);
-            indices.R[0] = wrapWordIndex(i32NumXWords, wordX);
-            indices.R[1] = wrapWordIndex(i32NumYWords, wordY + 1);
-            indices.S[0] = wrapWordIndex(i32NumXWords, wordX + 1);
-            indices.S[1] = wrapWordIndex(i32NumYWords, wordY + 1);
-
-            // Work out the offsets into the twiddle structs, multiply by two as there are two members per word.
-            uint32_t WordOffsets[4] = {
-                TwiddleUV(i32NumXWords, i32NumYWords, indices.P[0], indices.P[1]) * 2,
-                TwiddleUV(i32NumXWords, i32NumYWords, indices.Q[0], indices.Q[1]) * 2,
-                TwiddleUV(i32NumXWords, i32NumYWords, indices.R[0], indices.R[1]) * 2,
-                TwiddleUV(i32NumXWords, i32NumYWords, indices.S[0], indices.S[1]) * 2,
-            };
-
-            // Access individual elements to fill out PVRTCWord
-            PVRTCWord P, Q, R, S;
-            P.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[0] + 1]);
-            P.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[0]]);
-            Q.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[1] + 1]);
-            Q.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[1]]);
-            R.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[2] + 1]);
-            R.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[2]]);
-            S.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[3] + 1]);
-            S.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[3]]);
-
-            // assemble 4 words into struct to get decompressed pixels from
-            pvrtcGetDecompressedPixels(P, Q, R, S, pPixels.data(), ui8Bpp, uiII);
-            mapDecompressedData(pOutData, ui32Width, pPixels.data(), indices, ui8Bpp);
-
-        } // for each word
-    } // for each row of words
+    // Twiddled offsets of the words of the first row and of the first column, multiplied by two as there are two members per word.
+    // The bits of the column and the row don't overlap, the offset of any word is the sum of the offsets of its column and its row.
+    std::vector<uint32_t> XWordOffsets(i32NumXWords);
+    for (int wordX = 0; wordX < i32NumXWords; wordX++)
+        XWordOffsets[wordX] = TwiddleUV(i32NumXWords, i32NumYWords, wordX, 0) * 2;
+    std::vector<uint32_t> YWordOffsets(i32NumYWords);
+    for (int wordY = 0; wordY < i32NumYWords; wordY++)
+        YWordOffsets[wordY] = TwiddleUV(i32NumXWords, i32NumYWords, 0, wordY) * 2;
+
+    // Each row of words writes the bottom half of a row of pixel words and the top half of the next one,
+    // so rows can be decompressed in any order
+    const auto decompressRows = [&](int firstWordY, int lastWordY) {
+        // Structs used for decompression
+        PVRTCWordIndices indices;
+        Pixel32 pPixels[8 * 4];
+
+        for (int wordY = firstWordY; wordY < lastWordY; wordY++) {
+            // for each column of words
+            for (int wordX = -1; wordX < i32NumXWords - 1; wordX++) {
+                indices.P[0] = wrapWordIndex(i32NumXWords, wordX);
+                indices.P[1] = wrapWordIndex(i32NumYWords, wordY);
+                indices.Q[0] = wrapWordIndex(i32NumXWords, wordX + 1);
+                indices.Q[1] = wrapWordIndex(i32NumYWords, wordY);
+                indices.R[0] = wrapWordIndex(i32NumXWords, wordX);
+                indices.R[1] = wrapWordIndex(i32NumYWords, wordY + 1);
+                indices.S[0] = wrapWordIndex(i32NumXWords, wordX + 1);
+                indices.S[1] = wrapWordIndex(i32NumYWords, wordY + 1);
+
+                // Work out the offsets into the twiddle structs.
+                uint32_t WordOffsets[4] = {
+                    XWordOffsets[indices.P[0]] + YWordOffsets[indices.P[1]],
+                    XWordOffsets[indices.Q[0]] + YWordOffsets[indices.Q[1]],
+                    XWordOffsets[indices.R[0]] + YWordOffsets[indices.R[1]],
+                    XWordOffsets[indices.S[0]] + YWordOffsets[indices.S[1]],
+                };
+
+                // Access individual elements to fill out PVRTCWord
+                PVRTCWord P, Q, R, S;
+                P.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[0] + 1]);
+                P.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[0]]);
+                Q.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[1] + 1]);
+                Q.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[1]]);
+                R.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[2] + 1]);
+                R.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[2]]);
+                S.u32ColorData = static_cast<uint32_t>(pWordMembers[WordOffsets[3] + 1]);
+                S.u32ModulationData = static_cast<uint32_t>(pWordMembers[WordOffsets[3]]);
+
+                // assemble 4 words into struct to get decompressed pixels from
+                pvrtcGetDecompressedPixels(P, Q, R, S, pPixels, ui8Bpp, uiII);
+                mapDecompressedData(pOutData, ui32Width, pPixels, indices, ui8Bpp);
+
+            } // for each word
+        } // for each row of words
+    };
+
+    // Rows of words go from -1 to i32NumYWords - 2, split them in parts big enough to be worth sending to another thread
+    const int rowsPerPart = std::max(1, DECOMPRESS_WORDS_PER_PART / i32NumXWords);
+    const int partCount = (i32NumYWords + rowsPerPart - 1) / rowsPerPart;
+    if (!pool || partCount < 2) {
+        decompressRows(-1, i32NumYWords - 1);
+    } else {
+        pool->parallel_for(partCount, [&](size_t part) {
+            const int firstWordY = static_cast<int>(part) * rowsPerPart - 1;
+            decompressRows(firstWordY, std::min(firstWordY + rowsPerPart, i32NumYWords - 1));
+        });
+    }
 
     // Return the data size
     return ui32Width * ui32Height / static_cast<uint32_t>((ui32WordWidth / 2));
 }
 
-uint32_t PVRTDecompressPVRTC(const void *pCompressedData, uint32_t Do2bitMode, uint32_t XDim, uint32_t YDim, uint32_t DoPvrtType, uint8_t *pResultImage) {
+uint32_t PVRTDecompressPVRTC(const void *pCompressedData, uint32_t Do2bitMode, uint32_t XDim, uint32_t YDim, uint32_t DoPvrtType, uint8_t *pResultImage, ThreadPool *pool) {
     // Cast the output buffer to a Pixel32 pointer.
     Pixel32 *pDecompressedData = (Pixel32 *)pResultImage;
     std::vector<Pixel32> pTempDataVector;
@@ -804,7 +831,7 @@ uint32_t PVRTDecompressPVRTC(const void *pCompressedData, uint32_t Do2bitMode, u
     }
 
     // Decompress the surface.
-    int retval = pvrtcDecompress((uint8_t *)pCompressedData, pDecompressedData, XTrueDim, YTrueDim, (Do2bitMode == 1 ? 2 : 4), DoPvrtType);
+    int retval = pvrtcDecompress((uint8_t *)pCompressedData, pDecompressedData, XTrueDim, YTrueDim, (Do2bitMode == 1 ? 2 : 4), DoPvrtType, pool);
 
     // If the dimensions were too small, then copy the new buffer back into the output buffer.
     if ((XTrueDim != XDim) || (YTrueDim != YDim)) {
@@ -106,7 +106,9 @@ COMMAND(handle_sync_surface_data) {
         }
     }
 
-    if (renderer.disable_surface_sync) {
+    // the Vulkan readbacks copy the surface of every scene, only games reading their surfaces need them
+    const bool readback_disabled = (renderer.current_backend == Backend::Vulkan) && !config.vulkan_surface_readback;
+    if (renderer.disable_surface_sync || readback_disabled) {
         if (helper.cmd->status)
             complete_command(renderer, helper, 0);
         return;
@@ -135,7 +137,7 @@ COMMAND(handle_sync_surface_data) {
         break;
 
     case Backend::Vulkan:
-        // not implemented for now
+        vulkan::readback_surface(*reinterpret_cast<vulkan::VKContext *>(renderer.context), mem, *surface, helper.cmd->status);
         break;
 
     default:
@@ -206,40 +208,21 @@ COMMAND(handle_transfer_copy) {
     const SceGxmTransferType dst_type = helper.pop<SceGxmTransferType>();
 
     if (src_type == dst_type) {
-        const auto src_bpp = gxm::get_bits_per_pixel(src->format);
-        const auto dest_bpp = gxm::get_bits_per_pixel(dest->format);
-        const uint32_t src_bytes_per_pixel = (src_bpp + 7) >> 3;
-        const uint32_t dest_bytes_per_pixel = (dest_bpp + 7) >> 3;
-
-        for (uint32_t x = 0; x < src->width; x++) {
-            for (uint32_t y = 0; y < src->height; y++) {
-                // Set offset of source and destination
-                const auto src_offset = ((x + src->x) * src_bytes_per_pixel) + ((y + src->y) * src->stride);
-                const auto dest_offset = ((x + dest->x) * dest_bytes_per_pixel) + ((y + dest->y) * dest->stride);
-
-                // Set pointer of source and destination
-                const auto src_ptr = (uint8_t *)src->address.get(mem) + src_offset;
-                auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
-
-                // Set color of source
-                const auto src_color = *(uint32_t *)src_ptr;
-
-                // Copy result in destination depending color Key
-                switch (colorKeyMode) {
-                case SCE_GXM_TRANSFER_COLORKEY_NONE:
-                    memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                case SCE_GXM_TRANSFER_COLORKEY_PASS:
-                    if ((src_color & colorKeyMask) == colorKeyValue)
-                        memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                case SCE_GXM_TRANSFER_COLORKEY_REJECT:
-                    if ((src_color & colorKeyMask) != colorKeyValue)
-                        memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-                    break;
-                default: break;
-                }
+        const uint32_t src_bytes_per_pixel = (gxm::get_bits_per_pixel(src->format) + 7) >> 3;
+        const uint32_t dest_bytes_per_pixel = (gxm::get_bits_per_pixel(dest->format) + 7) >> 3;
+
+        const uint8_t *src_row = static_cast<uint8_t *>(src->address.get(mem)) + src->x * src_bytes_per_pixel + static_cast<int64_t>(src->y) * src->stride;
+        uint8_t *dest_row = static_cast<uint8_t *>(dest->address.get(mem)) + dest->x * dest_bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
+
+        const TransferColorKey key = { colorKeyMode, colorKeyValue, colorKeyMask };
+        for (uint32_t y = 0; y < src->height; y++) {
+            if (!transfer_copy_row(dest_row, dest->format, src_row, src->format, src->width, key)) {
+                LOG_WARN("No conversion from SceGxmTransferFormat {} to {} support yet", log_hex(static_cast<uint32_t>(src->format)), log_hex(static_cast<uint32_t>(dest->format)));
+                break;
             }
+
+            src_row += src->stride;
+            dest_row += dest->stride;
         }
     } else
         LOG_WARN("No convertion of SceGxmTransferType support yet");
@@ -254,24 +237,18 @@ COMMAND(handle_transfer_downscale) {
     const SceGxmTransferImage *src = helper.pop<SceGxmTransferImage *>();
     const SceGxmTransferImage *dest = helper.pop<SceGxmTransferImage *>();
 
-    const auto src_bpp = gxm::get_bits_per_pixel(src->format);
-    const auto dest_bpp = gxm::get_bits_per_pixel(dest->format);
-    const uint32_t src_bytes_per_pixel = (src_bpp + 7) >> 3;
-    const uint32_t dest_bytes_per_pixel = (dest_bpp + 7) >> 3;
+    // Both images have the same format
+    const uint32_t bytes_per_pixel = (gxm::get_bits_per_pixel(src->format) + 7) >> 3;
 
-    for (uint32_t y = 0; y < src->height; y += 2) {
-        for (uint32_t x = 0; x < src->width; x += 2) {
-            // Set offset of source and destination
-            const auto src_offset = ((x + src->x) * src_bytes_per_pixel) + ((y + src->y) * src->stride);
-            const auto dest_offset = (x / 2 + dest->x) * dest_bytes_per_pixel + (y / 2 + dest->y) * dest->stride;
+    const uint8_t *src_row = static_cast<uint8_t *>(src->address.get(mem)) + src->x * bytes_per_pixel + static_cast<int64_t>(src->y) * src->stride;
+    uint8_t *dest_row = static_cast<uint8_t *>(dest->address.get(mem)) + dest->x * bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
 
-            // Set pointer of source and destination
-            const auto src_ptr = (uint8_t *)src->address.get(mem) + src_offset;
-            auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
+    const uint32_t dest_width = (src->width + 1) / 2;
+    for (uint32_t y = 0; y < src->height; y += 2) {
+        transfer_downscale_row(dest_row, src_row, dest_width, bytes_per_pixel);
 
-            // Copy result in destination
-            memcpy(dest_ptr, src_ptr, dest_bytes_per_pixel);
-        }
+        src_row += 2 * static_cast<int64_t>(src->stride);
+        dest_row += dest->stride;
     }
 
     // TODO: handle case where dest is a cached surface
@@ -285,20 +262,12 @@ COMMAND(handle_transfer_fill) {
     const uint32_t fill_color = helper.pop<uint32_t>();
     const SceGxmTransferImage *dest = helper.pop<SceGxmTransferImage *>();
 
-    const auto bpp = gxm::get_bits_per_pixel(dest->format);
+    const uint32_t bytes_per_pixel = (gxm::get_bits_per_pixel(dest->format) + 7) >> 3;
 
-    const uint32_t bytes_per_pixel = (bpp + 7) >> 3;
+    uint8_t *dest_row = static_cast<uint8_t *>(dest->address.get(mem)) + dest->x * bytes_per_pixel + static_cast<int64_t>(dest->y) * dest->stride;
     for (uint32_t y = 0; y < dest->height; y++) {
-        for (uint32_t x = 0; x < dest->width; x++) {
-            // Set offset of destination
-            const auto dest_offset = ((x + dest->x) * bytes_per_pixel) + ((y + dest->y) * dest->stride);
-
-            // Set pointer of destination
-            auto dest_ptr = (uint8_t *)dest->address.get(mem) + dest_offset;
-
-            // Fill color in destination
-            memcpy(dest_ptr, &fill_color, bytes_per_pixel);
-        }
+        transfer_fill_row(dest_row, dest->width, bytes_per_pixel, fill_color);
+        dest_row += dest->stride;
     }
 
     // TODO: handle case where dest is a cached surface
@@ -23,7 +23,9 @@
 #include <renderer/types.h>
 
 #include <renderer/gl/functions.h>
+#include <renderer/gl/state.h>
 #include <renderer/vulkan/functions.h>
+#include <renderer/vulkan/state.h>
 #include <renderer/vulkan/types.h>
 
 #include <renderer/functions.h>
@@ -78,8 +80,18 @@ COMMAND(handle_notification) {
 
 COMMAND(new_frame) {
     TRACY_FUNC_COMMANDS(new_frame);
-    if (renderer.current_backend == Backend::Vulkan) {
+    switch (renderer.current_backend) {
+    case Backend::OpenGL:
+        ++dynamic_cast<gl::GLState &>(renderer).texture_cache.frame;
+        break;
+
+    case Backend::Vulkan:
+        ++dynamic_cast<vulkan::VKState &>(renderer).texture_cache.frame;
         vulkan::new_frame(*reinterpret_cast<vulkan::VKContext *>(renderer.context));
+        break;
+
+    default:
+        break;
     }
 }
 
@@ -25,8 +25,10 @@
 #include <mem/ptr.h>
 #include <util/align.h>
 #include <util/log.h>
+#include <util/thread_pool.h>
 
-#include <algorithm> // find
+#include <algorithm> // clamp, find
+#include <array>
 #include <cstring> // memcmp
 #include <numeric> // accumulate, reduce
 #include <xxh3.h>
@@ -35,6 +37,11 @@
 #endif
 
 namespace renderer {
+
+size_t TextureCacheKeyHash::operator()(const SceGxmTexture &texture) const {
+    return static_cast<size_t>(XXH_INLINE_XXH3_64bits(&texture, sizeof(SceGxmTexture)));
+}
+
 namespace texture {
 
 static TextureCacheHash hash_data(const void *data, size_t size) {
@@ -48,10 +55,22 @@ static TextureCacheHash hash_palette_data(const SceGxmTexture &texture, size_t c
     return palette_hash;
 }
 
-TextureCacheHash hash_texture_data(const SceGxmTexture &texture, const MemState &mem) {
-    R_PROFILE(__func__);
+static TextureCacheHash hash_texture_palette(const SceGxmTexture &texture, const MemState &mem) {
     const SceGxmTextureFormat format = gxm::get_format(&texture);
     const SceGxmTextureBaseFormat base_format = gxm::get_base_format(format);
+
+    switch (base_format) {
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
+        return hash_palette_data(texture, 16, mem);
+    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
+        return hash_palette_data(texture, 256, mem);
+    default:
+        return 0;
+    }
+}
+
+TextureCacheHash hash_texture_data(const SceGxmTexture &texture, const MemState &mem) {
+    R_PROFILE(__func__);
     const size_t size = texture_size(texture);
     const Ptr<const void> data(texture.data_addr << 2);
     TextureCacheHash data_hash = 0;
@@ -60,31 +79,102 @@ TextureCacheHash hash_texture_data(const SceGxmTexture &texture, const MemState
         data_hash = hash_data(data.get(mem), size);
     }
 
-    switch (base_format) {
-    case SCE_GXM_TEXTURE_BASE_FORMAT_P4:
-        return data_hash ^ hash_palette_data(texture, 16, mem);
-    case SCE_GXM_TEXTURE_BASE_FORMAT_P8:
-        return data_hash ^ hash_palette_data(texture, 256, mem);
-    default:
-        return data_hash;
-    }
+    return data_hash ^ hash_texture_palette(texture, mem);
 }
 
-static size_t find_lru(const TextureCacheState &cache, TextureCacheTimestamp current_time) {
+// Samples are evenly spread over the texture, the first and last bytes always being part of them
+static constexpr size_t TEXTURE_SAMPLE_COUNT = 16;
+static constexpr size_t TEXTURE_SAMPLE_SIZE = 64;
+
+static TextureCacheHash hash_texture_samples(const SceGxmTexture &texture, const MemState &mem) {
     R_PROFILE(__func__);
+    const size_t size = texture_size(texture);
+    if (size <= TEXTURE_SAMPLE_COUNT * TEXTURE_SAMPLE_SIZE)
+        return hash_texture_data(texture, mem);
+
+    const Ptr<const uint8_t> data(texture.data_addr << 2);
+    if (!data.address())
+        return hash_texture_palette(texture, mem);
+
+    const uint8_t *bytes = data.get(mem);
+    const size_t step = (size - TEXTURE_SAMPLE_SIZE) / (TEXTURE_SAMPLE_COUNT - 1);
+    std::array<uint8_t, TEXTURE_SAMPLE_COUNT * TEXTURE_SAMPLE_SIZE> samples;
+    for (size_t i = 0; i < TEXTURE_SAMPLE_COUNT; i++) {
+        const size_t offset = (i == TEXTURE_SAMPLE_COUNT - 1) ? size - TEXTURE_SAMPLE_SIZE : i * step;
+        memcpy(&samples[i * TEXTURE_SAMPLE_SIZE], bytes + offset, TEXTURE_SAMPLE_SIZE);
+    }
 
-    uint64_t oldest_age = current_time - cache.infoes.front().timestamp;
-    size_t oldest_index = 0;
+    return hash_data(samples.data(), samples.size()) ^ hash_texture_palette(texture, mem);
+}
 
-    for (size_t index = 1; index < cache.infoes.size(); ++index) {
-        const uint64_t age = current_time - cache.infoes[index].timestamp;
-        if (age > oldest_age) {
-            oldest_age = age;
-            oldest_index = index;
-        }
+// Returns true if the texture content changed since it was last hashed.
+// The whole texture is hashed at most once per frame, later checks during the same frame only compare samples of it.
+static bool update_texture_hash(const TextureCacheState &cache, TextureCacheInfo &info, const SceGxmTexture &texture, const MemState &mem, bool force_full_hash) {
+    if (!force_full_hash && (info.hash_frame == cache.frame)) {
+        if (hash_texture_samples(texture, mem) == info.sample_hash)
+            return false;
     }
 
-    return oldest_index;
+    const TextureCacheHash hash = hash_texture_data(texture, mem);
+    const bool changed = hash != info.hash;
+    info.hash = hash;
+    info.sample_hash = hash_texture_samples(texture, mem);
+    info.hash_frame = cache.frame;
+
+    return changed;
+}
+
+void init_cache(TextureCacheState &cache, size_t capacity) {
+    // Indices are stored on 32 bits with one value reserved
+    capacity = std::clamp<size_t>(capacity, 1, TEXTURE_CACHE_NO_INDEX - 1);
+
+    cache.infoes.assign(capacity, TextureCacheInfo());
+    cache.lookup.clear();
+    cache.lookup.reserve(capacity);
+    cache.used = 0;
+    cache.lru_newest = TEXTURE_CACHE_NO_INDEX;
+    cache.lru_oldest = TEXTURE_CACHE_NO_INDEX;
+    cache.decoded.clear();
+    cache.decoded_index.clear();
+    cache.decoded_size = 0;
+}
+
+static void lru_unlink(TextureCacheState &cache, uint32_t index) {
+    TextureCacheInfo &info = cache.infoes[index];
+
+    if (info.lru_newer != TEXTURE_CACHE_NO_INDEX)
+        cache.infoes[info.lru_newer].lru_older = info.lru_older;
+    else
+        cache.lru_newest = info.lru_older;
+
+    if (info.lru_older != TEXTURE_CACHE_NO_INDEX)
+        cache.infoes[info.lru_older].lru_newer = info.lru_newer;
+    else
+        cache.lru_oldest = info.lru_newer;
+
+    info.lru_newer = TEXTURE_CACHE_NO_INDEX;
+    info.lru_older = TEXTURE_CACHE_NO_INDEX;
+}
+
+static void lru_push_newest(TextureCacheState &cache, uint32_t index) {
+    TextureCacheInfo &info = cache.infoes[index];
+    info.lru_newer = TEXTURE_CACHE_NO_INDEX;
+    info.lru_older = cache.lru_newest;
+
+    if (cache.lru_newest != TEXTURE_CACHE_NO_INDEX)
+        cache.infoes[cache.lru_newest].lru_newer = index;
+    else
+        cache.lru_oldest = index;
+
+    cache.lru_newest = index;
+}
+
+static void lru_touch(TextureCacheState &cache, uint32_t index) {
+    if (cache.lru_newest == index)
+        return;
+
+    lru_unlink(cache, index);
+    lru_push_newest(cache, index);
 }
 
 bool can_texture_be_unswizzled_without_decode(SceGxmTextureBaseFormat fmt, bool is_vulkan) {
@@ -165,6 +255,23 @@ static void resolve_z_order_compressed_texture(SceGxmTextureBaseFormat fmt, void
             reinterpret_cast<std::uint8_t *>(dest), bc_type);
 }
 
+// Size of the compressed data of a texture decompress_compressed_swizz_texture can decompress, 0 for other formats
+static size_t get_compressed_swizz_size(SceGxmTextureBaseFormat fmt, const std::uint32_t width, const std::uint32_t height) {
+    if (renderer::texture::is_compressed_format(fmt))
+        return renderer::texture::get_compressed_size(fmt, width, height);
+
+    if ((fmt >= SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) && (fmt <= SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP)) {
+        const bool is_2bpp = (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) || (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP);
+
+        const std::uint32_t num_xword = (width + (is_2bpp ? 7 : 3)) / (is_2bpp ? 8 : 4);
+        const std::uint32_t num_yword = (height + 3) / 4;
+
+        return (size_t)num_xword * (size_t)num_yword * 8;
+    }
+
+    return 0;
+}
+
 /**
  * \brief Try to decompress texture to 32-bit RGBA.
  *
@@ -173,10 +280,11 @@ static void resolve_z_order_compressed_texture(SceGxmTextureBaseFormat fmt, void
  * \param data   Source data to decompress.
  * \param width  Texture width.
  * \param height Texture height.
+ * \param pool   Pool decompressing big textures in parallel.
  *
  * \return Size of source taken.
  */
-static size_t decompress_compressed_swizz_texture(SceGxmTextureBaseFormat fmt, void *dest, const void *data, const std::uint32_t width, const std::uint32_t height) {
+static size_t decompress_compressed_swizz_texture(SceGxmTextureBaseFormat fmt, void *dest, const void *data, const std::uint32_t width, const std::uint32_t height, ThreadPool *pool) {
     int bc_type = 0;
 
     switch (fmt) {
@@ -214,18 +322,12 @@ static size_t decompress_compressed_swizz_texture(SceGxmTextureBaseFormat fmt, v
 
     if (bc_type) {
         decompress_bc_swizz_image(width, height, reinterpret_cast<const std::uint8_t *>(data),
-            reinterpret_cast<std::uint32_t *>(dest), bc_type);
-        return (((width + 3) / 4) * ((height + 3) / 4) * ((bc_type != 1 && bc_type != 4 && bc_type != 5) ? 16 : 8));
+            reinterpret_cast<std::uint32_t *>(dest), bc_type, pool);
+        return get_compressed_swizz_size(fmt, width, height);
     } else if ((fmt >= SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) && (fmt <= SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP)) {
         pvr::PVRTDecompressPVRTC(data, (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) || (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP), width, height,
-            (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP) || (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP), reinterpret_cast<uint8_t *>(dest));
-
-        const bool is_2bpp = (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRT2BPP) || (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP);
-
-        const std::uint32_t num_xword = (width + (is_2bpp ? 7 : 3)) / (is_2bpp ? 8 : 4);
-        const std::uint32_t num_yword = (height + 3) / 4;
-
-        return (size_t)num_xword * (size_t)num_yword * 8;
+            (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII2BPP) || (fmt == SCE_GXM_TEXTURE_BASE_FORMAT_PVRTII4BPP), reinterpret_cast<uint8_t *>(dest), pool);
+        return get_compressed_swizz_size(fmt, width, height);
     } else {
         LOG_ERROR("Trying to decompress and unswizzle unknown format {}", log_hex(fmt));
     }
@@ -233,6 +335,46 @@ static size_t decompress_compressed_swizz_texture(SceGxmTextureBaseFormat fmt, v
     return 0;
 }
 
+/**
+ * \brief Decompresses a texture to 32-bit RGBA, unless the same data was decompressed recently.
+ *
+ * \param cache  Texture cache keeping the decompressed textures.
+ * \param fmt    Texture base format.
+ * \param data   Source data to decompress.
+ * \param width  Texture width.
+ * \param height Texture height.
+ *
+ * \return The decompressed texture, which stays valid until the next call.
+ */
+static const DecodedTexture &get_decompressed_swizz_texture(TextureCacheState &cache, SceGxmTextureBaseFormat fmt, const void *data, const std::uint32_t width, const std::uint32_t height) {
+    const uint64_t seed = static_cast<uint64_t>(fmt) ^ (static_cast<uint64_t>(width) << 32) ^ (static_cast<uint64_t>(height) << 48);
+    const uint64_t key = XXH_INLINE_XXH3_64bits_withSeed(data, get_compressed_swizz_size(fmt, width, height), seed);
+
+    const auto found = cache.decoded_index.find(key);
+    if (found != cache.decoded_index.end()) {
+        cache.decoded.splice(cache.decoded.begin(), cache.decoded, found->second);
+        return *found->second;
+    }
+
+    // Forget the least recently used textures until the new one fits
+    const size_t decoded_size = align(width, 4) * align(height, 4) * 4;
+    while (!cache.decoded.empty() && (cache.decoded_size + decoded_size > DECODED_TEXTURE_CACHE_SIZE)) {
+        const DecodedTexture &oldest = cache.decoded.back();
+        cache.decoded_size -= oldest.pixels.size();
+        cache.decoded_index.erase(oldest.key);
+        cache.decoded.pop_back();
+    }
+
+    DecodedTexture &decoded = cache.decoded.emplace_front();
+    cache.decoded_index.emplace(key, cache.decoded.begin());
+    decoded.key = key;
+    decoded.pixels.resize(decoded_size);
+    decoded.source_size = decompress_compressed_swizz_texture(fmt, decoded.pixels.data(), data, width, height, &ThreadPool::shared());
+    cache.decoded_size += decoded_size;
+
+    return decoded;
+}
+
 /**
  * \brief Try to decompress texture to 16-bit RGB floating point color.
  *
@@ -417,7 +559,7 @@ uint16_t get_upload_mip(const uint16_t true_mip, const uint16_t width, const uin
     return std::min(true_mip, max_mip_text);
 }
 
-void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
+void upload_bound_texture(TextureCacheState &cache, const SceGxmTexture &gxm_texture, const MemState &mem) {
     R_PROFILE(__func__);
 
     bool is_vulkan = (*cache.backend == Backend::Vulkan);
@@ -544,12 +686,12 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
             pixels = texture_data_decompressed.data();
         } else if (need_decompress_and_unswizzle_on_cpu) {
             // Must decompress them
-            texture_data_decompressed.resize(align(width, 4) * align(height, 4) * 4);
-            source_size = decompress_compressed_swizz_texture(base_format, texture_data_decompressed.data(), pixels, width, height);
+            const DecodedTexture &decoded = get_decompressed_swizz_texture(cache, base_format, pixels, width, height);
+            source_size = decoded.source_size;
             bytes_per_pixel = 4;
             bpp = 32;
             upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
-            pixels = texture_data_decompressed.data();
+            pixels = decoded.pixels.data();
         }
 
         switch (base_format) {
@@ -659,13 +801,14 @@ void upload_bound_texture(const TextureCacheState &cache, const SceGxmTexture &g
             case SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC0:
             case SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC1:
             case SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC1: {
-                yuv_texture_pixels.resize(width * height * 3);
-                renderer::texture::yuv420_texture_to_rgb(yuv_texture_pixels.data(),
-                    reinterpret_cast<const uint8_t *>(pixels), width, height);
+                // converted straight to RGBA, the backends then do not have to add the alpha channel
+                yuv_texture_pixels.resize(width * height * 4);
+                renderer::texture::yuv420_texture_to_rgba(yuv_texture_pixels.data(), width * 4,
+                    reinterpret_cast<const uint8_t *>(pixels), width, height, fmt);
                 pixels = yuv_texture_pixels.data();
                 pixels_per_stride = width;
-                bpp = 24;
-                upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8;
+                bpp = 32;
+                upload_format = SCE_GXM_TEXTURE_BASE_FORMAT_U8U8U8U8;
                 break;
             }
 
@@ -720,16 +863,12 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
     size_t index = 0;
     bool configure = false;
     bool upload = false;
+    bool protect = false;
     const size_t size = texture_size(gxm_texture);
 
     // Try to find GXM texture in cache.
-    int cached_gxm_texture_index = -1;
-    for (size_t a = 0; a < cache.used; a++) {
-        if (memcmp(&cache.infoes[a].texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
-            cached_gxm_texture_index = a;
-            break;
-        }
-    }
+    const auto cached = cache.lookup.find(gxm_texture);
+    const bool is_cached = cached != cache.lookup.end();
 
     Address range_protect_begin = 0;
     Address range_protect_end = 0;
@@ -749,41 +888,52 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
     }
 
     TextureCacheInfo *info;
-    if (cached_gxm_texture_index == -1) {
+    if (!is_cached) {
         // Texture not found in cache.
-        if (cache.used < TextureCacheSize) {
+        if (cache.used < cache.infoes.size()) {
             // Cache is not full. Add texture to cache.
             index = cache.used;
             ++cache.used;
         } else {
-            // Cache is full. Find least recently used texture.
-            index = find_lru(cache, cache.timestamp);
+            // Cache is full. Reuse the least recently used texture.
+            index = cache.lru_oldest;
             LOG_DEBUG("Evicting texture {} (t = {}) from cache. Current t = {}.", index, cache.infoes[index].timestamp, cache.timestamp);
+            lru_unlink(cache, static_cast<uint32_t>(index));
+            cache.lookup.erase(cache.infoes[index].texture);
+            if (cache.stats)
+                ++cache.stats->evictions;
         }
+        if (cache.stats)
+            ++cache.stats->misses;
         configure = true;
         upload = true;
         cache.infoes[index] = TextureCacheInfo(gxm_texture);
+        cache.lookup.emplace(gxm_texture, static_cast<uint32_t>(index));
+        lru_push_newest(cache, static_cast<uint32_t>(index));
         info = &cache.infoes[index];
         info->use_hash = should_use_hash;
-        if (info->use_hash) {
-            info->hash = hash_texture_data(gxm_texture, mem);
-        }
+        // Protected textures also keep their hash to tell real changes from writes of identical data
+        update_texture_hash(cache, *info, gxm_texture, mem, true);
     } else {
         // Texture is cached.
-        index = cached_gxm_texture_index;
+        index = cached->second;
+        lru_touch(cache, static_cast<uint32_t>(index));
+        if (cache.stats)
+            ++cache.stats->hits;
         info = &cache.infoes[index];
         configure = false;
         if (info->use_hash) {
-            const TextureCacheHash hash = hash_texture_data(gxm_texture, mem);
-            upload = info->hash != hash;
-            info->hash = hash;
-        } else {
-            upload = info->dirty;
+            upload = update_texture_hash(cache, *info, gxm_texture, mem, false);
+        } else if (info->dirty) {
+            // The texture was written to since it was protected, it must be protected again whatever the result
+            upload = update_texture_hash(cache, *info, gxm_texture, mem, true);
+            protect = true;
         }
     }
 
     if (gxm_texture.data_addr == 0) {
         upload = false;
+        protect = false;
     }
 
 // Fix memory access error in the condition check for texture cache method
@@ -801,16 +951,18 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
     }
     if (upload) {
         upload_bound_texture(cache, gxm_texture, mem);
-        if (!info->use_hash) {
-            info->dirty = false;
-            add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MEM_PERM_READONLY, [info, gxm_texture](Address, bool) {
-                if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
-                    info->dirty = true;
-                }
-
-                return true;
-            });
-        }
+    }
+    if ((upload || protect) && !info->use_hash) {
+        info->dirty = false;
+        add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MEM_PERM_READONLY, [info, gxm_texture](Address, bool) {
+            if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
+                info->dirty = true;
+            }
+
+            return true;
+        });
+    }
+    if (upload) {
         cache.upload_done_callback();
     }
 
@@ -16,14 +16,32 @@
 // with this program; if not, write to the Free Software Foundation, Inc.,
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include <gxm/functions.h>
 #include <gxm/types.h>
 #include <shader/spirv_recompiler.h>
 #include <util/log.h>
+#include <util/thread_pool.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define TEXTURE_NEON
+#include <arm_neon.h>
+#endif
 
 namespace renderer::texture {
 
@@ -177,62 +195,185 @@ static uint32_t decode_morton2_y(uint32_t code) {
     return compact_one_by_one(code >> 1);
 }
 
+// Inverse of compact_one_by_one - spread the bits of x to the even-indexed bits
+static uint32_t part_one_by_one(uint32_t x) {
+    x &= 0x0000ffff;
+    x = (x ^ (x << 8)) & 0x00ff00ff;
+    x = (x ^ (x << 4)) & 0x0f0f0f0f;
+    x = (x ^ (x << 2)) & 0x33333333;
+    x = (x ^ (x << 1)) & 0x55555555;
+    return x;
+}
+
+// A swizzled texture is a row (or a column) of square blocks, each of them in Morton order
+// with y on the even bits and x on the odd bits of the texel index.
+// The texel (x, y) is at index x_offsets[x] + y_offsets[y], so an even x and y are the
+// first of 4 consecutive texels: (x, y), (x, y + 1), (x + 1, y), (x + 1, y + 1).
+static void make_swizzle_offsets(std::vector<uint32_t> &x_offsets, std::vector<uint32_t> &y_offsets, uint32_t width, uint32_t height) {
+    const uint32_t min = std::min(width, height);
+    const uint32_t k = std::countr_zero(min);
+    const uint32_t mask = min - 1;
+
+    x_offsets.resize(width);
+    for (uint32_t x = 0; x < width; x++)
+        x_offsets[x] = (part_one_by_one(x & mask) << 1) | ((x >> k) << (2 * k));
+
+    y_offsets.resize(height);
+    for (uint32_t y = 0; y < height; y++)
+        y_offsets[y] = part_one_by_one(y & mask) | ((y >> k) << (2 * k));
+}
+
+template <size_t BytesPerPixel>
+static void copy_swizzled_quad(uint8_t *row0, uint8_t *row1, const uint8_t *quad) {
+    std::memcpy(row0, quad, BytesPerPixel);
+    std::memcpy(row0 + BytesPerPixel, quad + 2 * BytesPerPixel, BytesPerPixel);
+    std::memcpy(row1, quad + BytesPerPixel, BytesPerPixel);
+    std::memcpy(row1 + BytesPerPixel, quad + 3 * BytesPerPixel, BytesPerPixel);
+}
+
+// Unswizzles two rows at a time, width and height are powers of two of at least 2
+template <size_t BytesPerPixel>
+static void unswizzle_rows(uint8_t *dest, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *x_offsets, const uint32_t *y_offsets) {
+    const size_t row_size = static_cast<size_t>(width) * BytesPerPixel;
+    for (uint32_t y = 0; y < height; y += 2) {
+        uint8_t *row0 = dest + y * row_size;
+        uint8_t *row1 = row0 + row_size;
+        const uint8_t *src_rows = src + static_cast<size_t>(y_offsets[y]) * BytesPerPixel;
+
+        uint32_t x = 0;
+        if constexpr (BytesPerPixel == 4) {
+            // Two quads hold 4 texels of each row, interleaved
+            for (; x + 4 <= width; x += 4) {
+                const uint8_t *quad0 = src_rows + static_cast<size_t>(x_offsets[x]) * 4;
+                const uint8_t *quad1 = src_rows + static_cast<size_t>(x_offsets[x + 2]) * 4;
+#ifdef TEXTURE_SSE2
+                const __m128 v0 = _mm_loadu_ps(reinterpret_cast<const float *>(quad0));
+                const __m128 v1 = _mm_loadu_ps(reinterpret_cast<const float *>(quad1));
+                _mm_storeu_ps(reinterpret_cast<float *>(row0 + x * 4), _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(reinterpret_cast<float *>(row1 + x * 4), _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+#elif defined(TEXTURE_NEON)
+                const uint32x4x2_t rows = vuzpq_u32(vld1q_u32(reinterpret_cast<const uint32_t *>(quad0)), vld1q_u32(reinterpret_cast<const uint32_t *>(quad1)));
+                vst1q_u32(reinterpret_cast<uint32_t *>(row0 + x * 4), rows.val[0]);
+                vst1q_u32(reinterpret_cast<uint32_t *>(row1 + x * 4), rows.val[1]);
+#else
+                copy_swizzled_quad<4>(row0 + x * 4, row1 + x * 4, quad0);
+                copy_swizzled_quad<4>(row0 + x * 4 + 8, row1 + x * 4 + 8, quad1);
+#endif
+            }
+        } else if constexpr (BytesPerPixel == 2) {
+            // Four quads hold 8 texels of each row, interleaved
+            for (; x + 8 <= width; x += 8) {
+                const uint8_t *quads[4];
+                for (uint32_t i = 0; i < 4; i++)
+                    quads[i] = src_rows + static_cast<size_t>(x_offsets[x + 2 * i]) * 2;
+#ifdef TEXTURE_SSE2
+                const __m128i v0 = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(quads[0])), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(quads[1])));
+                const __m128i v1 = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(quads[2])), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(quads[3])));
+                // Sign extending the 16-bit halves lets the saturating pack keep them as they are
+                const __m128i even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16), _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16));
+                const __m128i odd = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row0 + x * 2), even);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row1 + x * 2), odd);
+#elif defined(TEXTURE_NEON)
+                const uint16x8_t v0 = vcombine_u16(vld1_u16(reinterpret_cast<const uint16_t *>(quads[0])), vld1_u16(reinterpret_cast<const uint16_t *>(quads[1])));
+                const uint16x8_t v1 = vcombine_u16(vld1_u16(reinterpret_cast<const uint16_t *>(quads[2])), vld1_u16(reinterpret_cast<const uint16_t *>(quads[3])));
+                const uint16x8x2_t rows = vuzpq_u16(v0, v1);
+                vst1q_u16(reinterpret_cast<uint16_t *>(row0 + x * 2), rows.val[0]);
+                vst1q_u16(reinterpret_cast<uint16_t *>(row1 + x * 2), rows.val[1]);
+#else
+                for (uint32_t i = 0; i < 4; i++)
+                    copy_swizzled_quad<2>(row0 + (x + 2 * i) * 2, row1 + (x + 2 * i) * 2, quads[i]);
+#endif
+            }
+        }
+
+        for (; x < width; x += 2)
+            copy_swizzled_quad<BytesPerPixel>(row0 + x * BytesPerPixel, row1 + x * BytesPerPixel, src_rows + static_cast<size_t>(x_offsets[x]) * BytesPerPixel);
+    }
+}
+
+// Same with 4-bit texels, the first texel of each byte being in its low nibble
+static void unswizzle_rows_4bpp(uint8_t *dest, const uint8_t *src, uint32_t width, uint32_t height, const uint32_t *x_offsets, const uint32_t *y_offsets) {
+    const size_t row_size = width / 2;
+    for (uint32_t y = 0; y < height; y += 2) {
+        uint8_t *row0 = dest + y * row_size;
+        uint8_t *row1 = row0 + row_size;
+        for (uint32_t x = 0; x < width; x += 2) {
+            const uint8_t *quad = src + (y_offsets[y] + x_offsets[x]) / 2;
+            row0[x / 2] = (quad[0] & 0x0f) | (quad[1] << 4);
+            row1[x / 2] = (quad[0] >> 4) | (quad[1] & 0xf0);
+        }
+    }
+}
+
 void swizzled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
-    if (bits_per_pixel % 8 != 0) {
+    if (bits_per_pixel % 8 != 0 && bits_per_pixel != 4) {
         // Don't support yet
         return;
     }
 
-    uint8_t bytes_per_pixel = (bits_per_pixel + 7) >> 3;
-
-    for (uint32_t i = 0; i < static_cast<uint32_t>(width * height); i++) {
-        size_t min = width < height ? width : height;
-        size_t k = static_cast<size_t>(log2(min));
+    if (width == 1 || height == 1) {
+        // A single line is stored linearly, whatever its length
+        std::memcpy(dest, src, (static_cast<size_t>(width) * height * bits_per_pixel + 7) / 8);
+        return;
+    }
 
-        size_t x, y;
-        if (height < width) {
-            // XXXyxyxyx → XXXxxxyyy
-            size_t j = i >> (2 * k) << (2 * k)
-                | (decode_morton2_y(i) & (min - 1)) << k
-                | (decode_morton2_x(i) & (min - 1)) << 0;
-            x = j / height;
-            y = j % height;
-        } else {
-            // YYYyxyxyx → YYYyyyxxx
-            size_t j = i >> (2 * k) << (2 * k)
-                | (decode_morton2_x(i) & (min - 1)) << k
-                | (decode_morton2_y(i) & (min - 1)) << 0;
-            x = j % width;
-            y = j / width;
-        }
+    if (!std::has_single_bit(width) || !std::has_single_bit(height)) {
+        LOG_ERROR("Swizzled texture size {}x{} is not a power of two", width, height);
+        return;
+    }
 
-        if (y >= height || x >= width)
-            continue;
+    std::vector<uint32_t> x_offsets, y_offsets;
+    make_swizzle_offsets(x_offsets, y_offsets, width, height);
 
-        std::memcpy(dest + (y * width + x) * bytes_per_pixel, src + i * bytes_per_pixel, bytes_per_pixel);
+    switch (bits_per_pixel) {
+    case 4:
+        unswizzle_rows_4bpp(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 8:
+        unswizzle_rows<1>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 16:
+        unswizzle_rows<2>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 24:
+        unswizzle_rows<3>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 32:
+        unswizzle_rows<4>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 64:
+        unswizzle_rows<8>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    case 128:
+        unswizzle_rows<16>(dest, src, width, height, x_offsets.data(), y_offsets.data());
+        break;
+    default:
+        LOG_ERROR("Unsupported swizzled texture bits per pixel: {}", bits_per_pixel);
+        break;
     }
 }
 
 void tiled_texture_to_linear_texture(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint8_t bits_per_pixel) {
-    // 32x32 block is assembled to tiled.
-    if (bits_per_pixel % 8 != 0) {
+    // 32x32 block is assembled to tiled, each line of a tile is stored linearly
+    if (bits_per_pixel % 8 != 0 && bits_per_pixel != 4) {
         // Don't support yet
         return;
     }
 
-    const uint32_t bpp = bits_per_pixel >> 3;
     const uint32_t width_in_tiles = (width + 31) >> 5;
+    // In bytes for 4-bit texels, where the width of each line is rounded up to the byte
+    const auto size_of = [bits_per_pixel](size_t texels) {
+        return (texels * bits_per_pixel + 7) / 8;
+    };
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            // Calculate texel address in tile
-            const uint32_t texel_offset_in_tile = (x & 0b11111) | ((y & 0b11111) << 5);
-            const uint32_t tile_address = (x >> 5) + width_in_tiles * (y >> 5);
-
-            const uint32_t offset = ((tile_address << 10) | (texel_offset_in_tile)) * bpp;
-
-            // Make scanline
-            memcpy(dest + ((y * width) + x) * bpp, src + offset, bpp);
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *dest_row = dest + y * size_of(width);
+        const uint8_t *src_row = src + size_of((width_in_tiles * (y >> 5) << 10) | ((y & 0b11111) << 5));
+        for (uint32_t tile_x = 0; tile_x < width_in_tiles; tile_x++) {
+            const uint32_t x = tile_x << 5;
+            const uint32_t texel_count = std::min<uint32_t>(32, width - x);
+            std::memcpy(dest_row + size_of(x), src_row + size_of(tile_x << 10), size_of(texel_count));
         }
     }
 }
@@ -278,18 +419,27 @@ size_t get_compressed_size(SceGxmTextureBaseFormat base_format, std::uint32_t wi
 
 // This BC decompression code is based on code from AMD GPUOpen's Compressonator
 
+// Big textures are decompressed in parts of this many blocks, big enough to be worth sending to another thread
+static constexpr std::size_t DECOMPRESS_BLOCKS_PER_PART = 4096;
+
+// Z-order curve inverse table, the pixels of a block are stored in Z-order in the decompressed image
+static constexpr uint8_t z_order_curve_inv[] = {
+    0, 2, 8, 10,
+    1, 3, 9, 11,
+    4, 6, 12, 14,
+    5, 7, 13, 15
+};
+
 /**
- * \brief Decompresses one block of a BC1 texture and stores the resulting pixels at the appropriate offset in 'image'.
+ * \brief Computes the 4 colors a BC1 block picks its pixels from.
  *
  * \param block_storage     pointer to the block to decompress.
- * \param image             pointer to image where the decompressed pixel data should be stored.
+ * \param colors            colors of the block, in RGBA8.
  **/
-static void decompress_block_bc1(const std::uint8_t *block_storage, std::uint32_t *image) {
+static void get_bc1_colors(const std::uint8_t *block_storage, std::uint32_t colors[4]) {
     std::uint16_t n0 = static_cast<std::uint16_t>((block_storage[1] << 8) | block_storage[0]);
     std::uint16_t n1 = static_cast<std::uint16_t>((block_storage[3] << 8) | block_storage[2]);
 
-    block_storage += 4;
-
     std::uint8_t r0 = (n0 & 0xF800) >> 8;
     std::uint8_t g0 = (n0 & 0x07E0) >> 3;
     std::uint8_t b0 = (n0 & 0x001F) << 3;
@@ -305,8 +455,8 @@ static void decompress_block_bc1(const std::uint8_t *block_storage, std::uint32_
     b0 |= b0 >> 5;
     b1 |= b1 >> 5;
 
-    std::uint32_t c0 = 0xFF000000 | (b0 << 16) | (g0 << 8) | r0;
-    std::uint32_t c1 = 0xFF000000 | (b1 << 16) | (g1 << 8) | r1;
+    colors[0] = 0xFF000000 | (b0 << 16) | (g0 << 8) | r0;
+    colors[1] = 0xFF000000 | (b1 << 16) | (g1 << 8) | r1;
 
     if (n0 > n1) {
         std::uint8_t r2 = static_cast<uint8_t>((2 * r0 + r1 + 1) / 3);
@@ -316,65 +466,69 @@ static void decompress_block_bc1(const std::uint8_t *block_storage, std::uint32_
         std::uint8_t b2 = static_cast<uint8_t>((2 * b0 + b1 + 1) / 3);
         std::uint8_t b3 = static_cast<uint8_t>((2 * b1 + b0 + 1) / 3);
 
-        std::uint32_t c2 = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
-        std::uint32_t c3 = 0xFF000000 | (b3 << 16) | (g3 << 8) | r3;
-
-        for (int i = 0; i < 16; ++i) {
-            int index = (block_storage[i / 4] >> (i % 4 * 2)) & 0x03;
-            switch (index) {
-            case 0:
-                image[i] = c0;
-                break;
-            case 1:
-                image[i] = c1;
-                break;
-            case 2:
-                image[i] = c2;
-                break;
-            case 3:
-                image[i] = c3;
-                break;
-            }
-        }
+        colors[2] = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
+        colors[3] = 0xFF000000 | (b3 << 16) | (g3 << 8) | r3;
     } else {
         // Transparent decode
         std::uint8_t r2 = static_cast<uint8_t>((r0 + r1) / 2);
         std::uint8_t g2 = static_cast<uint8_t>((g0 + g1) / 2);
         std::uint8_t b2 = static_cast<uint8_t>((b0 + b1) / 2);
 
-        std::uint32_t c2 = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
-
-        for (int i = 0; i < 16; ++i) {
-            int index = (block_storage[i / 4] >> (i % 4 * 2)) & 0x03;
-            switch (index) {
-            case 0:
-                image[i] = c0;
-                break;
-            case 1:
-                image[i] = c1;
-                break;
-            case 2:
-                image[i] = c2;
-                break;
-            case 3:
-                image[i] = 0x00000000;
-                break;
-            }
-        }
+        colors[2] = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
+        colors[3] = 0x00000000;
     }
 }
 
 /**
- * \brief Decompresses one block of a alpha texture and stores the resulting pixels at the appropriate offset in 'image'.
+ * \brief Decompresses one block of a BC1 texture and stores the resulting pixels at the appropriate offset in 'image'.
  *
  * \param block_storage     pointer to the block to decompress.
  * \param image             pointer to image where the decompressed pixel data should be stored.
- * \param offset            offset to where data should be written.
- * \param stride            stride between bytes to where data should be written.
  **/
-static void decompress_block_alpha(const std::uint8_t *block_storage, std::uint8_t *image, const std::uint32_t offset, const std::uint32_t stride) {
-    uint8_t alpha[8];
+static void decompress_block_bc1(const std::uint8_t *block_storage, std::uint32_t *image) {
+    std::uint32_t colors[4];
+    get_bc1_colors(block_storage, colors);
+
+    // 2-bit color index of each pixel
+    std::uint32_t indices;
+    std::memcpy(&indices, block_storage + 4, sizeof(indices));
+
+#ifdef __AVX2__
+    // Shifting the indices of the pixels in Z-order, only the first 4 lanes are ever picked
+    const __m256i palette = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(colors)));
+    const __m256i all_indices = _mm256_set1_epi32(static_cast<int>(indices));
+    const __m256i index_mask = _mm256_set1_epi32(3);
+    const __m256i shifts_low = _mm256_setr_epi32(0, 8, 2, 10, 16, 24, 18, 26);
+    const __m256i shifts_high = _mm256_setr_epi32(4, 12, 6, 14, 20, 28, 22, 30);
+    const __m256i pixels_low = _mm256_permutevar8x32_epi32(palette, _mm256_and_si256(_mm256_srlv_epi32(all_indices, shifts_low), index_mask));
+    const __m256i pixels_high = _mm256_permutevar8x32_epi32(palette, _mm256_and_si256(_mm256_srlv_epi32(all_indices, shifts_high), index_mask));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(image), pixels_low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(image + 8), pixels_high);
+#elif defined(TEXTURE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    static const int32_t shifts[16] = { 0, -8, -2, -10, -16, -24, -18, -26, -4, -12, -6, -14, -20, -28, -22, -30 };
+    const uint8x16_t palette = vld1q_u8(reinterpret_cast<const uint8_t *>(colors));
+    const uint32x4_t all_indices = vdupq_n_u32(indices);
+    for (int i = 0; i < 16; i += 4) {
+        const uint32x4_t index = vandq_u32(vshlq_u32(all_indices, vld1q_s32(shifts + i)), vdupq_n_u32(3));
+        // Offsets of the bytes of the picked colors in the palette
+        const uint8x16_t offsets = vreinterpretq_u8_u32(vmlaq_n_u32(vdupq_n_u32(0x03020100), index, 0x04040404));
+        vst1q_u32(image + i, vreinterpretq_u32_u8(vqtbl1q_u8(palette, offsets)));
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        image[z_order_curve_inv[i]] = colors[indices & 0x03];
+        indices >>= 2;
+    }
+#endif
+}
 
+/**
+ * \brief Computes the 8 values an alpha block picks its pixels from.
+ *
+ * \param block_storage     pointer to the block to decompress.
+ * \param alpha             values of the block.
+ **/
+static void get_alpha_values(const std::uint8_t *block_storage, std::uint8_t alpha[8]) {
     alpha[0] = block_storage[0];
     alpha[1] = block_storage[1];
 
@@ -397,79 +551,61 @@ static void decompress_block_alpha(const std::uint8_t *block_storage, std::uint8
         alpha[6] = 0; // Bit code 110
         alpha[7] = 255; // Bit code 111
     }
-
-    image += offset;
-
-    image[stride * 0] = alpha[block_storage[2] & 0x07];
-    image[stride * 1] = alpha[(block_storage[2] >> 3) & 0x07];
-    image[stride * 2] = alpha[((block_storage[3] << 2) & 0x04) | ((block_storage[2] >> 6) & 0x03)];
-    image[stride * 3] = alpha[(block_storage[3] >> 1) & 0x07];
-    image[stride * 4] = alpha[(block_storage[3] >> 4) & 0x07];
-    image[stride * 5] = alpha[((block_storage[4] << 1) & 0x06) | ((block_storage[3] >> 7) & 0x01)];
-    image[stride * 6] = alpha[(block_storage[4] >> 2) & 0x07];
-    image[stride * 7] = alpha[(block_storage[4] >> 5) & 0x07];
-    image[stride * 8] = alpha[block_storage[5] & 0x07];
-    image[stride * 9] = alpha[(block_storage[5] >> 3) & 0x07];
-    image[stride * 10] = alpha[((block_storage[6] << 2) & 0x04) | ((block_storage[5] >> 6) & 0x03)];
-    image[stride * 11] = alpha[(block_storage[6] >> 1) & 0x07];
-    image[stride * 12] = alpha[(block_storage[6] >> 4) & 0x07];
-    image[stride * 13] = alpha[((block_storage[7] << 1) & 0x06) | ((block_storage[6] >> 7) & 0x01)];
-    image[stride * 14] = alpha[(block_storage[7] >> 2) & 0x07];
-    image[stride * 15] = alpha[(block_storage[7] >> 5) & 0x07];
 }
 
 /**
- * \brief Decompresses one block of a signed alpha texture and stores the resulting pixels at the appropriate offset in 'image'.
+ * \brief Computes the 8 values a signed alpha block picks its pixels from.
  *
  * \param block_storage     pointer to the block to decompress.
- * \param image             pointer to image where the decompressed pixel data should be stored.
- * \param offset            offset to where data should be written.
- * \param stride            stride between bytes to where data should be written.
+ * \param alpha             values of the block, as the bytes of signed values.
  **/
-static void decompress_block_alpha_signed(const std::uint8_t *block_storage, std::uint8_t *image, const std::uint32_t offset, const std::uint32_t stride) {
-    int8_t alpha[8];
+static void get_alpha_values_signed(const std::uint8_t *block_storage, std::uint8_t alpha[8]) {
+    int8_t values[8];
 
-    alpha[0] = static_cast<int8_t>(block_storage[0]);
-    alpha[1] = static_cast<int8_t>(block_storage[1]);
+    values[0] = static_cast<int8_t>(block_storage[0]);
+    values[1] = static_cast<int8_t>(block_storage[1]);
 
-    if (alpha[0] > alpha[1]) {
+    if (values[0] > values[1]) {
         // 8-alpha block:  derive the other six alphas.
         // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
-        alpha[2] = static_cast<int8_t>((6 * alpha[0] + 1 * alpha[1] + 3) / 7); // bit code 010
-        alpha[3] = static_cast<int8_t>((5 * alpha[0] + 2 * alpha[1] + 3) / 7); // bit code 011
-        alpha[4] = static_cast<int8_t>((4 * alpha[0] + 3 * alpha[1] + 3) / 7); // bit code 100
-        alpha[5] = static_cast<int8_t>((3 * alpha[0] + 4 * alpha[1] + 3) / 7); // bit code 101
-        alpha[6] = static_cast<int8_t>((2 * alpha[0] + 5 * alpha[1] + 3) / 7); // bit code 110
-        alpha[7] = static_cast<int8_t>((1 * alpha[0] + 6 * alpha[1] + 3) / 7); // bit code 111
+        values[2] = static_cast<int8_t>((6 * values[0] + 1 * values[1] + 3) / 7); // bit code 010
+        values[3] = static_cast<int8_t>((5 * values[0] + 2 * values[1] + 3) / 7); // bit code 011
+        values[4] = static_cast<int8_t>((4 * values[0] + 3 * values[1] + 3) / 7); // bit code 100
+        values[5] = static_cast<int8_t>((3 * values[0] + 4 * values[1] + 3) / 7); // bit code 101
+        values[6] = static_cast<int8_t>((2 * values[0] + 5 * values[1] + 3) / 7); // bit code 110
+        values[7] = static_cast<int8_t>((1 * values[0] + 6 * values[1] + 3) / 7); // bit code 111
     } else {
         // 6-alpha block.
         // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
-        alpha[2] = static_cast<int8_t>((4 * alpha[0] + 1 * alpha[1] + 2) / 5); // Bit code 010
-        alpha[3] = static_cast<int8_t>((3 * alpha[0] + 2 * alpha[1] + 2) / 5); // Bit code 011
-        alpha[4] = static_cast<int8_t>((2 * alpha[0] + 3 * alpha[1] + 2) / 5); // Bit code 100
-        alpha[5] = static_cast<int8_t>((1 * alpha[0] + 4 * alpha[1] + 2) / 5); // Bit code 101
-        alpha[6] = -128; // Bit code 110
-        alpha[7] = 127; // Bit code 111
+        values[2] = static_cast<int8_t>((4 * values[0] + 1 * values[1] + 2) / 5); // Bit code 010
+        values[3] = static_cast<int8_t>((3 * values[0] + 2 * values[1] + 2) / 5); // Bit code 011
+        values[4] = static_cast<int8_t>((2 * values[0] + 3 * values[1] + 2) / 5); // Bit code 100
+        values[5] = static_cast<int8_t>((1 * values[0] + 4 * values[1] + 2) / 5); // Bit code 101
+        values[6] = -128; // Bit code 110
+        values[7] = 127; // Bit code 111
     }
 
-    image += offset;
+    std::memcpy(alpha, values, sizeof(values));
+}
+
+/**
+ * \brief Decompresses one alpha block and stores the resulting values in one channel of the pixels in 'image'.
+ *
+ * \param block_storage     pointer to the block to decompress.
+ * \param alpha             values of the block, from get_alpha_values or get_alpha_values_signed.
+ * \param image             pointer to image where the decompressed pixel data should be stored.
+ * \param offset            offset of the channel in each pixel.
+ **/
+static void decompress_block_alpha(const std::uint8_t *block_storage, const std::uint8_t alpha[8], std::uint8_t *image, const std::uint32_t offset) {
+    // 3-bit value index of each pixel, 24 bits for each half of the block
+    const std::uint32_t indices_top = block_storage[2] | (block_storage[3] << 8) | (block_storage[4] << 16);
+    const std::uint32_t indices_bottom = block_storage[5] | (block_storage[6] << 8) | (block_storage[7] << 16);
 
-    image[stride * 0] = static_cast<uint8_t>(alpha[block_storage[2] & 0x07]);
-    image[stride * 1] = static_cast<uint8_t>(alpha[(block_storage[2] >> 3) & 0x07]);
-    image[stride * 2] = static_cast<uint8_t>(alpha[((block_storage[3] << 2) & 0x04) | ((block_storage[2] >> 6) & 0x03)]);
-    image[stride * 3] = static_cast<uint8_t>(alpha[(block_storage[3] >> 1) & 0x07]);
-    image[stride * 4] = static_cast<uint8_t>(alpha[(block_storage[3] >> 4) & 0x07]);
-    image[stride * 5] = static_cast<uint8_t>(alpha[((block_storage[4] << 1) & 0x06) | ((block_storage[3] >> 7) & 0x01)]);
-    image[stride * 6] = static_cast<uint8_t>(alpha[(block_storage[4] >> 2) & 0x07]);
-    image[stride * 7] = static_cast<uint8_t>(alpha[(block_storage[4] >> 5) & 0x07]);
-    image[stride * 8] = static_cast<uint8_t>(alpha[block_storage[5] & 0x07]);
-    image[stride * 9] = static_cast<uint8_t>(alpha[(block_storage[5] >> 3) & 0x07]);
-    image[stride * 10] = static_cast<uint8_t>(alpha[((block_storage[6] << 2) & 0x04) | ((block_storage[5] >> 6) & 0x03)]);
-    image[stride * 11] = static_cast<uint8_t>(alpha[(block_storage[6] >> 1) & 0x07]);
-    image[stride * 12] = static_cast<uint8_t>(alpha[(block_storage[6] >> 4) & 0x07]);
-    image[stride * 13] = static_cast<uint8_t>(alpha[((block_storage[7] << 1) & 0x06) | ((block_storage[6] >> 7) & 0x01)]);
-    image[stride * 14] = static_cast<uint8_t>(alpha[(block_storage[7] >> 2) & 0x07]);
-    image[stride * 15] = static_cast<uint8_t>(alpha[(block_storage[7] >> 5) & 0x07]);
+    image += offset;
+    for (int i = 0; i < 8; ++i) {
+        image[z_order_curve_inv[i] * 4] = alpha[(indices_top >> (3 * i)) & 0x07];
+        image[z_order_curve_inv[i + 8] * 4] = alpha[(indices_bottom >> (3 * i)) & 0x07];
+    }
 }
 
 /**
@@ -481,12 +617,14 @@ static void decompress_block_alpha_signed(const std::uint8_t *block_storage, std
 static void decompress_block_bc2(const std::uint8_t *block_storage, std::uint32_t *image) {
     decompress_block_bc1(block_storage + 8, image);
 
-    for (int i = 0; i < 16; i += 2) {
-        image[i] = (((block_storage[i] & 0x0F) | ((block_storage[i] & 0x0F) << 4)) << 24) | (image[i] & 0x00FFFFFF);
-    }
+    // 4-bit alpha of each pixel
+    std::uint64_t alpha;
+    std::memcpy(&alpha, block_storage, sizeof(alpha));
 
-    for (int i = 1; i < 16; i += 2) {
-        image[i] = (((block_storage[i] & 0xF0) | ((block_storage[i] & 0xF0) >> 4)) << 24) | (image[i] & 0x00FFFFFF);
+    for (int i = 0; i < 16; ++i) {
+        std::uint32_t &pixel = image[z_order_curve_inv[i]];
+        pixel = (static_cast<std::uint32_t>((alpha & 0x0F) * 0x11) << 24) | (pixel & 0x00FFFFFF);
+        alpha >>= 4;
     }
 }
 
@@ -497,8 +635,11 @@ static void decompress_block_bc2(const std::uint8_t *block_storage, std::uint32_
  * \param image             pointer to image where the decompressed pixel data should be stored.
  **/
 static void decompress_block_bc3(const std::uint8_t *block_storage, std::uint32_t *image) {
+    std::uint8_t alpha[8];
+    get_alpha_values(block_storage, alpha);
+
     decompress_block_bc1(block_storage + 8, image);
-    decompress_block_alpha(block_storage, reinterpret_cast<std::uint8_t *>(image), 3, 4);
+    decompress_block_alpha(block_storage, alpha, reinterpret_cast<std::uint8_t *>(image), 3);
 }
 
 /**
@@ -508,9 +649,11 @@ static void decompress_block_bc3(const std::uint8_t *block_storage, std::uint32_
  * \param image             pointer to image where the decompressed pixel data should be stored.
  **/
 static void decompress_block_bc4u(const std::uint8_t *block_storage, std::uint32_t *image) {
-    for (int i = 0; i < 16; i++)
-        image[i] = 0x00000000;
-    decompress_block_alpha(block_storage, reinterpret_cast<std::uint8_t *>(image), 0, 4);
+    std::uint8_t alpha[8];
+    get_alpha_values(block_storage, alpha);
+
+    std::memset(image, 0, 16 * sizeof(std::uint32_t));
+    decompress_block_alpha(block_storage, alpha, reinterpret_cast<std::uint8_t *>(image), 0);
 }
 
 /**
@@ -520,9 +663,11 @@ static void decompress_block_bc4u(const std::uint8_t *block_storage, std::uint32
  * \param image             pointer to image where the decompressed pixel data should be stored.
  **/
 static void decompress_block_bc4s(const std::uint8_t *block_storage, std::uint32_t *image) {
-    for (int i = 0; i < 16; i++)
-        image[i] = 0x00000000;
-    decompress_block_alpha_signed(block_storage, reinterpret_cast<std::uint8_t *>(image), 0, 4);
+    std::uint8_t alpha[8];
+    get_alpha_values_signed(block_storage, alpha);
+
+    std::memset(image, 0, 16 * sizeof(std::uint32_t));
+    decompress_block_alpha(block_storage, alpha, reinterpret_cast<std::uint8_t *>(image), 0);
 }
 
 /**
@@ -532,10 +677,13 @@ static void decompress_block_bc4s(const std::uint8_t *block_storage, std::uint32
  * \param image             pointer to image where the decompressed pixel data should be stored.
  **/
 static void decompress_block_bc5u(const std::uint8_t *block_storage, std::uint32_t *image) {
-    for (int i = 0; i < 16; i++)
-        image[i] = 0x00000000;
-    decompress_block_alpha(block_storage, reinterpret_cast<std::uint8_t *>(image), 0, 4);
-    decompress_block_alpha(block_storage + 8, reinterpret_cast<std::uint8_t *>(image), 1, 4);
+    std::uint8_t red[8], green[8];
+    get_alpha_values(block_storage, red);
+    get_alpha_values(block_storage + 8, green);
+
+    std::memset(image, 0, 16 * sizeof(std::uint32_t));
+    decompress_block_alpha(block_storage, red, reinterpret_cast<std::uint8_t *>(image), 0);
+    decompress_block_alpha(block_storage + 8, green, reinterpret_cast<std::uint8_t *>(image), 1);
 }
 
 /**
@@ -545,10 +693,25 @@ static void decompress_block_bc5u(const std::uint8_t *block_storage, std::uint32
  * \param image             pointer to image where the decompressed pixel data should be stored.
  **/
 static void decompress_block_bc5s(const std::uint8_t *block_storage, std::uint32_t *image) {
-    for (int i = 0; i < 16; i++)
-        image[i] = 0x00000000;
-    decompress_block_alpha_signed(block_storage, reinterpret_cast<std::uint8_t *>(image), 0, 4);
-    decompress_block_alpha_signed(block_storage + 8, reinterpret_cast<std::uint8_t *>(image), 1, 4);
+    std::uint8_t red[8], green[8];
+    get_alpha_values_signed(block_storage, red);
+    get_alpha_values_signed(block_storage + 8, green);
+
+    std::memset(image, 0, 16 * sizeof(std::uint32_t));
+    decompress_block_alpha(block_storage, red, reinterpret_cast<std::uint8_t *>(image), 0);
+    decompress_block_alpha(block_storage + 8, green, reinterpret_cast<std::uint8_t *>(image), 1);
+}
+
+// Decompresses count blocks from the first one, each of them to 16 consecutive pixels
+template <void (*DecompressBlock)(const std::uint8_t *, std::uint32_t *), std::size_t BlockSize>
+static void decompress_blocks(const std::uint8_t *block_storage, std::uint32_t *image, std::size_t first, std::size_t count) {
+    block_storage += first * BlockSize;
+    image += first * 16;
+    for (std::size_t i = 0; i < count; i++) {
+        DecompressBlock(block_storage, image);
+        block_storage += BlockSize;
+        image += 16;
+    }
 }
 
 /**
@@ -561,62 +724,58 @@ static void decompress_block_bc5s(const std::uint8_t *block_storage, std::uint32
  * \param block_storage     Pointer to compressed blocks.
  * \param image             Pointer to the image where the decompressed pixels will be stored.
  * \param bc_type           Block compressed type. BC1 (DXT1), BC2 (DXT3), BC3 (DXT5), BC4U (RGTC1), BC4S (RGTC1), BC5U (RGTC2) or BC5S (RGTC2).
+ * \param pool              Pool decompressing big textures in parts, in parallel. Can be null.
  */
-void decompress_bc_swizz_image(std::uint32_t width, std::uint32_t height, const std::uint8_t *block_storage, std::uint32_t *image, const std::uint8_t bc_type) {
+void decompress_bc_swizz_image(std::uint32_t width, std::uint32_t height, const std::uint8_t *block_storage, std::uint32_t *image, const std::uint8_t bc_type, ThreadPool *pool) {
     std::uint32_t block_count_x = (width + 3) / 4;
     std::uint32_t block_count_y = (height + 3) / 4;
-    std::size_t block_size = (bc_type != 1 && bc_type != 4 && bc_type != 5) ? 16 : 8;
-
-    std::uint32_t temp_block_result[16] = {};
 
-    // Z-order curve inverse table
-    static const int z_order_curve_inv[] = {
-        0, 2, 8, 10,
-        1, 3, 9, 11,
-        4, 6, 12, 14,
-        5, 7, 13, 15
-    };
-
-    for (std::uint32_t j = 0; j < block_count_y; j++) {
-        for (std::uint32_t i = 0; i < block_count_x; i++) {
-            switch (bc_type) {
-            case 1:
-                decompress_block_bc1(block_storage, temp_block_result);
-                break;
+    void (*decompress)(const std::uint8_t *, std::uint32_t *, std::size_t, std::size_t) = nullptr;
+    switch (bc_type) {
+    case 1:
+        decompress = decompress_blocks<decompress_block_bc1, 8>;
+        break;
 
-            case 2:
-                decompress_block_bc2(block_storage, temp_block_result);
-                break;
+    case 2:
+        decompress = decompress_blocks<decompress_block_bc2, 16>;
+        break;
 
-            case 3:
-                decompress_block_bc3(block_storage, temp_block_result);
-                break;
+    case 3:
+        decompress = decompress_blocks<decompress_block_bc3, 16>;
+        break;
 
-            case 4:
-                decompress_block_bc4u(block_storage, temp_block_result);
-                break;
+    case 4:
+        decompress = decompress_blocks<decompress_block_bc4u, 8>;
+        break;
 
-            case 5:
-                decompress_block_bc4s(block_storage, temp_block_result);
-                break;
+    case 5:
+        decompress = decompress_blocks<decompress_block_bc4s, 8>;
+        break;
 
-            case 6:
-                decompress_block_bc5u(block_storage, temp_block_result);
-                break;
+    case 6:
+        decompress = decompress_blocks<decompress_block_bc5u, 16>;
+        break;
 
-            case 7:
-                decompress_block_bc5s(block_storage, temp_block_result);
-                break;
-            }
+    case 7:
+        decompress = decompress_blocks<decompress_block_bc5s, 16>;
+        break;
 
-            for (int b = 0; b < 16; b++) {
-                image[z_order_curve_inv[b]] = temp_block_result[b];
-            }
+    default:
+        return;
+    }
 
-            block_storage += block_size;
-            image += 16;
-        }
+    // Blocks are independent from each other
+    const std::size_t block_count = static_cast<std::size_t>(block_count_x) * block_count_y;
+    const std::size_t part_count = (block_count + DECOMPRESS_BLOCKS_PER_PART - 1) / DECOMPRESS_BLOCKS_PER_PART;
+    if (!pool || part_count < 2) {
+        decompress(block_storage, image, 0, block_count);
+        return;
     }
+
+    pool->parallel_for(part_count, [&](std::size_t part) {
+        const std::size_t first = part * DECOMPRESS_BLOCKS_PER_PART;
+        decompress(block_storage, image, first, std::min(DECOMPRESS_BLOCKS_PER_PART, block_count - first));
+    });
 }
 
 /**
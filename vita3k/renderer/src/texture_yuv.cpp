@@ -17,64 +17,263 @@
 
 #include <renderer/functions.h>
 
-#include <util/log.h>
+#include <gxm/functions.h>
 
 #include <algorithm>
 
-extern "C" {
-#include <libswscale/swscale.h>
-}
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YUV_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define YUV_NEON
+#include <arm_neon.h>
+#endif
 
 namespace renderer::texture {
 
-static SwsContext *s_render_sws_context{};
-static size_t res[2] = { 0, 0 };
-SwsContext *get_sws_context(size_t width, size_t height) {
-    bool recreate = false;
-    if (res[0] != width || res[1] != height) {
-        recreate = true;
-        res[0] = width;
-        res[1] = height;
-    } else if (s_render_sws_context == nullptr) {
-        recreate = true;
-    }
+// Limited range YUV to RGB coefficients. The luma one is applied to Y * 257 with a 16-bit high multiply,
+// the chroma ones have 6 fractional bits, as does the result before it is shifted down.
+struct YuvCoefficients {
+    uint16_t y;
+    int16_t y_bias;
+    int16_t v_to_r;
+    int16_t u_to_g;
+    int16_t v_to_g;
+    int16_t u_to_b;
+};
 
-    if (recreate) {
-        if (s_render_sws_context != nullptr) {
-            sws_freeContext(s_render_sws_context);
-            s_render_sws_context = nullptr;
-        }
-        s_render_sws_context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_RGB24,
-            0, nullptr, nullptr, nullptr);
-    }
-    return s_render_sws_context;
+// 1.164 * 64 * 65536 / 257 for luma, -16 * 1.164 * 64 + 32 for the bias (with the rounding of the final shift)
+static constexpr YuvCoefficients bt601_coefficients = { 19003, -1160, 102, 25, 52, 129 };
+static constexpr YuvCoefficients bt709_coefficients = { 19003, -1160, 115, 14, 34, 135 };
+
+static uint8_t clamp_to_u8(int value) {
+    return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+static void yuv_to_rgba_pixel(uint8_t *dst, uint8_t y, uint8_t u, uint8_t v, const YuvCoefficients &coefs) {
+    const int luma = static_cast<int>((y * 0x0101u * coefs.y) >> 16) + coefs.y_bias;
+    const int d = u - 128;
+    const int e = v - 128;
+    dst[0] = clamp_to_u8((luma + coefs.v_to_r * e) >> 6);
+    dst[1] = clamp_to_u8((luma - coefs.u_to_g * d - coefs.v_to_g * e) >> 6);
+    dst[2] = clamp_to_u8((luma + coefs.u_to_b * d) >> 6);
+    dst[3] = 255;
 }
 
-void yuv420_texture_to_rgb(uint8_t *dst, const uint8_t *src, size_t width, size_t height) {
-    SwsContext *context = get_sws_context(width, height);
-    assert(context);
+#ifdef __AVX2__
+// Converts 32 pixels, the chroma values are 16-bit lanes already centered on 0
+static void yuv_to_rgba_32(uint8_t *dst, const uint8_t *y_row, __m256i d, __m256i e, const YuvCoefficients &coefs) {
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(y_row));
+
+    const __m256i r_diff = _mm256_mullo_epi16(e, _mm256_set1_epi16(coefs.v_to_r));
+    const __m256i g_diff = _mm256_add_epi16(_mm256_mullo_epi16(d, _mm256_set1_epi16(coefs.u_to_g)), _mm256_mullo_epi16(e, _mm256_set1_epi16(coefs.v_to_g)));
+    const __m256i b_diff = _mm256_mullo_epi16(d, _mm256_set1_epi16(coefs.u_to_b));
+
+    // Unpacking works inside each 128-bit lane, the low halves hold pixels 0-7 and 16-23 for both luma and chroma
+    const __m256i luma_lo = _mm256_add_epi16(_mm256_mulhi_epu16(_mm256_unpacklo_epi8(y, y), _mm256_set1_epi16(coefs.y)), _mm256_set1_epi16(coefs.y_bias));
+    const __m256i luma_hi = _mm256_add_epi16(_mm256_mulhi_epu16(_mm256_unpackhi_epi8(y, y), _mm256_set1_epi16(coefs.y)), _mm256_set1_epi16(coefs.y_bias));
 
-    const uint8_t *slices[] = {
-        &src[0], // Y Slice
-        &src[width * height], // U Slice
-        &src[width * height + width * height / 4], // V Slice
+    const auto channel = [&](__m256i diff, bool subtract) {
+        const __m256i diff_lo = _mm256_unpacklo_epi16(diff, diff);
+        const __m256i diff_hi = _mm256_unpackhi_epi16(diff, diff);
+        const __m256i lo = subtract ? _mm256_subs_epi16(luma_lo, diff_lo) : _mm256_adds_epi16(luma_lo, diff_lo);
+        const __m256i hi = subtract ? _mm256_subs_epi16(luma_hi, diff_hi) : _mm256_adds_epi16(luma_hi, diff_hi);
+        return _mm256_packus_epi16(_mm256_srai_epi16(lo, 6), _mm256_srai_epi16(hi, 6));
     };
 
-    int strides[] = {
-        static_cast<int>(width),
-        static_cast<int>(width / 2),
-        static_cast<int>(width / 2),
+    const __m256i r = channel(r_diff, false);
+    const __m256i g = channel(g_diff, true);
+    const __m256i b = channel(b_diff, false);
+    const __m256i a = _mm256_set1_epi8(static_cast<char>(0xFF));
+
+    const __m256i rg_lo = _mm256_unpacklo_epi8(r, g);
+    const __m256i rg_hi = _mm256_unpackhi_epi8(r, g);
+    const __m256i ba_lo = _mm256_unpacklo_epi8(b, a);
+    const __m256i ba_hi = _mm256_unpackhi_epi8(b, a);
+
+    const __m256i rgba0 = _mm256_unpacklo_epi16(rg_lo, ba_lo);
+    const __m256i rgba1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);
+    const __m256i rgba2 = _mm256_unpacklo_epi16(rg_hi, ba_hi);
+    const __m256i rgba3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);
+
+    __m256i *out = reinterpret_cast<__m256i *>(dst);
+    _mm256_storeu_si256(out, _mm256_permute2x128_si256(rgba0, rgba1, 0x20));
+    _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(rgba2, rgba3, 0x20));
+    _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(rgba0, rgba1, 0x31));
+    _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(rgba2, rgba3, 0x31));
+}
+#elif defined(YUV_SSE2)
+// Converts 16 pixels, the chroma values are 16-bit lanes already centered on 0
+static void yuv_to_rgba_16(uint8_t *dst, const uint8_t *y_row, __m128i d, __m128i e, const YuvCoefficients &coefs) {
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y_row));
+
+    const __m128i r_diff = _mm_mullo_epi16(e, _mm_set1_epi16(coefs.v_to_r));
+    const __m128i g_diff = _mm_add_epi16(_mm_mullo_epi16(d, _mm_set1_epi16(coefs.u_to_g)), _mm_mullo_epi16(e, _mm_set1_epi16(coefs.v_to_g)));
+    const __m128i b_diff = _mm_mullo_epi16(d, _mm_set1_epi16(coefs.u_to_b));
+
+    const __m128i luma_lo = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpacklo_epi8(y, y), _mm_set1_epi16(coefs.y)), _mm_set1_epi16(coefs.y_bias));
+    const __m128i luma_hi = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpackhi_epi8(y, y), _mm_set1_epi16(coefs.y)), _mm_set1_epi16(coefs.y_bias));
+
+    const auto channel = [&](__m128i diff, bool subtract) {
+        const __m128i diff_lo = _mm_unpacklo_epi16(diff, diff);
+        const __m128i diff_hi = _mm_unpackhi_epi16(diff, diff);
+        const __m128i lo = subtract ? _mm_subs_epi16(luma_lo, diff_lo) : _mm_adds_epi16(luma_lo, diff_lo);
+        const __m128i hi = subtract ? _mm_subs_epi16(luma_hi, diff_hi) : _mm_adds_epi16(luma_hi, diff_hi);
+        return _mm_packus_epi16(_mm_srai_epi16(lo, 6), _mm_srai_epi16(hi, 6));
     };
 
-    uint8_t *dst_slices[] = {
-        dst,
+    const __m128i r = channel(r_diff, false);
+    const __m128i g = channel(g_diff, true);
+    const __m128i b = channel(b_diff, false);
+    const __m128i a = _mm_set1_epi8(static_cast<char>(0xFF));
+
+    const __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+    const __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+    const __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+    const __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+    __m128i *out = reinterpret_cast<__m128i *>(dst);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+}
+#elif defined(YUV_NEON)
+// Converts 16 pixels, the chroma values are 16-bit lanes already centered on 0
+static void yuv_to_rgba_16(uint8_t *dst, const uint8_t *y_row, int16x8_t d, int16x8_t e, const YuvCoefficients &coefs) {
+    const uint8x16_t y = vld1q_u8(y_row);
+
+    const int16x8_t r_diff = vmulq_n_s16(e, coefs.v_to_r);
+    const int16x8_t g_diff = vmlaq_n_s16(vmulq_n_s16(d, coefs.u_to_g), e, coefs.v_to_g);
+    const int16x8_t b_diff = vmulq_n_s16(d, coefs.u_to_b);
+
+    const auto luma = [&](uint8x8_t half) {
+        const uint16x8_t y16 = vmulq_n_u16(vmovl_u8(half), 0x0101);
+        const uint16x8_t scaled = vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(y16), coefs.y), 16), vshrn_n_u32(vmull_n_u16(vget_high_u16(y16), coefs.y), 16));
+        return vaddq_s16(vreinterpretq_s16_u16(scaled), vdupq_n_s16(coefs.y_bias));
     };
+    const int16x8_t luma_lo = luma(vget_low_u8(y));
+    const int16x8_t luma_hi = luma(vget_high_u8(y));
 
-    const int dst_strides[] = {
-        static_cast<int>(width * 3),
+    const auto channel = [&](int16x8_t diff, bool subtract) {
+        const int16x8x2_t dup = vzipq_s16(diff, diff);
+        const int16x8_t lo = subtract ? vqsubq_s16(luma_lo, dup.val[0]) : vqaddq_s16(luma_lo, dup.val[0]);
+        const int16x8_t hi = subtract ? vqsubq_s16(luma_hi, dup.val[1]) : vqaddq_s16(luma_hi, dup.val[1]);
+        return vcombine_u8(vqshrun_n_s16(lo, 6), vqshrun_n_s16(hi, 6));
     };
 
-    int error = sws_scale(context, slices, strides, 0, height, dst_slices, dst_strides);
-    assert(error == height);
+    uint8x16x4_t rgba;
+    rgba.val[0] = channel(r_diff, false);
+    rgba.val[1] = channel(g_diff, true);
+    rgba.val[2] = channel(b_diff, false);
+    rgba.val[3] = vdupq_n_u8(0xFF);
+    vst4q_u8(dst, rgba);
+}
+#endif
+
+// Converts one row, the chroma samples of two pixels being at u_row[x / 2 * chroma_step] and v_row[x / 2 * chroma_step]
+static void yuv_row_to_rgba(uint8_t *dst, const uint8_t *y_row, const uint8_t *u_row, const uint8_t *v_row, size_t width,
+    size_t chroma_step, const YuvCoefficients &coefs) {
+    size_t x = 0;
+#ifdef __AVX2__
+    const __m256i center = _mm256_set1_epi16(128);
+    for (; x + 32 <= width; x += 32) {
+        __m256i u, v;
+        if (chroma_step == 1) {
+            u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u_row + x / 2)));
+            v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v_row + x / 2)));
+        } else {
+            // u_row and v_row are one byte apart in the interleaved plane
+            const __m256i uv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(std::min(u_row, v_row) + x));
+            const __m256i even = _mm256_and_si256(uv, _mm256_set1_epi16(0xFF));
+            const __m256i odd = _mm256_srli_epi16(uv, 8);
+            u = u_row < v_row ? even : odd;
+            v = u_row < v_row ? odd : even;
+        }
+        yuv_to_rgba_32(dst + x * 4, y_row + x, _mm256_sub_epi16(u, center), _mm256_sub_epi16(v, center), coefs);
+    }
+#elif defined(YUV_SSE2)
+    const __m128i center = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        __m128i u, v;
+        if (chroma_step == 1) {
+            u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u_row + x / 2)), zero);
+            v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v_row + x / 2)), zero);
+        } else {
+            // u_row and v_row are one byte apart in the interleaved plane
+            const __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(std::min(u_row, v_row) + x));
+            const __m128i even = _mm_and_si128(uv, _mm_set1_epi16(0xFF));
+            const __m128i odd = _mm_srli_epi16(uv, 8);
+            u = u_row < v_row ? even : odd;
+            v = u_row < v_row ? odd : even;
+        }
+        yuv_to_rgba_16(dst + x * 4, y_row + x, _mm_sub_epi16(u, center), _mm_sub_epi16(v, center), coefs);
+    }
+#elif defined(YUV_NEON)
+    const uint8x8_t center = vdup_n_u8(128);
+    for (; x + 16 <= width; x += 16) {
+        uint8x8_t u, v;
+        if (chroma_step == 1) {
+            u = vld1_u8(u_row + x / 2);
+            v = vld1_u8(v_row + x / 2);
+        } else {
+            const uint8x8x2_t uv = vld2_u8(std::min(u_row, v_row) + x);
+            u = u_row < v_row ? uv.val[0] : uv.val[1];
+            v = u_row < v_row ? uv.val[1] : uv.val[0];
+        }
+        yuv_to_rgba_16(dst + x * 4, y_row + x, vreinterpretq_s16_u16(vsubl_u8(u, center)), vreinterpretq_s16_u16(vsubl_u8(v, center)), coefs);
+    }
+#endif
+
+    for (; x < width; x++) {
+        const size_t chroma_offset = x / 2 * chroma_step;
+        yuv_to_rgba_pixel(dst + x * 4, y_row[x], u_row[chroma_offset], v_row[chroma_offset], coefs);
+    }
+}
+
+void yuv420_texture_to_rgba(uint8_t *dst, size_t dst_stride, const uint8_t *src, size_t width, size_t height, SceGxmTextureFormat format) {
+    const SceGxmTextureBaseFormat base_format = gxm::get_base_format(format);
+    const uint32_t swizzle = format & SCE_GXM_TEXTURE_SWIZZLE_MASK;
+    const bool is_yvu = swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC0 || swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC1;
+    const bool is_csc1 = swizzle == SCE_GXM_TEXTURE_SWIZZLE_YUV_CSC1 || swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC1;
+    // CSC0 is the BT.601 matrix, CSC1 the BT.709 one
+    const YuvCoefficients &coefs = is_csc1 ? bt709_coefficients : bt601_coefficients;
+
+    // The chroma planes are rounded up for odd sizes, the last column or row has its own samples
+    const size_t chroma_width = (width + 1) / 2;
+    const size_t chroma_height = (height + 1) / 2;
+
+    const uint8_t *y_plane = src;
+    const uint8_t *u_plane;
+    const uint8_t *v_plane;
+    size_t chroma_stride;
+    size_t chroma_step;
+    if (base_format == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2) {
+        // One plane with interleaved chroma samples
+        u_plane = src + width * height;
+        v_plane = u_plane + 1;
+        chroma_stride = chroma_width * 2;
+        chroma_step = 2;
+    } else {
+        u_plane = src + width * height;
+        v_plane = u_plane + chroma_width * chroma_height;
+        chroma_stride = chroma_width;
+        chroma_step = 1;
+    }
+
+    if (is_yvu)
+        std::swap(u_plane, v_plane);
+
+    for (size_t y = 0; y < height; y++) {
+        const size_t chroma_offset = (y / 2) * chroma_stride;
+        yuv_row_to_rgba(dst + y * dst_stride, y_plane + y * width, u_plane + chroma_offset, v_plane + chroma_offset, width, chroma_step, coefs);
+    }
 }
 } // namespace renderer::texture
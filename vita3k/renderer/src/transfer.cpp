@@ -0,0 +1,477 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/functions.h>
+
+#include <gxm/functions.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define TRANSFER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace renderer {
+
+// Guest surfaces have no alignment guarantee, every scalar access goes through memcpy
+template <typename T>
+static T load(const uint8_t *src) {
+    T value;
+    memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void store(uint8_t *dest, T value) {
+    memcpy(dest, &value, sizeof(T));
+}
+
+// Value the color key is compared with, the first 4 bytes of the pixel at most
+static uint32_t load_key_value(const uint8_t *src, uint32_t bytes_per_pixel) {
+    uint32_t value = 0;
+    memcpy(&value, src, std::min(bytes_per_pixel, 4u));
+    return value;
+}
+
+static bool is_copied(uint32_t value, const TransferColorKey &key) {
+    const bool equal = (value & key.mask) == key.value;
+    return equal == (key.mode == SCE_GXM_TRANSFER_COLORKEY_PASS);
+}
+
+template <typename T>
+static void copy_row_color_key(uint8_t *dest, const uint8_t *src, uint32_t width, const TransferColorKey &key) {
+    const bool pass = key.mode == SCE_GXM_TRANSFER_COLORKEY_PASS;
+    const T mask = static_cast<T>(key.mask);
+    const T value = static_cast<T>(key.value);
+    uint32_t x = 0;
+
+    // Pixels are selected where (src & mask) == value for PASS, where it is not for REJECT
+#ifdef __AVX2__
+    {
+        __m256i vmask, vvalue;
+        if constexpr (sizeof(T) == 1) {
+            vmask = _mm256_set1_epi8(static_cast<char>(mask));
+            vvalue = _mm256_set1_epi8(static_cast<char>(value));
+        } else if constexpr (sizeof(T) == 2) {
+            vmask = _mm256_set1_epi16(static_cast<short>(mask));
+            vvalue = _mm256_set1_epi16(static_cast<short>(value));
+        } else {
+            vmask = _mm256_set1_epi32(static_cast<int>(mask));
+            vvalue = _mm256_set1_epi32(static_cast<int>(value));
+        }
+        constexpr uint32_t step = 32 / sizeof(T);
+        for (; x + step <= width; x += step) {
+            const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * sizeof(T)));
+            const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dest + x * sizeof(T)));
+            const __m256i masked = _mm256_and_si256(s, vmask);
+            __m256i equal;
+            if constexpr (sizeof(T) == 1)
+                equal = _mm256_cmpeq_epi8(masked, vvalue);
+            else if constexpr (sizeof(T) == 2)
+                equal = _mm256_cmpeq_epi16(masked, vvalue);
+            else
+                equal = _mm256_cmpeq_epi32(masked, vvalue);
+            const __m256i result = pass ? _mm256_blendv_epi8(d, s, equal) : _mm256_blendv_epi8(s, d, equal);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * sizeof(T)), result);
+        }
+    }
+#endif
+#if defined(TRANSFER_SSE2)
+    {
+        __m128i vmask, vvalue;
+        if constexpr (sizeof(T) == 1) {
+            vmask = _mm_set1_epi8(static_cast<char>(mask));
+            vvalue = _mm_set1_epi8(static_cast<char>(value));
+        } else if constexpr (sizeof(T) == 2) {
+            vmask = _mm_set1_epi16(static_cast<short>(mask));
+            vvalue = _mm_set1_epi16(static_cast<short>(value));
+        } else {
+            vmask = _mm_set1_epi32(static_cast<int>(mask));
+            vvalue = _mm_set1_epi32(static_cast<int>(value));
+        }
+        constexpr uint32_t step = 16 / sizeof(T);
+        for (; x + step <= width; x += step) {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * sizeof(T)));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + x * sizeof(T)));
+            const __m128i masked = _mm_and_si128(s, vmask);
+            __m128i select;
+            if constexpr (sizeof(T) == 1)
+                select = _mm_cmpeq_epi8(masked, vvalue);
+            else if constexpr (sizeof(T) == 2)
+                select = _mm_cmpeq_epi16(masked, vvalue);
+            else
+                select = _mm_cmpeq_epi32(masked, vvalue);
+            if (!pass)
+                select = _mm_xor_si128(select, _mm_set1_epi32(-1));
+            const __m128i result = _mm_or_si128(_mm_and_si128(select, s), _mm_andnot_si128(select, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * sizeof(T)), result);
+        }
+    }
+#elif defined(TRANSFER_NEON)
+    if constexpr (sizeof(T) == 1) {
+        const uint8x16_t vmask = vdupq_n_u8(mask), vvalue = vdupq_n_u8(value);
+        for (; x + 16 <= width; x += 16) {
+            const uint8x16_t s = vld1q_u8(src + x), d = vld1q_u8(dest + x);
+            uint8x16_t select = vceqq_u8(vandq_u8(s, vmask), vvalue);
+            if (!pass)
+                select = vmvnq_u8(select);
+            vst1q_u8(dest + x, vbslq_u8(select, s, d));
+        }
+    } else if constexpr (sizeof(T) == 2) {
+        const uint16x8_t vmask = vdupq_n_u16(mask), vvalue = vdupq_n_u16(value);
+        for (; x + 8 <= width; x += 8) {
+            const uint16x8_t s = vreinterpretq_u16_u8(vld1q_u8(src + x * 2));
+            const uint16x8_t d = vreinterpretq_u16_u8(vld1q_u8(dest + x * 2));
+            uint16x8_t select = vceqq_u16(vandq_u16(s, vmask), vvalue);
+            if (!pass)
+                select = vmvnq_u16(select);
+            vst1q_u8(dest + x * 2, vreinterpretq_u8_u16(vbslq_u16(select, s, d)));
+        }
+    } else {
+        const uint32x4_t vmask = vdupq_n_u32(mask), vvalue = vdupq_n_u32(value);
+        for (; x + 4 <= width; x += 4) {
+            const uint32x4_t s = vreinterpretq_u32_u8(vld1q_u8(src + x * 4));
+            const uint32x4_t d = vreinterpretq_u32_u8(vld1q_u8(dest + x * 4));
+            uint32x4_t select = vceqq_u32(vandq_u32(s, vmask), vvalue);
+            if (!pass)
+                select = vmvnq_u32(select);
+            vst1q_u8(dest + x * 4, vreinterpretq_u8_u32(vbslq_u32(select, s, d)));
+        }
+    }
+#endif
+
+    for (; x < width; x++) {
+        const T pixel = load<T>(src + x * sizeof(T));
+        if (((pixel & mask) == value) == pass)
+            store<T>(dest + x * sizeof(T), pixel);
+    }
+}
+
+static void copy_row(uint8_t *dest, const uint8_t *src, uint32_t width, uint32_t bytes_per_pixel, const TransferColorKey &key) {
+    // Source and destination rows overlap when an image is copied over itself
+    if (key.mode != SCE_GXM_TRANSFER_COLORKEY_PASS && key.mode != SCE_GXM_TRANSFER_COLORKEY_REJECT) {
+        memmove(dest, src, width * bytes_per_pixel);
+        return;
+    }
+
+    // A key value with bits out of the pixel never matches
+    if (bytes_per_pixel < 4 && (key.value >> (bytes_per_pixel * 8)) != 0) {
+        if (key.mode == SCE_GXM_TRANSFER_COLORKEY_REJECT)
+            memmove(dest, src, width * bytes_per_pixel);
+        return;
+    }
+
+    switch (bytes_per_pixel) {
+    case 1: copy_row_color_key<uint8_t>(dest, src, width, key); break;
+    case 2: copy_row_color_key<uint16_t>(dest, src, width, key); break;
+    case 4: copy_row_color_key<uint32_t>(dest, src, width, key); break;
+    default:
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t *src_pixel = src + x * bytes_per_pixel;
+            if (is_copied(load_key_value(src_pixel, bytes_per_pixel), key))
+                memcpy(dest + x * bytes_per_pixel, src_pixel, bytes_per_pixel);
+        }
+        break;
+    }
+}
+
+static bool is_raw_format(SceGxmTransferFormat format) {
+    switch (format) {
+    case SCE_GXM_TRANSFER_FORMAT_RAW16:
+    case SCE_GXM_TRANSFER_FORMAT_RAW32:
+    case SCE_GXM_TRANSFER_FORMAT_RAW64:
+    case SCE_GXM_TRANSFER_FORMAT_RAW128:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Formats which can be converted to each other
+static bool is_color_format(SceGxmTransferFormat format) {
+    switch (format) {
+    case SCE_GXM_TRANSFER_FORMAT_U8_R:
+    case SCE_GXM_TRANSFER_FORMAT_U4U4U4U4_ABGR:
+    case SCE_GXM_TRANSFER_FORMAT_U1U5U5U5_ABGR:
+    case SCE_GXM_TRANSFER_FORMAT_U5U6U5_BGR:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8_GR:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8_BGR:
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR:
+    case SCE_GXM_TRANSFER_FORMAT_U2U10U10U10_ABGR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static uint32_t expand_bits(uint32_t value, uint32_t bits) {
+    switch (bits) {
+    case 1: return value ? 0xFF : 0;
+    case 2: return value * 0x55;
+    case 4: return value * 0x11;
+    case 5: return (value << 3) | (value >> 2);
+    case 6: return (value << 2) | (value >> 4);
+    case 10: return value >> 2;
+    default: return value;
+    }
+}
+
+// Decodes a pixel of a color format to U8U8U8U8_ABGR
+static uint32_t decode_pixel(SceGxmTransferFormat format, const uint8_t *src) {
+    uint32_t r = 0, g = 0, b = 0, a = 0xFF;
+    switch (format) {
+    case SCE_GXM_TRANSFER_FORMAT_U8_R:
+        r = src[0];
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U4U4U4U4_ABGR: {
+        const uint16_t pixel = load<uint16_t>(src);
+        r = expand_bits(pixel & 0xF, 4);
+        g = expand_bits((pixel >> 4) & 0xF, 4);
+        b = expand_bits((pixel >> 8) & 0xF, 4);
+        a = expand_bits(pixel >> 12, 4);
+        break;
+    }
+    case SCE_GXM_TRANSFER_FORMAT_U1U5U5U5_ABGR: {
+        const uint16_t pixel = load<uint16_t>(src);
+        r = expand_bits(pixel & 0x1F, 5);
+        g = expand_bits((pixel >> 5) & 0x1F, 5);
+        b = expand_bits((pixel >> 10) & 0x1F, 5);
+        a = expand_bits(pixel >> 15, 1);
+        break;
+    }
+    case SCE_GXM_TRANSFER_FORMAT_U5U6U5_BGR: {
+        const uint16_t pixel = load<uint16_t>(src);
+        r = expand_bits(pixel & 0x1F, 5);
+        g = expand_bits((pixel >> 5) & 0x3F, 6);
+        b = expand_bits(pixel >> 11, 5);
+        break;
+    }
+    case SCE_GXM_TRANSFER_FORMAT_U8U8_GR:
+        r = src[0];
+        g = src[1];
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8_BGR:
+        r = src[0];
+        g = src[1];
+        b = src[2];
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR:
+        return load<uint32_t>(src);
+    case SCE_GXM_TRANSFER_FORMAT_U2U10U10U10_ABGR: {
+        const uint32_t pixel = load<uint32_t>(src);
+        r = expand_bits(pixel & 0x3FF, 10);
+        g = expand_bits((pixel >> 10) & 0x3FF, 10);
+        b = expand_bits((pixel >> 20) & 0x3FF, 10);
+        a = expand_bits(pixel >> 30, 2);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void encode_pixel(SceGxmTransferFormat format, uint32_t rgba, uint8_t *dest) {
+    const uint32_t r = rgba & 0xFF;
+    const uint32_t g = (rgba >> 8) & 0xFF;
+    const uint32_t b = (rgba >> 16) & 0xFF;
+    const uint32_t a = rgba >> 24;
+    switch (format) {
+    case SCE_GXM_TRANSFER_FORMAT_U8_R:
+        dest[0] = static_cast<uint8_t>(r);
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U4U4U4U4_ABGR:
+        store<uint16_t>(dest, static_cast<uint16_t>((r >> 4) | ((g >> 4) << 4) | ((b >> 4) << 8) | ((a >> 4) << 12)));
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U1U5U5U5_ABGR:
+        store<uint16_t>(dest, static_cast<uint16_t>((r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10) | ((a >> 7) << 15)));
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U5U6U5_BGR:
+        store<uint16_t>(dest, static_cast<uint16_t>((r >> 3) | ((g >> 2) << 5) | ((b >> 3) << 11)));
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U8U8_GR:
+        dest[0] = static_cast<uint8_t>(r);
+        dest[1] = static_cast<uint8_t>(g);
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8_BGR:
+        dest[0] = static_cast<uint8_t>(r);
+        dest[1] = static_cast<uint8_t>(g);
+        dest[2] = static_cast<uint8_t>(b);
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR:
+        store<uint32_t>(dest, rgba);
+        break;
+    case SCE_GXM_TRANSFER_FORMAT_U2U10U10U10_ABGR:
+        store<uint32_t>(dest, ((r << 2) | (r >> 6)) | (((g << 2) | (g >> 6)) << 10) | (((b << 2) | (b >> 6)) << 20) | ((a >> 6) << 30));
+        break;
+    default:
+        break;
+    }
+}
+
+bool transfer_copy_row(uint8_t *dest, SceGxmTransferFormat dest_format, const uint8_t *src, SceGxmTransferFormat src_format, uint32_t width, const TransferColorKey &key) {
+    const uint32_t src_bytes_per_pixel = (gxm::get_bits_per_pixel(src_format) + 7) >> 3;
+    const uint32_t dest_bytes_per_pixel = (gxm::get_bits_per_pixel(dest_format) + 7) >> 3;
+
+    // Raw formats take the bits of any format of the same size
+    const bool same_layout = (src_format == dest_format) || ((src_bytes_per_pixel == dest_bytes_per_pixel) && (is_raw_format(src_format) || is_raw_format(dest_format)));
+    if (same_layout) {
+        copy_row(dest, src, width, src_bytes_per_pixel, key);
+        return true;
+    }
+
+    if (!is_color_format(src_format) || !is_color_format(dest_format))
+        return false;
+
+    for (uint32_t x = 0; x < width; x++) {
+        const uint8_t *src_pixel = src + x * src_bytes_per_pixel;
+        if (key.mode != SCE_GXM_TRANSFER_COLORKEY_NONE && !is_copied(load_key_value(src_pixel, src_bytes_per_pixel), key))
+            continue;
+
+        encode_pixel(dest_format, decode_pixel(src_format, src_pixel), dest + x * dest_bytes_per_pixel);
+    }
+
+    return true;
+}
+
+template <typename T>
+static void fill_row_simd(uint8_t *dest, uint32_t width, T color) {
+    uint32_t x = 0;
+#ifdef __AVX2__
+    {
+        __m256i vcolor;
+        if constexpr (sizeof(T) == 2)
+            vcolor = _mm256_set1_epi16(static_cast<short>(color));
+        else
+            vcolor = _mm256_set1_epi32(static_cast<int>(color));
+        for (; x + 32 / sizeof(T) <= width; x += 32 / sizeof(T))
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * sizeof(T)), vcolor);
+    }
+#endif
+#if defined(TRANSFER_SSE2)
+    {
+        __m128i vcolor;
+        if constexpr (sizeof(T) == 2)
+            vcolor = _mm_set1_epi16(static_cast<short>(color));
+        else
+            vcolor = _mm_set1_epi32(static_cast<int>(color));
+        for (; x + 16 / sizeof(T) <= width; x += 16 / sizeof(T))
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * sizeof(T)), vcolor);
+    }
+#elif defined(TRANSFER_NEON)
+    if constexpr (sizeof(T) == 2) {
+        const uint8x16_t vcolor = vreinterpretq_u8_u16(vdupq_n_u16(color));
+        for (; x + 8 <= width; x += 8)
+            vst1q_u8(dest + x * 2, vcolor);
+    } else {
+        const uint8x16_t vcolor = vreinterpretq_u8_u32(vdupq_n_u32(color));
+        for (; x + 4 <= width; x += 4)
+            vst1q_u8(dest + x * 4, vcolor);
+    }
+#endif
+
+    for (; x < width; x++)
+        store<T>(dest + x * sizeof(T), color);
+}
+
+void transfer_fill_row(uint8_t *dest, uint32_t width, uint32_t bytes_per_pixel, uint32_t color) {
+    switch (bytes_per_pixel) {
+    case 1:
+        memset(dest, static_cast<uint8_t>(color), width);
+        break;
+    case 2:
+        fill_row_simd<uint16_t>(dest, width, static_cast<uint16_t>(color));
+        break;
+    case 4:
+        fill_row_simd<uint32_t>(dest, width, color);
+        break;
+    default: {
+        if (width == 0)
+            break;
+
+        // The color only covers the first 4 bytes of wider pixels, then the row doubles itself
+        uint8_t pixel[16] = {};
+        memcpy(pixel, &color, std::min(bytes_per_pixel, 4u));
+        memcpy(dest, pixel, bytes_per_pixel);
+
+        const size_t row_size = static_cast<size_t>(width) * bytes_per_pixel;
+        for (size_t filled = bytes_per_pixel; filled < row_size; filled *= 2)
+            memcpy(dest + filled, dest, std::min(filled, row_size - filled));
+        break;
+    }
+    }
+}
+
+void transfer_downscale_row(uint8_t *dest, const uint8_t *src, uint32_t dest_width, uint32_t bytes_per_pixel) {
+    uint32_t x = 0;
+
+    // Keeps the even pixels of the source row
+    if (bytes_per_pixel == 4) {
+#ifdef __AVX2__
+        for (; x + 8 <= dest_width; x += 8) {
+            const __m256 a = _mm256_loadu_ps(reinterpret_cast<const float *>(src + x * 8));
+            const __m256 b = _mm256_loadu_ps(reinterpret_cast<const float *>(src + x * 8 + 32));
+            const __m256 even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m256i ordered = _mm256_permute4x64_epi64(_mm256_castps_si256(even), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + x * 4), ordered);
+        }
+#endif
+#if defined(TRANSFER_SSE2)
+        for (; x + 4 <= dest_width; x += 4) {
+            const __m128 a = _mm_loadu_ps(reinterpret_cast<const float *>(src + x * 8));
+            const __m128 b = _mm_loadu_ps(reinterpret_cast<const float *>(src + x * 8 + 16));
+            _mm_storeu_ps(reinterpret_cast<float *>(dest + x * 4), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+#elif defined(TRANSFER_NEON)
+        for (; x + 4 <= dest_width; x += 4) {
+            const uint32x4x2_t pixels = vld2q_u32(reinterpret_cast<const uint32_t *>(src + x * 8));
+            vst1q_u8(dest + x * 4, vreinterpretq_u8_u32(pixels.val[0]));
+        }
+#endif
+    } else if (bytes_per_pixel == 2) {
+#if defined(TRANSFER_SSE2)
+        for (; x + 8 <= dest_width; x += 8) {
+            // sign extend the low half of every pair so that the signed pack keeps it as is
+            const __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4)), 16), 16);
+            const __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4 + 16)), 16), 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 2), _mm_packs_epi32(a, b));
+        }
+#elif defined(TRANSFER_NEON)
+        for (; x + 8 <= dest_width; x += 8) {
+            const uint16x8x2_t pixels = vld2q_u16(reinterpret_cast<const uint16_t *>(src + x * 4));
+            vst1q_u8(dest + x * 2, vreinterpretq_u8_u16(pixels.val[0]));
+        }
+#endif
+    }
+
+    for (; x < dest_width; x++)
+        memcpy(dest + x * bytes_per_pixel, src + x * 2 * bytes_per_pixel, bytes_per_pixel);
+}
+
+} // namespace renderer
@@ -28,15 +28,32 @@
 #include <renderer/shaders.h>
 #include <shader/spirv_recompiler.h>
 
+#include <config/state.h>
 #include <util/align.h>
 #include <util/fs.h>
 #include <util/log.h>
+#include <util/thread_pool.h>
 
 namespace renderer::vulkan {
 PipelineCache::PipelineCache(VKState &state)
     : state(state) {
 }
 
+PipelineCache::~PipelineCache() = default;
+
+void PipelineCache::cleanup() {
+    // the jobs of the shared pool use the device and this cache
+    cancel_precompile = true;
+    for (const std::future<void> &job : precompile_jobs)
+        job.wait();
+    precompile_jobs.clear();
+
+    for (const auto &[hash, pending] : pending_shaders)
+        pending.module.wait();
+    for (const auto &[key, pending] : pending_pipelines)
+        pending.pipeline.wait();
+}
+
 void PipelineCache::init() {
     vk::PipelineCacheCreateInfo pipeline_info{};
     pipeline_cache = state.device.createPipelineCache(pipeline_info);
@@ -217,6 +234,33 @@ static const Sha256Hash get_shader_hash(const SceGxmProgram &program) {
     return hash_bytes;
 }
 
+static vk::PipelineShaderStageCreateInfo get_shader_stage(vk::ShaderModule shader, bool is_vertex) {
+    return vk::PipelineShaderStageCreateInfo{
+        .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
+        .module = shader,
+        .pName = is_vertex ? "main_vs" : "main_fs"
+    };
+}
+
+void PipelineCache::add_compiled_shader(const Sha256Hash &hash, vk::ShaderModule shader, bool is_vertex) {
+    shaders[hash] = shader;
+
+    // Save shader cache haches
+    // vertex and fragment shaders are not linked together so no need to associate them
+    Sha256Hash empty_hash{};
+    if (is_vertex) {
+        state.shaders_cache_hashs.push_back({ hash, empty_hash });
+    } else {
+        state.shaders_cache_hashs.push_back({ empty_hash, hash });
+    }
+    renderer::save_shaders_cache_hashs(state, state.shaders_cache_hashs);
+
+    const auto time_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    next_pipeline_cache_save = time_s + pipeline_cache_save_delay;
+
+    state.shaders_count_compiled++;
+}
+
 vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, MemState &mem, const std::vector<SceGxmVertexAttribute> *hint_attributes) {
     if (maskupdate)
         LOG_CRITICAL("Mask not implemented in the vulkan renderer!");
@@ -229,14 +273,8 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
             it = shaders.find(hash);
     }
 
-    if (it != shaders.end()) {
-        vk::PipelineShaderStageCreateInfo shader_stage_info{
-            .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
-            .module = it->second,
-            .pName = is_vertex ? "main_vs" : "main_fs"
-        };
-        return shader_stage_info;
-    }
+    if (it != shaders.end())
+        return get_shader_stage(it->second, is_vertex);
 
     const char *base_path = state.base_path;
     const char *title_id = state.title_id;
@@ -259,30 +297,102 @@ vk::PipelineShaderStageCreateInfo PipelineCache::retrieve_shader(const SceGxmPro
     };
 
     vk::ShaderModule shader = current_context->state.device.createShaderModule(shader_info);
-    shaders[hash] = shader;
+    add_compiled_shader(hash, shader, is_vertex);
 
-    // Save shader cache haches
-    // vertex and fragment shaders are not linked together so no need to associate them
-    Sha256Hash empty_hash{};
-    if (is_vertex) {
-        state.shaders_cache_hashs.push_back({ hash, empty_hash });
-    } else {
-        state.shaders_cache_hashs.push_back({ empty_hash, hash });
-    }
-    renderer::save_shaders_cache_hashs(state, state.shaders_cache_hashs);
+    return get_shader_stage(shader, is_vertex);
+}
 
-    const auto time_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    next_pipeline_cache_save = time_s + pipeline_cache_save_delay;
+static std::shared_future<vk::ShaderModule> make_ready_future(vk::ShaderModule shader) {
+    std::promise<vk::ShaderModule> promise;
+    promise.set_value(shader);
+    return promise.get_future().share();
+}
 
-    vk::PipelineShaderStageCreateInfo shader_stage_info{
-        .stage = is_vertex ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment,
-        .module = shader,
-        .pName = is_vertex ? "main_vs" : "main_fs"
-    };
+std::shared_future<vk::ShaderModule> PipelineCache::retrieve_shader_async(const SceGxmProgram *program, const Sha256Hash &hash, bool is_vertex, bool maskupdate, const std::vector<SceGxmVertexAttribute> *hint_attributes) {
+    if (maskupdate)
+        LOG_CRITICAL("Mask not implemented in the vulkan renderer!");
 
-    state.shaders_count_compiled++;
+    const auto pending = pending_shaders.find(hash);
+    if (pending != pending_shaders.end())
+        return pending->second.module;
+
+    // look if it is already there or in the cache
+    if (precompile_shader(hash))
+        return make_ready_future(shaders[hash]);
+
+    LOG_INFO("Generating vulkan spv shader {}", hex_string(hash));
+
+    // everything the translation needs is copied, the context keeps changing meanwhile
+    shader::Hints hints = current_context->shader_hints;
+    hints.color_format = current_context->record.color_surface.colorFormat;
+    auto attributes = hint_attributes ? std::make_shared<std::vector<SceGxmVertexAttribute>>(*hint_attributes) : nullptr;
+    // so is the program, the guest can free or reuse its memory before the job runs
+    const uint8_t *program_bytes = reinterpret_cast<const uint8_t *>(program);
+    auto program_copy = std::make_shared<std::vector<uint8_t>>(program_bytes, program_bytes + program->size);
+
+    ShaderCompileStats &stats = state.shader_compile_stats;
+    ++stats.queue_depth;
+    std::shared_future<vk::ShaderModule> module = ThreadPool::shared().submit([this, program_copy, hints, attributes, maskupdate, features = state.features, &stats]() mutable {
+        hints.attributes = attributes.get();
+        const SceGxmProgram &program = *reinterpret_cast<const SceGxmProgram *>(program_copy->data());
+        const std::string shader_version = fmt::format("vk{}", shader::CURRENT_VERSION);
+        const shader::usse::SpirvCode source = load_spirv_shader(program, features, true, hints, maskupdate, state.base_path, state.title_id, state.self_name, shader_version, true);
+
+        vk::ShaderModuleCreateInfo shader_info{
+            .codeSize = sizeof(uint32_t) * source.size(),
+            .pCode = source.data()
+        };
+        const vk::ShaderModule shader = state.device.createShaderModule(shader_info);
+        --stats.queue_depth;
+
+        return shader;
+    });
+
+    pending_shaders.emplace(hash, PendingShader{ module, is_vertex });
+    return module;
+}
+
+template <typename T>
+static bool is_ready(const std::shared_future<T> &future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void PipelineCache::collect_compiled() {
+    collect_precompiled();
+
+    for (auto it = pending_shaders.begin(); it != pending_shaders.end();) {
+        if (is_ready(it->second.module)) {
+            add_compiled_shader(it->first, it->second.module.get(), it->second.is_vertex);
+            it = pending_shaders.erase(it);
+        } else {
+            ++it;
+        }
+    }
 
-    return shader_stage_info;
+    for (auto it = pending_pipelines.begin(); it != pending_pipelines.end();) {
+        if (is_ready(it->second.pipeline)) {
+            const vk::Pipeline pipeline = it->second.pipeline.get();
+            // failed pipelines are tried again the next time they are needed
+            if (pipeline) {
+                pipelines[it->first] = pipeline;
+                fallback_pipelines[it->second.fallback_key] = pipeline;
+            }
+            it = pending_pipelines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PipelineCache::record_hitch(std::chrono::steady_clock::time_point start) {
+    const uint64_t hitch_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    ShaderCompileStats &stats = state.shader_compile_stats;
+    ++stats.hitch_count;
+    stats.hitch_time_us += hitch_us;
+    stats.last_hitch_us = hitch_us;
+    if (hitch_us > stats.max_hitch_us)
+        stats.max_hitch_us = hitch_us;
 }
 
 vk::PipelineLayout PipelineCache::retrieve_pipeline_layout(const uint16_t vert_texture_count, const uint16_t frag_texture_count) {
@@ -505,88 +615,42 @@ static vk::StencilOpState convert_op_state(const GxmStencilStateOp &state) {
     };
 }
 
-vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem) {
-    current_context = &context;
-    const GxmRecordState &record = context.record;
-    // get the hash of the current context
-    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
-    uint64_t key = XXH_INLINE_XXH3_64bits(&record, record_pipeline_len);
-
-    // add the hash of the blending
-    const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
-    const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
-        fragment_program_gxm.renderer_data.get());
-    key ^= fragment_program.blending_hash;
-
-    // add the hash of the attribute and stream layout
-    const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
-    key ^= vertex_program_gxm.key_hash;
-
-    // and also add the primitive type
-    key ^= static_cast<uint64_t>(type);
-    auto it = pipelines.find(key);
-    if (it != pipelines.end())
-        return it->second;
-
-    const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
-        vertex_program_gxm.renderer_data.get());
-
-    // the vertex input state must be computed before shader are retrieved in case symbols are stripped
-    const vk::PipelineVertexInputStateCreateInfo vertex_input = get_vertex_input_state(mem);
-
-    const vk::PipelineShaderStageCreateInfo vertex_shader = retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
-    const vk::PipelineShaderStageCreateInfo fragment_shader = retrieve_shader(fragment_program_gxm.program.get(mem), fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
-    const vk::PipelineShaderStageCreateInfo shader_stages[] = { vertex_shader, fragment_shader };
+// Everything needed to create a pipeline but its shaders, owning its data so that it can be created on another thread
+struct PipelineDescription {
+    std::vector<vk::VertexInputBindingDescription> binding_descr;
+    std::vector<vk::VertexInputAttributeDescription> attr_descr;
+    vk::PrimitiveTopology topology;
+    vk::PipelineRasterizationStateCreateInfo rasterizer;
+    vk::PipelineDepthStencilStateCreateInfo ds_info;
+    vk::PipelineColorBlendAttachmentState blending;
+    bool is_fragment_disabled;
+    vk::PipelineLayout layout;
+    vk::RenderPass render_pass;
+};
+
+static vk::Pipeline create_pipeline(vk::Device device, vk::PipelineCache pipeline_cache, const PipelineDescription &descr, vk::ShaderModule vertex_shader, vk::ShaderModule fragment_shader) {
+    const vk::PipelineShaderStageCreateInfo shader_stages[] = { get_shader_stage(vertex_shader, true), get_shader_stage(fragment_shader, false) };
     // disable the fragment shader if gxm asks us to
-    const bool is_fragment_disabled = record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED;
-    const uint32_t shader_stage_count = is_fragment_disabled ? 1U : 2U;
+    const uint32_t shader_stage_count = descr.is_fragment_disabled ? 1U : 2U;
+
+    vk::PipelineVertexInputStateCreateInfo vertex_input{};
+    vertex_input.setVertexBindingDescriptions(descr.binding_descr);
+    vertex_input.setVertexAttributeDescriptions(descr.attr_descr);
 
     const vk::PipelineInputAssemblyStateCreateInfo input_assembly{
-        .topology = translate_primitive(type)
+        .topology = descr.topology
     };
 
-    const bool two_sided = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED);
-
-    const vk::PipelineRasterizationStateCreateInfo rasterizer{
-        .polygonMode = translate_polygon_mode(record.front_polygon_mode),
-        .cullMode = translate_cull_mode(record.cull_mode),
-        // front face is always counter clockwise
-        .frontFace = vk::FrontFace::eCounterClockwise,
-        .depthBiasEnable = VK_TRUE
-    };
     const vk::PipelineMultisampleStateCreateInfo multisampling{
         .rasterizationSamples = vk::SampleCountFlagBits::e1
     };
-    // depth and stencil tests are always enabled on the ps vita as there is almost no cost in doing so
-    // on a tiled renderer
-    const vk::PipelineDepthStencilStateCreateInfo ds_info{
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = (record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED),
-        .depthCompareOp = translate_depth_func(record.front_depth_func),
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_TRUE,
-        .front = convert_op_state(record.front_stencil_state_op),
-        .back = convert_op_state(two_sided ? record.back_stencil_state_op : record.front_stencil_state_op)
-    };
 
     vk::PipelineColorBlendStateCreateInfo color_blending{};
-    if (is_fragment_disabled) {
-        // The write mask must be empty as the lack of a fragment shader results in undefined values
-        static const vk::PipelineColorBlendAttachmentState blending = {
-            .blendEnable = VK_FALSE,
-            .colorWriteMask = vk::ColorComponentFlags()
-        };
-        color_blending.setAttachments(blending);
-    } else {
-        const vk::PipelineColorBlendAttachmentState &blending = fragment_program.blending;
-        color_blending.setAttachments(blending);
-    }
-
-    vk::PipelineLayout pipeline_layout = retrieve_pipeline_layout(vertex_program.texture_count, fragment_program.texture_count);
+    color_blending.setAttachments(descr.blending);
 
     // all of these can be changed at any time using the vita graphics api (like opengl)
     // Because each one can take a lot of different values, it's better to set them as dynamic
-    static vk::DynamicState dynamic_states[] = {
+    static const vk::DynamicState dynamic_states[] = {
         vk::DynamicState::eViewport,
         vk::DynamicState::eScissor,
         vk::DynamicState::eLineWidth,
@@ -610,30 +674,203 @@ vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiv
         .pVertexInputState = &vertex_input,
         .pInputAssemblyState = &input_assembly,
         .pViewportState = &viewport,
-        .pRasterizationState = &rasterizer,
+        .pRasterizationState = &descr.rasterizer,
         .pMultisampleState = &multisampling,
-        .pDepthStencilState = &ds_info,
+        .pDepthStencilState = &descr.ds_info,
         .pColorBlendState = &color_blending,
         .pDynamicState = &dynamic_info,
-        .layout = pipeline_layout,
-        .renderPass = context.current_render_pass,
+        .layout = descr.layout,
+        .renderPass = descr.render_pass,
         .subpass = 0
     };
 
-    const auto result = state.device.createGraphicsPipeline(pipeline_cache, pipeline_info);
+    // the pipeline cache is internally synchronized, pipelines can be created from any thread
+    const auto result = device.createGraphicsPipeline(pipeline_cache, pipeline_info);
     if (result.result != vk::Result::eSuccess) {
         LOG_CRITICAL("Failed to create pipeline.");
         return nullptr;
     }
 
-    pipelines[key] = result.value;
-
     return result.value;
 }
 
+PipelineDescription PipelineCache::describe_pipeline(VKContext &context, SceGxmPrimitiveType type, MemState &mem) {
+    const GxmRecordState &record = context.record;
+    const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
+    const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
+        fragment_program_gxm.renderer_data.get());
+    const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
+    const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
+        vertex_program_gxm.renderer_data.get());
+
+    PipelineDescription descr;
+
+    get_vertex_input_state(mem);
+    descr.binding_descr = binding_descr;
+    descr.attr_descr = attr_descr;
+
+    descr.topology = translate_primitive(type);
+
+    const bool two_sided = (record.two_sided == SCE_GXM_TWO_SIDED_ENABLED);
+
+    descr.rasterizer = vk::PipelineRasterizationStateCreateInfo{
+        .polygonMode = translate_polygon_mode(record.front_polygon_mode),
+        .cullMode = translate_cull_mode(record.cull_mode),
+        // front face is always counter clockwise
+        .frontFace = vk::FrontFace::eCounterClockwise,
+        .depthBiasEnable = VK_TRUE
+    };
+    // depth and stencil tests are always enabled on the ps vita as there is almost no cost in doing so
+    // on a tiled renderer
+    descr.ds_info = vk::PipelineDepthStencilStateCreateInfo{
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = (record.front_depth_write_mode == SCE_GXM_DEPTH_WRITE_ENABLED),
+        .depthCompareOp = translate_depth_func(record.front_depth_func),
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_TRUE,
+        .front = convert_op_state(record.front_stencil_state_op),
+        .back = convert_op_state(two_sided ? record.back_stencil_state_op : record.front_stencil_state_op)
+    };
+
+    descr.is_fragment_disabled = record.front_side_fragment_program_mode == SCE_GXM_FRAGMENT_PROGRAM_DISABLED;
+    if (descr.is_fragment_disabled) {
+        // The write mask must be empty as the lack of a fragment shader results in undefined values
+        descr.blending = vk::PipelineColorBlendAttachmentState{
+            .blendEnable = VK_FALSE,
+            .colorWriteMask = vk::ColorComponentFlags()
+        };
+    } else {
+        descr.blending = fragment_program.blending;
+    }
+
+    descr.layout = retrieve_pipeline_layout(vertex_program.texture_count, fragment_program.texture_count);
+    descr.render_pass = context.current_render_pass;
+
+    return descr;
+}
+
+vk::Pipeline PipelineCache::retrieve_pipeline(VKContext &context, SceGxmPrimitiveType &type, MemState &mem, const Config &config) {
+    current_context = &context;
+    const GxmRecordState &record = context.record;
+    // get the hash of the current context
+    constexpr size_t record_pipeline_len = offsetof(GxmRecordState, vertex_streams);
+    uint64_t key = XXH_INLINE_XXH3_64bits(&record, record_pipeline_len);
+
+    // add the hash of the blending
+    const SceGxmFragmentProgram &fragment_program_gxm = *record.fragment_program.get(mem);
+    const VKFragmentProgram &fragment_program = *reinterpret_cast<VKFragmentProgram *>(
+        fragment_program_gxm.renderer_data.get());
+    key ^= fragment_program.blending_hash;
+
+    // add the hash of the attribute and stream layout
+    const SceGxmVertexProgram &vertex_program_gxm = *record.vertex_program.get(mem);
+    key ^= vertex_program_gxm.key_hash;
+
+    // and also add the primitive type
+    key ^= static_cast<uint64_t>(type);
+    auto it = pipelines.find(key);
+    if (it != pipelines.end())
+        return it->second;
+
+    const bool is_async = (config.shader_compilation_mode != SHADER_COMPILATION_SYNC);
+    if (!pending_shaders.empty() || !pending_pipelines.empty() || has_precompiled) {
+        collect_compiled();
+        it = pipelines.find(key);
+        if (it != pipelines.end())
+            return it->second;
+    }
+
+    const auto hitch_start = std::chrono::steady_clock::now();
+
+    const VertexProgram &vertex_program = *reinterpret_cast<VertexProgram *>(
+        vertex_program_gxm.renderer_data.get());
+
+    // shaders, vertex layout and render pass, what a pipeline standing in for this one must share with it
+    struct {
+        Sha256Hash vertex_hash;
+        Sha256Hash fragment_hash;
+        uint64_t vertex_key_hash;
+        VkRenderPass render_pass;
+        uint64_t type;
+    } fallback_data = { vertex_program.hash, fragment_program.hash, vertex_program_gxm.key_hash, static_cast<VkRenderPass>(context.current_render_pass), static_cast<uint64_t>(type) };
+    const uint64_t fallback_key = XXH_INLINE_XXH3_64bits(&fallback_data, sizeof(fallback_data));
+
+    if (!is_async) {
+        // the vertex input state must be computed before shader are retrieved in case symbols are stripped
+        const PipelineDescription descr = describe_pipeline(context, type, mem);
+
+        const vk::PipelineShaderStageCreateInfo vertex_shader = retrieve_shader(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, mem, &vertex_program_gxm.attributes);
+        const vk::PipelineShaderStageCreateInfo fragment_shader = retrieve_shader(fragment_program_gxm.program.get(mem), fragment_program.hash, false, fragment_program_gxm.is_maskupdate, mem, nullptr);
+
+        const vk::Pipeline pipeline = create_pipeline(state.device, pipeline_cache, descr, vertex_shader.module, fragment_shader.module);
+        if (pipeline) {
+            pipelines[key] = pipeline;
+            fallback_pipelines[fallback_key] = pipeline;
+        }
+
+        record_hitch(hitch_start);
+        return pipeline;
+    }
+
+    auto pending = pending_pipelines.find(key);
+    if (pending == pending_pipelines.end()) {
+        auto descr = std::make_shared<PipelineDescription>(describe_pipeline(context, type, mem));
+        auto vertex_shader = retrieve_shader_async(vertex_program_gxm.program.get(mem), vertex_program.hash, true, fragment_program_gxm.is_maskupdate, &vertex_program_gxm.attributes);
+        auto fragment_shader = retrieve_shader_async(fragment_program_gxm.program.get(mem), fragment_program.hash, false, fragment_program_gxm.is_maskupdate, nullptr);
+
+        // the shaders are submitted before the pipeline, so a worker waiting for them never waits for a task still queued
+        ShaderCompileStats &stats = state.shader_compile_stats;
+        ++stats.queue_depth;
+        std::shared_future<vk::Pipeline> pipeline = ThreadPool::shared().submit([device = state.device, cache = pipeline_cache, descr, vertex_shader, fragment_shader, &stats]() {
+            const vk::Pipeline result = create_pipeline(device, cache, *descr, vertex_shader.get(), fragment_shader.get());
+            --stats.queue_depth;
+            return result;
+        });
+
+        pending = pending_pipelines.emplace(key, PendingPipeline{ pipeline, fallback_key }).first;
+    }
+
+    // draw with what we have and look for the right pipeline again on the next draw
+    const auto fallback = fallback_pipelines.find(fallback_key);
+    if (fallback != fallback_pipelines.end()) {
+        context.refresh_pipeline = true;
+        ++state.shader_compile_stats.fallback_draws;
+        return fallback->second;
+    }
+
+    if (config.shader_compilation_mode == SHADER_COMPILATION_ASYNC_SKIP_DRAW) {
+        context.refresh_pipeline = true;
+        ++state.shader_compile_stats.skipped_draws;
+        return nullptr;
+    }
+
+    pending->second.pipeline.wait();
+    collect_compiled();
+    record_hitch(hitch_start);
+
+    it = pipelines.find(key);
+    return (it != pipelines.end()) ? it->second : nullptr;
+}
+
+static std::vector<uint32_t> load_cached_shader(const VKState &state, const Sha256Hash &hash) {
+    const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(hash));
+
+    return renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.base_path, state.title_id, state.self_name);
+}
+
+static vk::ShaderModule create_shader_module(vk::Device device, const std::vector<uint32_t> &source) {
+    vk::ShaderModuleCreateInfo shader_info{
+        .codeSize = sizeof(uint32_t) * source.size(),
+        .pCode = source.data()
+    };
+
+    return device.createShaderModule(shader_info);
+}
+
 bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
     const auto shader_path{ fs::path(state.base_path) / "cache/shaders" / state.title_id / state.self_name };
 
+    collect_precompiled();
     auto it = shaders.find(hash);
     if (it != shaders.end())
         return true;
@@ -641,23 +878,80 @@ bool PipelineCache::precompile_shader(const Sha256Hash &hash) {
     if (!fs::exists(shader_path) || fs::is_empty(shader_path))
         return false;
 
-    Sha256Hash shader_hash;
-    memcpy(shader_hash.data(), hash.data(), sizeof(Sha256Hash));
-    const std::string hash_ver = fmt::format("vk{}-{}", shader::CURRENT_VERSION, hex_string(shader_hash));
-
-    const std::vector<uint32_t> source = renderer::pre_load_shader_spirv(hash_ver.c_str(), "spv", state.base_path, state.title_id, state.self_name);
-
+    const std::vector<uint32_t> source = load_cached_shader(state, hash);
     if (source.empty())
         return false;
 
-    vk::ShaderModuleCreateInfo shader_info{
-        .codeSize = sizeof(uint32_t) * source.size(),
-        .pCode = source.data()
-    };
+    shaders[hash] = create_shader_module(state.device, source);
 
-    vk::ShaderModule shader = state.device.createShaderModule(shader_info);
-    shaders[hash] = shader;
+    return true;
+}
 
+// Time the boot screen waits for the precompilation, the shaders left are loaded in the background while the app starts
+static constexpr auto PRECOMPILE_FOREGROUND_TIME = std::chrono::seconds(5);
+
+bool PipelineCache::precompile_shaders() {
+    const size_t total = state.shaders_cache_hashs.size();
+    if (!precompile_started) {
+        precompile_started = true;
+        precompile_start = std::chrono::steady_clock::now();
+
+        // the hashes are copied, the render thread keeps adding new ones
+        // the shaders the app asks for meanwhile are compiled first, these ones only when the workers are idle
+        for (const ShadersHash &hash : state.shaders_cache_hashs) {
+            precompile_jobs.push_back(ThreadPool::shared().submit_background([this, hash, total] {
+                if (cancel_precompile)
+                    return;
+
+                const Sha256Hash empty_hash{};
+                for (const Sha256Hash &shader_hash : { hash.vert, hash.frag }) {
+                    if (shader_hash == empty_hash)
+                        continue;
+
+                    const std::vector<uint32_t> source = load_cached_shader(state, shader_hash);
+                    if (source.empty())
+                        continue;
+
+                    const vk::ShaderModule shader = create_shader_module(state.device, source);
+                    const std::lock_guard<std::mutex> lock(precompiled_mutex);
+                    precompiled_shaders.emplace_back(shader_hash, shader);
+                    has_precompiled = true;
+                }
+
+                const uint32_t count = ++state.programs_count_pre_compiled;
+                LOG_INFO("Program Compiled {}/{}", count, total);
+            }));
+        }
+    }
+
+    collect_precompiled();
+
+    const bool done = state.programs_count_pre_compiled >= total;
+    if (!done && (std::chrono::steady_clock::now() - precompile_start < PRECOMPILE_FOREGROUND_TIME))
+        return false;
+
+    if (!done)
+        LOG_INFO("Starting the app while {} programs are still being compiled", total - state.programs_count_pre_compiled);
+
+    precompile_started = false;
     return true;
 }
-} // namespace renderer::vulkan
\ No newline at end of file
+
+void PipelineCache::collect_precompiled() {
+    if (!has_precompiled)
+        return;
+
+    std::vector<std::pair<Sha256Hash, vk::ShaderModule>> precompiled;
+    {
+        const std::lock_guard<std::mutex> lock(precompiled_mutex);
+        precompiled.swap(precompiled_shaders);
+        has_precompiled = false;
+    }
+
+    for (const auto &[hash, shader] : precompiled) {
+        // the render thread may have needed it first
+        if (!shaders.emplace(hash, shader).second)
+            state.device.destroyShaderModule(shader);
+    }
+}
+} // namespace renderer::vulkan
@@ -0,0 +1,283 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/vulkan/functions.h>
+
+#include <renderer/vulkan/gxm_to_vulkan.h>
+#include <renderer/vulkan/types.h>
+
+#include <gxm/functions.h>
+#include <mem/functions.h>
+#include <mem/ptr.h>
+#include <mem/state.h>
+
+#include <util/align.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace renderer::vulkan {
+
+// the buffer is read by the CPU, it should be in cached memory
+static constexpr vma::AllocationCreateInfo readback_alloc = {
+    .flags = vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped,
+    .usage = vma::MemoryUsage::eAuto,
+};
+
+static void wait_readback(VKState &state, SurfaceReadback &readback) {
+    if (!readback.submitted)
+        return;
+
+    constexpr uint64_t max_time = std::numeric_limits<uint64_t>::max();
+    if (state.device.waitForFences(readback.fence, VK_TRUE, max_time) != vk::Result::eSuccess)
+        LOG_ERROR("Could not wait for the surface readback fence.");
+}
+
+// Unprotects the surface and writes the copy to it, the memory protect mutex must be held
+static void write_readback(VKState &state, MemState &mem, SurfaceReadback &readback) {
+    wait_readback(state, readback);
+    state.allocator.invalidateAllocation(readback.buffer.allocation, 0, VK_WHOLE_SIZE);
+
+    const Address protect_begin = align_down(readback.address, mem.page_size);
+    const Address protect_end = align(readback.address + readback.size, mem.page_size);
+    unprotect_inner(mem, protect_begin, protect_end - protect_begin);
+
+    uint8_t *dest = Ptr<uint8_t>(readback.address).get(mem);
+    const uint8_t *src = static_cast<const uint8_t *>(readback.buffer.mapped_data);
+    const uint32_t row_size = readback.width * readback.bytes_per_pixel;
+    if (readback.res_multiplier == 1) {
+        for (uint32_t y = 0; y < readback.height; y++)
+            memcpy(dest + y * readback.stride_in_bytes, src + y * readback.buffer_row_size, row_size);
+    } else {
+        const uint32_t src_pixel_step = readback.res_multiplier * readback.bytes_per_pixel;
+        for (uint32_t y = 0; y < readback.height; y++) {
+            uint8_t *dest_row = dest + y * readback.stride_in_bytes;
+            const uint8_t *src_row = src + y * readback.res_multiplier * readback.buffer_row_size;
+            for (uint32_t x = 0; x < readback.width; x++)
+                memcpy(dest_row + x * readback.bytes_per_pixel, src_row + x * src_pixel_step, readback.bytes_per_pixel);
+        }
+    }
+
+    readback.pending = false;
+}
+
+// Same as write_readback, for a readback whose protect block is still there: its pages are
+// protected again so that the other protect blocks on them keep working
+static void flush_readback(VKState &state, MemState &mem, SurfaceReadback &readback) {
+    write_readback(state, mem, readback);
+    const Address protect_begin = align_down(readback.address, mem.page_size);
+    const Address protect_end = align(readback.address + readback.size, mem.page_size);
+    protect_inner(mem, protect_begin, protect_end - protect_begin, MEM_PERM_NONE);
+}
+
+void readback_surface(VKContext &context, MemState &mem, const SceGxmColorSurface &surface, const bool immediate) {
+    VKState &state = context.state;
+
+    // only the surface the last scene rendered to is known for sure to be in the surface cache
+    vkutil::Image *image = context.current_color_attachment;
+    if (!image || surface.data.address() == 0 || surface.data != context.record.color_surface.data) {
+        static bool has_happened = false;
+        LOG_WARN_IF(!has_happened, "Reading back a color surface which was not the last one rendered to is not supported");
+        has_happened = true;
+        return;
+    }
+
+    const SceGxmColorBaseFormat base_format = gxm::get_base_format(surface.colorFormat);
+    const vk::Format vk_format = color::translate_format(base_format);
+    // the image texels must have the same layout as the guest pixels
+    const bool same_layout = (image->format == vk_format || (vk_format == vk::Format::eR8G8B8A8Unorm && image->format == vk::Format::eR8G8B8A8Srgb))
+        && base_format != SCE_GXM_COLOR_BASE_FORMAT_U8U8U8 && base_format != SCE_GXM_COLOR_BASE_FORMAT_U2F10F10F10;
+    if (!same_layout) {
+        static bool has_happened = false;
+        LOG_WARN_IF(!has_happened, "Reading back color surfaces with base format {} is not supported", log_hex(static_cast<uint32_t>(base_format)));
+        has_happened = true;
+        return;
+    }
+
+    const uint32_t res_multiplier = state.res_multiplier;
+    const uint32_t bytes_per_pixel = gxm::bits_per_pixel(base_format) / 8;
+    const uint32_t copy_width = std::min<uint32_t>(image->width, surface.width * res_multiplier);
+    const uint32_t copy_height = std::min<uint32_t>(image->height, surface.height * res_multiplier);
+    const uint32_t stride_in_bytes = gxm::get_stride_in_bytes(surface.colorFormat, surface.strideInPixels);
+
+    std::shared_ptr<SurfaceReadback> &readback_ptr = context.readbacks[context.readback_idx];
+    context.readback_idx = (context.readback_idx + 1) % NB_SURFACE_READBACKS;
+    if (!readback_ptr)
+        readback_ptr = std::make_shared<SurfaceReadback>();
+    SurfaceReadback &readback = *readback_ptr;
+
+    {
+        const std::lock_guard<std::mutex> lock(mem.protect_mutex);
+        // the guest never looked at the older copies of this surface, they are replaced by this one
+        for (const auto &other : context.readbacks) {
+            if (other && other->pending && other->address == surface.data.address())
+                other->pending = false;
+        }
+
+        // all the readbacks are in use, write the oldest one now
+        if (readback.pending)
+            flush_readback(state, mem, readback);
+
+        readback.generation++;
+    }
+
+    // no callback uses this readback anymore, the fence and the buffer are ours
+    wait_readback(state, readback);
+    if (readback.submitted) {
+        state.device.resetFences(readback.fence);
+        readback.submitted = false;
+    }
+
+    if (!context.readback_pool) {
+        vk::CommandPoolCreateInfo pool_info{
+            .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            .queueFamilyIndex = state.general_family_index
+        };
+        context.readback_pool = state.device.createCommandPool(pool_info);
+    }
+
+    if (!readback.cmd_buffer) {
+        vk::CommandBufferAllocateInfo cmd_buffer_info{
+            .commandPool = context.readback_pool,
+            .commandBufferCount = 1
+        };
+        readback.cmd_buffer = state.device.allocateCommandBuffers(cmd_buffer_info)[0];
+        readback.fence = state.device.createFence(vk::FenceCreateInfo{});
+    }
+
+    const vk::DeviceSize buffer_size = static_cast<vk::DeviceSize>(copy_width) * copy_height * bytes_per_pixel;
+    if (!readback.buffer.buffer || readback.buffer.size < buffer_size) {
+        readback.buffer.destroy();
+        readback.buffer = vkutil::Buffer(state.allocator, buffer_size);
+        readback.buffer.init_buffer(vk::BufferUsageFlagBits::eTransferDst, readback_alloc);
+    }
+
+    vk::CommandBuffer cmd_buffer = readback.cmd_buffer;
+    cmd_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+    // the scene has been submitted before, wait for it to be done rendering
+    vk::ImageMemoryBarrier image_barrier{
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+        .oldLayout = vk::ImageLayout::eGeneral,
+        .newLayout = vk::ImageLayout::eGeneral,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->image,
+        .subresourceRange = vkutil::color_subresource_range
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(), {}, {}, image_barrier);
+
+    vk::BufferImageCopy copy_region{
+        .bufferOffset = 0,
+        .bufferRowLength = copy_width,
+        .bufferImageHeight = copy_height,
+        .imageSubresource = vkutil::color_subresource_layer,
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { copy_width, copy_height, 1 }
+    };
+    cmd_buffer.copyImageToBuffer(image->image, vk::ImageLayout::eGeneral, readback.buffer.buffer, copy_region);
+
+    vk::BufferMemoryBarrier buffer_barrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readback.buffer.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE
+    };
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags(), {}, buffer_barrier, {});
+
+    cmd_buffer.end();
+
+    vk::SubmitInfo submit_info{};
+    submit_info.setCommandBuffers(cmd_buffer);
+    state.general_queue.submit(submit_info, readback.fence);
+    readback.submitted = true;
+
+    uint64_t generation;
+    {
+        const std::lock_guard<std::mutex> lock(mem.protect_mutex);
+        readback.address = surface.data.address();
+        readback.width = copy_width / res_multiplier;
+        readback.height = copy_height / res_multiplier;
+        readback.bytes_per_pixel = bytes_per_pixel;
+        readback.stride_in_bytes = stride_in_bytes;
+        readback.size = stride_in_bytes * surface.height;
+        readback.buffer_row_size = copy_width * bytes_per_pixel;
+        readback.res_multiplier = res_multiplier;
+        readback.pending = true;
+        generation = readback.generation;
+
+        if (immediate) {
+            write_readback(state, mem, readback);
+            return;
+        }
+    }
+
+    // write the copy when the guest first accesses the surface, the memory protect mutex is held during the callback
+    // the state and the memory outlive the callback, the readback is kept alive by it
+    add_protect(mem, readback.address, readback.size, MEM_PERM_NONE, [&state, &mem, readback_ptr, generation](Address, bool) {
+        if (readback_ptr->generation == generation && readback_ptr->pending)
+            write_readback(state, mem, *readback_ptr);
+
+        return true;
+    });
+}
+
+void destroy_readbacks(VKContext &context, MemState &mem) {
+    VKState &state = context.state;
+
+    {
+        // the guest gets what has been rendered, the callbacks left do nothing from now on
+        const std::lock_guard<std::mutex> lock(mem.protect_mutex);
+        for (const auto &readback : context.readbacks) {
+            if (!readback)
+                continue;
+
+            if (readback->pending)
+                flush_readback(state, mem, *readback);
+            readback->generation++;
+        }
+    }
+
+    for (auto &readback : context.readbacks) {
+        if (!readback)
+            continue;
+
+        wait_readback(state, *readback);
+        readback->buffer.destroy();
+        readback->buffer = vkutil::Buffer();
+        if (readback->fence)
+            state.device.destroyFence(readback->fence);
+        readback.reset();
+    }
+
+    // frees the command buffers as well
+    if (context.readback_pool) {
+        state.device.destroyCommandPool(context.readback_pool);
+        context.readback_pool = nullptr;
+    }
+}
+
+} // namespace renderer::vulkan
@@ -398,12 +398,14 @@ bool VKState::create(SDL_Window *window, std::unique_ptr<renderer::State> &state
 
     pipeline_cache.init();
     texture_cache.backend = &current_backend;
-    texture::init(texture_cache, false);
+    texture_cache.stats = &texture_cache_stats;
+    texture::init(texture_cache, false, texture_cache_size);
 
     return true;
 }
 
 void VKState::cleanup() {
+    pipeline_cache.cleanup();
     device.waitIdle();
 
     screen_renderer.cleanup();
@@ -508,17 +510,8 @@ std::vector<std::string> VKState::get_gpu_list() {
     return gpu_list;
 }
 
-void VKState::precompile_shader(const ShadersHash &hash) {
-    Sha256Hash empty_hash{};
-    if (hash.vert != empty_hash) {
-        pipeline_cache.precompile_shader(hash.vert);
-    }
-    if (hash.frag != empty_hash) {
-        pipeline_cache.precompile_shader(hash.frag);
-    }
-
-    programs_count_pre_compiled++;
-    LOG_INFO("Program Compiled {}/{}", programs_count_pre_compiled, shaders_cache_hashs.size());
+bool VKState::precompile_shaders() {
+    return pipeline_cache.precompile_shaders();
 }
 
 void VKState::preclose_action() {
@@ -26,6 +26,8 @@
 #include <util/align.h>
 #include <util/log.h>
 
+#include <xxh3.h>
+
 namespace renderer::vulkan {
 
 void set_uniform_buffer(VKContext &context, const ShaderProgram *program, const bool vertex_shader, const int block_num, const int size, const uint8_t *data) {
@@ -37,26 +39,103 @@ void set_uniform_buffer(VKContext &context, const ShaderProgram *program, const
     const uint32_t data_size_upload = std::min<uint32_t>(size, program->uniform_buffer_sizes.at(block_num) * 4);
     const uint32_t offset_start_upload = offset * 4;
 
-    if (vertex_shader) {
-        if (!context.vertex_uniform_storage_allocated) {
-            // Allocate a region for it. Don't worry though, when the shader program is changed
-            context.vertex_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-            context.vertex_uniform_storage_allocated = true;
-        }
+    // The storage is uploaded when drawing, once all the uniform buffers are set
+    UniformStorage &storage = vertex_shader ? context.vertex_uniform_storage : context.fragment_uniform_storage;
+    storage.size = program->max_total_uniform_buffer_storage * 4;
+    if (storage.data.size() < std::max(storage.size, offset_start_upload + data_size_upload))
+        storage.data.resize(std::max(storage.size, offset_start_upload + data_size_upload));
 
-        context.vertex_uniform_stream_ring_buffer.copy(context.prerender_cmd, data_size_upload, data, offset_start_upload);
-    } else {
-        if (!context.fragment_uniform_storage_allocated) {
-            // Allocate a region for it. Don't worry though, when the shader program is changed
-            context.fragment_uniform_stream_ring_buffer.allocate(program->max_total_uniform_buffer_storage * 4);
-            context.fragment_uniform_storage_allocated = true;
-        }
+    memcpy(storage.data.data() + offset_start_upload, data, data_size_upload);
+    storage.dirty = true;
+}
+
+// Smaller streams are always copied, hashing them would cost about as much
+constexpr uint32_t STREAM_CACHE_MIN_SIZE = 1024;
 
-        context.fragment_uniform_stream_ring_buffer.copy(context.prerender_cmd, data_size_upload, data, offset_start_upload);
+static uint64_t aligned_stream_size(const uint64_t size) {
+    return align(size, 256);
+}
+
+// Copies the data to the ring buffer, unless a copy of it from a recent draw is still there and will
+// not be overwritten by the reserve bytes allocated next or before the GPU reads it. Returns the offset of the data in the buffer.
+static uint32_t upload_stream(vkutil::HostRingBuffer &ring_buffer, StreamCache &cache, vk::CommandBuffer cmd_buffer,
+    const uint8_t *data, const uint32_t size, const uint64_t reserve, const bool use_cache) {
+    if (!use_cache || size < STREAM_CACHE_MIN_SIZE) {
+        ring_buffer.allocate(cmd_buffer, size, data);
+        cache.bytes_uploaded += size;
+        return ring_buffer.data_offset;
     }
+
+    const uint64_t hash = XXH_INLINE_XXH3_64bits(data, size);
+    StreamCacheEntry &entry = cache.entries[reinterpret_cast<uintptr_t>(data)];
+    if (entry.size == size && entry.hash == hash && ring_buffer.is_intact(entry.position, reserve)) {
+        cache.bytes_reused += size;
+        return entry.offset;
+    }
+
+    ring_buffer.allocate(cmd_buffer, size, data);
+    cache.bytes_uploaded += size;
+    entry = StreamCacheEntry{
+        .size = size,
+        .hash = hash,
+        .position = ring_buffer.data_position,
+        .offset = ring_buffer.data_offset
+    };
+
+    return entry.offset;
+}
+
+// Uniforms are often the same for many draws, the storage is looked up by its content and a recent copy
+// still in the ring buffer is used instead, with the same window as the vertex and index data.
+void upload_uniform_storage(vkutil::RingBuffer &ring_buffer, UniformStorage &storage, vk::CommandBuffer cmd_buffer) {
+    if (!storage.dirty || storage.size == 0)
+        return;
+
+    storage.dirty = false;
+
+    const uint64_t hash = XXH_INLINE_XXH3_64bits(storage.data.data(), storage.size);
+    StreamCacheEntry &entry = storage.cache.entries[hash];
+    if (entry.size == storage.size && entry.hash == hash && ring_buffer.is_intact(entry.position, 0)) {
+        storage.cache.bytes_reused += storage.size;
+        storage.offset = entry.offset;
+        return;
+    }
+
+    ring_buffer.allocate(cmd_buffer, storage.size, storage.data.data());
+    storage.cache.bytes_uploaded += storage.size;
+    storage.offset = ring_buffer.data_offset;
+    entry = StreamCacheEntry{
+        .size = storage.size,
+        .hash = hash,
+        .position = ring_buffer.data_position,
+        .offset = ring_buffer.data_offset
+    };
+}
+
+static void end_stream_cache_frame(StreamCache &cache, const vkutil::HostRingBuffer &ring_buffer) {
+    cache.last_frame_bytes_uploaded = cache.bytes_uploaded;
+    cache.last_frame_bytes_reused = cache.bytes_reused;
+    cache.bytes_uploaded = 0;
+    cache.bytes_reused = 0;
+
+    // forget the copies the ring buffer has overwritten since
+    std::erase_if(cache.entries, [&](const auto &item) {
+        return !ring_buffer.is_intact(item.second.position, 0);
+    });
 }
 
 void new_frame(VKContext &context) {
+    end_stream_cache_frame(context.vertex_stream_cache, context.vertex_stream_ring_buffer);
+    end_stream_cache_frame(context.index_stream_cache, context.index_stream_ring_buffer);
+    end_stream_cache_frame(context.vertex_uniform_storage.cache, context.vertex_uniform_stream_ring_buffer);
+    end_stream_cache_frame(context.fragment_uniform_storage.cache, context.fragment_uniform_stream_ring_buffer);
+    LOG_TRACE("Vertex data: {} bytes uploaded, {} reused. Index data: {} bytes uploaded, {} reused",
+        context.vertex_stream_cache.last_frame_bytes_uploaded, context.vertex_stream_cache.last_frame_bytes_reused,
+        context.index_stream_cache.last_frame_bytes_uploaded, context.index_stream_cache.last_frame_bytes_reused);
+    LOG_TRACE("Vertex uniforms: {} bytes uploaded, {} reused. Fragment uniforms: {} bytes uploaded, {} reused",
+        context.vertex_uniform_storage.cache.last_frame_bytes_uploaded, context.vertex_uniform_storage.cache.last_frame_bytes_reused,
+        context.fragment_uniform_storage.cache.last_frame_bytes_uploaded, context.fragment_uniform_storage.cache.last_frame_bytes_reused);
+
     context.frame_timestamp++;
     context.current_frame_idx = context.frame_timestamp % MAX_FRAMES_RENDERING;
 
@@ -209,9 +288,9 @@ static void draw_bind_descriptors(VKContext &context, MemState &mem) {
 
     uint32_t dynamic_offsets[] = {
         // vertex uniform
-        context.vertex_uniform_stream_ring_buffer.data_offset,
+        context.vertex_uniform_storage.offset,
         // fragment uniform
-        context.fragment_uniform_stream_ring_buffer.data_offset,
+        context.fragment_uniform_storage.offset,
         // GXMRenderVertUniformBlock
         context.vertex_info_uniform_buffer.data_offset,
         // GXMRenderFragUniformBlock
@@ -253,6 +332,21 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
     if (max_stream_idx == 0)
         return;
 
+    // a reused copy must survive the uploads of the other streams of this draw
+    uint64_t reserve = 0;
+    for (std::size_t i = 0; i < max_stream_idx; i++) {
+        if (!state.vertex_streams[i].data)
+            continue;
+
+        size_t size = state.vertex_streams[i].size;
+#ifdef __APPLE__
+        const uint32_t stride = vertex_program.streams[i].stride;
+        if (stride % 4 != 0)
+            size = ((size + stride - 1) / stride) * align(stride, 4);
+#endif
+        reserve += aligned_stream_size(size);
+    }
+
     for (std::size_t i = 0; i < max_stream_idx; i++) {
         if (state.vertex_streams[i].data) {
 #ifdef __APPLE__
@@ -261,10 +355,12 @@ static void bind_vertex_streams(VKContext &context, MemState &mem) {
             if (restride) {
                 restride_stream(state.vertex_streams[i], vertex_program.streams[i].stride);
             }
+#else
+            constexpr bool restride = false;
 #endif
-            context.vertex_stream_ring_buffer.allocate(context.prerender_cmd, state.vertex_streams[i].size, state.vertex_streams[i].data);
-
-            context.vertex_buffer_offsets[i] = context.vertex_stream_ring_buffer.data_offset;
+            // a restrided stream is a temporary copy, it can't be looked up later
+            context.vertex_buffer_offsets[i] = upload_stream(context.vertex_stream_ring_buffer, context.vertex_stream_cache, context.prerender_cmd,
+                state.vertex_streams[i].data, state.vertex_streams[i].size, reserve, !restride);
 
 #ifdef __APPLE__
             if (restride) {
@@ -330,7 +426,14 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     if (context.refresh_pipeline || !context.in_renderpass || type != context.last_primitive) {
         context.refresh_pipeline = false;
         context.last_primitive = type;
-        vk::Pipeline new_pipeline = context.state.pipeline_cache.retrieve_pipeline(context, type, mem);
+        vk::Pipeline new_pipeline = context.state.pipeline_cache.retrieve_pipeline(context, type, mem, config);
+        if (!new_pipeline) {
+            // still being compiled, skip this draw
+            if (replaced_indices)
+                delete[] reinterpret_cast<uint8_t *>(indices);
+
+            return;
+        }
 
         if (!context.in_renderpass || new_pipeline != context.current_pipeline) {
             context.current_pipeline = new_pipeline;
@@ -392,6 +495,9 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
         context.previous_frag_info = frag_ublock;
     }
 
+    upload_uniform_storage(context.vertex_uniform_stream_ring_buffer, context.vertex_uniform_storage, context.prerender_cmd);
+    upload_uniform_storage(context.fragment_uniform_stream_ring_buffer, context.fragment_uniform_storage, context.prerender_cmd);
+
     // create, update and bind descriptors (uniforms and textures)
     draw_bind_descriptors(context, mem);
     // bind the vertex streams
@@ -402,17 +508,16 @@ void draw(VKContext &context, SceGxmPrimitiveType type, SceGxmIndexFormat format
     const size_t index_size = (format == SCE_GXM_INDEX_FORMAT_U16) ? 2 : 4;
     const size_t index_buffer_size = index_size * count;
 
-    context.index_stream_ring_buffer.allocate(context.prerender_cmd, index_buffer_size, indices);
+    // triangle fan indices replaced on Metal are a temporary copy
+    const uint32_t index_offset = upload_stream(context.index_stream_ring_buffer, context.index_stream_cache, context.prerender_cmd,
+        static_cast<const uint8_t *>(indices), index_buffer_size, aligned_stream_size(index_buffer_size), !replaced_indices);
 
-    context.render_cmd.bindIndexBuffer(context.index_stream_ring_buffer.handle(), context.index_stream_ring_buffer.data_offset, index_type);
+    context.render_cmd.bindIndexBuffer(context.index_stream_ring_buffer.handle(), index_offset, index_type);
 
     context.render_cmd.drawIndexed(count, instance_count, 0, 0, 0);
 
     if (replaced_indices)
         delete[] reinterpret_cast<uint8_t *>(indices);
-
-    context.vertex_uniform_storage_allocated = false;
-    context.fragment_uniform_storage_allocated = false;
 }
 
 } // namespace renderer::vulkan
@@ -214,7 +214,7 @@ void VKTextureCacheState::prepare_staging_buffer(bool is_configure) {
 
 namespace texture {
 
-bool init(VKTextureCacheState &cache, const bool hashless_texture_cache) {
+bool init(VKTextureCacheState &cache, const bool hashless_texture_cache, const size_t capacity) {
     cache.select_callback = [&cache](const std::size_t index, const void *texture) {
         cache.current_texture = &cache.textures[index];
         cache.is_texture_transfer_ready = false;
@@ -233,6 +233,8 @@ bool init(VKTextureCacheState &cache, const bool hashless_texture_cache) {
     };
 
     cache.use_protect = hashless_texture_cache;
+    renderer::texture::init_cache(cache, capacity);
+    cache.textures.resize(cache.infoes.size());
 
     // don't forget to specify the allocator for all the staging buffers
     for (int i = 0; i < NB_TEXTURE_STAGING_BUFFERS; i++)
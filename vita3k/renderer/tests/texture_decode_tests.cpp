@@ -0,0 +1,409 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/functions.h>
+#include <renderer/pvrt-dec.h>
+#include <util/thread_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace pvr_reference {
+// The PVRTC decoder before the parallel parts, see pvrt_dec_reference.cpp
+uint32_t PVRTDecompressPVRTC(const void *compressedData, uint32_t do2bitMode, uint32_t xDim, uint32_t yDim, uint32_t doPvrtType, uint8_t *outResultImage);
+} // namespace pvr_reference
+
+// The per pixel BC decoders decompress_bc_swizz_image used before the SIMD index expansion,
+// with the BC2 explicit alpha fix only
+static void reference_block_bc1(const uint8_t *block_storage, uint32_t *image) {
+    uint16_t n0 = static_cast<uint16_t>((block_storage[1] << 8) | block_storage[0]);
+    uint16_t n1 = static_cast<uint16_t>((block_storage[3] << 8) | block_storage[2]);
+
+    block_storage += 4;
+
+    uint8_t r0 = (n0 & 0xF800) >> 8;
+    uint8_t g0 = (n0 & 0x07E0) >> 3;
+    uint8_t b0 = (n0 & 0x001F) << 3;
+
+    uint8_t r1 = (n1 & 0xF800) >> 8;
+    uint8_t g1 = (n1 & 0x07E0) >> 3;
+    uint8_t b1 = (n1 & 0x001F) << 3;
+
+    r0 |= r0 >> 5;
+    r1 |= r1 >> 5;
+    g0 |= g0 >> 6;
+    g1 |= g1 >> 6;
+    b0 |= b0 >> 5;
+    b1 |= b1 >> 5;
+
+    uint32_t c0 = 0xFF000000 | (b0 << 16) | (g0 << 8) | r0;
+    uint32_t c1 = 0xFF000000 | (b1 << 16) | (g1 << 8) | r1;
+
+    if (n0 > n1) {
+        uint8_t r2 = static_cast<uint8_t>((2 * r0 + r1 + 1) / 3);
+        uint8_t r3 = static_cast<uint8_t>((2 * r1 + r0 + 1) / 3);
+        uint8_t g2 = static_cast<uint8_t>((2 * g0 + g1 + 1) / 3);
+        uint8_t g3 = static_cast<uint8_t>((2 * g1 + g0 + 1) / 3);
+        uint8_t b2 = static_cast<uint8_t>((2 * b0 + b1 + 1) / 3);
+        uint8_t b3 = static_cast<uint8_t>((2 * b1 + b0 + 1) / 3);
+
+        uint32_t c2 = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
+        uint32_t c3 = 0xFF000000 | (b3 << 16) | (g3 << 8) | r3;
+
+        for (int i = 0; i < 16; ++i) {
+            int index = (block_storage[i / 4] >> (i % 4 * 2)) & 0x03;
+            switch (index) {
+            case 0:
+                image[i] = c0;
+                break;
+            case 1:
+                image[i] = c1;
+                break;
+            case 2:
+                image[i] = c2;
+                break;
+            case 3:
+                image[i] = c3;
+                break;
+            }
+        }
+    } else {
+        // Transparent decode
+        uint8_t r2 = static_cast<uint8_t>((r0 + r1) / 2);
+        uint8_t g2 = static_cast<uint8_t>((g0 + g1) / 2);
+        uint8_t b2 = static_cast<uint8_t>((b0 + b1) / 2);
+
+        uint32_t c2 = 0xFF000000 | (b2 << 16) | (g2 << 8) | r2;
+
+        for (int i = 0; i < 16; ++i) {
+            int index = (block_storage[i / 4] >> (i % 4 * 2)) & 0x03;
+            switch (index) {
+            case 0:
+                image[i] = c0;
+                break;
+            case 1:
+                image[i] = c1;
+                break;
+            case 2:
+                image[i] = c2;
+                break;
+            case 3:
+                image[i] = 0x00000000;
+                break;
+            }
+        }
+    }
+}
+
+static void reference_block_alpha(const uint8_t *block_storage, uint8_t *image, const uint32_t offset, const uint32_t stride) {
+    uint8_t alpha[8];
+
+    alpha[0] = block_storage[0];
+    alpha[1] = block_storage[1];
+
+    if (alpha[0] > alpha[1]) {
+        // 8-alpha block:  derive the other six alphas.
+        // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+        alpha[2] = static_cast<uint8_t>((6 * alpha[0] + 1 * alpha[1] + 3) / 7); // bit code 010
+        alpha[3] = static_cast<uint8_t>((5 * alpha[0] + 2 * alpha[1] + 3) / 7); // bit code 011
+        alpha[4] = static_cast<uint8_t>((4 * alpha[0] + 3 * alpha[1] + 3) / 7); // bit code 100
+        alpha[5] = static_cast<uint8_t>((3 * alpha[0] + 4 * alpha[1] + 3) / 7); // bit code 101
+        alpha[6] = static_cast<uint8_t>((2 * alpha[0] + 5 * alpha[1] + 3) / 7); // bit code 110
+        alpha[7] = static_cast<uint8_t>((1 * alpha[0] + 6 * alpha[1] + 3) / 7); // bit code 111
+    } else {
+        // 6-alpha block.
+        // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+        alpha[2] = static_cast<uint8_t>((4 * alpha[0] + 1 * alpha[1] + 2) / 5); // Bit code 010
+        alpha[3] = static_cast<uint8_t>((3 * alpha[0] + 2 * alpha[1] + 2) / 5); // Bit code 011
+        alpha[4] = static_cast<uint8_t>((2 * alpha[0] + 3 * alpha[1] + 2) / 5); // Bit code 100
+        alpha[5] = static_cast<uint8_t>((1 * alpha[0] + 4 * alpha[1] + 2) / 5); // Bit code 101
+        alpha[6] = 0; // Bit code 110
+        alpha[7] = 255; // Bit code 111
+    }
+
+    image += offset;
+
+    image[stride * 0] = alpha[block_storage[2] & 0x07];
+    image[stride * 1] = alpha[(block_storage[2] >> 3) & 0x07];
+    image[stride * 2] = alpha[((block_storage[3] << 2) & 0x04) | ((block_storage[2] >> 6) & 0x03)];
+    image[stride * 3] = alpha[(block_storage[3] >> 1) & 0x07];
+    image[stride * 4] = alpha[(block_storage[3] >> 4) & 0x07];
+    image[stride * 5] = alpha[((block_storage[4] << 1) & 0x06) | ((block_storage[3] >> 7) & 0x01)];
+    image[stride * 6] = alpha[(block_storage[4] >> 2) & 0x07];
+    image[stride * 7] = alpha[(block_storage[4] >> 5) & 0x07];
+    image[stride * 8] = alpha[block_storage[5] & 0x07];
+    image[stride * 9] = alpha[(block_storage[5] >> 3) & 0x07];
+    image[stride * 10] = alpha[((block_storage[6] << 2) & 0x04) | ((block_storage[5] >> 6) & 0x03)];
+    image[stride * 11] = alpha[(block_storage[6] >> 1) & 0x07];
+    image[stride * 12] = alpha[(block_storage[6] >> 4) & 0x07];
+    image[stride * 13] = alpha[((block_storage[7] << 1) & 0x06) | ((block_storage[6] >> 7) & 0x01)];
+    image[stride * 14] = alpha[(block_storage[7] >> 2) & 0x07];
+    image[stride * 15] = alpha[(block_storage[7] >> 5) & 0x07];
+}
+
+static void reference_block_alpha_signed(const uint8_t *block_storage, uint8_t *image, const uint32_t offset, const uint32_t stride) {
+    int8_t alpha[8];
+
+    alpha[0] = static_cast<int8_t>(block_storage[0]);
+    alpha[1] = static_cast<int8_t>(block_storage[1]);
+
+    if (alpha[0] > alpha[1]) {
+        // 8-alpha block:  derive the other six alphas.
+        // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+        alpha[2] = static_cast<int8_t>((6 * alpha[0] + 1 * alpha[1] + 3) / 7); // bit code 010
+        alpha[3] = static_cast<int8_t>((5 * alpha[0] + 2 * alpha[1] + 3) / 7); // bit code 011
+        alpha[4] = static_cast<int8_t>((4 * alpha[0] + 3 * alpha[1] + 3) / 7); // bit code 100
+        alpha[5] = static_cast<int8_t>((3 * alpha[0] + 4 * alpha[1] + 3) / 7); // bit code 101
+        alpha[6] = static_cast<int8_t>((2 * alpha[0] + 5 * alpha[1] + 3) / 7); // bit code 110
+        alpha[7] = static_cast<int8_t>((1 * alpha[0] + 6 * alpha[1] + 3) / 7); // bit code 111
+    } else {
+        // 6-alpha block.
+        // Bit code 000 = alpha_0, 001 = alpha_1, others are interpolated.
+        alpha[2] = static_cast<int8_t>((4 * alpha[0] + 1 * alpha[1] + 2) / 5); // Bit code 010
+        alpha[3] = static_cast<int8_t>((3 * alpha[0] + 2 * alpha[1] + 2) / 5); // Bit code 011
+        alpha[4] = static_cast<int8_t>((2 * alpha[0] + 3 * alpha[1] + 2) / 5); // Bit code 100
+        alpha[5] = static_cast<int8_t>((1 * alpha[0] + 4 * alpha[1] + 2) / 5); // Bit code 101
+        alpha[6] = -128; // Bit code 110
+        alpha[7] = 127; // Bit code 111
+    }
+
+    image += offset;
+
+    image[stride * 0] = static_cast<uint8_t>(alpha[block_storage[2] & 0x07]);
+    image[stride * 1] = static_cast<uint8_t>(alpha[(block_storage[2] >> 3) & 0x07]);
+    image[stride * 2] = static_cast<uint8_t>(alpha[((block_storage[3] << 2) & 0x04) | ((block_storage[2] >> 6) & 0x03)]);
+    image[stride * 3] = static_cast<uint8_t>(alpha[(block_storage[3] >> 1) & 0x07]);
+    image[stride * 4] = static_cast<uint8_t>(alpha[(block_storage[3] >> 4) & 0x07]);
+    image[stride * 5] = static_cast<uint8_t>(alpha[((block_storage[4] << 1) & 0x06) | ((block_storage[3] >> 7) & 0x01)]);
+    image[stride * 6] = static_cast<uint8_t>(alpha[(block_storage[4] >> 2) & 0x07]);
+    image[stride * 7] = static_cast<uint8_t>(alpha[(block_storage[4] >> 5) & 0x07]);
+    image[stride * 8] = static_cast<uint8_t>(alpha[block_storage[5] & 0x07]);
+    image[stride * 9] = static_cast<uint8_t>(alpha[(block_storage[5] >> 3) & 0x07]);
+    image[stride * 10] = static_cast<uint8_t>(alpha[((block_storage[6] << 2) & 0x04) | ((block_storage[5] >> 6) & 0x03)]);
+    image[stride * 11] = static_cast<uint8_t>(alpha[(block_storage[6] >> 1) & 0x07]);
+    image[stride * 12] = static_cast<uint8_t>(alpha[(block_storage[6] >> 4) & 0x07]);
+    image[stride * 13] = static_cast<uint8_t>(alpha[((block_storage[7] << 1) & 0x06) | ((block_storage[6] >> 7) & 0x01)]);
+    image[stride * 14] = static_cast<uint8_t>(alpha[(block_storage[7] >> 2) & 0x07]);
+    image[stride * 15] = static_cast<uint8_t>(alpha[(block_storage[7] >> 5) & 0x07]);
+}
+
+static void reference_block_bc2(const uint8_t *block_storage, uint32_t *image) {
+    reference_block_bc1(block_storage + 8, image);
+
+    // Fixed to read nibble i rather than byte i
+    for (int i = 0; i < 16; i += 2) {
+        image[i] = (((block_storage[i / 2] & 0x0F) | ((block_storage[i / 2] & 0x0F) << 4)) << 24) | (image[i] & 0x00FFFFFF);
+    }
+
+    for (int i = 1; i < 16; i += 2) {
+        image[i] = (((block_storage[i / 2] & 0xF0) | ((block_storage[i / 2] & 0xF0) >> 4)) << 24) | (image[i] & 0x00FFFFFF);
+    }
+}
+
+static void reference_block_bc3(const uint8_t *block_storage, uint32_t *image) {
+    reference_block_bc1(block_storage + 8, image);
+    reference_block_alpha(block_storage, reinterpret_cast<uint8_t *>(image), 3, 4);
+}
+
+static void reference_block_bc4u(const uint8_t *block_storage, uint32_t *image) {
+    for (int i = 0; i < 16; i++)
+        image[i] = 0x00000000;
+    reference_block_alpha(block_storage, reinterpret_cast<uint8_t *>(image), 0, 4);
+}
+
+static void reference_block_bc4s(const uint8_t *block_storage, uint32_t *image) {
+    for (int i = 0; i < 16; i++)
+        image[i] = 0x00000000;
+    reference_block_alpha_signed(block_storage, reinterpret_cast<uint8_t *>(image), 0, 4);
+}
+
+static void reference_block_bc5u(const uint8_t *block_storage, uint32_t *image) {
+    for (int i = 0; i < 16; i++)
+        image[i] = 0x00000000;
+    reference_block_alpha(block_storage, reinterpret_cast<uint8_t *>(image), 0, 4);
+    reference_block_alpha(block_storage + 8, reinterpret_cast<uint8_t *>(image), 1, 4);
+}
+
+static void reference_block_bc5s(const uint8_t *block_storage, uint32_t *image) {
+    for (int i = 0; i < 16; i++)
+        image[i] = 0x00000000;
+    reference_block_alpha_signed(block_storage, reinterpret_cast<uint8_t *>(image), 0, 4);
+    reference_block_alpha_signed(block_storage + 8, reinterpret_cast<uint8_t *>(image), 1, 4);
+}
+
+static void reference_bc_swizz_image(uint32_t width, uint32_t height, const uint8_t *block_storage, uint32_t *image, const uint8_t bc_type) {
+    uint32_t block_count_x = (width + 3) / 4;
+    uint32_t block_count_y = (height + 3) / 4;
+    size_t block_size = (bc_type != 1 && bc_type != 4 && bc_type != 5) ? 16 : 8;
+
+    uint32_t temp_block_result[16] = {};
+
+    // Z-order curve inverse table
+    static const int z_order_curve_inv[] = {
+        0, 2, 8, 10,
+        1, 3, 9, 11,
+        4, 6, 12, 14,
+        5, 7, 13, 15
+    };
+
+    for (uint32_t j = 0; j < block_count_y; j++) {
+        for (uint32_t i = 0; i < block_count_x; i++) {
+            switch (bc_type) {
+            case 1:
+                reference_block_bc1(block_storage, temp_block_result);
+                break;
+
+            case 2:
+                reference_block_bc2(block_storage, temp_block_result);
+                break;
+
+            case 3:
+                reference_block_bc3(block_storage, temp_block_result);
+                break;
+
+            case 4:
+                reference_block_bc4u(block_storage, temp_block_result);
+                break;
+
+            case 5:
+                reference_block_bc4s(block_storage, temp_block_result);
+                break;
+
+            case 6:
+                reference_block_bc5u(block_storage, temp_block_result);
+                break;
+
+            case 7:
+                reference_block_bc5s(block_storage, temp_block_result);
+                break;
+            }
+
+            for (int b = 0; b < 16; b++) {
+                image[z_order_curve_inv[b]] = temp_block_result[b];
+            }
+
+            block_storage += block_size;
+            image += 16;
+        }
+    }
+}
+
+static constexpr uint8_t BC_TYPE_COUNT = 7;
+
+// One block line, one block column, square, wider and taller, with more blocks than a decoding part
+static const std::pair<uint32_t, uint32_t> bc_sizes[] = {
+    { 4, 4 }, { 64, 4 }, { 4, 64 }, { 32, 32 }, { 128, 32 }, { 32, 128 }, { 512, 256 }, { 256, 512 }
+};
+
+static size_t bc_block_size(uint8_t bc_type) {
+    return (bc_type != 1 && bc_type != 4 && bc_type != 5) ? 16 : 8;
+}
+
+static std::vector<uint8_t> random_bytes(std::mt19937 &rng, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes)
+        byte = static_cast<uint8_t>(rng());
+    return bytes;
+}
+
+static void expect_bc_matches_reference(const std::vector<uint8_t> &blocks, uint32_t width, uint32_t height, uint8_t bc_type, ThreadPool *pool) {
+    const size_t pixel_count = static_cast<size_t>((width + 3) / 4 * 4) * ((height + 3) / 4 * 4);
+
+    std::vector<uint32_t> expected(pixel_count, 0xDEADBEEF);
+    reference_bc_swizz_image(width, height, blocks.data(), expected.data(), bc_type);
+
+    std::vector<uint32_t> result(pixel_count, 0xDEADBEEF);
+    renderer::texture::decompress_bc_swizz_image(width, height, blocks.data(), result.data(), bc_type, pool);
+
+    ASSERT_EQ(result, expected) << "BC type " << int(bc_type) << ", " << width << "x" << height << (pool ? " in parallel" : "");
+}
+
+TEST(texture_decode, bc_fixed_blocks) {
+    // Both BC1 color modes and equal endpoints, both alpha modes, signed endpoints, every index pattern
+    const std::vector<std::vector<uint8_t>> halves = {
+        { 0x00, 0xF8, 0xE0, 0x07, 0x00, 0x55, 0xAA, 0xFF },
+        { 0xE0, 0x07, 0x00, 0xF8, 0xE4, 0xE4, 0x1B, 0x1B },
+        { 0x34, 0x12, 0x34, 0x12, 0xFF, 0x00, 0xFF, 0x00 },
+        { 0xFF, 0x00, 0x88, 0xC6, 0xFA, 0x05, 0x77, 0x12 },
+        { 0x00, 0xFF, 0x49, 0x92, 0x24, 0xB6, 0x6D, 0xDB },
+        { 0x80, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+        { 0x7F, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xF0, 0x0F, 0xA5, 0x5A, 0x3C, 0xC3, 0x96, 0x69 },
+    };
+
+    for (uint8_t bc_type = 1; bc_type <= BC_TYPE_COUNT; bc_type++) {
+        // Every pair of halves, as a block line
+        std::vector<uint8_t> blocks;
+        uint32_t block_count = 0;
+        for (const auto &first : halves) {
+            for (const auto &second : halves) {
+                blocks.insert(blocks.end(), first.begin(), first.end());
+                if (bc_block_size(bc_type) == 16)
+                    blocks.insert(blocks.end(), second.begin(), second.end());
+                block_count++;
+            }
+        }
+
+        expect_bc_matches_reference(blocks, block_count * 4, 4, bc_type, nullptr);
+    }
+}
+
+TEST(texture_decode, bc_random_blocks) {
+    std::mt19937 rng(5);
+    ThreadPool pool(4);
+
+    for (uint8_t bc_type = 1; bc_type <= BC_TYPE_COUNT; bc_type++) {
+        for (const auto &[width, height] : bc_sizes) {
+            const std::vector<uint8_t> blocks = random_bytes(rng, (width / 4) * (height / 4) * bc_block_size(bc_type));
+            expect_bc_matches_reference(blocks, width, height, bc_type, nullptr);
+            expect_bc_matches_reference(blocks, width, height, bc_type, &pool);
+        }
+    }
+}
+
+TEST(texture_decode, pvrtc_matches_reference) {
+    std::mt19937 rng(6);
+    ThreadPool pool(4);
+
+    // Smaller than the minimum size, square, wider and taller, and with more words than a decoding part
+    const std::pair<uint32_t, uint32_t> sizes[] = {
+        { 4, 4 }, { 8, 8 }, { 16, 16 }, { 64, 16 }, { 16, 64 }, { 128, 128 }, { 512, 256 }, { 256, 512 }
+    };
+
+    for (const uint32_t is_2bpp : { 0u, 1u }) {
+        for (const uint32_t pvrt_type : { 0u, 1u }) {
+            for (const auto &[width, height] : sizes) {
+                const uint32_t word_width = is_2bpp ? 8 : 4;
+                const uint32_t word_count = std::max(width, word_width * 2) / word_width * std::max(height, 8u) / 4;
+                const std::vector<uint8_t> words = random_bytes(rng, word_count * 8);
+
+                std::vector<uint8_t> expected(width * height * 4, 0xCD);
+                pvr_reference::PVRTDecompressPVRTC(words.data(), is_2bpp, width, height, pvrt_type, expected.data());
+
+                for (ThreadPool *decode_pool : { static_cast<ThreadPool *>(nullptr), &pool }) {
+                    std::vector<uint8_t> result(width * height * 4, 0xCD);
+                    pvr::PVRTDecompressPVRTC(words.data(), is_2bpp, width, height, pvrt_type, result.data(), decode_pool);
+                    ASSERT_EQ(result, expected) << (is_2bpp ? "2bpp" : "4bpp") << (pvrt_type ? " II " : " I ") << width << "x" << height << (decode_pool ? " in parallel" : "");
+                }
+            }
+        }
+    }
+}
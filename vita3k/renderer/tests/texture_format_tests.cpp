@@ -0,0 +1,149 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/functions.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace renderer::texture;
+
+static const uint8_t all_bits_per_pixel[] = { 4, 8, 16, 24, 32, 64, 128 };
+
+// Square, wider, taller, on a single block line and smaller than the vectors
+static const std::pair<uint16_t, uint16_t> power_of_two_sizes[] = {
+    { 2, 2 }, { 4, 4 }, { 8, 2 }, { 2, 8 }, { 16, 16 }, { 64, 16 }, { 16, 64 }, { 256, 32 }, { 32, 256 }, { 128, 128 }, { 1024, 8 }
+};
+
+static uint32_t compact_one_by_one(uint32_t x) {
+    x &= 0x55555555;
+    x = (x ^ (x >> 1)) & 0x33333333;
+    x = (x ^ (x >> 2)) & 0x0f0f0f0f;
+    x = (x ^ (x >> 4)) & 0x00ff00ff;
+    x = (x ^ (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+static void copy_texel(uint8_t *dest, size_t dest_index, const uint8_t *src, size_t src_index, uint32_t bits_per_pixel) {
+    if (bits_per_pixel == 4) {
+        // The first texel of a byte is in its low nibble
+        const uint8_t texel = (src[src_index / 2] >> ((src_index & 1) * 4)) & 0xf;
+        const uint8_t shift = (dest_index & 1) * 4;
+        dest[dest_index / 2] = (dest[dest_index / 2] & ~(0xf << shift)) | (texel << shift);
+        return;
+    }
+
+    const uint32_t bytes_per_pixel = bits_per_pixel / 8;
+    std::memcpy(dest + dest_index * bytes_per_pixel, src + src_index * bytes_per_pixel, bytes_per_pixel);
+}
+
+// The per texel mapping swizzled_texture_to_linear_texture used before the offset tables
+static void reference_swizzled_to_linear(uint8_t *dest, const uint8_t *src, uint16_t width, uint16_t height, uint32_t bits_per_pixel) {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(width * height); i++) {
+        size_t min = width < height ? width : height;
+        size_t k = static_cast<size_t>(log2(min));
+
+        size_t x, y;
+        if (height < width) {
+            // XXXyxyxyx → XXXxxxyyy
+            size_t j = i >> (2 * k) << (2 * k)
+                | (compact_one_by_one(i >> 1) & (min - 1)) << k
+                | (compact_one_by_one(i) & (min - 1)) << 0;
+            x = j / height;
+            y = j % height;
+        } else {
+            // YYYyxyxyx → YYYyyyxxx
+            size_t j = i >> (2 * k) << (2 * k)
+                | (compact_one_by_one(i) & (min - 1)) << k
+                | (compact_one_by_one(i >> 1) & (min - 1)) << 0;
+            x = j % width;
+            y = j / width;
+        }
+
+        if (y >= height || x >= width)
+            continue;
+
+        copy_texel(dest, y * width + x, src, i, bits_per_pixel);
+    }
+}
+
+static std::vector<uint8_t> random_texture(std::mt19937 &rng, uint16_t width, uint16_t height, uint32_t bits_per_pixel) {
+    std::vector<uint8_t> texture((static_cast<size_t>(width) * height * bits_per_pixel + 7) / 8);
+    for (uint8_t &byte : texture)
+        byte = static_cast<uint8_t>(rng());
+    return texture;
+}
+
+TEST(texture_format, swizzled_matches_per_texel_mapping) {
+    std::mt19937 rng(42);
+    for (const auto &[width, height] : power_of_two_sizes) {
+        for (const uint8_t bits_per_pixel : all_bits_per_pixel) {
+            const std::vector<uint8_t> src = random_texture(rng, width, height, bits_per_pixel);
+
+            std::vector<uint8_t> expected(src.size());
+            reference_swizzled_to_linear(expected.data(), src.data(), width, height, bits_per_pixel);
+
+            std::vector<uint8_t> result(src.size());
+            swizzled_texture_to_linear_texture(result.data(), src.data(), width, height, bits_per_pixel);
+
+            ASSERT_EQ(result, expected) << width << "x" << height << ", " << static_cast<int>(bits_per_pixel) << " bits per pixel";
+        }
+    }
+}
+
+TEST(texture_format, swizzled_single_line) {
+    // A single line is linear, even when its length is not a power of two
+    std::mt19937 rng(1);
+    for (const auto &[width, height] : { std::pair<uint16_t, uint16_t>{ 1, 1 }, { 1, 8 }, { 8, 1 }, { 1, 6 }, { 6, 1 }, { 1, 37 } }) {
+        for (const uint8_t bits_per_pixel : all_bits_per_pixel) {
+            const std::vector<uint8_t> src = random_texture(rng, width, height, bits_per_pixel);
+
+            std::vector<uint8_t> expected(src.size());
+            reference_swizzled_to_linear(expected.data(), src.data(), width, height, bits_per_pixel);
+            if (bits_per_pixel == 4 && (width * height) % 2)
+                expected.back() |= src.back() & 0xf0;
+            ASSERT_EQ(expected, src);
+
+            std::vector<uint8_t> result(src.size());
+            swizzled_texture_to_linear_texture(result.data(), src.data(), width, height, bits_per_pixel);
+
+            ASSERT_EQ(result, src) << width << "x" << height << ", " << static_cast<int>(bits_per_pixel) << " bits per pixel";
+        }
+    }
+}
+
+TEST(texture_format, swizzled_non_power_of_two_is_rejected) {
+    // The hardware needs swizzled textures to be powers of two, the arbitrary ones are padded
+    // before being unswizzled. The old mapping scrambled the others, they are left untouched now.
+    std::mt19937 rng(2);
+    for (const auto &[width, height] : { std::pair<uint16_t, uint16_t>{ 6, 4 }, { 4, 6 }, { 12, 12 }, { 100, 64 } }) {
+        for (const uint8_t bits_per_pixel : all_bits_per_pixel) {
+            const std::vector<uint8_t> src = random_texture(rng, width, height, bits_per_pixel);
+            const std::vector<uint8_t> dest_initial = random_texture(rng, width, height, bits_per_pixel);
+
+            std::vector<uint8_t> result = dest_initial;
+            swizzled_texture_to_linear_texture(result.data(), src.data(), width, height, bits_per_pixel);
+
+            ASSERT_EQ(result, dest_initial) << width << "x" << height << ", " << static_cast<int>(bits_per_pixel) << " bits per pixel";
+        }
+    }
+}
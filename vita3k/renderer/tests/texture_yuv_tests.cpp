@@ -0,0 +1,235 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/functions.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace renderer::texture;
+
+static const SceGxmTextureFormat yuv_formats[] = {
+    SCE_GXM_TEXTURE_FORMAT_YUV420P2_CSC0,
+    SCE_GXM_TEXTURE_FORMAT_YVU420P2_CSC0,
+    SCE_GXM_TEXTURE_FORMAT_YUV420P2_CSC1,
+    SCE_GXM_TEXTURE_FORMAT_YVU420P2_CSC1,
+    SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC0,
+    SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC0,
+    SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC1,
+    SCE_GXM_TEXTURE_FORMAT_YVU420P3_CSC1,
+};
+
+static bool is_p2(SceGxmTextureFormat format) {
+    return (format & SCE_GXM_TEXTURE_BASE_FORMAT_MASK) == SCE_GXM_TEXTURE_BASE_FORMAT_YUV420P2;
+}
+
+static bool is_yvu(SceGxmTextureFormat format) {
+    const uint32_t swizzle = format & SCE_GXM_TEXTURE_SWIZZLE_MASK;
+    return swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC0 || swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC1;
+}
+
+static bool is_csc1(SceGxmTextureFormat format) {
+    const uint32_t swizzle = format & SCE_GXM_TEXTURE_SWIZZLE_MASK;
+    return swizzle == SCE_GXM_TEXTURE_SWIZZLE_YUV_CSC1 || swizzle == SCE_GXM_TEXTURE_SWIZZLE_YVU_CSC1;
+}
+
+static size_t yuv_texture_size(size_t width, size_t height) {
+    return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+// Y, U and V of a pixel, with the chroma planes rounded up for odd sizes
+static void fetch_yuv(const std::vector<uint8_t> &src, size_t width, size_t height, SceGxmTextureFormat format, size_t x, size_t y, int &luma, int &u, int &v) {
+    const size_t chroma_width = (width + 1) / 2;
+    const size_t chroma_height = (height + 1) / 2;
+    const size_t chroma = (y / 2) * chroma_width + x / 2;
+    const uint8_t *first;
+    const uint8_t *second;
+    if (is_p2(format)) {
+        first = &src[width * height + chroma * 2];
+        second = first + 1;
+    } else {
+        first = &src[width * height + chroma];
+        second = first + chroma_width * chroma_height;
+    }
+
+    luma = src[y * width + x];
+    u = is_yvu(format) ? *second : *first;
+    v = is_yvu(format) ? *first : *second;
+}
+
+// The per pixel fixed-point conversion the SIMD kernels must match exactly
+static void reference_yuv420_to_rgba(uint8_t *dst, size_t dst_stride, const std::vector<uint8_t> &src, size_t width, size_t height, SceGxmTextureFormat format) {
+    // Luma scale applied to Y * 257 as a 16-bit high multiply, then 6 fractional bits
+    const int y_scale = 19003;
+    const int y_bias = -1160;
+    const int v_to_r = is_csc1(format) ? 115 : 102;
+    const int u_to_g = is_csc1(format) ? 14 : 25;
+    const int v_to_g = is_csc1(format) ? 34 : 52;
+    const int u_to_b = is_csc1(format) ? 135 : 129;
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            int luma, u, v;
+            fetch_yuv(src, width, height, format, x, y, luma, u, v);
+            const int scaled = static_cast<int>((luma * 257u * y_scale) >> 16) + y_bias;
+            uint8_t *pixel = dst + y * dst_stride + x * 4;
+            pixel[0] = static_cast<uint8_t>(std::clamp((scaled + v_to_r * (v - 128)) >> 6, 0, 255));
+            pixel[1] = static_cast<uint8_t>(std::clamp((scaled - u_to_g * (u - 128) - v_to_g * (v - 128)) >> 6, 0, 255));
+            pixel[2] = static_cast<uint8_t>(std::clamp((scaled + u_to_b * (u - 128)) >> 6, 0, 255));
+            pixel[3] = 255;
+        }
+    }
+}
+
+static void expect_matches_reference(const std::vector<uint8_t> &src, size_t width, size_t height, SceGxmTextureFormat format) {
+    // Rows with padding after them, which must be left alone
+    const size_t dst_stride = width * 4 + 12;
+    std::vector<uint8_t> expected(dst_stride * height, 0xCD);
+    reference_yuv420_to_rgba(expected.data(), dst_stride, src, width, height, format);
+
+    std::vector<uint8_t> result(dst_stride * height, 0xCD);
+    yuv420_texture_to_rgba(result.data(), dst_stride, src.data(), width, height, format);
+
+    ASSERT_EQ(result, expected) << std::hex << "format 0x" << format << std::dec << ", " << width << "x" << height;
+}
+
+TEST(texture_yuv, matches_scalar_on_random_data) {
+    std::mt19937 rng(10);
+
+    // Odd sizes, and widths around the 16 and 32 pixels of the SIMD kernels
+    const size_t widths[] = { 1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 48, 63, 64, 65, 97, 130 };
+    const size_t heights[] = { 1, 2, 3, 4, 5, 9 };
+
+    for (const SceGxmTextureFormat format : yuv_formats) {
+        for (const size_t width : widths) {
+            for (const size_t height : heights) {
+                std::vector<uint8_t> src(yuv_texture_size(width, height));
+                for (uint8_t &byte : src)
+                    byte = static_cast<uint8_t>(rng());
+
+                expect_matches_reference(src, width, height, format);
+            }
+        }
+    }
+}
+
+TEST(texture_yuv, matches_scalar_on_saturation_edges) {
+    // Every combination of the extreme and limited range boundary values, each pixel a different one
+    const uint8_t edges[] = { 0, 1, 15, 16, 17, 127, 128, 129, 235, 236, 239, 240, 241, 254, 255 };
+    constexpr size_t edge_count = std::size(edges);
+    const size_t width = 2 * edge_count * edge_count + 1;
+    const size_t height = 2 * edge_count + 1;
+
+    for (const SceGxmTextureFormat format : yuv_formats) {
+        std::vector<uint8_t> src(yuv_texture_size(width, height));
+        const size_t chroma_width = (width + 1) / 2;
+        const size_t chroma_height = (height + 1) / 2;
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++)
+                src[y * width + x] = edges[(y / 2) % edge_count];
+        }
+        for (size_t y = 0; y < chroma_height; y++) {
+            for (size_t x = 0; x < chroma_width; x++) {
+                const uint8_t u = edges[x % edge_count];
+                const uint8_t v = edges[(x / edge_count + y) % edge_count];
+                if (is_p2(format)) {
+                    src[width * height + (y * chroma_width + x) * 2] = u;
+                    src[width * height + (y * chroma_width + x) * 2 + 1] = v;
+                } else {
+                    src[width * height + y * chroma_width + x] = u;
+                    src[width * height + chroma_width * chroma_height + y * chroma_width + x] = v;
+                }
+            }
+        }
+
+        expect_matches_reference(src, width, height, format);
+    }
+}
+
+TEST(texture_yuv, close_to_float_conversion) {
+    std::mt19937 rng(11);
+    constexpr size_t width = 64;
+    constexpr size_t height = 16;
+
+    for (const SceGxmTextureFormat format : { SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC0, SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC1 }) {
+        // Limited range values only, the float results are then not clamped
+        std::vector<uint8_t> src(yuv_texture_size(width, height));
+        for (uint8_t &byte : src)
+            byte = static_cast<uint8_t>(64 + rng() % 128);
+
+        std::vector<uint8_t> result(width * height * 4);
+        yuv420_texture_to_rgba(result.data(), width * 4, src.data(), width, height, format);
+
+        const double kr = is_csc1(format) ? 0.2126 : 0.299;
+        const double kb = is_csc1(format) ? 0.0722 : 0.114;
+        const double kg = 1 - kr - kb;
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                int luma, u, v;
+                fetch_yuv(src, width, height, format, x, y, luma, u, v);
+                const double scaled = (luma - 16) * 255.0 / 219;
+                const double pb = (u - 128) * 255.0 / 224;
+                const double pr = (v - 128) * 255.0 / 224;
+                const double rgb[] = {
+                    scaled + 2 * (1 - kr) * pr,
+                    scaled - 2 * (1 - kb) * kb / kg * pb - 2 * (1 - kr) * kr / kg * pr,
+                    scaled + 2 * (1 - kb) * pb,
+                };
+                for (int c = 0; c < 3; c++)
+                    ASSERT_NEAR(result[(y * width + x) * 4 + c], std::clamp(rgb[c], 0.0, 255.0), 2.5) << x << ", " << y << ", channel " << c;
+            }
+        }
+    }
+}
+
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST(texture_yuv, DISABLED_benchmark) {
+    constexpr int repeat_count = 50;
+    std::mt19937 rng(12);
+
+    std::printf("YUV420 to RGBA, per pixel reference -> kernel:\n");
+    for (const auto [width, height] : { std::pair<size_t, size_t>{ 960, 544 }, std::pair<size_t, size_t>{ 1920, 1088 } }) {
+        for (const SceGxmTextureFormat format : { SCE_GXM_TEXTURE_FORMAT_YUV420P3_CSC0, SCE_GXM_TEXTURE_FORMAT_YUV420P2_CSC0 }) {
+            std::vector<uint8_t> src(yuv_texture_size(width, height));
+            for (uint8_t &byte : src)
+                byte = static_cast<uint8_t>(rng());
+            std::vector<uint8_t> dst(width * height * 4);
+
+            const auto measure = [&](const auto &convert) {
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < repeat_count; i++)
+                    convert();
+                const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                return time.count() / repeat_count;
+            };
+
+            const double kernel = measure([&] {
+                yuv420_texture_to_rgba(dst.data(), width * 4, src.data(), width, height, format);
+            });
+            const double reference = measure([&] {
+                reference_yuv420_to_rgba(dst.data(), width * 4, src, width, height, format);
+            });
+
+            std::printf("  %zux%zu %s %.3f ms -> %.3f ms\n", width, height, is_p2(format) ? "P2" : "P3", reference, kernel);
+        }
+    }
+}
@@ -0,0 +1,302 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <gxm/functions.h>
+#include <renderer/functions.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace renderer;
+
+static const SceGxmTransferFormat all_formats[] = {
+    SCE_GXM_TRANSFER_FORMAT_U8_R,
+    SCE_GXM_TRANSFER_FORMAT_U4U4U4U4_ABGR,
+    SCE_GXM_TRANSFER_FORMAT_U1U5U5U5_ABGR,
+    SCE_GXM_TRANSFER_FORMAT_U5U6U5_BGR,
+    SCE_GXM_TRANSFER_FORMAT_U8U8_GR,
+    SCE_GXM_TRANSFER_FORMAT_U8U8U8_BGR,
+    SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR,
+    SCE_GXM_TRANSFER_FORMAT_VYUY422,
+    SCE_GXM_TRANSFER_FORMAT_YVYU422,
+    SCE_GXM_TRANSFER_FORMAT_UYVY422,
+    SCE_GXM_TRANSFER_FORMAT_YUYV422,
+    SCE_GXM_TRANSFER_FORMAT_U2U10U10U10_ABGR,
+    SCE_GXM_TRANSFER_FORMAT_RAW16,
+    SCE_GXM_TRANSFER_FORMAT_RAW32,
+    SCE_GXM_TRANSFER_FORMAT_RAW64,
+    SCE_GXM_TRANSFER_FORMAT_RAW128,
+};
+
+static const SceGxmTransferColorKeyMode all_key_modes[] = {
+    SCE_GXM_TRANSFER_COLORKEY_NONE,
+    SCE_GXM_TRANSFER_COLORKEY_PASS,
+    SCE_GXM_TRANSFER_COLORKEY_REJECT,
+};
+
+// Widths going over every vector size with every possible tail
+static constexpr uint32_t MAX_WIDTH = 70;
+// Guest surfaces have no alignment, the rows start on every offset of a vector
+static constexpr uint32_t MAX_MISALIGNMENT = 3;
+
+static uint32_t get_bytes_per_pixel(SceGxmTransferFormat format) {
+    return (gxm::get_bits_per_pixel(format) + 7) >> 3;
+}
+
+// The per pixel loops the transfer commands used before the row kernels
+
+static void reference_copy_row(uint8_t *dest, const uint8_t *src, uint32_t width, uint32_t bytes_per_pixel, const TransferColorKey &key) {
+    for (uint32_t x = 0; x < width; x++) {
+        const uint8_t *src_pixel = src + x * bytes_per_pixel;
+        uint32_t src_color = 0;
+        memcpy(&src_color, src_pixel, std::min(bytes_per_pixel, 4u));
+
+        bool copied = false;
+        switch (key.mode) {
+        case SCE_GXM_TRANSFER_COLORKEY_NONE:
+            copied = true;
+            break;
+        case SCE_GXM_TRANSFER_COLORKEY_PASS:
+            copied = (src_color & key.mask) == key.value;
+            break;
+        case SCE_GXM_TRANSFER_COLORKEY_REJECT:
+            copied = (src_color & key.mask) != key.value;
+            break;
+        }
+
+        if (copied)
+            memcpy(dest + x * bytes_per_pixel, src_pixel, bytes_per_pixel);
+    }
+}
+
+static void reference_fill_row(uint8_t *dest, uint32_t width, uint32_t bytes_per_pixel, uint32_t color) {
+    uint8_t pixel[16] = {};
+    memcpy(pixel, &color, std::min(bytes_per_pixel, 4u));
+    for (uint32_t x = 0; x < width; x++)
+        memcpy(dest + x * bytes_per_pixel, pixel, bytes_per_pixel);
+}
+
+static void reference_downscale_row(uint8_t *dest, const uint8_t *src, uint32_t dest_width, uint32_t bytes_per_pixel) {
+    for (uint32_t x = 0; x < dest_width; x++)
+        memcpy(dest + x * bytes_per_pixel, src + x * 2 * bytes_per_pixel, bytes_per_pixel);
+}
+
+static std::vector<uint8_t> random_bytes(std::mt19937 &rng, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes)
+        byte = static_cast<uint8_t>(rng());
+    return bytes;
+}
+
+TEST(transfer, copy_row_matches_scalar) {
+    std::mt19937 rng(42);
+    for (const SceGxmTransferFormat format : all_formats) {
+        const uint32_t bytes_per_pixel = get_bytes_per_pixel(format);
+        const size_t buffer_size = (MAX_WIDTH + 1) * bytes_per_pixel + MAX_MISALIGNMENT;
+
+        for (const SceGxmTransferColorKeyMode mode : all_key_modes) {
+            for (uint32_t width = 0; width <= MAX_WIDTH; width++) {
+                const uint32_t misalignment = width % (MAX_MISALIGNMENT + 1);
+                std::vector<uint8_t> src = random_bytes(rng, buffer_size);
+                const std::vector<uint8_t> dest_initial = random_bytes(rng, buffer_size);
+
+                // Only a few pixels have few bits, so that both selections are exercised
+                TransferColorKey key = { mode, 0, 0x0F0F0F0F };
+                for (uint32_t x = 0; x < width; x += 3) {
+                    uint8_t *pixel = &src[misalignment + x * bytes_per_pixel];
+                    for (uint32_t i = 0; i < std::min(bytes_per_pixel, 4u); i++)
+                        pixel[i] &= 0xF0;
+                }
+
+                std::vector<uint8_t> expected = dest_initial;
+                reference_copy_row(&expected[misalignment], &src[misalignment], width, bytes_per_pixel, key);
+
+                std::vector<uint8_t> result = dest_initial;
+                ASSERT_TRUE(transfer_copy_row(&result[misalignment], format, &src[misalignment], format, width, key));
+
+                ASSERT_EQ(result, expected) << "format " << std::hex << format << std::dec << ", color key mode " << mode << ", width " << width;
+            }
+        }
+    }
+}
+
+TEST(transfer, copy_row_key_value_out_of_pixel) {
+    std::mt19937 rng(7);
+    const std::vector<uint8_t> src = random_bytes(rng, MAX_WIDTH * 2);
+    const std::vector<uint8_t> dest_initial = random_bytes(rng, MAX_WIDTH * 2);
+
+    for (const SceGxmTransferColorKeyMode mode : { SCE_GXM_TRANSFER_COLORKEY_PASS, SCE_GXM_TRANSFER_COLORKEY_REJECT }) {
+        const TransferColorKey key = { mode, 0x10000, 0xFFFFFFFF };
+
+        std::vector<uint8_t> expected = dest_initial;
+        reference_copy_row(expected.data(), src.data(), MAX_WIDTH, 2, key);
+
+        std::vector<uint8_t> result = dest_initial;
+        ASSERT_TRUE(transfer_copy_row(result.data(), SCE_GXM_TRANSFER_FORMAT_RAW16, src.data(), SCE_GXM_TRANSFER_FORMAT_RAW16, MAX_WIDTH, key));
+        ASSERT_EQ(result, expected);
+    }
+}
+
+TEST(transfer, copy_row_overlapping) {
+    constexpr size_t offset = 64;
+    constexpr size_t row_size = MAX_WIDTH * 4;
+    std::mt19937 rng(8);
+    const std::vector<uint8_t> initial = random_bytes(rng, row_size + 2 * offset);
+    const TransferColorKey key = { SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0 };
+
+    // Image copied over itself a few pixels backward or forward
+    for (const int shift : { -36, -4, 4, 36 }) {
+        std::vector<uint8_t> expected = initial;
+        std::copy(initial.begin() + offset, initial.begin() + offset + row_size, expected.begin() + offset + shift);
+
+        std::vector<uint8_t> result = initial;
+        ASSERT_TRUE(transfer_copy_row(&result[offset + shift], SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, &result[offset], SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, MAX_WIDTH, key));
+        ASSERT_EQ(result, expected) << "shift " << shift;
+    }
+}
+
+TEST(transfer, copy_row_raw_formats_of_same_size) {
+    std::mt19937 rng(3);
+    for (const SceGxmTransferFormat src_format : all_formats) {
+        for (const SceGxmTransferFormat dest_format : all_formats) {
+            const uint32_t bytes_per_pixel = get_bytes_per_pixel(src_format);
+            if (src_format == dest_format || bytes_per_pixel != get_bytes_per_pixel(dest_format))
+                continue;
+
+            const bool is_raw = (src_format >= SCE_GXM_TRANSFER_FORMAT_RAW16) || (dest_format >= SCE_GXM_TRANSFER_FORMAT_RAW16);
+            if (!is_raw)
+                continue;
+
+            const std::vector<uint8_t> src = random_bytes(rng, MAX_WIDTH * bytes_per_pixel);
+            std::vector<uint8_t> result(src.size());
+            const TransferColorKey key = { SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0 };
+            ASSERT_TRUE(transfer_copy_row(result.data(), dest_format, src.data(), src_format, MAX_WIDTH, key));
+            ASSERT_EQ(result, src);
+        }
+    }
+}
+
+TEST(transfer, copy_row_converts_color_formats) {
+    const uint8_t src[] = { 0xFF, 0x00, 0x80, 0x40 };
+    uint8_t dest[2] = {};
+    const TransferColorKey key = { SCE_GXM_TRANSFER_COLORKEY_NONE, 0, 0 };
+
+    ASSERT_TRUE(transfer_copy_row(dest, SCE_GXM_TRANSFER_FORMAT_U5U6U5_BGR, src, SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, 1, key));
+    uint16_t pixel;
+    memcpy(&pixel, dest, sizeof(pixel));
+    ASSERT_EQ(pixel, 0x1F | (0x00 << 5) | (0x10 << 11));
+
+    ASSERT_FALSE(transfer_copy_row(dest, SCE_GXM_TRANSFER_FORMAT_YUYV422, src, SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, 1, key));
+}
+
+TEST(transfer, fill_row_matches_scalar) {
+    std::mt19937 rng(1);
+    for (const SceGxmTransferFormat format : all_formats) {
+        const uint32_t bytes_per_pixel = get_bytes_per_pixel(format);
+        const size_t buffer_size = (MAX_WIDTH + 1) * bytes_per_pixel + MAX_MISALIGNMENT;
+
+        for (uint32_t width = 0; width <= MAX_WIDTH; width++) {
+            const uint32_t misalignment = width % (MAX_MISALIGNMENT + 1);
+            const uint32_t color = rng();
+            const std::vector<uint8_t> dest_initial = random_bytes(rng, buffer_size);
+
+            std::vector<uint8_t> expected = dest_initial;
+            reference_fill_row(&expected[misalignment], width, bytes_per_pixel, color);
+
+            std::vector<uint8_t> result = dest_initial;
+            transfer_fill_row(&result[misalignment], width, bytes_per_pixel, color);
+
+            ASSERT_EQ(result, expected) << "format " << std::hex << format << std::dec << ", width " << width;
+        }
+    }
+}
+
+TEST(transfer, downscale_row_matches_scalar) {
+    std::mt19937 rng(2);
+    for (const SceGxmTransferFormat format : all_formats) {
+        const uint32_t bytes_per_pixel = get_bytes_per_pixel(format);
+
+        for (uint32_t dest_width = 0; dest_width <= MAX_WIDTH; dest_width++) {
+            const uint32_t misalignment = dest_width % (MAX_MISALIGNMENT + 1);
+            const std::vector<uint8_t> src = random_bytes(rng, 2 * dest_width * bytes_per_pixel + MAX_MISALIGNMENT);
+            const std::vector<uint8_t> dest_initial = random_bytes(rng, (dest_width + 1) * bytes_per_pixel + MAX_MISALIGNMENT);
+
+            std::vector<uint8_t> expected = dest_initial;
+            reference_downscale_row(&expected[misalignment], &src[misalignment], dest_width, bytes_per_pixel);
+
+            std::vector<uint8_t> result = dest_initial;
+            transfer_downscale_row(&result[misalignment], &src[misalignment], dest_width, bytes_per_pixel);
+
+            ASSERT_EQ(result, expected) << "format " << std::hex << format << std::dec << ", width " << dest_width;
+        }
+    }
+}
+
+// Time of a full screen 32-bit transfer with the row kernels and with the per pixel loops.
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST(transfer, DISABLED_benchmark) {
+    constexpr uint32_t width = 960;
+    constexpr uint32_t height = 544;
+    constexpr uint32_t bytes_per_pixel = 4;
+    constexpr uint32_t stride = width * bytes_per_pixel;
+    constexpr int repeat_count = 20;
+
+    std::mt19937 rng(0);
+    const std::vector<uint8_t> src = random_bytes(rng, stride * height);
+    std::vector<uint8_t> dest(stride * height);
+    const TransferColorKey key = { SCE_GXM_TRANSFER_COLORKEY_REJECT, 0x00FF00FF, 0x00FFFFFF };
+
+    const auto measure = [&](const auto &transfer) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeat_count; i++) {
+            for (uint32_t y = 0; y < height; y++)
+                transfer(&dest[y * stride], &src[y * stride]);
+        }
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        return time.count() / repeat_count;
+    };
+
+    const double copy_key = measure([&](uint8_t *dest_row, const uint8_t *src_row) {
+        transfer_copy_row(dest_row, SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, src_row, SCE_GXM_TRANSFER_FORMAT_U8U8U8U8_ABGR, width, key);
+    });
+    const double copy_key_scalar = measure([&](uint8_t *dest_row, const uint8_t *src_row) {
+        reference_copy_row(dest_row, src_row, width, bytes_per_pixel, key);
+    });
+    const double fill = measure([&](uint8_t *dest_row, const uint8_t *) {
+        transfer_fill_row(dest_row, width, bytes_per_pixel, 0x12345678);
+    });
+    const double fill_scalar = measure([&](uint8_t *dest_row, const uint8_t *) {
+        reference_fill_row(dest_row, width, bytes_per_pixel, 0x12345678);
+    });
+    const double downscale = measure([&](uint8_t *dest_row, const uint8_t *src_row) {
+        transfer_downscale_row(dest_row, src_row, width / 2, bytes_per_pixel);
+    });
+    const double downscale_scalar = measure([&](uint8_t *dest_row, const uint8_t *src_row) {
+        reference_downscale_row(dest_row, src_row, width / 2, bytes_per_pixel);
+    });
+
+    std::printf("960x544 32-bit transfer, per pixel -> row kernels:\n");
+    std::printf("  copy with color key %.3f ms -> %.3f ms\n", copy_key_scalar, copy_key);
+    std::printf("  fill                %.3f ms -> %.3f ms\n", fill_scalar, fill);
+    std::printf("  downscale           %.3f ms -> %.3f ms\n", downscale_scalar, downscale);
+}
@@ -0,0 +1,103 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <renderer/vulkan/functions.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace renderer::vulkan;
+
+// Ring buffer backed by host memory instead of a Vulkan buffer
+class MemoryRingBuffer : public vkutil::RingBuffer {
+protected:
+    void create() override {
+        cursor = 0;
+    }
+
+public:
+    std::vector<uint8_t> memory;
+
+    explicit MemoryRingBuffer(const uint32_t capacity)
+        : RingBuffer(vma::Allocator(), vk::BufferUsageFlagBits::eStorageBuffer, capacity)
+        , memory(capacity) {
+        create();
+    }
+
+    void copy(vk::CommandBuffer cmd_buffer, const uint32_t size, const void *data, const uint32_t offset = 0) override {
+        memcpy(memory.data() + data_offset + offset, data, size);
+    }
+};
+
+static UniformStorage make_storage(const uint32_t size, const uint8_t value) {
+    UniformStorage storage;
+    storage.size = size;
+    storage.data.assign(size, value);
+    storage.dirty = true;
+    return storage;
+}
+
+TEST(uniform_storage, reuses_recent_copies_only) {
+    constexpr uint32_t capacity = 64 * 1024;
+    MemoryRingBuffer ring_buffer(capacity);
+    const vk::CommandBuffer cmd_buffer;
+
+    UniformStorage storage = make_storage(1024, 0x11);
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.offset, 0);
+    EXPECT_EQ(storage.cache.bytes_uploaded, 1024);
+    EXPECT_FALSE(storage.dirty);
+
+    // Nothing is uploaded when no uniform buffer was set
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.cache.bytes_uploaded, 1024);
+
+    // Other uniforms, then the first ones again
+    UniformStorage other = make_storage(1024, 0x22);
+    upload_uniform_storage(ring_buffer, other, cmd_buffer);
+    EXPECT_EQ(other.offset, 1024);
+
+    storage.dirty = true;
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.offset, 0);
+    EXPECT_EQ(storage.cache.bytes_uploaded, 1024);
+    EXPECT_EQ(storage.cache.bytes_reused, 1024);
+
+    // Changed content is copied
+    storage.data[5] = 0x33;
+    storage.dirty = true;
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.offset, 2048);
+    EXPECT_EQ(storage.cache.bytes_uploaded, 2048);
+
+    // More than half a buffer after the first copy, it is too old to be used by new draws
+    ring_buffer.allocate(capacity / 2);
+    storage.data[5] = 0x11;
+    storage.dirty = true;
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.offset, capacity / 2 + 3072);
+    EXPECT_EQ(storage.cache.bytes_uploaded, 3072);
+    EXPECT_EQ(memcmp(ring_buffer.memory.data() + storage.offset, storage.data.data(), storage.size), 0);
+
+    // The new copy is then the one reused
+    storage.dirty = true;
+    upload_uniform_storage(ring_buffer, storage, cmd_buffer);
+    EXPECT_EQ(storage.offset, capacity / 2 + 3072);
+    EXPECT_EQ(storage.cache.bytes_reused, 2048);
+}
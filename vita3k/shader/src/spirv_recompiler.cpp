@@ -42,6 +42,7 @@
 #include <iterator>
 #include <list>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -1711,6 +1712,7 @@ static SpirvCode convert_gxp_to_spirv_impl(const SceGxmProgram &program, const s
     if (dumper) {
         dumper("dsm", disasm_dump);
     }
+    disasm::disasm_storage = nullptr;
 
     b.dump(spirv);
 
@@ -1772,8 +1774,13 @@ static std::string convert_spirv_to_glsl(const std::string &shader_name, SpirvCo
 // ***********************
 
 void spirv_disasm_print(const usse::SpirvCode &spirv_binary, std::string *spirv_dump) {
+    // the glslang disassembler fills shared static tables, when several shaders are compiled at once
+    static std::mutex disasm_mutex;
     std::stringstream spirv_disasm;
-    spv::Disassemble(spirv_disasm, spirv_binary);
+    {
+        const std::lock_guard<std::mutex> lock(disasm_mutex);
+        spv::Disassemble(spirv_disasm, spirv_binary);
+    }
 
     if (spirv_dump) {
         *spirv_dump = spirv_disasm.str();
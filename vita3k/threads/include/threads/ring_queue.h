@@ -0,0 +1,165 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Bounded queue with any number of producers and a single consumer.
+// Pushing and popping are lock-free, the mutex is only taken to sleep when the queue
+// is full or empty and to wake up a thread sleeping on it.
+template <typename T, size_t Capacity>
+class RingQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    RingQueue() {
+        for (size_t i = 0; i < Capacity; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    RingQueue(const RingQueue &) = delete;
+    RingQueue &operator=(const RingQueue &) = delete;
+
+    // Returns false if the queue is full
+    bool try_push(const T &item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true) {
+            slot = &slots[pos & MASK];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = item;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        wake(consumer_waiting, cond_not_empty);
+
+        return true;
+    }
+
+    // Waits for some space if the queue is full, does nothing once aborted
+    void push(const T &item) {
+        while (!try_push(item)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++producers_waiting;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cond_not_full.wait(lock, [&] { return aborted || !full(); });
+            --producers_waiting;
+            if (aborted)
+                return;
+        }
+    }
+
+    // Item in front of the queue, which stays valid until pop is called, or nullptr if there is none.
+    // Waits for an item for up to the given time in microseconds, or until one is there if it is 0.
+    // Consumer only.
+    T *top(const int us = 0) {
+        if (T *item = front())
+            return item;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        consumer_waiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto ready = [&] { return aborted || front(); };
+        if (us == 0)
+            cond_not_empty.wait(lock, ready);
+        else
+            cond_not_empty.wait_for(lock, std::chrono::microseconds(us), ready);
+        consumer_waiting = false;
+
+        return aborted ? nullptr : front();
+    }
+
+    // Removes the item in front of the queue, which must be there. Consumer only.
+    void pop() {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        slots[pos & MASK].sequence.store(pos + Capacity, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_release);
+        wake(producers_waiting, cond_not_full);
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    void abort() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+        }
+        cond_not_empty.notify_all();
+        cond_not_full.notify_all();
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    T *front() {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        Slot &slot = slots[pos & MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return nullptr;
+
+        return &slot.value;
+    }
+
+    bool full() const {
+        return size() >= Capacity;
+    }
+
+    // The fences pair with the ones taken before sleeping: either the sleeper sees the new state,
+    // or the waker sees the sleeper
+    template <typename Waiting>
+    void wake(Waiting &waiting, std::condition_variable &cond) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            { const std::lock_guard<std::mutex> lock(mutex); }
+            cond.notify_all();
+        }
+    }
+
+    std::array<Slot, Capacity> slots;
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    alignas(64) std::atomic<size_t> head{ 0 };
+
+    std::mutex mutex;
+    std::condition_variable cond_not_empty;
+    std::condition_variable cond_not_full;
+    std::atomic<bool> consumer_waiting{ false };
+    std::atomic<uint32_t> producers_waiting{ 0 };
+    bool aborted = false;
+};
@@ -0,0 +1,136 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <threads/queue.h>
+#include <threads/ring_queue.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+TEST(ring_queue, fifo) {
+    RingQueue<int, 4> queue;
+    ASSERT_EQ(queue.top(1), nullptr);
+
+    for (int i = 0; i < 4; i++)
+        ASSERT_TRUE(queue.try_push(i));
+    ASSERT_FALSE(queue.try_push(4));
+    ASSERT_EQ(queue.size(), 4u);
+
+    for (int i = 0; i < 4; i++) {
+        int *item = queue.top();
+        ASSERT_NE(item, nullptr);
+        ASSERT_EQ(*item, i);
+        queue.pop();
+        ASSERT_TRUE(queue.try_push(i + 4));
+    }
+
+    for (int i = 4; i < 8; i++) {
+        ASSERT_EQ(*queue.top(), i);
+        queue.pop();
+    }
+    ASSERT_EQ(queue.size(), 0u);
+}
+
+TEST(ring_queue, abort) {
+    RingQueue<int, 2> queue;
+    std::thread consumer([&] {
+        ASSERT_EQ(queue.top(), nullptr);
+    });
+    queue.abort();
+    consumer.join();
+}
+
+TEST(ring_queue, producers) {
+    constexpr int PRODUCER_COUNT = 4;
+    constexpr int ITEM_COUNT = 100000;
+    RingQueue<std::pair<int, int>, 32> queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCER_COUNT; producer++) {
+        producers.emplace_back([&queue, producer] {
+            for (int i = 0; i < ITEM_COUNT; i++)
+                queue.push({ producer, i });
+        });
+    }
+
+    // every producer's items come out in order
+    std::vector<int> next(PRODUCER_COUNT, 0);
+    for (int i = 0; i < PRODUCER_COUNT * ITEM_COUNT; i++) {
+        const std::pair<int, int> item = *queue.top();
+        queue.pop();
+        ASSERT_EQ(item.second, next[item.first]);
+        next[item.first]++;
+    }
+
+    for (auto &producer : producers)
+        producer.join();
+    ASSERT_EQ(queue.size(), 0u);
+}
+
+// Command lists per second through the Queue command_buffer_queue used to be and through the ring,
+// one producer pushing while the render thread pops, as the renderer does with top then pop.
+// Opt-in, run with --gtest_also_run_disabled_tests
+TEST(ring_queue, DISABLED_benchmark) {
+    constexpr int ITEM_COUNT = 2000000;
+    // Stands for a CommandList, a pair of pointers
+    typedef std::pair<void *, void *> Item;
+
+    const auto measure = [&](const auto &push, const auto &pop) {
+        const auto start = std::chrono::steady_clock::now();
+        std::thread producer([&] {
+            for (int i = 0; i < ITEM_COUNT; i++)
+                push(Item{ nullptr, reinterpret_cast<void *>(static_cast<uintptr_t>(i)) });
+        });
+        int popped = 0;
+        for (int i = 0; i < ITEM_COUNT; i++)
+            popped += pop() == i;
+        producer.join();
+        const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+        EXPECT_EQ(popped, ITEM_COUNT);
+        return ITEM_COUNT / time.count() / 1e6;
+    };
+
+    Queue<Item> queue;
+    queue.maxPendingCount_ = 32;
+    const auto queue_push = [&](const Item &item) {
+        queue.push(item);
+    };
+    const auto queue_pop = [&] {
+        const auto item = queue.top();
+        queue.pop();
+        return static_cast<int>(reinterpret_cast<uintptr_t>(item->second));
+    };
+    const double queue_rate = measure(queue_push, queue_pop);
+
+    RingQueue<Item, 32> ring;
+    const auto ring_push = [&](const Item &item) {
+        ring.push(item);
+    };
+    const auto ring_pop = [&] {
+        const int value = static_cast<int>(reinterpret_cast<uintptr_t>(ring.top()->second));
+        ring.pop();
+        return value;
+    };
+    const double ring_rate = measure(ring_push, ring_pop);
+
+    std::printf("Queue %.1fM items/s, RingQueue %.1fM items/s\n", queue_rate, ring_rate);
+}
@@ -0,0 +1,64 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only view of a whole file mapped in memory, safe to read from several threads
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool open(const fs::path &path);
+    void close();
+
+    bool is_open() const {
+        return opened;
+    }
+
+    const uint8_t *data() const {
+        return view;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // True if [offset, offset + count) lies in the file
+    bool contains(uint64_t offset, uint64_t count) const {
+        return offset <= length && count <= length - offset;
+    }
+
+private:
+    const uint8_t *view = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef WIN32
+    void *mapping = nullptr;
+#endif
+};
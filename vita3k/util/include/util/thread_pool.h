@@ -0,0 +1,90 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running tasks in submission order, background tasks
+// only run when no other task is waiting
+class ThreadPool {
+public:
+    // 0 means one thread per hardware thread but one, with at least one thread
+    explicit ThreadPool(size_t thread_count = 0);
+    // Waits for the queued tasks to be done
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Workers shared by the whole emulator, created on first use. Everything running work in
+    // parallel goes through it, so that the subsystems don't each start one thread per core.
+    // Tasks must not wait for tasks submitted after them.
+    static ThreadPool &shared();
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F &&task) {
+        typedef std::invoke_result_t<F> Result;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        push([packaged] { (*packaged)(); }, false);
+
+        return result;
+    }
+
+    // Same as submit, for work nobody is waiting for right now
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit_background(F &&task) {
+        typedef std::invoke_result_t<F> Result;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        push([packaged] { (*packaged)(); }, true);
+
+        return result;
+    }
+
+    // Calls task(i) for every i in [0, count), on the pool and on the calling thread.
+    // Returns once they are all done, can be called from a task of the pool.
+    void parallel_for(size_t count, const std::function<void(size_t)> &task);
+
+    size_t thread_count() const {
+        return threads.size();
+    }
+
+    // Tasks submitted but not started yet
+    size_t queued_count();
+
+private:
+    void push(std::function<void()> task, bool background);
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> tasks;
+    std::deque<std::function<void()>> background_tasks;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
@@ -203,6 +203,15 @@ bool hasF16C(void) {
     return ((abcd[2] & (1 << 29)) != 0); // ecx bit 29 indicates F16C
 }
 
+// detect if CPU supports the AES-NI instruction set
+bool hasAES(void) {
+    if (instrset_detect() < 5)
+        return false; // must have SSE4.1
+    int abcd[4]; // cpuid results
+    cpuid(abcd, 1); // call cpuid function 1
+    return ((abcd[2] & (1 << 25)) != 0); // ecx bit 25 indicates AES-NI
+}
+
 // detect if CPU supports the AVX512ER instruction set
 bool hasAVX512ER(void) {
     if (instrset_detect() < 9)
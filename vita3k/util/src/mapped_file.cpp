@@ -0,0 +1,135 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/mapped_file.h>
+
+#include <util/log.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        view = std::exchange(other.view, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+#ifdef WIN32
+        mapping = std::exchange(other.mapping, nullptr);
+#endif
+    }
+
+    return *this;
+}
+
+bool MappedFile::open(const fs::path &path) {
+    close();
+
+#ifdef WIN32
+    const HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Could not open {} for mapping, error: {}", path.string(), GetLastError());
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Empty files cannot be mapped, they are just an empty view
+    if (file_size.QuadPart > 0) {
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            view = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!view) {
+            LOG_ERROR("Could not map {}, error: {}", path.string(), GetLastError());
+            if (mapping)
+                CloseHandle(mapping);
+            mapping = nullptr;
+            CloseHandle(file);
+            return false;
+        }
+    }
+    // The mapping keeps the file open
+    CloseHandle(file);
+    length = static_cast<size_t>(file_size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Could not open {} for mapping, errno: {}", path.string(), errno);
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (file_stat.st_size > 0) {
+        void *address = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            LOG_ERROR("Could not map {}, errno: {}", path.string(), errno);
+            ::close(fd);
+            return false;
+        }
+        // Files are mostly read front to back, let the kernel read ahead further
+        madvise(address, file_stat.st_size, MADV_SEQUENTIAL);
+        view = static_cast<const uint8_t *>(address);
+    }
+    ::close(fd);
+    length = static_cast<size_t>(file_stat.st_size);
+#endif
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef WIN32
+    if (view)
+        UnmapViewOfFile(view);
+    if (mapping)
+        CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    if (view)
+        munmap(const_cast<uint8_t *>(view), length);
+#endif
+    view = nullptr;
+    length = 0;
+    opened = false;
+}
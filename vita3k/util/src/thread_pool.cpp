@@ -0,0 +1,115 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+        const size_t hardware_threads = std::thread::hardware_concurrency();
+        thread_count = std::max<size_t>(hardware_threads, 2) - 1;
+    }
+
+    threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+
+    for (auto &thread : threads)
+        thread.join();
+}
+
+void ThreadPool::push(std::function<void()> task, bool background) {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        (background ? background_tasks : tasks).push_back(std::move(task));
+    }
+    cond.notify_one();
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return stopping || !tasks.empty() || !background_tasks.empty(); });
+            std::deque<std::function<void()>> &queue = tasks.empty() ? background_tasks : tasks;
+            if (queue.empty())
+                return;
+
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        task();
+    }
+}
+
+size_t ThreadPool::queued_count() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size() + background_tasks.size();
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &task) {
+    if (count == 0)
+        return;
+
+    struct Shared {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    // Helpers which start after everything is done still read it
+    const auto shared = std::make_shared<Shared>();
+
+    // Nobody waits on the helpers themselves, only on the items, so that
+    // a helper still queued behind the caller never blocks it
+    const auto work = [shared, &task, count] {
+        size_t index;
+        while ((index = shared->next++) < count) {
+            task(index);
+            if (++shared->done == count) {
+                const std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->cond.notify_all();
+            }
+        }
+    };
+
+    const size_t helper_count = std::min(threads.size(), count - 1);
+    for (size_t i = 0; i < helper_count; i++)
+        push(work, false);
+
+    work();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->cond.wait(lock, [&] { return shared->done == count; });
+}
@@ -95,11 +95,15 @@ protected:
 
     uint32_t cursor = ~0;
     uint32_t capacity;
+    // same as cursor but never goes back, going back to the beginning counts the end of the buffer left unused
+    uint64_t position = 0;
 
     virtual void create() = 0;
 
 public:
     uint32_t data_offset = 0;
+    // position of the data at data_offset, used to know if it has been overwritten since
+    uint64_t data_position = 0;
 
     explicit RingBuffer(vma::Allocator allocator, vk::BufferUsageFlags usage, const size_t capacity);
 
@@ -115,6 +119,14 @@ public:
         copy(cmd_buffer, data_size, data);
     }
 
+    // true if the data allocated at data_position can still be used by new commands after allocating reserve more bytes
+    // (aligned sizes), these allocations can skip at most reserve bytes at the end of the buffer
+    // the data must be at most half the buffer behind: the commands recorded before the GPU reads it allocate
+    // more after it, like for new data, and are assumed to use less than the other half
+    bool is_intact(const uint64_t data_position, const uint64_t reserve) const {
+        return position + 2 * reserve <= data_position + capacity / 2;
+    }
+
     vk::Buffer handle() const {
         return buffer.buffer;
     }
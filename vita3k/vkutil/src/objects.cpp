@@ -21,6 +21,8 @@
 
 #include <util/log.h>
 
+#include <algorithm>
+
 namespace vkutil {
 Image::Image() = default;
 
@@ -175,14 +177,18 @@ RingBuffer::RingBuffer(vma::Allocator allocator, vk::BufferUsageFlags usage, con
 void RingBuffer::allocate(const uint32_t data_size) {
     if (cursor + data_size > capacity) {
         // LOG_WARNING("End of buffer reached");
+        position += capacity - std::min(cursor, capacity);
         cursor = 0;
     }
 
     data_offset = cursor;
+    data_position = position;
 
+    const uint32_t old_cursor = cursor;
     cursor += data_size;
     // align to 256 bytes, the granularity is at most this value in any gpu
     cursor = (cursor + 255) & ~255;
+    position += cursor - old_cursor;
 }
 
 void HostRingBuffer::create() {
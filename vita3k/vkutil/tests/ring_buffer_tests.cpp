@@ -0,0 +1,141 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <vkutil/objects.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+// Ring buffer without GPU memory, remembers which allocation last wrote each 256-byte line
+class TrackedRingBuffer : public vkutil::RingBuffer {
+protected:
+    void create() override {
+        cursor = 0;
+    }
+
+public:
+    std::vector<uint64_t> owners;
+
+    uint64_t get_position() const {
+        return position;
+    }
+
+    explicit TrackedRingBuffer(const uint32_t capacity)
+        : RingBuffer(vma::Allocator(), vk::BufferUsageFlagBits::eVertexBuffer, capacity)
+        , owners(capacity / 256, UINT64_MAX) {
+        create();
+    }
+
+    void copy(vk::CommandBuffer cmd_buffer, const uint32_t size, const void *data, const uint32_t offset = 0) override {
+    }
+
+    void allocate_tracked(const uint32_t size) {
+        allocate(size);
+        for (uint32_t line = data_offset / 256; line < (data_offset + size + 255) / 256; line++)
+            owners[line] = data_position;
+    }
+
+    bool is_overwritten(const uint64_t position, const uint32_t offset, const uint32_t size) const {
+        for (uint32_t line = offset / 256; line < (offset + size + 255) / 256; line++) {
+            if (owners[line] != position)
+                return true;
+        }
+        return false;
+    }
+};
+
+TEST(ring_buffer, intact_within_half_the_buffer) {
+    TrackedRingBuffer ring_buffer(4096);
+
+    ring_buffer.allocate_tracked(300);
+    const uint64_t position = ring_buffer.data_position;
+    EXPECT_EQ(ring_buffer.data_offset, 0);
+    EXPECT_TRUE(ring_buffer.is_intact(position, 0));
+    EXPECT_TRUE(ring_buffer.is_intact(position, 768));
+    EXPECT_FALSE(ring_buffer.is_intact(position, 1024));
+
+    // 512 bytes aligned, then up to half the buffer
+    ring_buffer.allocate_tracked(1536);
+    EXPECT_TRUE(ring_buffer.is_intact(position, 0));
+    ring_buffer.allocate_tracked(1);
+    EXPECT_FALSE(ring_buffer.is_intact(position, 0));
+    EXPECT_FALSE(ring_buffer.is_overwritten(position, 0, 300));
+
+    // The end of the buffer skipped when wrapping counts, 768 skipped and 1280 allocated is more than half
+    TrackedRingBuffer wrapping(4096);
+    wrapping.allocate_tracked(3000);
+    wrapping.allocate_tracked(256);
+    const uint64_t last = wrapping.data_position;
+    EXPECT_TRUE(wrapping.is_intact(last, 0));
+    wrapping.allocate_tracked(1025);
+    EXPECT_EQ(wrapping.data_offset, 0);
+    EXPECT_EQ(wrapping.data_position, 4096);
+    EXPECT_FALSE(wrapping.is_intact(last, 0));
+}
+
+TEST(ring_buffer, intact_data_is_never_overwritten) {
+    constexpr uint32_t capacity = 64 * 1024;
+    std::mt19937 rng(9);
+    TrackedRingBuffer ring_buffer(capacity);
+
+    struct Allocation {
+        uint64_t position;
+        uint32_t offset;
+        uint32_t size;
+    };
+    std::vector<Allocation> allocations;
+
+    for (int i = 0; i < 20000; i++) {
+        // The reserve is the aligned size of the next few allocations, like for the streams of a draw
+        std::vector<uint32_t> parts(rng() % 4);
+        uint64_t reserve = 0;
+        for (uint32_t &part : parts) {
+            part = rng() % 2 ? rng() % 512 + 1 : rng() % 8192 + 1;
+            reserve += (part + 255) & ~255;
+        }
+
+        std::vector<Allocation> intact;
+        for (const Allocation &allocation : allocations) {
+            if (ring_buffer.is_intact(allocation.position, reserve))
+                intact.push_back(allocation);
+        }
+
+        for (const uint32_t part : parts)
+            ring_buffer.allocate_tracked(part);
+
+        // Still there, and with half the buffer left before it is overwritten
+        for (const Allocation &allocation : intact) {
+            ASSERT_FALSE(ring_buffer.is_overwritten(allocation.position, allocation.offset, allocation.size)) << i;
+            ASSERT_LE(ring_buffer.get_position(), allocation.position + capacity / 2) << i;
+        }
+
+        // Data is only overwritten once a full buffer has been allocated after it
+        for (const Allocation &allocation : allocations) {
+            if (ring_buffer.is_overwritten(allocation.position, allocation.offset, allocation.size)) {
+                ASSERT_GT(ring_buffer.get_position(), allocation.position + capacity) << i;
+            }
+        }
+
+        const uint32_t size = rng() % 2 ? rng() % 512 + 1 : rng() % 8192 + 1;
+        ring_buffer.allocate_tracked(size);
+        allocations.push_back({ ring_buffer.data_position, ring_buffer.data_offset, size });
+        if (allocations.size() > 100)
+            allocations.erase(allocations.begin());
+    }
+}